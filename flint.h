@@ -69,6 +69,9 @@ extern "C" {
 #define FLINT_BACKEND_ONLY_CPU 1
 #define FLINT_BACKEND_ONLY_GPU 2
 #define FLINT_BACKEND_BOTH 3
+/** Compiles graphs that are executed on the CPU to native code (implies
+ * `FLINT_BACKEND_ONLY_CPU`), see `fExecuteGraph_cpu_jit`. */
+#define FLINT_BACKEND_CPU_JIT 4
 
 /** Types of erros that can occur in the framework (also see `fErrorMessage`)
  * Error Types:
@@ -109,8 +112,10 @@ typedef enum FErrorType FErrorType;
  * disabling of the gpu backend (by passing `FLINT_BACKEND_ONLY_CPU`), disabling
  * of the cpu backend (by passing `FLINT_BACKEND_BOTH`), initializing both
  * backends explicitly (by passing `FLINT_BACKEND_BOTH`, which is recommended,
- * since Flint is then allowed to choose the framework with heuristics). Only
- * use those functions if you...
+ * since Flint is then allowed to choose the framework with heuristics). Adding
+ * `FLINT_BACKEND_CPU_JIT` executes the graphs that would be executed by the cpu
+ * backend with natively compiled code instead. Only use those functions if
+ * you...
  * - ...want to explicitly decide where and when the initialization should take
  *      place
  * - ...want to only start one backend
@@ -127,9 +132,13 @@ FErrorType flintInit_cpu();
  * `flintInit`. Returns `NO_ERROR` on success or the error type */
 FErrorType flintInit_gpu();
 
+/** Don't call this function explicitly if you intent to use Flint normally. Use
+ * `flintInit`. Returns `NO_ERROR` on success or the error type */
+FErrorType flintInit_cpu_jit();
+
 /** Returns an integer containing the Backend information bitwise.
- * See constants `FLINT_BACKEND_ONLY_CPU`, `FLINT_BACKEND_ONLY_GPU` and
- * `FLINT_BACKEND_BOTH`. */
+ * See constants `FLINT_BACKEND_ONLY_CPU`, `FLINT_BACKEND_ONLY_GPU`,
+ * `FLINT_BACKEND_BOTH` and `FLINT_BACKEND_CPU_JIT`. */
 int flintInitializedBackends();
 
 /** Deallocates any resourced allocated by the corresponding backends.
@@ -148,6 +157,52 @@ FErrorType flintCleanup_cpu();
  * type */
 FErrorType flintCleanup_gpu();
 
+/** Unloads the natively compiled graphs of the cpu jit backend, if it was
+ * initialized, else it does nothing. Returns `NO_ERROR` on success or the error
+ * type */
+FErrorType flintCleanup_cpu_jit();
+
+/** Measures the execution times of the operations on the initialized backends
+ * (sequentially and in parallel on the cpu and on the gpu if it is
+ * initialized) for a range of sizes, fits a cost curve per operation and
+ * stores them to `path` (or the default path, see `fLoadCostModel`, if `path`
+ * is NULL). Afterwards those curves decide which backend executes a graph and
+ * if a node is executed in parallel on the cpu instead of the built-in
+ * heuristics. Takes a few seconds. Returns `NO_ERROR` on success or the error
+ * type */
+FErrorType fCalibrateCostModel(const char *path);
+
+/** Loads a cost model that was stored by `fCalibrateCostModel` from `path`. If
+ * `path` is NULL the environment variable `FLINT_COST_MODEL` or else
+ * `$XDG_CACHE_HOME/flint/cost_model` (`~/.cache/flint/cost_model`) is used.
+ * `flintInit` loads that default file if it exists, or calibrates the model
+ * if the environment variable `FLINT_CALIBRATE` is set to 1. Returns
+ * `NO_ERROR` on success or the error type */
+FErrorType fLoadCostModel(const char *path);
+
+/** Discards the loaded cost model, the built-in heuristics are used again */
+void fResetCostModel();
+
+/** Configures the threads of the cpu backend: `num_threads` threads (0 for one
+ * per hardware thread), counting the thread that calls Flint, which helps
+ * executing and is never pinned. `cpus` and `numa_nodes` may be NULL or
+ * contain `num_threads - 1` entries, one for each worker thread: worker `i` is
+ * pinned to the cpu `cpus[i]`, or if that is -1 (or `cpus` is NULL) to the
+ * cpus of the NUMA node `numa_nodes[i]`, or stays unpinned if that is -1 too.
+ * If both are NULL the workers are distributed evenly over the NUMA nodes of
+ * the system. Restarts the thread pool if the backend is already initialized,
+ * so it may not be called during an execution. Returns `NO_ERROR` on success
+ * or the error type (`INVALID_SELECT` for unknown cpus or NUMA nodes) */
+FErrorType fConfigureThreads_cpu(unsigned int num_threads, const int *cpus,
+								 const int *numa_nodes);
+
+/** Number of threads the cpu backend executes with (or will execute with
+ * once it is initialized), see `fConfigureThreads_cpu` */
+unsigned int fNumThreads_cpu();
+
+/** Number of NUMA nodes of the system, 1 if the topology is unknown */
+int fNumNumaNodes();
+
 /**
  * See also: `flogging`, `FLogType`
  * - `F_DEBUG` (only internal debugging informations of the framework),
@@ -215,13 +270,74 @@ void fDisableEagerExecution();
 /** Returns 1 if eager execution has been enabled, else 0 */
 int fIsEagerExecution();
 
-/** The 4 allowed data types:
+/** Accuracy of the transcendental functions (`flog`, `flog2`, `flog10`,
+ * `fsin`, `fcos`, `ftan`, `fsqrt_g`, `fexp` and `fpow_g`) on the cpu backend:
+ * - `F_STRICT_MATH` (default) computes them with the C math library
+ * - `F_FAST_MATH` uses branch-free polynomial approximations that the
+ *   compiler vectorizes. Their error is at most 2 ulp (4 ulp for `ftan` of
+ *   doubles), special values (0, infinities, NaN) are handled like the C
+ *   library does. They are only faster than the C library if Flint is
+ *   compiled with optimizations for a cpu with vector instructions (e.g.
+ *   `-O3 -march=native`).
+ * The cpu jit and the gpu backend always use their built-in functions. */
+enum FMathAccuracy { F_STRICT_MATH, F_FAST_MATH };
+
+/** Sets the accuracy of the transcendental functions, see `FMathAccuracy` */
+void fSetMathAccuracy(enum FMathAccuracy accuracy);
+
+/** Returns the accuracy of the transcendental functions, see
+ * `FMathAccuracy` */
+enum FMathAccuracy fMathAccuracy();
+
+/** Algorithm of the cpu backend for convolutions (`fconvolve` and its
+ * gradients):
+ * - `F_CONV_AUTO` (default) chooses from the shapes and steps: Winograd for
+ *   3x3 kernels with step 1 over the last two dimensions (floating point
+ *   types), a direct matrix multiplication for 1x1 kernels with step 1, im2col
+ *   and matrix multiplication for other kernels with many elements and a
+ *   direct loop over the windows for small kernels
+ * - `F_CONV_IM2COL` always lowers to im2col and matrix multiplication
+ * - `F_CONV_GENERIC` always uses the generic implementation, which
+ *   reconstructs the multidimensional index of every element
+ * The results of Winograd differ from the other algorithms by rounding. */
+enum FConvolutionAlgorithm { F_CONV_AUTO, F_CONV_IM2COL, F_CONV_GENERIC };
+
+/** Sets the algorithm of the convolutions, see `FConvolutionAlgorithm` */
+void fSetConvolutionAlgorithm(enum FConvolutionAlgorithm algorithm);
+
+/** Returns the algorithm of the convolutions, see `FConvolutionAlgorithm` */
+enum FConvolutionAlgorithm fConvolutionAlgorithm();
+
+/** The 8 allowed data types:
  * - `F_INT32`(integer, 32bit)
  * - `F_INT64`(integer, 64bit)
  * - `F_FLOAT32` (floating point, 32bit)
  * - `F_FLOAT64` (floating point, 64bit)
+ * - `F_FLOAT16` (floating point, 16bit, IEEE 754 half precision)
+ * - `F_BFLOAT16` (floating point, 16bit, the upper half of a `F_FLOAT32`)
+ * - `F_INT8` (integer, 8bit)
+ * - `F_UINT8` (unsigned integer, 8bit)
+ * The 16bit types are storage types: their data is passed as 16bit patterns
+ * (e.g. `uint16_t`), operations read them as `F_FLOAT32`, compute in 32bit
+ * and round the results to the nearest representable value. Operations with a
+ * `F_FLOAT16` and a `F_BFLOAT16` tensor result in `F_FLOAT32`, constants don't
+ * widen them.
+ * The 8bit types hold quantized values (see `fquantize`), operations compute
+ * them in `F_INT32`. Operations with a `F_INT8` and a `F_UINT8` tensor result
+ * in `F_INT32`, just like matrix multiplications and convolutions of two 8bit
+ * tensors (which accumulate the products of the stored integers) and sum and
+ * product reductions of 8bit tensors.
  */
-enum FType { F_INT32, F_INT64, F_FLOAT32, F_FLOAT64 };
+enum FType {
+	F_INT32,
+	F_INT64,
+	F_FLOAT32,
+	F_FLOAT64,
+	F_FLOAT16,
+	F_BFLOAT16,
+	F_INT8,
+	F_UINT8
+};
 
 enum FOperationType {
 	FSTORE,
@@ -277,6 +393,17 @@ enum FOperationType {
 	FPOOLING_SUM,
 	FGRADIENT_POOLING_MAX, // only for internal use
 	FDROPOUT,
+	FQUANTIZE,
+	FDEQUANTIZE,
+	FSPARSE,
+	FSPARSE_MATMUL,
+	FSOFTMAX,
+	FLOG_SOFTMAX,
+	FSOFTMAX_CROSS_ENTROPY,
+	FBATCH_MOMENTS,
+	FBATCH_NORM,
+	FGRADIENT_BATCH_NORM_SUMS,
+	FGRADIENT_BATCH_NORM,
 	FNUM_OPERATION_TYPES
 };
 
@@ -312,7 +439,10 @@ typedef struct FOperation FOperation;
  * - ...the data size is changed, num_entries is equivalently updated and
  *      `realloc` is used and ...
  * - ...the data was not already loaded to the gpu (i.e. the result must be the
- *        return value of `fExecuteGraph_cpu`)
+ *        return value of `fExecuteGraph_cpu`) and ...
+ * - ...the data is not shared with other nodes (results of `fflatten`,
+ *        `freshape` and slices of contiguous ranges share the data of their
+ *        parameter instead of copying it)
  */
 struct FResultData {
 		// link to gpu data
@@ -450,6 +580,36 @@ FGraphNode *farange(const size_t *shape, const int dimensions, const int ax);
  * since those are handled by the reference counting system.*/
 void fFreeGraph(FGraphNode *graph);
 
+/** Statistics of the pool the data of tensors is allocated from, see
+ * `fMemoryPoolStatistics`. The hit rate of the pool is `hits / allocations`.
+ */
+struct FMemoryPoolStatistics {
+		// number of buffers requested from the pool
+		size_t allocations;
+		// number of requests that were served by a previously released buffer
+		size_t hits;
+		// bytes of released buffers that are kept for reuse
+		size_t retained_bytes;
+		// bytes of buffers that are currently in use
+		size_t used_bytes;
+};
+typedef struct FMemoryPoolStatistics FMemoryPoolStatistics;
+
+/** Returns the statistics of the buffer pool. Data of tensors that is freed
+ * with `fFreeGraph` is not returned to the system, but kept by the pool so that
+ * following executions with the same sizes can reuse it. */
+FMemoryPoolStatistics fMemoryPoolStatistics();
+
+/** Releases buffers that are kept by the pool for reuse to the system until at
+ * most `max_retained_bytes` bytes are retained (pass 0 to release all of them).
+ * Buffers that are in use are not affected. */
+void fTrimMemoryPool(size_t max_retained_bytes);
+
+/** Sets the maximum number of bytes the buffer pool retains for reuse (default
+ * 1 GiB), buffers that are released beyond that are returned to the system
+ * directly. Trims the pool to the new limit. */
+void fSetMemoryPoolLimit(size_t max_retained_bytes);
+
 /** Executes the graph node operations from all yet to be executed predecessors
  * to `node` and returns a node with a `FResultData` operation in
  * which the resulting data is stored.
@@ -483,6 +643,14 @@ FGraphNode *fExecuteGraph(FGraphNode *node);
  * which the resulting data is stored. */
 FGraphNode *fExecuteGraph_cpu(FGraphNode *node);
 
+/** Returns the number of bytes `fExecuteGraph_cpu` will allocate to execute
+ * `node` without executing it. The intermediate results that are only needed
+ * during the execution are planned into one block of memory by their live
+ * ranges, so the prediction is the size of that block plus the size of the
+ * result. Data of already executed nodes is not included. Allows to size e.g.
+ * batches before the execution. */
+size_t fPredictPeakMemory_cpu(FGraphNode *node);
+
 /** Executes the graph node operations from all yet to be executed predecessors
  * to `node` and returns a node with a `FResultData` operation in
  * which the resulting data is stored. For the GPU
@@ -494,6 +662,19 @@ FGraphNode *fExecuteGraph_cpu(FGraphNode *node);
  * backend can reuse already compiled kernels. */
 FGraphNode *fExecuteGraph_gpu(FGraphNode *node);
 
+/** Executes the graph node operations from all yet to be executed predecessors
+ * to `node` and returns a node with a `FResultData` operation in
+ * which the resulting data is stored. Like the lazy GPU backend the
+ * operations are combined into one function, which is compiled with the system
+ * C++ compiler (`FLINT_JIT_CXX`, `CXX` or `c++`) and executed by the cpu
+ * threads. Shapes and types are constants of the generated code. Compiled
+ * graphs are cached on disk (in `FLINT_JIT_CACHE`, `$XDG_CACHE_HOME/flint` or
+ * `~/.cache/flint`), so graph structures only have to be compiled once.
+ * Graphs that can't be compiled (or contain random operations, whose seeds
+ * would lead to a new compilation each time) are executed by
+ * `fExecuteGraph_cpu`. */
+FGraphNode *fExecuteGraph_cpu_jit(FGraphNode *node);
+
 /** Executes the graph node directly and assumes that predecessor data has
  * already been computed. Uses the CPU backend. Mainly used by helper functions
  * of the framework, only use it if you now what you are doing.
@@ -808,8 +989,16 @@ FGraphNode *fequal_cd(FGraphNode *a, const double b);
  * tensor multiple other previous entries are needed, the operand tensors need
  * to be executed first. Therefor the method will implicitly (or eagerly)
  * execute the two parameter nodes `a` and `b` if their data is not already
- * present. */
+ * present. If `a` is a sparse matrix (see `fsparse`) and `b` a matrix, only
+ * the stored entries of `a` are multiplied. */
 FGraphNode *fmatmul(FGraphNode *a, FGraphNode *b);
+/** Like `fmatmul`, but multiplies the matrices of `a` transposed in their last
+ * two dimensions if `transpose_a` is not 0 and the ones of `b` transposed if
+ * `transpose_b` is not 0. The transpositions are never materialized, e.g.
+ * tensors with shapes `(64, 16, 32)` and `(24, 16)` with `transpose_a` and
+ * `transpose_b` set yield a tensor with shape `(64, 32, 24)`. */
+FGraphNode *fmatmul_transposed(FGraphNode *a, FGraphNode *b, int transpose_a,
+							   int transpose_b);
 /** Flattens the complete tensor to a tensor with one
 dimension.
 E.g.`flattened([[[3, 1, 4], [2, 1, 5]], [[0, 4, 2], [4, 7, 9]]]) = [3, 1, 4, 2,
@@ -825,7 +1014,8 @@ it's not possible to flatten the dimension 0. A Tensor `[[[3, 1, 4], [2, 1, 5]],
 */
 FGraphNode *fflatten_dimension(FGraphNode *a, int dimension);
 
-/** Converts the data of `a` to the type given by `newtype`*/
+/** Converts the data of `a` to the type given by `newtype`. Conversions to
+ * `F_FLOAT16` and `F_BFLOAT16` round to the nearest even value. */
 FGraphNode *fconvert(FGraphNode *a, enum FType newtype);
 /** Reshapes the underlying data of the tensor to the new shape. The product of
   each dimension of the new shape must be the same as the product of the
@@ -899,6 +1089,39 @@ FGraphNode *freduce_min(FGraphNode *a, const int dimension);
  * ensure that the method may execute the parameter node.*/
 FGraphNode *freduce_max(FGraphNode *a, const int dimension);
 
+/** Reduces the `num_axes` dimensions `axes` of the tensor by additive folding
+ * at once, e.g.
+ *
+ * `freduce_sum_axes([[[1,2],[3,4]], [[5,6],[7,8]]], {0, 1}, 2, false) =
+ * [16,20]`
+ *
+ * Negative axes count from the end. If `keepdims` is set the reduced
+ * dimensions are kept with a size of 1, else they are removed (reducing all
+ * of them yields a tensor of shape `[1]`). Consecutive axes are reduced in
+ * one pass. */
+FGraphNode *freduce_sum_axes(FGraphNode *a, const int *axes,
+							 const int num_axes, const int keepdims);
+
+/** Reduces the `num_axes` dimensions `axes` of the tensor by multiplicative
+ * folding at once, see `freduce_sum_axes`. */
+FGraphNode *freduce_mul_axes(FGraphNode *a, const int *axes,
+							 const int num_axes, const int keepdims);
+
+/** Reduces the `num_axes` dimensions `axes` of the tensor by keeping the
+ * minimum at once, see `freduce_sum_axes`. */
+FGraphNode *freduce_min_axes(FGraphNode *a, const int *axes,
+							 const int num_axes, const int keepdims);
+
+/** Reduces the `num_axes` dimensions `axes` of the tensor by keeping the
+ * maximum at once, see `freduce_sum_axes`. */
+FGraphNode *freduce_max_axes(FGraphNode *a, const int *axes,
+							 const int num_axes, const int keepdims);
+
+/** Mean of the tensor over the `num_axes` dimensions `axes`, see
+ * `freduce_sum_axes`. The mean of integer tensors is of type `F_FLOAT64`. */
+FGraphNode *freduce_mean_axes(FGraphNode *a, const int *axes,
+							  const int num_axes, const int keepdims);
+
 /** Selects a slice of the tensor with a dimension wise start and end index.
  * `start` and `end` are arrays with as many entries
  * as the tensor has dimensions. They may contain negative values,
@@ -1176,6 +1399,91 @@ FGraphNode *fpooling_max(FGraphNode *a, const size_t *window_size,
  * 0.4. each element has a 40% probability of being set to 0).
  */
 FGraphNode *fdropout(FGraphNode *g, const double p);
+
+/**
+ * Quantizes `a` to the 8bit type `type` (`F_INT8` or `F_UINT8`), i.e. computes
+ * `round(a / scale) + zero_point` (rounded to the nearest even integer) and
+ * clamps it to the range of `type`. NaN is quantized to `zero_point`.
+ * `scale` (converted to `F_FLOAT32`) and `zero_point` (converted to `F_INT32`)
+ * are broadcasted to `a` like the parameters of `fadd`: single element tensors
+ * quantize the whole tensor, tensors with the shape of the trailing
+ * dimensions of `a` (or of its leading dimensions, see
+ * `fEnforceInverseBroadcasting`) quantize each channel separately. The
+ * gradient passes through the rounding (straight through estimator).
+ */
+FGraphNode *fquantize(FGraphNode *a, FGraphNode *scale, FGraphNode *zero_point,
+					  enum FType type);
+/**
+ * Inverse of `fquantize`: computes `(a - zero_point) * scale` as `F_FLOAT32`
+ * for an integer tensor `a` with the broadcasting of `fquantize`. This also
+ * dequantizes the `F_INT32` results of `fmatmul` and `fconvolve` of two 8bit
+ * tensors (with the product of their scales), if their zero points are 0.
+ */
+FGraphNode *fdequantize(FGraphNode *a, FGraphNode *scale,
+						FGraphNode *zero_point);
+/**
+ * Creates a sparse matrix with the shape `shape` (rows and columns) that
+ * contains the entries of the one dimensional tensor `values` at the
+ * positions `rows[i]`, `columns[i]` (both arrays have one entry per value) and
+ * zeros everywhere else. Only the values are stored, compressed by rows (CSR):
+ * together with their column indices and the offset of each row (both as
+ * `F_INT64` tensors). Entries at the same position are not merged, each one
+ * stays a stored entry and they add up whenever the matrix is used.
+ * `fmatmul` of a sparse matrix with a dense matrix only touches the stored
+ * entries, every other operation uses it as the dense matrix it represents.
+ * The gradients are calculated for `values` (one per stored entry).
+ */
+FGraphNode *fsparse(FGraphNode *values, const size_t *rows,
+					const size_t *columns, const size_t *shape);
+/**
+ * Normalizes `a` along the dimension `ax` with the softmax function, i.e.
+ * `exp(a - max(a)) / sum(exp(a - max(a)))` where the maximum and the sum are
+ * taken along `ax`. The maximum and the sum are computed in a single pass
+ * without any intermediate tensors. Integer tensors are converted to
+ * `F_FLOAT64`.
+ */
+FGraphNode *fsoftmax(FGraphNode *a, const int ax);
+/**
+ * The natural logarithm of `fsoftmax(a, ax)`, i.e.
+ * `a - max(a) - log(sum(exp(a - max(a))))` along `ax`, which stays accurate
+ * for very small probabilities.
+ */
+FGraphNode *flog_softmax(FGraphNode *a, const int ax);
+/**
+ * The cross entropy between the softmax of `a` along the dimension `ax` (see
+ * `fsoftmax`) and `labels`, i.e. `-sum(labels * flog_softmax(a, ax))` along
+ * `ax`. The result has the shape of `a` without the dimension `ax` (like
+ * `freduce_sum(a, ax)`).
+ * `labels` is either a distribution with the same shape as `a` or an integer
+ * tensor with the shape of the result that contains the index of the correct
+ * class (between 0 and the size of `ax`) for each row.
+ * The softmax is never materialized and the gradient for `a` is
+ * `fsoftmax(a, ax) - labels` (with the labels one-hot encoded for indices).
+ */
+FGraphNode *fsoftmax_cross_entropy(FGraphNode *a, FGraphNode *labels,
+								   const int ax);
+/**
+ * The mean and the (biased) variance of every channel of `a` along the
+ * dimension `ax`, i.e. over all other dimensions, computed in a single pass.
+ * The result has the shape `[2, a->operation.shape[ax]]` with the means in the
+ * first and the variances in the second row, which is the layout `fbatch_norm`
+ * expects. Integer tensors are converted to `F_FLOAT64`.
+ * The statistics are not differentiated on their own, their gradient is only
+ * accounted for when they are passed to `fbatch_norm` together with `a`.
+ */
+FGraphNode *fbatch_moments(FGraphNode *a, const int ax);
+/**
+ * Batch normalization of `a` with the channels along the dimension `ax`, i.e.
+ * `(a - mean) / sqrt(var + epsilon) * gamma + beta` where `mean` and `var` are
+ * the two rows of `moments` (see `fbatch_moments`) and `gamma` and `beta`
+ * have one entry per channel. Everything is computed in a single pass
+ * without transposing `a` or broadcasting the parameters to its shape.
+ * If `moments` is `fbatch_moments(a, ax)` the gradient for `a` is derived
+ * through the statistics with one fused kernel, otherwise the statistics are
+ * treated like any other operand (e.g. running statistics during inference).
+ */
+FGraphNode *fbatch_norm(FGraphNode *a, FGraphNode *moments, FGraphNode *gamma,
+						FGraphNode *beta, const int ax, const double epsilon);
 #ifdef __cplusplus
 }
 
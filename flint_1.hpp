@@ -299,6 +299,15 @@ template <typename T> struct Tensor<T, 1> {
 		Tensor<T, 1> reduce_max() {
 			return Tensor<T, 1>(freduce_max(node, 0), std::array<size_t, 1>{1});
 		}
+		/** Normalizes the tensor with the softmax function, i.e.
+		 * `exp(x - max(x)) / sum(exp(x - max(x)))` (see `fsoftmax`). */
+		Tensor<to_float<T>, 1> softmax() {
+			return Tensor<to_float<T>, 1>(fsoftmax(node, 0), shape);
+		}
+		/** The natural logarithm of `softmax()` (see `flog_softmax`). */
+		Tensor<to_float<T>, 1> log_softmax() {
+			return Tensor<to_float<T>, 1>(flog_softmax(node, 0), shape);
+		}
 		/** Returns the number of entries in this Tensor */
 		const std::array<size_t, 1> get_shape() const { return shape; }
 		/**
@@ -156,6 +156,14 @@ inline std::string type_string(FType t) {
 		return "float";
 	case F_FLOAT64:
 		return "double";
+	case F_FLOAT16:
+		return "float16";
+	case F_BFLOAT16:
+		return "bfloat16";
+	case F_INT8:
+		return "int8";
+	case F_UINT8:
+		return "uint8";
 	}
 	return "";
 }
@@ -198,8 +206,16 @@ inline FType higher_type(const FType a, const FType b) {
 		highest = F_FLOAT64;
 	else if (a == F_FLOAT32 || (b == F_FLOAT32))
 		highest = F_FLOAT32;
+	else if (a == F_FLOAT16 || (b == F_FLOAT16))
+		// neither of the 16bit types can represent the other one
+		highest = a == F_BFLOAT16 || b == F_BFLOAT16 ? F_FLOAT32 : F_FLOAT16;
+	else if (a == F_BFLOAT16 || (b == F_BFLOAT16))
+		highest = F_BFLOAT16;
 	else if (a == F_INT64 || (b == F_INT64))
 		highest = F_INT64;
+	else if (a == b)
+		// the 8bit types only stay 8bit if both have the same one
+		highest = a;
 	return highest;
 }
 /** Returns the higher of two flint types, as a constexpr */
@@ -209,8 +225,16 @@ inline constexpr FType higher_type_constexpr(const FType a, const FType b) {
 		highest = F_FLOAT64;
 	else if (a == F_FLOAT32 || (b == F_FLOAT32))
 		highest = F_FLOAT32;
+	else if (a == F_FLOAT16 || (b == F_FLOAT16))
+		// neither of the 16bit types can represent the other one
+		highest = a == F_BFLOAT16 || b == F_BFLOAT16 ? F_FLOAT32 : F_FLOAT16;
+	else if (a == F_BFLOAT16 || (b == F_BFLOAT16))
+		highest = F_BFLOAT16;
 	else if (a == F_INT64 || (b == F_INT64))
 		highest = F_INT64;
+	else if (a == b)
+		// the 8bit types only stay 8bit if both have the same one
+		highest = a;
 	return highest;
 }
 template <typename K> static constexpr bool is_int() {
@@ -796,11 +796,19 @@ template <typename T, unsigned int n> struct Tensor {
 		 * //   [9.500000, 7.000000, 7.000000]],
 		 * //  [[18.500000, 13.000000, 14.000000],
 		 * //   [27.500000, 19.000000, 21.000000]]])
-		 * }*/
+		 * }
+		 *
+		 * If `transpose_this` or `transpose_other` is set, the matrices of
+		 * this Tensor or of `other` are transposed in their last two
+		 * dimensions, without materializing the transposition (see
+		 * `fmatmul_transposed`).*/
 		template <typename K, unsigned int k>
-		Tensor<stronger_return<K>, k >= n ? k : n> matmul(Tensor<K, k> &other) {
-			int x = shape[shape.size() - 2];
-			int z = other.shape[other.shape.size() - 1];
+		Tensor<stronger_return<K>, k >= n ? k : n>
+		matmul(Tensor<K, k> &other, bool transpose_this = false,
+			   bool transpose_other = false) {
+			int x = shape[shape.size() - (transpose_this ? 1 : 2)];
+			int z =
+				other.shape[other.shape.size() - (transpose_other ? 2 : 1)];
 			std::array<size_t, k >= n ? k : n> ns;
 			for (size_t i = 0; i < ns.size() - 2; i++) {
 				ns[i] = k >= n ? other.shape[i] : shape[i];
@@ -808,7 +816,10 @@ template <typename T, unsigned int n> struct Tensor {
 			ns[ns.size() - 2] = x;
 			ns[ns.size() - 1] = z;
 			return Tensor < stronger_return<K>,
-				   k >= n ? k : n > (fmatmul(node, other.node), ns);
+				   k >= n ? k : n > (fmatmul_transposed(node, other.node,
+														transpose_this,
+														transpose_other),
+									 ns);
 		}
 		/**
 		 * Converts this Tensor (and the underlying data) to type `K` given in
@@ -1055,7 +1066,11 @@ template <typename T, unsigned int n> struct Tensor {
 		 *
 		 * The results of this Tensor must be available, to
 		 * ensure that the method may execute the Tensor. */
-		Tensor<T, 1> reduce_mul() { return flattened().reduce_mul(); }
+		Tensor<T, 1> reduce_mul() {
+			const std::array<int, n> axes = all_axes();
+			return Tensor<T, 1>(freduce_mul_axes(node, axes.data(), n, false),
+								1);
+		}
 		/** Reduces all dimension of the tensor by summation e.g.
 		 *
 		 * @code{
@@ -1066,7 +1081,11 @@ template <typename T, unsigned int n> struct Tensor {
 		 *
 		 * The results of this Tensor must be available, to
 		 * ensure that the method may execute the Tensor. */
-		Tensor<T, 1> reduce_sum() { return flattened().reduce_sum(); }
+		Tensor<T, 1> reduce_sum() {
+			const std::array<int, n> axes = all_axes();
+			return Tensor<T, 1>(freduce_sum_axes(node, axes.data(), n, false),
+								1);
+		}
 		/** Reduces one dimension of the tensor by keeping the minimum e.g.
 		 *
 		 * @code{
@@ -1108,7 +1127,11 @@ template <typename T, unsigned int n> struct Tensor {
 		 *
 		 * The results of this Tensor must be available, to
 		 * ensure that the method may execute the Tensor. */
-		Tensor<T, 1> reduce_min() { return flattened().reduce_min(); }
+		Tensor<T, 1> reduce_min() {
+			const std::array<int, n> axes = all_axes();
+			return Tensor<T, 1>(freduce_min_axes(node, axes.data(), n, false),
+								1);
+		}
 		/** Reduces one dimension of the tensor by keeping the maximum e.g.
 		 *
 		 * @code{
@@ -1139,6 +1162,20 @@ template <typename T, unsigned int n> struct Tensor {
 				ns[i] = shape[i + 1];
 			return Tensor<T, n - 1>(freduce_max(node, dimension), ns);
 		}
+		/** Normalizes the tensor along `dimension` with the softmax function,
+		 * i.e. `exp(x - max(x)) / sum(exp(x - max(x)))` (see `fsoftmax`). */
+		Tensor<to_float<T>, n> softmax(int dimension) {
+			if (dimension < 0)
+				dimension = shape.size() + dimension;
+			return Tensor<to_float<T>, n>(fsoftmax(node, dimension), shape);
+		}
+		/** The natural logarithm of `softmax(dimension)` (see
+		 * `flog_softmax`). */
+		Tensor<to_float<T>, n> log_softmax(int dimension) {
+			if (dimension < 0)
+				dimension = shape.size() + dimension;
+			return Tensor<to_float<T>, n>(flog_softmax(node, dimension), shape);
+		}
 		/** Reduces all dimension of the tensor by keeping the maximum value
 		 * e.g.
 		 *
@@ -1150,7 +1187,11 @@ template <typename T, unsigned int n> struct Tensor {
 		 *
 		 * The results of this Tensor must be available, to
 		 * ensure that the method may execute the Tensor. */
-		Tensor<T, 1> reduce_max() { return flattened().reduce_max(); }
+		Tensor<T, 1> reduce_max() {
+			const std::array<int, n> axes = all_axes();
+			return Tensor<T, 1>(freduce_max_axes(node, axes.data(), n, false),
+								1);
+		}
 		/**
 		 * Takes the elementwise absolute value of this Tensor (negative signs
 		 * are removed).
@@ -1817,6 +1858,12 @@ template <typename T, unsigned int n> struct Tensor {
 		FGraphNode *node;
 		std::array<size_t, n> shape;
 		size_t total_size;
+		static std::array<int, n> all_axes() {
+			std::array<int, n> axes;
+			for (int i = 0; i < n; i++)
+				axes[i] = i;
+			return axes;
+		}
 		template <typename K>
 		void
 		initShape(const std::initializer_list<std::initializer_list<K>> &vec,
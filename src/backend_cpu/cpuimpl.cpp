@@ -16,9 +16,13 @@
 */
 #include "../../flint.h"
 // #include "execution.hpp"
+#include "../cost_model.hpp"
 #include "../errors.hpp"
 #include "../operations/implementation.hpp"
 #include "../utils.hpp"
+#include "memory_planner.hpp"
+#include "strided.hpp"
+#include "thread_pool.hpp"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
@@ -26,100 +30,148 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
-#include <list>
 #include <queue>
-#include <semaphore>
 #include <stdlib.h>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
-// virtual maximum number of threads
-#define MAX_PARALLELITY 4096
 static bool initialized = false;
-static std::vector<std::thread *> threads;
+static WorkStealingPool *pool = nullptr;
+// set by `fConfigureThreads_cpu`, 0 threads for one per core
+static unsigned int configured_threads = 0;
+static std::vector<WorkerPlacement> configured_placement;
 
-static void threadRoutine();
+static unsigned int numThreads() {
+	if (configured_threads)
+		return configured_threads;
+	const unsigned int cores = std::thread::hardware_concurrency();
+	return cores ? cores : 8;
+}
+/** Spreads the workers evenly over the NUMA nodes (the calling thread is
+ * counted for the first one), leaves them unpinned on other systems */
+static std::vector<WorkerPlacement> defaultPlacement(unsigned int threads) {
+	const size_t nodes = numa_topology().size();
+	std::vector<WorkerPlacement> placement;
+	if (nodes > 1)
+		for (size_t t = 1; t < threads; t++)
+			placement.push_back({-1, (int)(t * nodes / threads)});
+	return placement;
+}
 FErrorType flintInit_cpu() {
 	if (!initialized) {
 		initialized = true;
-		int cores = std::thread::hardware_concurrency();
-		if (!cores)
-			cores = 8;
+		const unsigned int cores = numThreads();
 		flogging(F_INFO,
 				 "Using " + std::to_string(cores) + " threads for CPU-backend");
-		threads = std::vector<std::thread *>(cores);
-		for (int i = 0; i < cores; i++)
-			threads[i] = new std::thread(threadRoutine);
+		if (numa_topology().size() > 1)
+			flogging(F_VERBOSE,
+					 "Distributing them over " +
+						 std::to_string(numa_topology().size()) +
+						 " NUMA nodes");
+		pool = new WorkStealingPool(cores, configured_placement.empty()
+											   ? defaultPlacement(cores)
+											   : configured_placement);
+	}
+	return NO_ERROR;
+}
+FErrorType fConfigureThreads_cpu(unsigned int num_threads, const int *cpus,
+								 const int *numa_nodes) {
+	const std::vector<std::vector<int>> &topology = numa_topology();
+	std::vector<WorkerPlacement> placement;
+	const unsigned int threads = num_threads ? num_threads : numThreads();
+	if (cpus || numa_nodes)
+		for (unsigned int i = 0; i + 1 < threads; i++) {
+			WorkerPlacement worker;
+			if (cpus)
+				worker.cpu = cpus[i];
+			if (numa_nodes)
+				worker.numa_node = numa_nodes[i];
+			bool known_cpu = worker.cpu == -1;
+			for (const std::vector<int> &node : topology)
+				known_cpu |= std::find(node.begin(), node.end(), worker.cpu) !=
+							 node.end();
+			if (!known_cpu || worker.numa_node < -1 ||
+				worker.numa_node >= (int)topology.size()) {
+				setErrorType(INVALID_SELECT);
+				flogging(F_ERROR, "Invalid cpu or NUMA node for worker " +
+									  std::to_string(i) + "!");
+				return INVALID_SELECT;
+			}
+			placement.push_back(worker);
+		}
+	configured_threads = num_threads;
+	configured_placement = placement;
+	if (initialized) {
+		// restart the pool with the new configuration
+		flintCleanup_cpu();
+		return flintInit_cpu();
 	}
 	return NO_ERROR;
 }
-static blocking_queue<
-	std::tuple<FGraphNode *, std::vector<CPUResultData>, void *, size_t, size_t,
-			   std::counting_semaphore<MAX_PARALLELITY> *>>
-	thread_queue;
+unsigned int fNumThreads_cpu() { return pool ? pool->size() : numThreads(); }
+int fNumNumaNodes() { return numa_topology().size(); }
+
+WorkStealingPool *cpu_thread_pool() {
+	if (!initialized)
+		flintInit_cpu();
+	return pool;
+}
 
 FErrorType flintCleanup_cpu() {
 	if (initialized) {
-		flogging(F_DEBUG, "Sending kill signal and poisson pills");
+		flogging(F_DEBUG, "Stopping worker threads");
 		initialized = false;
-		for (size_t i = 0; i < threads.size(); i++)
-			thread_queue.push_front({nullptr, {}, nullptr, 0, 0, nullptr});
-		for (std::thread *t : threads) {
-			t->join();
-			delete t;
-		}
+		delete pool;
+		pool = nullptr;
 	}
 	return NO_ERROR;
 }
 
-static void threadRoutine() {
-	while (true) {
-		auto [node, pred_data, result, from, to, sem] =
-			thread_queue.pop_front();
-		if (!node)
-			break;
-		OperationImplementation::implementations[node->operation.op_type]
-			->execute_cpu(node, pred_data, result, from, to);
-		sem->release();
-	}
-}
 #define PARALLEL_EXECUTION_SIZE 256 // for debugging
 static void chooseExecutionMethod(FGraphNode *node,
-								  std::vector<CPUResultData> pred_data,
+								  const std::vector<CPUResultData> &pred_data,
 								  void *result, size_t size) {
 	const auto start = std::chrono::high_resolution_clock::now();
 	const size_t score =
 		size * OperationImplementation::implementations[node->operation.op_type]
 				   ->operation_score(node);
-	const size_t dis_num =
-		OperationImplementation::implementations[node->operation.op_type]
-			->deploy_as_many_elements(node);
-	if (score >= PARALLEL_EXECUTION_SIZE && dis_num >= threads.size()) {
-		const size_t exeUnits = std::min(dis_num, threads.size());
-		const size_t workSize = dis_num / exeUnits;
-		std::counting_semaphore<MAX_PARALLELITY> *sem =
-			new std::counting_semaphore<MAX_PARALLELITY>(0);
-		for (size_t i = 0; i < exeUnits; i++) {
-			const size_t to = i == exeUnits - 1 ? dis_num : (i + 1) * workSize;
-			thread_queue.push_front({node, pred_data, result, i * workSize,
-									 to - i * workSize, sem});
+	OperationImplementation *impl =
+		OperationImplementation::implementations[node->operation.op_type];
+	const size_t parts = impl->reduction_parts(node);
+	const size_t dis_num = impl->deploy_as_many_elements(node) * parts;
+	// the parts of split reductions are computed into a temporary buffer
+	void *target = result;
+	if (parts > 1) {
+		target = pool_allocate(dis_num * type_size(node->operation.data_type));
+		if (!target) {
+			setErrorType(OUT_OF_MEMORY);
+			flogging(F_ERROR, "Not enough memory for the parts of a reduction!");
+			return;
 		}
-		for (size_t i = 0; i < exeUnits; i++)
-			sem->acquire();
-		delete sem;
+	}
+	CostPrediction costs;
+	const bool parallel =
+		pool->size() > 1 && dis_num >= pool->size() &&
+		(predict_costs(node, size, costs) ? costs.parallel() < costs.sequential
+										  : score >= PARALLEL_EXECUTION_SIZE);
+	if (parallel) {
+		pool->execute_parallel(node, pred_data, target, dis_num,
+							   std::min(dis_num, pool->size()));
 	} else {
-		OperationImplementation::implementations[node->operation.op_type]
-			->execute_cpu(node, pred_data, result, 0, dis_num);
+		impl->execute_cpu(node, pred_data, target, 0, dis_num);
+	}
+	if (parts > 1) {
+		impl->combine_parts_cpu(node, target, result);
+		pool_free(target);
 	}
 	std::chrono::duration<double, std::milli> elapsed =
 		std::chrono::high_resolution_clock::now() - start;
 	flogging(F_DEBUG,
-			 (score >= PARALLEL_EXECUTION_SIZE && dis_num >= threads.size()
-				  ? std::string("Parallel Execution on CPU (score: " +
-								std::to_string(score) + ")")
-				  : std::string("Sequential Execution on CPU (score: " +
-								std::to_string(score) + ")")) +
+			 (parallel ? std::string("Parallel Execution on CPU (score: " +
+									 std::to_string(score) + ")")
+					   : std::string("Sequential Execution on CPU (score: " +
+									 std::to_string(score) + ")")) +
 				 " took " + std::to_string(elapsed.count()) + "ms");
 }
 FGraphNode *fExecuteGraph_cpu_eagerly(FGraphNode *node) {
@@ -136,9 +188,10 @@ FGraphNode *fExecuteGraph_cpu_eagerly(FGraphNode *node) {
 	void *data = nullptr;
 
 	if (!is_data_node) {
-		const std::vector<bool> reusage =
-			OperationImplementation::implementations[node->operation.op_type]
-				->reuse_parameter_result(node);
+		OperationImplementation *impl =
+			OperationImplementation::implementations[node->operation.op_type];
+		const std::vector<bool> reusage = impl->reuse_parameter_result(node);
+		const long view = impl->view_offset(node);
 		// build predecessor data
 		for (int i = 0; i < node->num_predecessor; i++) {
 			FGraphNode *pred = node->predecessors[i];
@@ -164,10 +217,11 @@ FGraphNode *fExecuteGraph_cpu_eagerly(FGraphNode *node) {
 			pred_data[i].shape = std::vector<size_t>(
 				pred->operation.shape,
 				pred->operation.shape + pred->operation.dimensions);
-			if (!data && pred->reference_counter == 1 && !reusage.empty() &&
-				reusage[i] &&
+			if (!data && view == -1 && pred->reference_counter == 1 &&
+				!reusage.empty() && reusage[i] &&
 				(pred->operation.op_type != FSTORE || !node->gradient_data) &&
-				pred->operation.op_type != FGEN_CONSTANT && pred != node) {
+				pred->operation.op_type != FGEN_CONSTANT && pred != node &&
+				!pool_shared(pred_data[i].data)) {
 				// recycle data
 				if (pred->result_data) {
 					FResultData *data = pred->result_data;
@@ -183,30 +237,62 @@ FGraphNode *fExecuteGraph_cpu_eagerly(FGraphNode *node) {
 				data = pred_data[i].data;
 			}
 		}
+		if (view != -1) {
+			// the result is a range of the parameter, it shares its buffer
+			FResultData *rd = new FResultData();
+			rd->data = pool_share(pred_data[0].data,
+								  view * type_size(node->operation.data_type));
+			rd->num_entries = total;
+			rd->mem_id = nullptr;
+			node->result_data = rd;
+			return node;
+		}
 		if (!data) {
 			switch (node->operation.data_type) {
 			case F_INT32:
-				data = safe_mal<int>(total);
+				data = safe_mal_pooled<int>(total);
 				if (!data)
 					return nullptr;
 				break;
 			case F_INT64:
-				data = safe_mal<long>(total);
+				data = safe_mal_pooled<long>(total);
 				if (!data)
 					return nullptr;
 				break;
 			case F_FLOAT32:
-				data = safe_mal<float>(total);
+				data = safe_mal_pooled<float>(total);
 				if (!data)
 					return nullptr;
 				break;
 			case F_FLOAT64:
-				data = safe_mal<double>(total);
+				data = safe_mal_pooled<double>(total);
+				if (!data)
+					return nullptr;
+				break;
+			case F_FLOAT16:
+				data = safe_mal_pooled<Float16>(total);
+				if (!data)
+					return nullptr;
+				break;
+			case F_BFLOAT16:
+				data = safe_mal_pooled<BFloat16>(total);
+				if (!data)
+					return nullptr;
+				break;
+			case F_INT8:
+				data = safe_mal_pooled<int8_t>(total);
+				if (!data)
+					return nullptr;
+				break;
+			case F_UINT8:
+				data = safe_mal_pooled<uint8_t>(total);
 				if (!data)
 					return nullptr;
 				break;
 			}
 		}
+		if (impl->accumulates_result())
+			memset(data, 0, total * type_size(node->operation.data_type));
 		chooseExecutionMethod(node, pred_data, (double *)data, total);
 	} else {
 		data = ((FStore *)node->operation.additional_data)->data;
@@ -219,58 +305,437 @@ FGraphNode *fExecuteGraph_cpu_eagerly(FGraphNode *node) {
 	return node;
 }
 
-FGraphNode *fExecuteGraph_cpu(FGraphNode *node) {
-	if (!initialized)
-		flintInit_cpu();
-	if (node->result_data)
-		return node;
-	if (node->operation.op_type == FSTORE) {
-		node->result_data = new FResultData();
-		FStore *store = (FStore *)node->operation.additional_data;
-		node->result_data->num_entries = store->num_entries;
-		node->result_data->mem_id = store->mem_id;
-		node->result_data->data = store->data;
-		return node;
+/**
+ * State of one execution of `fExecuteGraph_cpu` that is shared between the
+ * tasks of the nodes. Each node that has to be computed is a task of the pool
+ * that is submitted as soon as all of its predecessors are computed, so
+ * independent nodes run at the same time.
+ */
+struct GraphExecution {
+		FGraphNode *node; // the node that should be computed
+		std::vector<FGraphNode *> nodes; // in topological order
+		std::unordered_map<FGraphNode *, size_t> index; // position in `nodes`
+		std::vector<CPUResultData> results;
+		std::vector<std::vector<size_t>> successors;
+		// number of predecessors that are not computed yet
+		std::unique_ptr<std::atomic<int>[]> pending;
+		std::vector<CPUTask> tasks;
+		CompletionLatch latch;
+		std::atomic<bool> failed{false};
+		// consumer a node is fused into or -1 if its result is materialized
+		std::vector<long> fused_into;
+		// nodes that are fused into a materialized node (topological order)
+		std::vector<std::vector<size_t>> fused;
+		// offset in elements of the result of a node in the buffer of its
+		// parameter if it is a view on it (see `view_offset`) or -1
+		std::vector<long> views;
+		// layout of nodes that are gathered from another node
+		std::vector<StridedLayout> layouts;
+		// strided nodes that are only read through the layouts of their
+		// consumers, they are neither computed nor materialized
+		std::vector<bool> absorbed;
+		// parameter whose result is overwritten by a node or -1
+		std::vector<int> recycle;
+		// offset of the result of a node in `arena` or -1 if it is allocated
+		// on its own
+		std::vector<long> offsets;
+		char *arena = nullptr;
+		size_t arena_bytes = 0;
+		// bytes of results that are allocated on their own
+		size_t separate_bytes = 0;
+		// worker that computed a node or -1, nodes are submitted to the
+		// worker of their largest input to read it from close memory
+		std::vector<long> producer;
+};
+/**
+ * Checks if node `p` of `exe` can be computed blockwise inside the loop of its
+ * consumer `c`, where it is parameter `j`.
+ */
+static bool isFusable(const GraphExecution &exe, size_t p, size_t c, int j) {
+	FGraphNode *pred = exe.nodes[p];
+	FGraphNode *curr = exe.nodes[c];
+	// strided nodes gather any range of their elements
+	const bool gathered = exe.layouts[p].source != -1;
+	if (pred == exe.node || pred->reference_counter != 1 ||
+		!(gathered ||
+		  OperationImplementation::implementations[pred->operation.op_type]
+			  ->is_elementwise()) ||
+		!OperationImplementation::implementations[curr->operation.op_type]
+			 ->is_elementwise())
+		return false;
+	if (exe.results[p].num_entries != exe.results[c].num_entries)
+		return false;
+	if (curr->num_predecessor == 2) {
+		size_t iv1, iv2;
+		calculate_divisor_for_inverse_broadcasting(
+			curr->predecessors[0], iv1, curr->predecessors[1], iv2);
+		if ((j == 0 ? iv1 : iv2) != 1)
+			return false;
+	}
+	return true;
+}
+// number of elements a fused group computes at once per thread
+#define FUSION_BLOCK_SIZE 1024
+/** Nodes whose results are read to compute node `i` */
+static std::vector<size_t> inputsOf(const GraphExecution &exe, size_t i) {
+	if (exe.layouts[i].source != -1)
+		return {(size_t)exe.layouts[i].source};
+	const FGraphNode *curr = exe.nodes[i];
+	std::vector<size_t> inputs(curr->num_predecessor);
+	for (int j = 0; j < curr->num_predecessor; j++)
+		inputs[j] = exe.index.at(curr->predecessors[j]);
+	return inputs;
+}
+/**
+ * Computes the elements `from` to `from + size` of node `i` (without the
+ * nodes fused into it), strided nodes are gathered from their source.
+ */
+static void computeRange(const GraphExecution &exe, size_t i,
+						 const std::vector<CPUResultData> &pred_data,
+						 void *result, size_t from, size_t size) {
+	FGraphNode *curr = exe.nodes[i];
+	const StridedLayout &layout = exe.layouts[i];
+	if (layout.source == -1) {
+		OperationImplementation::implementations[curr->operation.op_type]
+			->execute_cpu(curr, pred_data, result, from, size);
+		return;
+	}
+	const void *data = exe.results[layout.source].data;
+	const std::vector<size_t> &shape = exe.results[i].shape;
+	switch (type_size(curr->operation.data_type)) {
+	case 1:
+		strided_gather((uint8_t *)result, (const uint8_t *)data, shape, layout,
+					   from, size);
+		break;
+	case 2:
+		strided_gather((uint16_t *)result, (const uint16_t *)data, shape,
+					   layout, from, size);
+		break;
+	case 4:
+		strided_gather((int *)result, (const int *)data, shape, layout, from,
+					   size);
+		break;
+	default:
+		strided_gather((long *)result, (const long *)data, shape, layout,
+					   from, size);
+	}
+}
+/**
+ * Computes the elements `from` to `from + size` of the materialized node `i`
+ * and all nodes fused into it. The fused nodes are computed in blocks of
+ * `FUSION_BLOCK_SIZE` elements into small buffers that stay in cache.
+ */
+static void executeFusedRange(const GraphExecution &exe, size_t i,
+							  const std::vector<CPUResultData> &pred_data,
+							  void *result, size_t from, size_t size) {
+	const std::vector<size_t> &members = exe.fused[i];
+	const size_t num_members = members.size();
+	const size_t block_bytes = FUSION_BLOCK_SIZE * sizeof(double);
+	std::vector<char> scratch(num_members * block_bytes);
+	// parameters of every member and of the materialized node (last entry)
+	std::vector<std::vector<CPUResultData>> member_data(num_members + 1);
+	// parameters that are results of members: (node, parameter, member)
+	std::vector<std::tuple<size_t, int, size_t>> links;
+	for (size_t k = 0; k <= num_members; k++) {
+		FGraphNode *curr = exe.nodes[k == num_members ? i : members[k]];
+		if (k == num_members)
+			member_data[k] = pred_data;
+		for (int j = 0; j < curr->num_predecessor; j++) {
+			const size_t p = exe.index.at(curr->predecessors[j]);
+			if (k != num_members)
+				member_data[k].push_back(exe.results[p]);
+			if (exe.fused_into[p] != -1) {
+				const size_t m =
+					std::lower_bound(members.begin(), members.end(), p) -
+					members.begin();
+				links.push_back({k, j, m});
+			}
+		}
+	}
+	for (size_t start = from; start < from + size;
+		 start += FUSION_BLOCK_SIZE) {
+		const size_t block =
+			std::min((size_t)FUSION_BLOCK_SIZE, from + size - start);
+		// the operations index their data absolute, so the buffers are
+		// shifted by the start of the block
+		const auto buffer = [&](size_t k) {
+			const FGraphNode *member = exe.nodes[members[k]];
+			return (void *)(scratch.data() + k * block_bytes -
+							start * type_size(member->operation.data_type));
+		};
+		for (const auto &[k, j, m] : links)
+			member_data[k][j].data = buffer(m);
+		for (size_t k = 0; k < num_members; k++)
+			computeRange(exe, members[k], member_data[k], buffer(k), start,
+						 block);
+		computeRange(exe, i, member_data[num_members], result, start, block);
+	}
+}
+static void executeFusedTask(const CPUTask &task) {
+	const GraphExecution &exe = *(const GraphExecution *)task.argument;
+	executeFusedRange(exe, exe.index.at(task.node), *task.pred_data,
+					  task.result, task.from, task.size);
+}
+/**
+ * Executes the materialized node `i` together with the nodes that are fused
+ * into it, in parallel if the combined score is high enough.
+ */
+static void executeFused(GraphExecution &exe, size_t i,
+						 const std::vector<CPUResultData> &pred_data,
+						 void *result, size_t size) {
+	const auto start = std::chrono::high_resolution_clock::now();
+	FGraphNode *node = exe.nodes[i];
+	size_t score = 0;
+	CostPrediction costs;
+	bool predicted = true;
+	for (size_t m : exe.fused[i]) {
+		score += OperationImplementation::implementations
+					 [exe.nodes[m]->operation.op_type]
+						 ->operation_score(exe.nodes[m]);
+		predicted &= predict_costs(exe.nodes[m], size, costs);
+	}
+	score += OperationImplementation::implementations[node->operation.op_type]
+				 ->operation_score(node);
+	predicted &= predict_costs(node, size, costs);
+	score *= size;
+	const bool parallel =
+		pool->size() > 1 && size >= pool->size() &&
+		(predicted ? costs.parallel() < costs.sequential
+				   : score >= PARALLEL_EXECUTION_SIZE);
+	if (parallel)
+		pool->execute_parallel(node, pred_data, result, size,
+							   std::min(size, pool->size()), executeFusedTask,
+							   &exe);
+	else
+		executeFusedRange(exe, i, pred_data, result, 0, size);
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::high_resolution_clock::now() - start;
+	flogging(F_DEBUG,
+			 std::string(parallel ? "Parallel" : "Sequential") +
+				 " Execution of " + std::to_string(exe.fused[i].size() + 1) +
+				 " fused nodes on CPU (score: " + std::to_string(score) +
+				 ") took " + std::to_string(elapsed.count()) + "ms");
+}
+/**
+ * Computes the node at position `i` of `exe` after all its predecessors are
+ * computed. Returns false if the result could not be allocated.
+ */
+static bool executeNode(GraphExecution &exe, size_t i) {
+	FGraphNode *curr = exe.nodes[i];
+	const size_t size = exe.results[i].num_entries;
+	if (exe.views[i] != -1) {
+		// nothing to compute, results in the arena are shared by the plan
+		const size_t p = exe.index.at(curr->predecessors[0]);
+		exe.results[i].data =
+			exe.offsets[i] != -1
+				? exe.arena + exe.offsets[i]
+				: pool_share(exe.results[p].data,
+							 exe.views[i] * type_size(curr->operation.data_type));
+		exe.producer[i] = exe.producer[p];
+		return true;
 	}
+	std::vector<CPUResultData> predData(curr->num_predecessor);
+	for (int j = 0; j < curr->num_predecessor; j++)
+		predData[j] = exe.results[exe.index.at(curr->predecessors[j])];
+	void *result = nullptr;
+	const int j = exe.recycle[i];
+	if (j != -1) {
+		// recycle result data of that parent, it is no longer used elsewhere
+		// (then this is the only task that accesses it)
+		FGraphNode *pred = curr->predecessors[j];
+		if (pred->result_data) {
+			FResultData *data = pred->result_data;
+			if (data->mem_id)
+				data->data = nullptr;
+			else {
+				delete data;
+				pred->result_data = nullptr;
+			}
+		}
+		if (pred->operation.op_type == FSTORE) {
+			((FStore *)pred->operation.additional_data)->data = nullptr;
+		}
+		exe.results[exe.index.at(pred)].multi_use = true;
+		predData[j].multi_use = true;
+		result = predData[j].data;
+	} else if (exe.offsets[i] != -1)
+		result = exe.arena + exe.offsets[i];
+	else {
+		// allocate result data
+		switch (curr->operation.data_type) {
+		case F_INT32: {
+			result = safe_mal_pooled<int>(size);
+		} break;
+		case F_INT64: {
+			result = safe_mal_pooled<long>(size);
+		} break;
+		case F_FLOAT32: {
+			result = safe_mal_pooled<float>(size);
+		} break;
+		case F_FLOAT64: {
+			result = safe_mal_pooled<double>(size);
+		} break;
+		case F_FLOAT16: {
+			result = safe_mal_pooled<Float16>(size);
+		} break;
+		case F_BFLOAT16: {
+			result = safe_mal_pooled<BFloat16>(size);
+		} break;
+		case F_INT8: {
+			result = safe_mal_pooled<int8_t>(size);
+		} break;
+		case F_UINT8: {
+			result = safe_mal_pooled<uint8_t>(size);
+		} break;
+		}
+		if (!result)
+			return false;
+	}
+	if (OperationImplementation::implementations[curr->operation.op_type]
+			->accumulates_result())
+		memset(result, 0, size * type_size(curr->operation.data_type));
+	if (exe.fused[i].empty() && exe.layouts[i].source == -1)
+		chooseExecutionMethod(curr, predData, result, size);
+	else
+		executeFused(exe, i, predData, result, size);
+	exe.results[i].data = result;
+	exe.producer[i] = pool->current_worker();
+	return true;
+}
+/** Worker that computed the largest input of node `i` or -1 */
+static long closestWorker(const GraphExecution &exe, size_t i) {
+	const FGraphNode *curr = exe.nodes[i];
+	long worker = -1;
+	size_t largest = 0;
+	for (int j = 0; j < curr->num_predecessor; j++) {
+		const size_t p = exe.index.at(curr->predecessors[j]);
+		const size_t bytes =
+			exe.results[p].num_entries * type_size(exe.results[p].type);
+		if (exe.producer[p] != -1 && bytes > largest) {
+			largest = bytes;
+			worker = exe.producer[p];
+		}
+	}
+	return worker;
+}
+static void executeNodeTask(const CPUTask &task) {
+	GraphExecution &exe = *(GraphExecution *)task.argument;
+	const size_t i = exe.index.at(task.node);
+	// after a failure the remaining nodes are only counted down
+	if (!exe.failed.load(std::memory_order_relaxed) && !executeNode(exe, i))
+		exe.failed.store(true, std::memory_order_relaxed);
+	for (size_t s : exe.successors[i])
+		if (exe.pending[s].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			pool->submit_to(&exe.tasks[s], closestWorker(exe, s));
+}
+/**
+ * Describes the computed nodes of `exe` that only rearrange the elements of
+ * their parameter by strided layouts on the data they start at (see
+ * `StridedLayout`). Such nodes whose consumers are all strided too are
+ * absorbed into them, nodes with a single elementwise consumer are gathered
+ * blockwise in its loop and only the remaining ones are materialized.
+ */
+static void planStridedLayouts(GraphExecution &exe,
+							   const std::vector<bool> &compute) {
 	using namespace std;
-	unordered_map<FGraphNode *, CPUResultData> results;
-	list<FGraphNode *> toExecute; // in top down order
-	{
-		list<FGraphNode *> workList; // traverse bottom up
-		unordered_set<FGraphNode *> inExecuteList;
-		workList.push_front(node);
-		const bool is_gpu_backend =
-			flintInitializedBackends() & FLINT_BACKEND_ONLY_GPU;
-		// collect nodes
-		while (!workList.empty()) {
-			FGraphNode *curr = workList.front();
-			workList.pop_front();
-			if (inExecuteList.find(curr) != inExecuteList.end())
-				toExecute.remove(curr);
-			inExecuteList.insert(curr);
-			toExecute.push_front(curr);
-			if (!curr->result_data)
-				for (int i = 0; i < curr->num_predecessor; i++) {
-					FGraphNode *p = curr->predecessors[i];
-					// execute on GPU if it makes more sense
-					if (is_gpu_backend) {
-						const size_t score = compute_score(p, true);
-						if (score >= 1024) {
-							if (inExecuteList.find(p) != inExecuteList.end())
-								toExecute.remove(p);
-							fSyncMemory(fExecuteGraph_gpu(p));
-							toExecute.push_front(p);
-							inExecuteList.insert(p);
-							continue;
-						}
-					}
-					workList.push_back(p);
-				}
+	const size_t n = exe.nodes.size();
+	vector<vector<size_t>> consumers(n);
+	vector<bool> strided(n, false);
+	const auto dense = [&](size_t p) {
+		const vector<size_t> &shape = exe.results[p].shape;
+		StridedLayout layout;
+		layout.source = p;
+		layout.strides.resize(shape.size());
+		long stride = 1;
+		for (long d = shape.size() - 1; d >= 0; d--) {
+			layout.strides[d] = stride;
+			stride *= shape[d];
+		}
+		return layout;
+	};
+	for (size_t i = 0; i < n; i++) {
+		if (!compute[i])
+			continue;
+		FGraphNode *curr = exe.nodes[i];
+		for (int j = 0; j < curr->num_predecessor; j++)
+			consumers[exe.index.at(curr->predecessors[j])].push_back(i);
+		if (curr->num_predecessor != 1 || exe.fused_into[i] != -1 ||
+			curr->predecessors[0]->operation.op_type == FGEN_CONSTANT)
+			continue;
+		StridedLayout layout = dense(exe.index.at(curr->predecessors[0]));
+		strided[i] =
+			OperationImplementation::implementations[curr->operation.op_type]
+				->strided_view(curr, layout.strides, layout.offset);
+	}
+	for (size_t i = 0; i < n; i++) {
+		FGraphNode *curr = exe.nodes[i];
+		if (!strided[i] || curr == exe.node || consumers[i].empty() ||
+			consumers[i].size() != curr->reference_counter)
+			continue;
+		exe.absorbed[i] = all_of(consumers[i].begin(), consumers[i].end(),
+								 [&](size_t c) { return strided[c]; });
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (!strided[i])
+			continue;
+		FGraphNode *curr = exe.nodes[i];
+		const size_t p = exe.index.at(curr->predecessors[0]);
+		StridedLayout &layout = exe.layouts[i];
+		layout = exe.absorbed[p] ? exe.layouts[p] : dense(p);
+		OperationImplementation::implementations[curr->operation.op_type]
+			->strided_view(curr, layout.strides, layout.offset);
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (!strided[i] || exe.absorbed[i])
+			continue;
+		if (consumers[i].size() == 1) {
+			const size_t c = consumers[i][0];
+			FGraphNode *consumer = exe.nodes[c];
+			for (int j = 0; j < consumer->num_predecessor; j++)
+				if (consumer->predecessors[j] == exe.nodes[i] &&
+					isFusable(exe, i, c, j))
+					exe.fused_into[i] = c;
 		}
+		// materialized from a dense parameter by the operation itself
+		if (exe.fused_into[i] == -1 &&
+			!exe.absorbed[exe.index.at(exe.nodes[i]->predecessors[0])])
+			exe.layouts[i] = StridedLayout();
 	}
-	// work them in correct oder
-	for (FGraphNode *curr : toExecute) {
-		// collect predecessor results
+}
+/**
+ * Collects the nodes that have to be computed for `node` into `exe` and
+ * prepares their tasks, the tasks without dependencies are stored in `ready`.
+ * Returns the number of nodes that have to be computed. If `predict` is set,
+ * nothing is executed or synchronized (nodes that would be executed on the
+ * GPU are planned for the CPU).
+ */
+static size_t prepareExecution(GraphExecution &exe, FGraphNode *node,
+							   std::vector<size_t> &ready, bool predict) {
+	using namespace std;
+	const bool is_gpu_backend =
+		!predict && flintInitializedBackends() & FLINT_BACKEND_ONLY_GPU;
+	// collect nodes in topological order
+	exe.node = node;
+	exe.nodes = topological_sort(node, [&](FGraphNode *curr, int i) {
+		if (curr->result_data)
+			return false;
+		FGraphNode *p = curr->predecessors[i];
+		// execute on GPU if it makes more sense
+		if (is_gpu_backend && !p->result_data &&
+			prefer_gpu(p, true, compute_score(p, true) >= 1024))
+			fSyncMemory(fExecuteGraph_gpu(p));
+		return true;
+	});
+	// prepare the data of all nodes that are already available
+	exe.results = vector<CPUResultData>(exe.nodes.size());
+	exe.successors = vector<vector<size_t>>(exe.nodes.size());
+	exe.pending.reset(new atomic<int>[exe.nodes.size()]);
+	exe.tasks = vector<CPUTask>(exe.nodes.size());
+	exe.producer = vector<long>(exe.nodes.size(), -1);
+	vector<bool> compute(exe.nodes.size(), false);
+	for (size_t i = 0; i < exe.nodes.size(); i++) {
+		FGraphNode *curr = exe.nodes[i];
+		exe.index.insert({curr, i});
 		// calculate total size
 		size_t size = 1;
 		if (curr->operation.op_type != FGEN_CONSTANT)
@@ -278,15 +743,17 @@ FGraphNode *fExecuteGraph_cpu(FGraphNode *node) {
 				size *= curr->operation.shape[j];
 		if (size == 0)
 			flogging(F_ERROR, "Illegal number of entries!");
+		CPUResultData &foo = exe.results[i];
+		foo.shape = vector<size_t>(curr->operation.shape,
+								   curr->operation.shape +
+									   curr->operation.dimensions);
+		foo.type = curr->operation.data_type;
+		foo.num_entries = size;
+		exe.pending[i].store(0, std::memory_order_relaxed);
 		if (curr->operation.op_type == FSTORE || curr->result_data) {
-			CPUResultData foo;
-			foo.shape = vector<size_t>(curr->operation.shape,
-									   curr->operation.shape +
-										   curr->operation.dimensions);
-			foo.type = curr->operation.data_type;
 			if (curr->result_data) {
 				FResultData *rd = curr->result_data;
-				if (!rd->data)
+				if (!rd->data && !predict)
 					fSyncMemory(curr);
 				foo.num_entries = rd->num_entries;
 				if (foo.num_entries != size &&
@@ -307,84 +774,267 @@ FGraphNode *fExecuteGraph_cpu(FGraphNode *node) {
 										  " vs " + to_string(size));
 				foo.data = store->data;
 			}
-			results.insert({curr, foo});
-		} else {
-			vector<CPUResultData> predData(curr->num_predecessor);
-			void *data_to_recycle = nullptr;
-			const vector<bool> reusage =
-				OperationImplementation::implementations[curr->operation
-															 .op_type]
-					->reuse_parameter_result(curr);
-			for (int i = 0; i < curr->num_predecessor; i++) {
-				FGraphNode *pred = curr->predecessors[i];
-				predData[i] = results[pred];
-				// recycle result data of that parent if it is no longer used
-				// elsewhere
-				if (!data_to_recycle && pred->reference_counter == 1 &&
-					!reusage.empty() && reusage[i] &&
-					(pred->operation.op_type != FSTORE ||
-					 !curr->gradient_data) &&
-					pred->operation.op_type != FGEN_CONSTANT && pred != node) {
-					if (pred->result_data) {
-						FResultData *data = pred->result_data;
-						if (data->mem_id)
-							data->data = nullptr;
-						else {
-							delete data;
-							pred->result_data = nullptr;
-						}
-					}
-					if (pred->operation.op_type == FSTORE) {
-						((FStore *)pred->operation.additional_data)->data =
-							nullptr;
-					}
-					results[pred].multi_use = true;
-					predData[i].multi_use = true;
-					data_to_recycle = predData[i].data;
-				}
+		} else
+			compute[i] = true;
+	}
+	// elementwise nodes with a single consumer are computed blockwise
+	// together with that consumer instead of being materialized
+	exe.fused_into = vector<long>(exe.nodes.size(), -1);
+	exe.fused = vector<vector<size_t>>(exe.nodes.size());
+	exe.layouts = vector<StridedLayout>(exe.nodes.size());
+	exe.absorbed = vector<bool>(exe.nodes.size(), false);
+	if (!fIsEagerExecution()) {
+		for (size_t i = 0; i < exe.nodes.size(); i++) {
+			if (!compute[i])
+				continue;
+			FGraphNode *curr = exe.nodes[i];
+			for (int j = 0; j < curr->num_predecessor; j++) {
+				const size_t p = exe.index.at(curr->predecessors[j]);
+				if (compute[p] && isFusable(exe, p, i, j))
+					exe.fused_into[p] = i;
 			}
-			// allocate result data and execute
-			void *result = data_to_recycle;
-			if (!result) {
-				switch (curr->operation.data_type) {
-				case F_INT32: {
-					result = safe_mal<int>(size);
-				} break;
-				case F_INT64: {
-					result = safe_mal<long>(size);
-				} break;
-				case F_FLOAT32: {
-					result = safe_mal<float>(size);
-				} break;
-				case F_FLOAT64: {
-					result = safe_mal<double>(size);
-				} break;
+		}
+		planStridedLayouts(exe, compute);
+	}
+	// materialized nodes that reinterpret a materialized parameter share its
+	// buffer
+	exe.views = vector<long>(exe.nodes.size(), -1);
+	for (size_t i = 0; i < exe.nodes.size(); i++) {
+		FGraphNode *curr = exe.nodes[i];
+		if (compute[i] && exe.fused_into[i] == -1 &&
+			curr->num_predecessor == 1 &&
+			exe.fused_into[exe.index.at(curr->predecessors[0])] == -1 &&
+			!exe.absorbed[exe.index.at(curr->predecessors[0])])
+			exe.views[i] = OperationImplementation::implementations
+							   [curr->operation.op_type]
+								   ->view_offset(curr);
+	}
+	// count the predecessors that still have to be computed
+	size_t num_compute = 0;
+	for (size_t i = 0; i < exe.nodes.size(); i++) {
+		if (!compute[i] || exe.absorbed[i])
+			continue;
+		if (exe.fused_into[i] != -1) {
+			// register at the materialized consumer
+			size_t root = exe.fused_into[i];
+			while (exe.fused_into[root] != -1)
+				root = exe.fused_into[root];
+			exe.fused[root].push_back(i);
+			continue;
+		}
+		int pending = 0;
+		const auto count_inputs = [&](size_t member) {
+			for (size_t p : inputsOf(exe, member))
+				if (compute[p] && exe.fused_into[p] == -1) {
+					exe.successors[p].push_back(i);
+					pending++;
 				}
-				if (!result)
-					return nullptr;
+		};
+		for (size_t m : exe.fused[i])
+			count_inputs(m);
+		count_inputs(i);
+		exe.pending[i].store(pending, std::memory_order_relaxed);
+		CPUTask &task = exe.tasks[i];
+		task.node = exe.nodes[i];
+		task.latch = &exe.latch;
+		task.routine = executeNodeTask;
+		task.argument = &exe;
+		if (pending == 0)
+			ready.push_back(i);
+		num_compute++;
+	}
+	return num_compute;
+}
+/**
+ * Returns the parameter of node `i` whose result may be overwritten by the
+ * result of `i` (since it is not used elsewhere) or -1.
+ */
+static int recycledParameter(const GraphExecution &exe, size_t i) {
+	FGraphNode *curr = exe.nodes[i];
+	const std::vector<bool> reusage =
+		OperationImplementation::implementations[curr->operation.op_type]
+			->reuse_parameter_result(curr);
+	if (reusage.empty() || exe.views[i] != -1 || exe.layouts[i].source != -1)
+		return -1;
+	for (int j = 0; j < curr->num_predecessor; j++) {
+		FGraphNode *pred = curr->predecessors[j];
+		const size_t p = exe.index.at(pred);
+		// views and shared buffers must not be overwritten
+		if (exe.fused_into[p] == -1 && exe.views[p] == -1 &&
+			(!exe.results[p].data || !pool_shared(exe.results[p].data)) &&
+			pred->reference_counter == 1 && reusage[j] &&
+			(pred->operation.op_type != FSTORE || !curr->gradient_data) &&
+			pred->operation.op_type != FGEN_CONSTANT && pred != exe.node)
+			return j;
+	}
+	return -1;
+}
+/**
+ * Plans where the results of the computed nodes of `exe` are stored. Results
+ * that are only needed during the execution are placed in one arena by their
+ * live ranges (see `plan_memory`), the result of `exe.node` and every result
+ * during eager execution (since they are kept) is allocated on its own.
+ */
+static void planMemory(GraphExecution &exe, bool parallel) {
+	const size_t n = exe.nodes.size();
+	exe.recycle = std::vector<int>(n, -1);
+	exe.offsets = std::vector<long>(n, -1);
+	// buffer of each materialized node, nodes that overwrite a parameter
+	// share its buffer
+	std::vector<long> buffer(n, -1);
+	std::vector<BufferLifetime> buffers;
+	// 0: arena, 1: allocated on its own, 2: taken from an executed node
+	std::vector<char> kind;
+	for (size_t i = 0; i < n; i++) {
+		if (!exe.tasks[i].routine)
+			continue;
+		FGraphNode *curr = exe.nodes[i];
+		if (exe.views[i] != -1) {
+			buffer[i] = buffer[exe.index.at(curr->predecessors[0])];
+			continue;
+		}
+		const int j = exe.recycle[i] = recycledParameter(exe, i);
+		if (j != -1) {
+			const long p = buffer[exe.index.at(curr->predecessors[j])];
+			if (p != -1) {
+				buffer[i] = p;
+				continue;
 			}
-			chooseExecutionMethod(curr, predData, result, size);
-			results.insert(
-				{curr,
-				 {.data = result,
-				  .type = curr->operation.data_type,
-				  .num_entries = size,
-				  .shape = vector<size_t>(curr->operation.shape,
-										  curr->operation.shape +
-											  curr->operation.dimensions)}});
+		}
+		buffer[i] = buffers.size();
+		buffers.push_back(
+			{exe.results[i].num_entries * type_size(curr->operation.data_type),
+			 i,
+			 {}});
+		kind.push_back(j != -1 ? 2 : fIsEagerExecution() ? 1 : 0);
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (!exe.tasks[i].routine)
+			continue;
+		const auto add_uses = [&](size_t member) {
+			for (size_t p : inputsOf(exe, member)) {
+				const long b = buffer[p];
+				if (b != -1)
+					buffers[b].uses.push_back(i);
+			}
+		};
+		for (size_t m : exe.fused[i])
+			add_uses(m);
+		add_uses(i);
+	}
+	const long result_buffer = buffer[exe.index.at(exe.node)];
+	if (result_buffer != -1 && kind[result_buffer] == 0)
+		kind[result_buffer] = 1;
+	std::vector<BufferLifetime> arena_buffers;
+	std::vector<size_t> arena_index(buffers.size());
+	exe.separate_bytes = 0;
+	for (size_t b = 0; b < buffers.size(); b++) {
+		if (kind[b] == 0) {
+			arena_index[b] = arena_buffers.size();
+			arena_buffers.push_back(buffers[b]);
+		} else if (kind[b] == 1)
+			exe.separate_bytes += buffers[b].bytes;
+	}
+	const MemoryPlan plan =
+		plan_memory(arena_buffers, n, parallel ? &exe.successors : nullptr);
+	exe.arena_bytes = plan.arena_bytes;
+	for (size_t i = 0; i < n; i++) {
+		if (buffer[i] == -1 || kind[buffer[i]] != 0)
+			continue;
+		FGraphNode *curr = exe.nodes[i];
+		if (exe.views[i] != -1)
+			exe.offsets[i] =
+				exe.offsets[exe.index.at(curr->predecessors[0])] +
+				exe.views[i] * type_size(curr->operation.data_type);
+		else
+			exe.offsets[i] = plan.offsets[arena_index[buffer[i]]];
+	}
+	if (!arena_buffers.empty()) {
+		size_t unplanned = 0;
+		for (const BufferLifetime &b : arena_buffers)
+			unplanned += b.bytes;
+		flogging(F_DEBUG, "Planned " + std::to_string(arena_buffers.size()) +
+							  " intermediate results into " +
+							  std::to_string(plan.arena_bytes) +
+							  " bytes (lower bound: " +
+							  std::to_string(plan.lower_bound) +
+							  ", unplanned: " + std::to_string(unplanned) +
+							  ")");
+	}
+}
+size_t fPredictPeakMemory_cpu(FGraphNode *node) {
+	if (!initialized)
+		flintInit_cpu();
+	if (node->result_data || node->operation.op_type == FSTORE)
+		return 0;
+	GraphExecution exe;
+	std::vector<size_t> ready;
+	const size_t num_compute = prepareExecution(exe, node, ready, true);
+	planMemory(exe, pool->size() > 1 && num_compute > 1);
+	return exe.arena_bytes + exe.separate_bytes;
+}
+FGraphNode *fExecuteGraph_cpu(FGraphNode *node) {
+	if (!initialized)
+		flintInit_cpu();
+	if (node->result_data)
+		return node;
+	if (node->operation.op_type == FSTORE) {
+		node->result_data = new FResultData();
+		FStore *store = (FStore *)node->operation.additional_data;
+		node->result_data->num_entries = store->num_entries;
+		node->result_data->mem_id = store->mem_id;
+		node->result_data->data = store->data;
+		return node;
+	}
+	GraphExecution exe;
+	std::vector<size_t> ready;
+	const size_t num_compute = prepareExecution(exe, node, ready, false);
+	const bool parallel = pool->size() > 1 && num_compute > 1;
+	planMemory(exe, parallel);
+	if (exe.arena_bytes) {
+		exe.arena = (char *)pool_allocate(exe.arena_bytes);
+		if (!exe.arena) {
+			setErrorType(OUT_OF_MEMORY);
+			flogging(F_ERROR, "Could not malloc '" +
+								  std::to_string(exe.arena_bytes) + "' bytes!");
+			return nullptr;
+		}
+	}
+	// work them in correct order
+	if (!parallel) {
+		for (size_t i = 0; i < exe.nodes.size(); i++)
+			if (exe.tasks[i].routine && !executeNode(exe, i)) {
+				pool_free(exe.arena);
+				return nullptr;
+			}
+	} else {
+		// independent nodes are executed at the same time, the intra node
+		// parallelism of `chooseExecutionMethod` is scheduled on the same pool
+		exe.latch.reset(num_compute);
+		for (size_t i = 0; i < ready.size(); i++)
+			pool->submit(&exe.tasks[ready[i]], 1);
+		pool->wait(exe.latch);
+		if (exe.failed.load(std::memory_order_relaxed)) {
+			pool_free(exe.arena);
+			return nullptr;
 		}
 	}
-	CPUResultData final = results[node];
+	CPUResultData final = exe.results[exe.index.at(node)];
 	if (!fIsEagerExecution()) {
 		// free all other data
-		for (auto &[gn, rd] : results) {
+		pool_free(exe.arena);
+		for (size_t i = 0; i < exe.nodes.size(); i++) {
+			FGraphNode *gn = exe.nodes[i];
+			const CPUResultData &rd = exe.results[i];
 			if (gn != node && gn->operation.op_type != FSTORE &&
-				!gn->result_data && !rd.multi_use)
-				free(rd.data);
+				!gn->result_data && !rd.multi_use && exe.offsets[i] == -1)
+				pool_free(rd.data);
 		}
 	} else {
 		// construct a result for each node
-		for (auto &[gn, rd] : results) {
+		for (size_t i = 0; i < exe.nodes.size(); i++) {
+			FGraphNode *gn = exe.nodes[i];
+			const CPUResultData &rd = exe.results[i];
 			if (gn != node && gn->operation.op_type != FSTORE &&
 				!gn->result_data && !rd.multi_use) {
 				FResultData *result = new FResultData();
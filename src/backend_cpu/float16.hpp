@@ -0,0 +1,190 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_FLOAT16_HPP
+#define FLINT_FLOAT16_HPP
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+/*
+ * Storage types of `F_FLOAT16` (IEEE 754 half precision) and `F_BFLOAT16`
+ * (the upper half of a float32). They only define the conversion from and to
+ * float, so every expression of the kernels that reads them computes in
+ * float32 and rounds to the nearest even value when the result is stored.
+ */
+
+/** Bits of the half precision value nearest to `v` */
+inline uint16_t float_to_half(float v) {
+#ifdef __F16C__
+	return _cvtss_sh(v, _MM_FROUND_TO_NEAREST_INT);
+#else
+	uint32_t x;
+	std::memcpy(&x, &v, sizeof(x));
+	const uint16_t sign = (x >> 16) & 0x8000;
+	x &= 0x7fffffff;
+	// infinity and nan (which stays quiet)
+	if (x >= 0x7f800000)
+		return sign | 0x7c00 | (x > 0x7f800000 ? 0x200 : 0);
+	// rounds to a value larger than 65504
+	if (x >= 0x477ff000)
+		return sign | 0x7c00;
+	// subnormal, multiples of 2^-24
+	if (x < 0x38800000) {
+		float a;
+		std::memcpy(&a, &x, sizeof(a));
+		return sign | (uint16_t)std::nearbyint(a * 16777216.0f);
+	}
+	// rebias the exponent and round the mantissa to the nearest even
+	x += 0xc8000fff + ((x >> 13) & 1);
+	return sign | (x >> 13);
+#endif
+}
+/** Value of the half precision bits `h` */
+inline float half_to_float(uint16_t h) {
+#ifdef __F16C__
+	return _cvtsh_ss(h);
+#else
+	const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	const uint32_t em = h & 0x7fff;
+	uint32_t x;
+	if (em >= 0x7c00)
+		x = sign | 0x7f800000 | ((em & 0x3ff) << 13);
+	else if (em >= 0x400)
+		x = sign | ((em << 13) + 0x38000000);
+	else {
+		const float a = em * 5.9604644775390625e-8f;
+		std::memcpy(&x, &a, sizeof(x));
+		x |= sign;
+	}
+	float v;
+	std::memcpy(&v, &x, sizeof(v));
+	return v;
+#endif
+}
+/** Bits of the bfloat16 value nearest to `v` */
+inline uint16_t float_to_bfloat(float v) {
+	uint32_t x;
+	std::memcpy(&x, &v, sizeof(x));
+	if ((x & 0x7fffffff) > 0x7f800000)
+		return (x >> 16) | 0x40;
+	return (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+}
+/** Value of the bfloat16 bits `h` */
+inline float bfloat_to_float(uint16_t h) {
+	const uint32_t x = (uint32_t)h << 16;
+	float v;
+	std::memcpy(&v, &x, sizeof(v));
+	return v;
+}
+struct Float16 {
+		uint16_t bits;
+		Float16() = default;
+		Float16(float v) : bits(float_to_half(v)) {}
+		template <typename V,
+				  typename = std::enable_if_t<std::is_convertible_v<V, float>>>
+		Float16(V v) : Float16((float)v) {}
+		operator float() const { return half_to_float(bits); }
+		static Float16 from_bits(uint16_t bits) {
+			Float16 h;
+			h.bits = bits;
+			return h;
+		}
+		template <typename V> Float16 &operator+=(V v) {
+			return *this = (float)*this + v;
+		}
+		template <typename V> Float16 &operator-=(V v) {
+			return *this = (float)*this - v;
+		}
+		template <typename V> Float16 &operator*=(V v) {
+			return *this = (float)*this * v;
+		}
+		template <typename V> Float16 &operator/=(V v) {
+			return *this = (float)*this / v;
+		}
+};
+struct BFloat16 {
+		uint16_t bits;
+		BFloat16() = default;
+		BFloat16(float v) : bits(float_to_bfloat(v)) {}
+		template <typename V,
+				  typename = std::enable_if_t<std::is_convertible_v<V, float>>>
+		BFloat16(V v) : BFloat16((float)v) {}
+		operator float() const { return bfloat_to_float(bits); }
+		static BFloat16 from_bits(uint16_t bits) {
+			BFloat16 h;
+			h.bits = bits;
+			return h;
+		}
+		template <typename V> BFloat16 &operator+=(V v) {
+			return *this = (float)*this + v;
+		}
+		template <typename V> BFloat16 &operator-=(V v) {
+			return *this = (float)*this - v;
+		}
+		template <typename V> BFloat16 &operator*=(V v) {
+			return *this = (float)*this * v;
+		}
+		template <typename V> BFloat16 &operator/=(V v) {
+			return *this = (float)*this / v;
+		}
+};
+/**
+ * Type the kernels compute and accumulate values of type `T` in, the 8bit
+ * integers of the quantized types are computed in int
+ */
+template <typename T>
+using compute_type = typename std::conditional<
+	std::is_same<T, Float16>::value || std::is_same<T, BFloat16>::value, float,
+	typename std::conditional<std::is_same<T, int8_t>::value ||
+								  std::is_same<T, uint8_t>::value,
+							  int, T>::type>::type;
+
+namespace std {
+template <> class numeric_limits<Float16> {
+	public:
+		static constexpr bool is_specialized = true;
+		static constexpr bool is_signed = true;
+		static constexpr bool is_integer = false;
+		static constexpr bool has_infinity = true;
+		static constexpr bool has_quiet_NaN = true;
+		static constexpr int digits = 11;
+		static Float16 min() { return Float16::from_bits(0x0400); }
+		static Float16 max() { return Float16::from_bits(0x7bff); }
+		static Float16 lowest() { return Float16::from_bits(0xfbff); }
+		static Float16 epsilon() { return Float16::from_bits(0x1400); }
+		static Float16 infinity() { return Float16::from_bits(0x7c00); }
+		static Float16 quiet_NaN() { return Float16::from_bits(0x7e00); }
+};
+template <> class numeric_limits<BFloat16> {
+	public:
+		static constexpr bool is_specialized = true;
+		static constexpr bool is_signed = true;
+		static constexpr bool is_integer = false;
+		static constexpr bool has_infinity = true;
+		static constexpr bool has_quiet_NaN = true;
+		static constexpr int digits = 8;
+		static BFloat16 min() { return BFloat16::from_bits(0x0080); }
+		static BFloat16 max() { return BFloat16::from_bits(0x7f7f); }
+		static BFloat16 lowest() { return BFloat16::from_bits(0xff7f); }
+		static BFloat16 epsilon() { return BFloat16::from_bits(0x3c00); }
+		static BFloat16 infinity() { return BFloat16::from_bits(0x7f80); }
+		static BFloat16 quiet_NaN() { return BFloat16::from_bits(0x7fc0); }
+};
+} // namespace std
+#endif
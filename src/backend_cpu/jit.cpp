@@ -0,0 +1,321 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "../../flint.h"
+#include "../backend_ocl/codegen.hpp"
+#include "../errors.hpp"
+#include "../operations/implementation.hpp"
+#include "../utils.hpp"
+#include "thread_pool.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+/** Signature of the generated function, computes the entries `from` to `to`
+ * (exclusive) of the result */
+typedef void (*JITKernel)(void *__restrict__ result,
+						  const void *const *parameters, long from, long to);
+static bool initialized = false;
+static std::string cache_dir;
+static std::string compiler;
+// compiled kernels by their source code, nullptr if the compilation failed
+static std::unordered_map<std::string, JITKernel> kernel_cache;
+static std::list<void *> libraries;
+static size_t temporary_libraries = 0;
+// minimum number of elements for a parallel execution of a kernel
+#define JIT_PARALLEL_SIZE 4096
+
+// maps the OpenCL builtins used by the lazy code generation to C++
+static const char *jit_prelude =
+	"#include <float.h>\n"
+	"#include <limits.h>\n"
+	"#include <math.h>\n"
+	"#define get_global_id(dim) flint_gid\n"
+	"template <typename A, typename B> static inline auto min(A a, B b) {\n"
+	"	return a < b ? a : b;\n"
+	"}\n"
+	"template <typename A, typename B> static inline auto max(A a, B b) {\n"
+	"	return a > b ? a : b;\n"
+	"}\n"
+	"template <typename T, typename L, typename H>\n"
+	"static inline auto clamp(T x, L lo, H hi) {\n"
+	"	return min(max(x, lo), hi);\n"
+	"}\n"
+	"static inline double pown(double x, long n) { return pow(x, (double)n); "
+	"}\n"
+	"static inline float rsqrt(float x) { return 1.0f / sqrtf(x); }\n"
+	"static inline double rsqrt(double x) { return 1.0 / sqrt(x); }\n";
+
+FErrorType flintInit_cpu_jit() {
+	if (!initialized) {
+		namespace fs = std::filesystem;
+		initialized = true;
+		compiler =
+			environment_or("FLINT_JIT_CXX", environment_or("CXX", "c++"));
+		cache_dir = environment_or("FLINT_JIT_CACHE", cache_directory());
+		std::error_code err;
+		fs::create_directories(cache_dir, err);
+		if (err) {
+			flogging(F_WARNING, "Could not create the jit cache directory " +
+									cache_dir + ", using temporary directory");
+			cache_dir = fs::temp_directory_path().string();
+		}
+		flogging(F_VERBOSE, "Caching jit compiled graphs in " + cache_dir);
+	}
+	return NO_ERROR;
+}
+FErrorType flintCleanup_cpu_jit() {
+	if (initialized) {
+		initialized = false;
+		kernel_cache.clear();
+		for (void *library : libraries)
+			dlclose(library);
+		libraries.clear();
+	}
+	return NO_ERROR;
+}
+// quotes `str` as a single argument of a shell command
+static std::string shell_quote(const std::string &str) {
+	std::string quoted = "'";
+	for (char c : str)
+		quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+	return quoted + "'";
+}
+static std::string read_file(const std::string &path) {
+	std::ifstream file(path);
+	if (!file)
+		return "";
+	std::stringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+/**
+ * Loads the kernel for `source` from the disk cache or compiles it there.
+ * Returns nullptr if the compilation failed, which is remembered so the
+ * compiler is not invoked again for the same graph.
+ */
+static JITKernel compile(const std::string &source) {
+	namespace fs = std::filesystem;
+	const auto cached = kernel_cache.find(source);
+	if (cached != kernel_cache.end())
+		return cached->second;
+	const auto start = std::chrono::high_resolution_clock::now();
+	// the source contains every type and shape of the graph, so it is used as
+	// the structural key of the cache
+	std::stringstream name;
+	name << std::hex << std::hash<std::string>{}(source) << "_"
+		 << source.size();
+	const std::string base = cache_dir + "/graph_" + name.str();
+	std::string library = base + ".so";
+	const bool in_cache =
+		fs::exists(library) && read_file(base + ".cpp") == source;
+	if (!in_cache) {
+		// compile to a temporary file that is renamed afterwards, so parallel
+		// processes never load a half written library
+		const std::string tmp = base + "." + std::to_string(getpid());
+		{
+			std::ofstream file(tmp + ".cpp");
+			file << source;
+		}
+		const std::string command =
+			shell_quote(compiler) + " -O3 -march=native -shared -fPIC -w -o " +
+			shell_quote(tmp + ".so") + " " + shell_quote(tmp + ".cpp") +
+			" > " + shell_quote(tmp + ".log") + " 2>&1";
+		if (std::system(command.c_str()) != 0) {
+			flogging(F_WARNING, "Compilation of the graph failed (" + command +
+									"):\n" + read_file(tmp + ".log"));
+			fs::remove(tmp + ".cpp");
+			fs::remove(tmp + ".log");
+			kernel_cache.insert({source, nullptr});
+			return nullptr;
+		}
+		fs::remove(tmp + ".log");
+		std::error_code err;
+		if (!fs::exists(library) || fs::exists(base + ".cpp")) {
+			// not cached yet or overwrite a colliding entry
+			fs::rename(tmp + ".so", library, err);
+			if (!err)
+				fs::rename(tmp + ".cpp", base + ".cpp", err);
+		}
+		if (err || fs::exists(tmp + ".so")) {
+			// the library could not be moved to its place in the cache (or
+			// an older version is already loaded), load it from its
+			// temporary name instead
+			library = base + "_" + std::to_string(temporary_libraries++) +
+					  "." + std::to_string(getpid()) + ".so";
+			fs::rename(tmp + ".so", library);
+			fs::remove(tmp + ".cpp");
+		}
+	}
+	void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (!handle) {
+		flogging(F_WARNING, "Could not load compiled graph: " +
+								std::string(dlerror()));
+		kernel_cache.insert({source, nullptr});
+		return nullptr;
+	}
+	libraries.push_back(handle);
+	JITKernel kernel = (JITKernel)dlsym(handle, "execute_graph");
+	if (!kernel) {
+		flogging(F_WARNING, "Compiled graph is missing its entry point");
+		kernel_cache.insert({source, nullptr});
+		return nullptr;
+	}
+	kernel_cache.insert({source, kernel});
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::high_resolution_clock::now() - start;
+	flogging(F_DEBUG, std::string(in_cache ? "loading" : "compilation") +
+						  " of graph took " + std::to_string(elapsed.count()) +
+						  "ms");
+	return kernel;
+}
+/** Arguments of a (parallel) kernel execution */
+struct JITExecution {
+		JITKernel kernel;
+		std::vector<const void *> parameters;
+};
+static void executeKernelTask(const CPUTask &task) {
+	const JITExecution &exe = *(const JITExecution *)task.argument;
+	exe.kernel(task.result, exe.parameters.data(), task.from,
+			   task.from + task.size);
+}
+/**
+ * Checks if the nodes that would be compiled contain random operations or
+ * 16bit and 8bit storage types (the generated code only knows the types of
+ * the kernels, see `type_string`)
+ */
+static bool containsRandomOrNarrow(FGraphNode *node) {
+	std::list<FGraphNode *> todo = {node};
+	std::unordered_set<FGraphNode *> visited;
+	while (!todo.empty()) {
+		FGraphNode *curr = todo.front();
+		todo.pop_front();
+		if (is_narrow_type(curr->operation.data_type))
+			return true;
+		if (curr->result_data || curr->operation.op_type == FSTORE ||
+			!visited.insert(curr).second)
+			continue;
+		if (curr->operation.op_type == FGEN_RANDOM ||
+			curr->operation.op_type == FDROPOUT)
+			return true;
+		for (int i = 0; i < curr->num_predecessor; i++)
+			todo.push_back(curr->predecessors[i]);
+	}
+	return false;
+}
+/** Checks if `node` is a (chain of) view(s) on an already computed result */
+static bool isViewOnResult(FGraphNode *node) {
+	if (node->num_predecessor != 1 ||
+		OperationImplementation::implementations[node->operation.op_type]
+				->view_offset(node) == -1)
+		return false;
+	FGraphNode *pred = node->predecessors[0];
+	return pred->result_data || pred->operation.op_type == FSTORE ||
+		   isViewOnResult(pred);
+}
+FGraphNode *fExecuteGraph_cpu_jit(FGraphNode *node) {
+	using namespace std;
+	if (!initialized)
+		flintInit_cpu_jit();
+	const FOperation op = node->operation;
+	// the interpreter constructs the intermediate results for eager execution
+	// and shares the buffers of views
+	if (node->result_data || op.op_type == FSTORE ||
+		op.op_type == FGEN_CONSTANT || fIsEagerExecution() ||
+		containsRandomOrNarrow(node) || isViewOnResult(node))
+		return fExecuteGraph_cpu(node);
+	list<pair<FGraphNode *, string>> parameters;
+	const string graph_code = generateCode(node, parameters);
+	size_t total = 1;
+	for (int i = 0; i < op.dimensions; i++)
+		total *= op.shape[i];
+	JITExecution exe;
+	string source = jit_prelude;
+	source += "extern \"C\" void execute_graph(void *__restrict__ result, "
+			  "const void *const *parameters, long from, long to) {\n";
+	source += type_string(op.data_type) + " *__restrict__ R = (" +
+			  type_string(op.data_type) + " *)result;\n";
+	for (auto &[gn, name] : parameters) {
+		const string type = type_string(gn->operation.data_type);
+		source += "const " + type + " *__restrict__ " + name + " = (const " +
+				  type + " *)parameters[" +
+				  to_string(exe.parameters.size()) + "];\n";
+		const void *data = nullptr;
+		if (gn->result_data) {
+			if (!gn->result_data->data)
+				fSyncMemory(gn);
+			data = gn->result_data->data;
+		} else if (gn->operation.op_type == FSTORE) {
+			FStore *store = (FStore *)gn->operation.additional_data;
+			if (!store->data)
+				fSyncMemory(gn);
+			data = store->data;
+		} else if (gn->operation.op_type == FGEN_CONSTANT)
+			data = gn->operation.additional_data;
+		if (!data) {
+			flogging(F_DEBUG, "parameter of jit graph has no data, falling "
+							  "back to the cpu backend");
+			return fExecuteGraph_cpu(node);
+		}
+		exe.parameters.push_back(data);
+	}
+	// tells the compiler the range of the index, so it can resolve the index
+	// calculations of the parameters
+	source += "for (long flint_gid = from; flint_gid < to; flint_gid++) {\n"
+			  "if (flint_gid < 0 || flint_gid >= " +
+			  to_string(total) + "l) __builtin_unreachable();\n";
+	source += graph_code;
+	source += "R[index] = v0;\n}\n}\n";
+	exe.kernel = compile(source);
+	if (!exe.kernel)
+		return fExecuteGraph_cpu(node);
+	void *result = nullptr;
+	switch (op.data_type) {
+	case F_INT32:
+		result = safe_mal_pooled<int>(total);
+		break;
+	case F_INT64:
+		result = safe_mal_pooled<long>(total);
+		break;
+	case F_FLOAT32:
+		result = safe_mal_pooled<float>(total);
+		break;
+	case F_FLOAT64:
+		result = safe_mal_pooled<double>(total);
+		break;
+	}
+	if (!result)
+		return nullptr;
+	WorkStealingPool *pool = cpu_thread_pool();
+	if (total >= JIT_PARALLEL_SIZE && pool && pool->size() > 1)
+		pool->execute_parallel(node, {}, result, total,
+							   min(total, pool->size()), executeKernelTask,
+							   &exe);
+	else
+		exe.kernel(result, exe.parameters.data(), 0, total);
+	FResultData *rd = new FResultData();
+	rd->data = result;
+	rd->num_entries = total;
+	rd->mem_id = nullptr;
+	node->result_data = rd;
+	return node;
+}
@@ -0,0 +1,204 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "memory_planner.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <set>
+
+// offsets in the arena are aligned to this
+#define PLAN_ALIGNMENT 64
+// above this number of nodes the reachability of a parallel execution is not
+// computed (it needs num_nodes^2 bits) and buffers are never shared
+#define PLAN_MAX_PARALLEL_NODES 8192
+// above this number of buffers the quadratic greedy placement is replaced by a
+// linear scan over the execution order
+#define PLAN_MAX_GREEDY_BUFFERS 2048
+
+/**
+ * Sequential plan in O(n log n): walks the execution order, releases the
+ * buffers after their last use and places new ones into the best fitting free
+ * block (adjacent free blocks are merged).
+ */
+static void linearScan(const std::vector<BufferLifetime> &buffers,
+					   const std::vector<size_t> &sizes,
+					   const std::vector<size_t> &last_use, size_t num_nodes,
+					   MemoryPlan &plan) {
+	std::vector<std::vector<size_t>> defined(num_nodes), released(num_nodes);
+	for (size_t b = 0; b < buffers.size(); b++) {
+		defined[buffers[b].definition].push_back(b);
+		released[last_use[b]].push_back(b);
+	}
+	// free blocks by offset and by size
+	std::map<size_t, size_t> blocks;
+	std::set<std::pair<size_t, size_t>> by_size;
+	const auto remove = [&](std::map<size_t, size_t>::iterator block) {
+		by_size.erase({block->second, block->first});
+		return blocks.erase(block);
+	};
+	for (size_t i = 0; i < num_nodes; i++) {
+		for (size_t b : defined[i]) {
+			const size_t size = sizes[b];
+			const auto fit = by_size.lower_bound({size, 0});
+			size_t offset;
+			if (fit != by_size.end()) {
+				offset = fit->second;
+				const size_t rest = fit->first - size;
+				remove(blocks.find(offset));
+				if (rest > 0) {
+					blocks.insert({offset + size, rest});
+					by_size.insert({rest, offset + size});
+				}
+			} else if (!blocks.empty() &&
+					   blocks.rbegin()->first + blocks.rbegin()->second ==
+						   plan.arena_bytes) {
+				// extend the last free block
+				offset = blocks.rbegin()->first;
+				remove(std::prev(blocks.end()));
+			} else
+				offset = plan.arena_bytes;
+			plan.offsets[b] = offset;
+			plan.arena_bytes = std::max(plan.arena_bytes, offset + size);
+		}
+		for (size_t b : released[i]) {
+			size_t offset = plan.offsets[b], size = sizes[b];
+			auto next = blocks.lower_bound(offset);
+			if (next != blocks.end() && next->first == offset + size) {
+				size += next->second;
+				next = remove(next);
+			}
+			if (next != blocks.begin()) {
+				const auto prev = std::prev(next);
+				if (prev->first + prev->second == offset) {
+					offset = prev->first;
+					size += prev->second;
+					remove(prev);
+				}
+			}
+			blocks.insert({offset, size});
+			by_size.insert({size, offset});
+		}
+	}
+}
+
+MemoryPlan plan_memory(const std::vector<BufferLifetime> &buffers,
+					   size_t num_nodes,
+					   const std::vector<std::vector<size_t>> *successors) {
+	const size_t n = buffers.size();
+	MemoryPlan plan;
+	plan.offsets.resize(n);
+	std::vector<size_t> sizes(n), last_use(n);
+	for (size_t b = 0; b < n; b++) {
+		sizes[b] = (buffers[b].bytes + PLAN_ALIGNMENT - 1) / PLAN_ALIGNMENT *
+				   PLAN_ALIGNMENT;
+		last_use[b] = buffers[b].definition;
+		for (size_t u : buffers[b].uses)
+			last_use[b] = std::max(last_use[b], u);
+	}
+	// lower bound, the alive bytes per position of the sequential order
+	std::vector<long> delta(num_nodes + 1, 0);
+	for (size_t b = 0; b < n; b++) {
+		delta[buffers[b].definition] += sizes[b];
+		delta[last_use[b] + 1] -= sizes[b];
+	}
+	long alive = 0;
+	for (size_t i = 0; i < num_nodes; i++) {
+		alive += delta[i];
+		plan.lower_bound = std::max(plan.lower_bound, (size_t)alive);
+	}
+	// bitsets of the ancestors of each node for parallel executions
+	const bool parallel = successors != nullptr;
+	const bool share = !parallel || num_nodes <= PLAN_MAX_PARALLEL_NODES;
+	const size_t words = (num_nodes + 63) / 64;
+	std::vector<uint64_t> ancestors;
+	if (parallel && share) {
+		ancestors.resize(num_nodes * words, 0);
+		// positions are a topological order
+		for (size_t i = 0; i < num_nodes; i++) {
+			const uint64_t *own = &ancestors[i * words];
+			for (size_t s : (*successors)[i]) {
+				uint64_t *other = &ancestors[s * words];
+				for (size_t w = 0; w < words; w++)
+					other[w] |= own[w];
+				other[i / 64] |= (uint64_t)1 << (i % 64);
+			}
+		}
+	}
+	const auto is_ancestor = [&](size_t a, size_t of) {
+		return (ancestors[of * words + a / 64] >> (a % 64)) & 1;
+	};
+	// true if every access of `a` happens before the definition of `b`
+	const auto before = [&](size_t a, size_t b) {
+		const size_t def = buffers[b].definition;
+		if (buffers[a].uses.empty())
+			return buffers[a].definition != def &&
+				   is_ancestor(buffers[a].definition, def);
+		for (size_t u : buffers[a].uses)
+			if (u == def || !is_ancestor(u, def))
+				return false;
+		return true;
+	};
+	const auto conflict = [&](size_t a, size_t b) {
+		if (!parallel)
+			return !(last_use[a] < buffers[b].definition ||
+					 last_use[b] < buffers[a].definition);
+		return !before(a, b) && !before(b, a);
+	};
+	if (!share) {
+		// every buffer gets its own memory
+		for (size_t b = 0; b < n; b++) {
+			plan.offsets[b] = plan.arena_bytes;
+			plan.arena_bytes += sizes[b];
+		}
+		return plan;
+	}
+	if (!parallel && n > PLAN_MAX_GREEDY_BUFFERS) {
+		linearScan(buffers, sizes, last_use, num_nodes, plan);
+		return plan;
+	}
+	std::vector<size_t> order(n);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+					 [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+	std::vector<size_t> placed;
+	std::vector<size_t> conflicts;
+	for (size_t b : order) {
+		conflicts.clear();
+		for (size_t o : placed)
+			if (conflict(o, b))
+				conflicts.push_back(o);
+		std::sort(conflicts.begin(), conflicts.end(), [&](size_t x, size_t y) {
+			return plan.offsets[x] < plan.offsets[y];
+		});
+		// smallest gap between the conflicting buffers that is large enough
+		size_t offset = SIZE_MAX, best_gap = SIZE_MAX, end = 0;
+		for (size_t o : conflicts) {
+			if (plan.offsets[o] >= end) {
+				const size_t gap = plan.offsets[o] - end;
+				if (gap >= sizes[b] && gap < best_gap) {
+					best_gap = gap;
+					offset = end;
+				}
+			}
+			end = std::max(end, plan.offsets[o] + sizes[o]);
+		}
+		if (offset == SIZE_MAX)
+			offset = end;
+		plan.offsets[b] = offset;
+		plan.arena_bytes = std::max(plan.arena_bytes, offset + sizes[b]);
+		placed.push_back(b);
+	}
+	return plan;
+}
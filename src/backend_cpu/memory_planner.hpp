@@ -0,0 +1,58 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_MEMORY_PLANNER_HPP
+#define FLINT_MEMORY_PLANNER_HPP
+#include <cstddef>
+#include <vector>
+
+/**
+ * An intermediate result buffer of a graph execution. Nodes are identified by
+ * their position in the (topological) execution order.
+ */
+struct BufferLifetime {
+		size_t bytes;
+		// node that writes the buffer first
+		size_t definition;
+		// all nodes that access the buffer after `definition` (in place
+		// operations that overwrite it included)
+		std::vector<size_t> uses;
+};
+struct MemoryPlan {
+		// offset of each buffer in the arena
+		std::vector<size_t> offsets;
+		// size of the arena, i.e. the predicted peak of the intermediates
+		size_t arena_bytes = 0;
+		// largest sum of buffers that are alive at the same time in the
+		// sequential execution order, no plan can use less memory
+		size_t lower_bound = 0;
+};
+/**
+ * Assigns each buffer an offset inside one arena, so that buffers which may be
+ * alive at the same time do not overlap (greedy by size: the largest buffers
+ * are placed first, each into the smallest fitting gap between the buffers
+ * it conflicts with). Large sequential plans are computed with a linear scan
+ * over the execution order instead, which only reuses memory that is already
+ * released.
+ *
+ * If `successors` is nullptr, the nodes are executed sequentially in their
+ * order and two buffers conflict if their live ranges overlap. Otherwise the
+ * nodes may be executed in any order that respects the edges in `successors`
+ * (position -> positions of the nodes that depend on it), then one buffer may
+ * only reuse the memory of another if every use of the other one is an
+ * ancestor of its definition.
+ */
+MemoryPlan
+plan_memory(const std::vector<BufferLifetime> &buffers, size_t num_nodes,
+			const std::vector<std::vector<size_t>> *successors = nullptr);
+#endif
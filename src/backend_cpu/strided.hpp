@@ -0,0 +1,77 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_STRIDED_HPP
+#define FLINT_STRIDED_HPP
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Strided layouts of the cpu backend. Operations that only rearrange the
+ * elements of their parameter (see `OperationImplementation::strided_view`)
+ * are not computed on their own during a graph execution, their consumers
+ * read the elements directly from the data of the node the rearrangements
+ * start at. A chain of such operations collapses into one layout.
+ */
+
+struct StridedLayout {
+		// node the elements are read from or -1 if the node is dense
+		long source = -1;
+		// position of the first element in the data of `source`
+		long offset = 0;
+		// distance of two neighbouring indices in the data of `source` per
+		// dimension of the node, 0 for broadcasted and negative for reversed
+		// dimensions
+		std::vector<long> strides;
+};
+/**
+ * Elements `[from, from + size)` of a node with shape `shape` that is
+ * described by `layout` on the elements `data` of its source. Runs along the
+ * last dimension are copied at once.
+ */
+template <typename T>
+void strided_gather(T *__restrict__ result, const T *__restrict__ data,
+					const std::vector<size_t> &shape,
+					const StridedLayout &layout, size_t from, size_t size) {
+	const int last = shape.size() - 1;
+	const std::vector<long> &strides = layout.strides;
+	std::vector<size_t> index(last + 1);
+	long pos = layout.offset;
+	size_t rest = from;
+	for (int d = last; d >= 0; d--) {
+		index[d] = rest % shape[d];
+		rest /= shape[d];
+		pos += (long)index[d] * strides[d];
+	}
+	const size_t end = from + size;
+	const long step = strides[last];
+	for (size_t i = from; i < end;) {
+		const size_t run = std::min(shape[last] - index[last], end - i);
+		if (step == 1)
+			std::copy(data + pos, data + pos + run, result + i);
+		else
+			for (size_t k = 0; k < run; k++)
+				result[i + k] = data[pos + (long)k * step];
+		i += run;
+		pos += (long)run * step;
+		index[last] += run;
+		// carry into the outer dimensions
+		for (int d = last; d > 0 && index[d] == shape[d]; d--) {
+			pos += strides[d - 1] - (long)shape[d] * strides[d];
+			index[d] = 0;
+			index[d - 1]++;
+		}
+	}
+}
+#endif
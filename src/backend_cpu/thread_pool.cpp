@@ -0,0 +1,353 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "thread_pool.hpp"
+#include "../operations/implementation.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// pool and index of the worker thread, -1 for threads that are not part of one
+static thread_local const WorkStealingPool *worker_pool = nullptr;
+static thread_local long worker_id = -1;
+// number of unsuccessful searches before a worker parks
+#define SPIN_ROUNDS 64
+
+bool WorkStealingDeque::push(CPUTask *task) {
+	const int64_t b = bottom.load(std::memory_order_relaxed);
+	const int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= capacity)
+		return false;
+	buffer[b & (capacity - 1)].store(task, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+CPUTask *WorkStealingDeque::take() {
+	const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+	CPUTask *task = nullptr;
+	if (t <= b) {
+		task = buffer[b & (capacity - 1)].load(std::memory_order_relaxed);
+		if (t == b) {
+			// last element, race against thieves
+			if (!top.compare_exchange_strong(t, t + 1,
+											 std::memory_order_seq_cst,
+											 std::memory_order_relaxed))
+				task = nullptr;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+	} else
+		bottom.store(b + 1, std::memory_order_relaxed);
+	return task;
+}
+CPUTask *WorkStealingDeque::steal() {
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return nullptr;
+	CPUTask *task =
+		buffer[t & (capacity - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+									 std::memory_order_relaxed))
+		return nullptr;
+	return task;
+}
+InjectionQueue::InjectionQueue() : cells(new Cell[capacity]) {
+	for (size_t i = 0; i < capacity; i++)
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+bool InjectionQueue::push(CPUTask *task) {
+	size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+	while (true) {
+		Cell &cell = cells[pos & (capacity - 1)];
+		const size_t seq = cell.sequence.load(std::memory_order_acquire);
+		const long diff = (long)seq - (long)pos;
+		if (diff == 0) {
+			if (enqueue_pos.compare_exchange_weak(
+					pos, pos + 1, std::memory_order_relaxed)) {
+				cell.task = task;
+				cell.sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (diff < 0)
+			return false; // full
+		else
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+	}
+}
+CPUTask *InjectionQueue::pop() {
+	size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+	while (true) {
+		Cell &cell = cells[pos & (capacity - 1)];
+		const size_t seq = cell.sequence.load(std::memory_order_acquire);
+		const long diff = (long)seq - (long)(pos + 1);
+		if (diff == 0) {
+			if (dequeue_pos.compare_exchange_weak(
+					pos, pos + 1, std::memory_order_relaxed)) {
+				CPUTask *task = cell.task;
+				cell.sequence.store(pos + capacity, std::memory_order_release);
+				return task;
+			}
+		} else if (diff < 0)
+			return nullptr; // empty
+		else
+			pos = dequeue_pos.load(std::memory_order_relaxed);
+	}
+}
+/** Parses a cpu list of sysfs like "0-3,8-11" */
+static std::vector<int> parseCpuList(const std::string &list) {
+	std::vector<int> cpus;
+	std::stringstream stream(list);
+	std::string range;
+	while (std::getline(stream, range, ',')) {
+		if (range.empty())
+			continue;
+		const size_t dash = range.find('-');
+		const int first = std::stoi(range.substr(0, dash));
+		const int last = dash == std::string::npos
+							 ? first
+							 : std::stoi(range.substr(dash + 1));
+		for (int cpu = first; cpu <= last; cpu++)
+			cpus.push_back(cpu);
+	}
+	return cpus;
+}
+const std::vector<std::vector<int>> &numa_topology() {
+	static const std::vector<std::vector<int>> topology = []() {
+		namespace fs = std::filesystem;
+		std::vector<std::vector<int>> nodes;
+		std::error_code err;
+		for (const fs::directory_entry &entry :
+			 fs::directory_iterator("/sys/devices/system/node", err)) {
+			const std::string name = entry.path().filename().string();
+			if (name.size() < 5 || name.compare(0, 4, "node") != 0 ||
+				name.find_first_not_of("0123456789", 4) != std::string::npos)
+				continue;
+			const size_t node = std::stoul(name.substr(4));
+			std::ifstream file(entry.path() / "cpulist");
+			std::string list;
+			if (!std::getline(file, list))
+				continue;
+			if (nodes.size() <= node)
+				nodes.resize(node + 1);
+			nodes[node] = parseCpuList(list);
+		}
+		if (nodes.empty()) {
+			nodes.emplace_back();
+			for (unsigned int cpu = 0;
+				 cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++)
+				nodes[0].push_back(cpu);
+		}
+		return nodes;
+	}();
+	return topology;
+}
+/** Restricts the calling thread to the cpus of `placement` */
+static void pinThread(const WorkerPlacement &placement) {
+#ifdef __linux__
+	std::vector<int> cpus;
+	if (placement.cpu >= 0)
+		cpus.push_back(placement.cpu);
+	else if (placement.numa_node >= 0 &&
+			 placement.numa_node < (int)numa_topology().size())
+		cpus = numa_topology()[placement.numa_node];
+	if (cpus.empty())
+		return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu : cpus)
+		if (cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		flogging(F_WARNING, "Could not pin a worker thread of the cpu backend");
+#endif
+}
+WorkStealingPool::WorkStealingPool(
+	size_t num_threads, const std::vector<WorkerPlacement> &placement) {
+	const size_t num_workers = num_threads > 1 ? num_threads - 1 : 0;
+	for (size_t i = 0; i < num_workers; i++) {
+		deques.emplace_back(new WorkStealingDeque());
+		mailboxes.emplace_back(new InjectionQueue());
+	}
+	workers.reserve(num_workers);
+	for (size_t i = 0; i < num_workers; i++)
+		workers.emplace_back(
+			&WorkStealingPool::worker_routine, this, i,
+			i < placement.size() ? placement[i] : WorkerPlacement());
+}
+WorkStealingPool::~WorkStealingPool() {
+	running.store(false, std::memory_order_seq_cst);
+	epoch.fetch_add(1, std::memory_order_seq_cst);
+	epoch.notify_all();
+	for (std::thread &t : workers)
+		t.join();
+}
+void WorkStealingPool::run_task(const CPUTask &task) {
+	if (task.routine)
+		task.routine(task);
+	else
+		OperationImplementation::implementations[task.node->operation.op_type]
+			->execute_cpu(task.node, *task.pred_data, task.result, task.from,
+						  task.size);
+	task.latch->count_down();
+}
+void WorkStealingPool::wake_workers() {
+	epoch.fetch_add(1, std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_seq_cst) > 0)
+		epoch.notify_all();
+}
+CPUTask *WorkStealingPool::find_task(long self) {
+	CPUTask *task = nullptr;
+	if (self >= 0 && (task = mailboxes[self]->pop()))
+		return task;
+	if (self >= 0 && (task = deques[self]->take()))
+		return task;
+	if ((task = injection.pop()))
+		return task;
+	// steal, starting with the right neighbour to spread the thieves
+	const size_t n = deques.size();
+	for (size_t i = 1; i <= n; i++) {
+		const size_t victim = (self + i) % n;
+		if ((long)victim == self)
+			continue;
+		if ((task = deques[victim]->steal()))
+			return task;
+	}
+	// tasks meant for other workers that are still busy
+	for (size_t i = 1; i <= n; i++) {
+		const size_t victim = (self + i) % n;
+		if ((long)victim == self)
+			continue;
+		if ((task = mailboxes[victim]->pop()))
+			return task;
+	}
+	return nullptr;
+}
+void WorkStealingPool::worker_routine(size_t id,
+									  WorkerPlacement placement) {
+	pinThread(placement);
+	worker_pool = this;
+	worker_id = id;
+	int idle_rounds = 0;
+	while (running.load(std::memory_order_relaxed)) {
+		const uint32_t curr_epoch = epoch.load(std::memory_order_seq_cst);
+		CPUTask *task = find_task(id);
+		if (task) {
+			run_task(*task);
+			idle_rounds = 0;
+			continue;
+		}
+		if (++idle_rounds < SPIN_ROUNDS) {
+			std::this_thread::yield();
+			continue;
+		}
+		// park until new work is submitted (or the pool shuts down)
+		sleeping.fetch_add(1, std::memory_order_seq_cst);
+		if (running.load(std::memory_order_seq_cst))
+			epoch.wait(curr_epoch, std::memory_order_seq_cst);
+		sleeping.fetch_sub(1, std::memory_order_seq_cst);
+		idle_rounds = 0;
+	}
+	worker_pool = nullptr;
+	worker_id = -1;
+}
+void WorkStealingPool::enqueue(CPUTask *task, long worker) {
+	bool pushed;
+	if (worker >= 0)
+		pushed = mailboxes[worker]->push(task);
+	else if (worker_pool == this)
+		pushed = deques[worker_id]->push(task);
+	else
+		pushed = injection.push(task);
+	// no capacity left -> execute it directly
+	if (!pushed)
+		run_task(*task);
+}
+void WorkStealingPool::submit(CPUTask *tasks, size_t num_tasks) {
+	for (size_t i = 0; i < num_tasks; i++)
+		enqueue(&tasks[i], -1);
+	wake_workers();
+}
+void WorkStealingPool::submit_to(CPUTask *task, long worker) {
+	enqueue(task, worker);
+	wake_workers();
+}
+long WorkStealingPool::current_worker() const {
+	return worker_pool == this ? worker_id : -1;
+}
+void WorkStealingPool::wait(CompletionLatch &latch) {
+	const long self = worker_pool == this ? worker_id : -1;
+	while (!latch.done()) {
+		CPUTask *task = find_task(self);
+		if (task)
+			run_task(*task);
+		else {
+			// remaining tasks are being executed by other threads
+			latch.wait();
+		}
+	}
+}
+/**
+ * Per thread storage for the tasks and latch of a parallel execution. Kept in
+ * a free list so nested executions (a waiting thread helps executing a task
+ * that itself is executed in parallel) do not share storage and so that no
+ * allocation happens per node after warm up.
+ */
+struct ParallelContext {
+		CompletionLatch latch;
+		std::vector<CPUTask> tasks;
+};
+static thread_local std::vector<std::unique_ptr<ParallelContext>>
+	free_contexts;
+void WorkStealingPool::execute_parallel(
+	FGraphNode *node, const std::vector<CPUResultData> &pred_data,
+	void *result, size_t dis_num, size_t units,
+	void (*routine)(const CPUTask &), void *argument) {
+	std::unique_ptr<ParallelContext> ctx;
+	if (free_contexts.empty())
+		ctx.reset(new ParallelContext());
+	else {
+		ctx = std::move(free_contexts.back());
+		free_contexts.pop_back();
+	}
+	const size_t work_size = dis_num / units;
+	ctx->tasks.resize(units);
+	ctx->latch.reset(units);
+	for (size_t i = 0; i < units; i++) {
+		const size_t to = i == units - 1 ? dis_num : (i + 1) * work_size;
+		ctx->tasks[i] = {node,
+						 &pred_data,
+						 result,
+						 i * work_size,
+						 to - i * work_size,
+						 &ctx->latch,
+						 routine,
+						 argument};
+	}
+	// chunk i goes to worker i - 1, chunk 0 (and the ones beyond the number
+	// of workers) to the submitting thread
+	for (size_t i = 0; i < units; i++)
+		enqueue(&ctx->tasks[i], (long)(i % size()) - 1);
+	wake_workers();
+	wait(ctx->latch);
+	free_contexts.push_back(std::move(ctx));
+}
@@ -0,0 +1,190 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_THREAD_POOL_HPP
+#define FLINT_THREAD_POOL_HPP
+#include "../../flint.h"
+#include "cpu_common.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * Counts down the number of outstanding tasks of one parallel execution.
+ * Unlike `std::latch` it may be reset and reused, so the CPU backend does not
+ * have to allocate a new synchronization object per node.
+ */
+struct CompletionLatch {
+		std::atomic<int> remaining{0};
+		/** Has to be called before the tasks are submitted */
+		void reset(int count) {
+			remaining.store(count, std::memory_order_relaxed);
+		}
+		void count_down() {
+			if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				remaining.notify_all();
+		}
+		bool done() const {
+			return remaining.load(std::memory_order_acquire) == 0;
+		}
+		/** Blocks until the counter reaches 0 */
+		void wait() const {
+			int curr;
+			while ((curr = remaining.load(std::memory_order_acquire)) != 0)
+				remaining.wait(curr, std::memory_order_acquire);
+		}
+};
+/**
+ * One chunk of a node that is executed on the CPU, i.e. the call
+ * `execute_cpu(node, *pred_data, result, from, size)`. The predecessor data is
+ * only referenced, it has to stay alive until `latch` reaches 0.
+ * If `routine` is set, `routine(*this)` is called instead (used to schedule
+ * whole nodes of a graph, see `fExecuteGraph_cpu`).
+ */
+struct CPUTask {
+		FGraphNode *node;
+		const std::vector<CPUResultData> *pred_data;
+		void *result;
+		size_t from;
+		size_t size;
+		CompletionLatch *latch;
+		void (*routine)(const CPUTask &) = nullptr;
+		void *argument = nullptr;
+};
+/**
+ * Bounded Chase-Lev deque. Only the owning worker may `push` and `take` (at
+ * the bottom), every other thread may `steal` (from the top). Stores pointers
+ * so that every slot can be read and written atomically.
+ */
+class WorkStealingDeque {
+	private:
+		static constexpr int64_t capacity = 4096;
+		alignas(64) std::atomic<int64_t> top{0};
+		alignas(64) std::atomic<int64_t> bottom{0};
+		std::unique_ptr<std::atomic<CPUTask *>[]> buffer;
+
+	public:
+		WorkStealingDeque() : buffer(new std::atomic<CPUTask *>[capacity]) {}
+		/** Returns false if the deque is full */
+		bool push(CPUTask *task);
+		/** Returns nullptr if the deque is empty */
+		CPUTask *take();
+		/** Returns nullptr if the deque is empty or the steal lost a race */
+		CPUTask *steal();
+};
+/**
+ * Bounded lock-free multi-producer multi-consumer queue (after Dmitry
+ * Vyukov), used to hand tasks from threads that are not part of the pool to
+ * the workers without taking a lock.
+ */
+class InjectionQueue {
+	private:
+		static constexpr size_t capacity = 4096;
+		struct Cell {
+				std::atomic<size_t> sequence;
+				CPUTask *task;
+		};
+		std::unique_ptr<Cell[]> cells;
+		alignas(64) std::atomic<size_t> enqueue_pos{0};
+		alignas(64) std::atomic<size_t> dequeue_pos{0};
+
+	public:
+		InjectionQueue();
+		/** Returns false if the queue is full */
+		bool push(CPUTask *task);
+		/** Returns nullptr if the queue is empty */
+		CPUTask *pop();
+};
+/** Where a worker thread of a `WorkStealingPool` runs */
+struct WorkerPlacement {
+		// cpu the worker is pinned to or -1
+		int cpu = -1;
+		// if `cpu` is -1: NUMA node to whose cpus the worker is pinned or -1
+		int numa_node = -1;
+};
+/**
+ * The cpus of each NUMA node of the system (read from sysfs), a single node
+ * with all cpus if the topology is unknown.
+ */
+const std::vector<std::vector<int>> &numa_topology();
+/**
+ * Work-stealing scheduler of the CPU backend. Every worker owns a
+ * `WorkStealingDeque`, tasks submitted by a worker go to its own deque, tasks
+ * submitted by any other thread go through the lock-free `InjectionQueue`.
+ * Idle workers steal from each other and park on an atomic epoch counter, so
+ * the submission path never takes a lock.
+ *
+ * The thread that waits for its tasks helps executing them (see `wait`),
+ * which is why the pool only starts `num_threads - 1` workers.
+ *
+ * Additionally every worker has a mailbox for tasks that should preferably
+ * run on it (see `submit_to`), workers empty their own mailbox first and the
+ * ones of the others last.
+ */
+class WorkStealingPool {
+	private:
+		std::vector<std::thread> workers;
+		std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+		std::vector<std::unique_ptr<InjectionQueue>> mailboxes;
+		InjectionQueue injection;
+		std::atomic<bool> running{true};
+		std::atomic<uint32_t> epoch{0};
+		std::atomic<int> sleeping{0};
+		void worker_routine(size_t id, WorkerPlacement placement);
+		CPUTask *find_task(long self);
+		void wake_workers();
+		void enqueue(CPUTask *task, long worker);
+
+	public:
+		static void run_task(const CPUTask &task);
+		/** Starts a pool with `num_threads` participating threads (including
+		 * the thread that submits and waits). Worker `i` is pinned according
+		 * to `placement[i]` if there is such an entry. */
+		WorkStealingPool(size_t num_threads,
+						 const std::vector<WorkerPlacement> &placement = {});
+		~WorkStealingPool();
+		/** Number of threads that execute tasks in parallel */
+		size_t size() const { return workers.size() + 1; }
+		/** Enqueues `num_tasks` tasks. The latch of each task has to be reset
+		 * accordingly before. */
+		void submit(CPUTask *tasks, size_t num_tasks);
+		/** Enqueues `task` in the mailbox of worker `worker` (or like
+		 * `submit` if it is -1). Other threads only execute it if they run
+		 * out of work. */
+		void submit_to(CPUTask *task, long worker);
+		/** Index of the worker of this pool that calls this function or -1
+		 * if it is called by a thread that is not one of its workers */
+		long current_worker() const;
+		/** Executes pending tasks until `latch` reaches 0 */
+		void wait(CompletionLatch &latch);
+		/**
+		 * Splits the execution of `node` into `units` chunks of the
+		 * `dis_num` deployed elements, executes them in parallel and returns
+		 * after all of them are finished. Chunk `i` is always submitted to
+		 * the same worker, so that the pages of a result are touched first
+		 * by the worker that writes them and consumers with the same number
+		 * of elements read them on the same worker (and NUMA node). If
+		 * `routine` is set, it is called per chunk instead of `execute_cpu`
+		 * (see `CPUTask`).
+		 */
+		void execute_parallel(FGraphNode *node,
+							  const std::vector<CPUResultData> &pred_data,
+							  void *result, size_t dis_num, size_t units,
+							  void (*routine)(const CPUTask &) = nullptr,
+							  void *argument = nullptr);
+};
+/** Returns the pool of the CPU backend, initializes the backend if necessary */
+WorkStealingPool *cpu_thread_pool();
+#endif
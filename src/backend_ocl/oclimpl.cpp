@@ -167,10 +167,103 @@ FErrorType flintInit_gpu() {
 	flogging(F_VERBOSE, "Flint GPU backend was initialized!");
 	return NO_ERROR;
 }
+/**
+ * Type of the gpu memory and the eager kernels of nodes with type `t`, the
+ * 16bit types are stored and computed as floats on the gpu (the half precision
+ * extension is optional and there is no bfloat16 type in OpenCL C), the 8bit
+ * types as ints (like all integer kernels).
+ */
+static FType device_type(FType t) { return widened_type(t); }
+/** Converts `num_entries` values of the storage type `type` to `T` */
+template <typename T>
+static void widen(T *wide, FType type, size_t num_entries, const void *data) {
+	for (size_t i = 0; i < num_entries; i++)
+		switch (type) {
+		case F_FLOAT16:
+			wide[i] = ((const Float16 *)data)[i];
+			break;
+		case F_BFLOAT16:
+			wide[i] = ((const BFloat16 *)data)[i];
+			break;
+		case F_INT8:
+			wide[i] = ((const int8_t *)data)[i];
+			break;
+		default:
+			wide[i] = ((const uint8_t *)data)[i];
+		}
+}
+/** Converts `num_entries` values of type `T` to the storage type `type` */
+template <typename T>
+static void narrow(void *data, FType type, size_t num_entries, const T *wide) {
+	for (size_t i = 0; i < num_entries; i++)
+		switch (type) {
+		case F_FLOAT16:
+			((Float16 *)data)[i] = wide[i];
+			break;
+		case F_BFLOAT16:
+			((BFloat16 *)data)[i] = wide[i];
+			break;
+		case F_INT8:
+			((int8_t *)data)[i] = wide[i];
+			break;
+		default:
+			((uint8_t *)data)[i] = wide[i];
+		}
+}
+/**
+ * Enqueues the upload of `num_entries` elements of type `type` from `data` to
+ * `mem`. The storage types are widened on the host first, since that buffer is
+ * temporary their write blocks.
+ */
+static cl_int write_gpu_memory(cl_mem mem, FType type, size_t num_entries,
+							   const void *data, cl_event *event) {
+	if (!is_narrow_type(type))
+		return clEnqueueWriteBuffer(clqueue, mem, CL_FALSE, 0,
+									num_entries * type_size(type), data, 0,
+									nullptr, event);
+	if (device_type(type) == F_INT32) {
+		vector<int> wide(num_entries);
+		widen(wide.data(), type, num_entries, data);
+		return clEnqueueWriteBuffer(clqueue, mem, CL_TRUE, 0,
+									num_entries * sizeof(int), wide.data(), 0,
+									nullptr, event);
+	}
+	vector<float> wide(num_entries);
+	widen(wide.data(), type, num_entries, data);
+	return clEnqueueWriteBuffer(clqueue, mem, CL_TRUE, 0,
+								num_entries * sizeof(float), wide.data(), 0,
+								nullptr, event);
+}
+/**
+ * Reads `num_entries` elements of type `type` from `mem` to `data` (blocking),
+ * the storage types are converted from the floats or ints of the gpu.
+ */
+static cl_int read_gpu_memory(cl_mem mem, FType type, size_t num_entries,
+							  void *data) {
+	if (!is_narrow_type(type))
+		return clEnqueueReadBuffer(clqueue, mem, CL_TRUE, 0,
+								   num_entries * type_size(type), data, 0,
+								   nullptr, nullptr);
+	cl_int err_code;
+	if (device_type(type) == F_INT32) {
+		vector<int> wide(num_entries);
+		err_code = clEnqueueReadBuffer(clqueue, mem, CL_TRUE, 0,
+									   num_entries * sizeof(int), wide.data(),
+									   0, nullptr, nullptr);
+		narrow(data, type, num_entries, wide.data());
+	} else {
+		vector<float> wide(num_entries);
+		err_code = clEnqueueReadBuffer(clqueue, mem, CL_TRUE, 0,
+									   num_entries * sizeof(float),
+									   wide.data(), 0, nullptr, nullptr);
+		narrow(data, type, num_entries, wide.data());
+	}
+	return err_code;
+}
 static cl_mem create_gpu_memory(FGraphNode *node, cl_mem_flags memory_type,
 								size_t *total_size = nullptr) {
 	cl_int err_code;
-	size_t type_size_node = type_size(node->operation.data_type);
+	size_t type_size_node = type_size(device_type(node->operation.data_type));
 	size_t total_size_node = 1;
 	if (node->operation.op_type != FGEN_CONSTANT)
 		for (int i = 0; i < node->operation.dimensions; i++)
@@ -192,6 +285,21 @@ static cl_mem create_gpu_memory(FGraphNode *node, cl_mem_flags memory_type,
 		*total_size = total_size_node;
 	return result_mem;
 }
+/**
+ * Checks if the gpu memory of `node` is shared with a view on it (see
+ * `view_offset`), shared memory must not be recycled. Kernels that are still
+ * enqueued hold references too, that only prevents the recycling.
+ */
+static bool gpu_memory_shared(const FGraphNode *node) {
+	cl_mem mem = node->result_data ? node->result_data->mem_id : nullptr;
+	if (!mem && node->operation.op_type == FSTORE)
+		mem = ((FStore *)node->operation.additional_data)->mem_id;
+	cl_uint references = 1;
+	return mem &&
+		   clGetMemObjectInfo(mem, CL_MEM_REFERENCE_COUNT, sizeof(cl_uint),
+							  &references, nullptr) == CL_SUCCESS &&
+		   references > 1;
+}
 cl_mem OCLCompilerThread::copy_memory(const cl_mem other, size_t num_bytes,
 									  cl_mem_flags memory_flags) {
 	cl_int err_code;
@@ -236,9 +344,10 @@ cl_kernel OCLCompilerThread::eager_compile(FGraphNode *node, int hash) {
 		string kernel_name;
 		code +=
 			generateEagerCode(node->operation.op_type, ret, types, kernel_name);
-		bool correct = ret == node->operation.data_type;
+		bool correct = ret == device_type(node->operation.data_type);
 		for (int i = 0; i < types.size(); i++)
-			correct &= types[i] == node->predecessors[i]->operation.data_type;
+			correct &= types[i] ==
+					   device_type(node->predecessors[i]->operation.data_type);
 		if (correct)
 			our_kernel = kernel_name;
 		all_kernels.push_back({OCLCompilerThread::generate_kernel_hash(
@@ -340,44 +449,41 @@ FGraphNode *fExecuteGraph_gpu_eagerly(FGraphNode *node) {
 		node->result_data->data = store->data;
 		return node;
 	}
-	if ((node->operation.op_type == FLATTEN ||
-		 node->operation.op_type == FRESHAPE) &&
-		node->predecessors[0]->operation.op_type != FGEN_CONSTANT) {
-		// just copy previous data
+	const long view =
+		OperationImplementation::implementations[node->operation.op_type]
+			->view_offset(node);
+	if (view != -1) {
+		// share the buffers of the parameter, sub buffers would have to be
+		// aligned, so gpu memory is only shared without an offset
 		const FGraphNode *prev = node->predecessors[0];
-		void const *data;
-		cl_mem gpu_data;
-		size_t num_elems;
+		void *data = nullptr;
+		cl_mem gpu_data = nullptr;
 		if (prev->result_data) {
 			data = prev->result_data->data;
 			gpu_data = prev->result_data->mem_id;
-			num_elems = prev->result_data->num_entries;
 		} else if (prev->operation.op_type == FSTORE) {
 			const FStore *store = (FStore *)prev->operation.additional_data;
 			data = store->data;
 			gpu_data = store->mem_id;
-			num_elems = store->num_entries;
 		}
-		FResultData *rd = new FResultData();
-		rd->data = nullptr;
-		rd->num_entries = num_elems;
-		rd->mem_id = nullptr;
-		int type_s = type_size(node->operation.data_type);
-		if (gpu_data) {
-			rd->mem_id = OCLCompilerThread::copy_memory(
-				gpu_data, type_s * num_elems, CL_MEM_READ_WRITE);
-		} else if (data) {
-			rd->data = malloc(type_s * num_elems);
-			if (!rd->data) {
-				setErrorType(OUT_OF_MEMORY);
-				flogging(F_ERROR, "Not enough memory to store result! " +
-									  to_string(num_elems));
-				return nullptr;
+		if ((data || gpu_data) && (view == 0 || !gpu_data)) {
+			size_t num_elems = 1;
+			for (int i = 0; i < node->operation.dimensions; i++)
+				num_elems *= node->operation.shape[i];
+			FResultData *rd = new FResultData();
+			rd->num_entries = num_elems;
+			rd->mem_id = nullptr;
+			rd->data = nullptr;
+			if (gpu_data) {
+				clRetainMemObject(gpu_data);
+				rd->mem_id = gpu_data;
 			}
-			memcpy(rd->data, data, type_s * num_elems);
+			if (data)
+				rd->data = pool_share(
+					data, view * type_size(node->operation.data_type));
+			node->result_data = rd;
+			return node;
 		}
-		node->result_data = rd;
-		return node;
 	}
 	size_t inv_broad[2];
 	if (node->num_predecessor == 2)
@@ -386,10 +492,11 @@ FGraphNode *fExecuteGraph_gpu_eagerly(FGraphNode *node) {
 			inv_broad[1]);
 	vector<FType> params_types(node->num_predecessor);
 	for (int i = 0; i < node->num_predecessor; i++)
-		params_types[i] = node->predecessors[i]->operation.data_type;
+		params_types[i] = device_type(node->predecessors[i]->operation.data_type);
 	// because the operation type should be at the same position
 	int hash = OCLCompilerThread::generate_kernel_hash(
-		node->operation.op_type, node->operation.data_type, params_types);
+		node->operation.op_type, device_type(node->operation.data_type),
+		params_types);
 	const auto prog = OCLCompilerThread::eager_cache.find(hash);
 	cl_kernel kernel = nullptr;
 	cl_int err_code;
@@ -417,7 +524,6 @@ FGraphNode *fExecuteGraph_gpu_eagerly(FGraphNode *node) {
 		const FOperation op = pred->operation;
 		cl_mem mem_obj = nullptr;
 		bool do_write = false;
-		const size_t type_s = type_size(op.data_type);
 		size_t total_size;
 		cl_mem mem_id = nullptr;
 		const bool recycle =
@@ -425,7 +531,7 @@ FGraphNode *fExecuteGraph_gpu_eagerly(FGraphNode *node) {
 			reusage[i] && (op.op_type != FSTORE || !node->gradient_data) &&
 			((pred->result_data && pred->result_data->mem_id) ||
 			 pred->operation.op_type == FSTORE) &&
-			op.op_type != FGEN_CONSTANT;
+			op.op_type != FGEN_CONSTANT && !gpu_memory_shared(pred);
 		if (pred->result_data) {
 			total_size = pred->operation.op_type == FGEN_CONSTANT
 							 ? 1
@@ -434,7 +540,7 @@ FGraphNode *fExecuteGraph_gpu_eagerly(FGraphNode *node) {
 			if (recycle) {
 				pred->result_data->mem_id = nullptr;
 				if (pred->result_data->data)
-					free(pred->result_data->data);
+					pool_free(pred->result_data->data);
 				delete pred->result_data;
 				pred->result_data = nullptr;
 				if (op.op_type == FSTORE)
@@ -482,9 +588,8 @@ FGraphNode *fExecuteGraph_gpu_eagerly(FGraphNode *node) {
 							 fop_to_string[op.op_type]);
 			}
 			cl_event write_event;
-			err_code = clEnqueueWriteBuffer(clqueue, mem_obj, CL_FALSE, 0,
-											total_size * type_s, data, 0,
-											nullptr, &write_event);
+			err_code = write_gpu_memory(mem_obj, op.data_type, total_size,
+										data, &write_event);
 			if (err_code != CL_SUCCESS) {
 				string msg = "Unknown Error while loading data to GPU! Error: ";
 				setErrorType(OCL_ERROR);
@@ -504,7 +609,8 @@ FGraphNode *fExecuteGraph_gpu_eagerly(FGraphNode *node) {
 		// zero result
 		cl_event zero_event;
 		const long zero_pattern = 0;
-		const long type_size_node = type_size(node->operation.data_type);
+		const long type_size_node =
+			type_size(device_type(node->operation.data_type));
 		clEnqueueFillBuffer(clqueue, res_mem, &zero_pattern, type_size_node, 0,
 							total_size_node * type_size_node, 0, nullptr,
 							&zero_event);
@@ -689,7 +795,7 @@ FResultData *fSyncMemory(FGraphNode *node) {
 	if (res && res->mem_id && !res->data) {
 		// read result to cpu
 		int type_size_node = type_size(node->operation.data_type);
-		res->data = malloc(res->num_entries * type_size_node);
+		res->data = pool_allocate(res->num_entries * type_size_node);
 		if (store_data)
 			*store_data = res->data;
 		res->num_entries = res->num_entries;
@@ -699,9 +805,9 @@ FResultData *fSyncMemory(FGraphNode *node) {
 			return nullptr;
 		}
 		// wait for result
-		cl_int err_code = clEnqueueReadBuffer(clqueue, res->mem_id, CL_TRUE, 0,
-											  res->num_entries * type_size_node,
-											  res->data, 0, nullptr, nullptr);
+		cl_int err_code =
+			read_gpu_memory(res->mem_id, node->operation.data_type,
+							res->num_entries, res->data);
 		if (err_code != CL_SUCCESS) {
 			setErrorType(OCL_ERROR);
 			string msg =
@@ -724,33 +830,27 @@ static vector<bool>
 find_reusable_parameters(const FGraphNode *node,
 						 const list<pair<FGraphNode *, string>> params) {
 	vector<bool> result(params.size(), false);
-	list<const FGraphNode *> todo;
-	todo.push_front(node);
-	while (!todo.empty()) {
-		const FGraphNode *curr = todo.front();
-		todo.pop_front();
+	unordered_map<const FGraphNode *, size_t> param_index;
+	{
+		size_t j = 0;
+		for (const auto &[param, name] : params)
+			param_index.insert({param, j++});
+	}
+	// every node is visited once over a path of reusable parameters
+	topological_sort(node, [&](const FGraphNode *curr, int i) {
 		const vector<bool> reusage =
 			OperationImplementation::implementations[curr->operation.op_type]
 				->reuse_parameter_result(curr);
-		for (int i = 0; i < curr->num_predecessor; i++) {
-			if (i < reusage.size() && reusage[i]) {
-				const FGraphNode *pred = curr->predecessors[i];
-				bool allow_recycle = true;
-				if (pred->operation.op_type == FSTORE) {
-					allow_recycle = curr->gradient_data == nullptr;
-				}
-				if (allow_recycle) {
-					int j = 0;
-					for (const auto &[param, name] : params) {
-						if (pred == param)
-							result[j] = true;
-						j++;
-					}
-					todo.push_back(pred);
-				}
-			}
-		}
-	}
+		if (i >= reusage.size() || !reusage[i])
+			return false;
+		const FGraphNode *pred = curr->predecessors[i];
+		if (pred->operation.op_type == FSTORE && curr->gradient_data)
+			return false;
+		const auto entry = param_index.find(pred);
+		if (entry != param_index.end())
+			result[entry->second] = true;
+		return true;
+	});
 	return result;
 }
 FGraphNode *fExecuteGraph_gpu(FGraphNode *node) {
@@ -824,7 +924,7 @@ FGraphNode *fExecuteGraph_gpu(FGraphNode *node) {
 		chrono::high_resolution_clock::now() - start;
 	start = chrono::high_resolution_clock::now();
 	// result buffer
-	size_t type_size_node = type_size(node_op.data_type);
+	size_t type_size_node = type_size(device_type(node_op.data_type));
 	cl_mem result_mem = nullptr;
 	vector<cl_event> writeEvents;
 	// upload or link parameters
@@ -835,11 +935,13 @@ FGraphNode *fExecuteGraph_gpu(FGraphNode *node) {
 		for (auto &[gn, name] : parameters) {
 			const FOperation op = gn->operation;
 			const bool recycle = !result_mem && gn->reference_counter == 1 &&
-								 reusable[index] && op.op_type != FGEN_CONSTANT;
+								 reusable[index] &&
+								 op.op_type != FGEN_CONSTANT &&
+								 !gpu_memory_shared(gn);
 			// The problem here: optimized memory is a store
 			cl_mem mem_obj = nullptr;
 			bool do_write = false;
-			const size_t type_s = type_size(op.data_type);
+			const size_t type_s = type_size(device_type(op.data_type));
 			const size_t total_size =
 				op.op_type == FSTORE
 					? ((FStore *)op.additional_data)->num_entries
@@ -896,9 +998,9 @@ FGraphNode *fExecuteGraph_gpu(FGraphNode *node) {
 				if (!data)
 					flogging(F_ERROR, "parameter has no data!");
 				writeEvents.emplace_back();
-				err_code = clEnqueueWriteBuffer(
-					clqueue, mem_obj, CL_FALSE, 0, total_size * type_s, data, 0,
-					nullptr, &writeEvents[writeEvents.size() - 1]);
+				err_code =
+					write_gpu_memory(mem_obj, op.data_type, total_size, data,
+									 &writeEvents[writeEvents.size() - 1]);
 				if (err_code != CL_SUCCESS) {
 					string msg = "Unknown Error while loading data to GPU!";
 					flogging(F_ERROR, msg);
@@ -0,0 +1,441 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "cost_model.hpp"
+#include "backend_cpu/thread_pool.hpp"
+#include "errors.hpp"
+#include "memory_pool.hpp"
+#include "operations/implementation.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// minimum time in nanoseconds that one measurement is repeated for
+#define CALIBRATION_MIN_TIME 2e6
+#define CALIBRATION_MAX_REPETITIONS 50
+// version of the file format
+#define COST_MODEL_VERSION 1
+
+/** t(w) = overhead + per_unit * w in nanoseconds, where w is the number of
+ * elements times the `operation_score` of the node */
+struct CostCurve {
+		double overhead = -1;
+		double per_unit = 0;
+		bool valid() const { return overhead >= 0; }
+		double at(double work) const { return overhead + per_unit * work; }
+};
+struct OperationCosts {
+		CostCurve sequential, parallel, gpu;
+};
+struct CostModel {
+		bool loaded = false;
+		// size of the cpu thread pool during the calibration
+		size_t threads = 0;
+		OperationCosts operations[FNUM_OPERATION_TYPES];
+		// medians of the calibrated operations, used for the others
+		OperationCosts fallback;
+};
+static CostModel model;
+
+static size_t numElements(const FGraphNode *node) {
+	size_t total = 1;
+	for (int i = 0; i < node->operation.dimensions; i++)
+		total *= node->operation.shape[i];
+	return total;
+}
+static const OperationCosts &costsOf(FOperationType op) {
+	const OperationCosts &costs = model.operations[op];
+	return costs.sequential.valid() ? costs : model.fallback;
+}
+bool predict_costs(const FGraphNode *node, size_t elements,
+				   CostPrediction &prediction) {
+	if (!model.loaded)
+		return false;
+	const OperationCosts &costs = costsOf(node->operation.op_type);
+	const double work =
+		(double)elements *
+		OperationImplementation::implementations[node->operation.op_type]
+			->operation_score((FGraphNode *)node);
+	prediction.sequential += costs.sequential.at(work);
+	if (costs.parallel.valid()) {
+		prediction.parallel_overhead =
+			std::max(prediction.parallel_overhead, costs.parallel.overhead);
+		prediction.parallel_work += costs.parallel.per_unit * work;
+	} else
+		prediction.parallel_overhead = INFINITY;
+	if (costs.gpu.valid()) {
+		prediction.gpu_overhead =
+			std::max(prediction.gpu_overhead, costs.gpu.overhead);
+		prediction.gpu_work += costs.gpu.per_unit * work;
+	} else
+		prediction.has_gpu = false;
+	return true;
+}
+bool prefer_gpu(FGraphNode *node, bool with_pred, bool fallback) {
+	if (!model.loaded)
+		return fallback;
+	// the gpu executes the graph as one kernel, the cpu node by node
+	CostPrediction gpu;
+	double cpu = 0;
+	for (FGraphNode *curr :
+		 topological_sort(node, [with_pred](FGraphNode *c, int i) {
+			 return with_pred && !c->predecessors[i]->result_data &&
+					c->operation.op_type != FSTORE;
+		 })) {
+		if (curr->result_data || curr->operation.op_type == FSTORE)
+			continue;
+		CostPrediction single;
+		predict_costs(curr, numElements(curr), single);
+		predict_costs(curr, numElements(curr), gpu);
+		cpu += std::min(single.sequential, single.parallel());
+	}
+	if (!gpu.has_gpu)
+		return fallback;
+	return gpu.gpu() < cpu;
+}
+/** Weighted least squares fit of samples (work, time), the weights are the
+ * inverse squared times so that the small sizes are fitted as well */
+static CostCurve
+fitCurve(const std::vector<std::pair<double, double>> &samples) {
+	CostCurve curve;
+	if (samples.size() < 2)
+		return curve;
+	double sum = 0, mean_w = 0, mean_t = 0;
+	for (const auto &[w, t] : samples) {
+		const double weight = 1.0 / std::max(t * t, 1.0);
+		sum += weight;
+		mean_w += weight * w;
+		mean_t += weight * t;
+	}
+	mean_w /= sum;
+	mean_t /= sum;
+	double cov = 0, var = 0;
+	for (const auto &[w, t] : samples) {
+		const double weight = 1.0 / std::max(t * t, 1.0);
+		cov += weight * (w - mean_w) * (t - mean_t);
+		var += weight * (w - mean_w) * (w - mean_w);
+	}
+	curve.per_unit = var > 0 ? std::max(cov / var, 0.0) : 0;
+	curve.overhead = std::max(mean_t - curve.per_unit * mean_w, 0.0);
+	return curve;
+}
+/** Computes the costs of the operations that are not calibrated */
+static void computeFallback() {
+	const auto median = [](std::vector<double> values) {
+		if (values.empty())
+			return -1.0;
+		std::nth_element(values.begin(), values.begin() + values.size() / 2,
+						 values.end());
+		return values[values.size() / 2];
+	};
+	CostCurve OperationCosts::*curves[3] = {&OperationCosts::sequential,
+											&OperationCosts::parallel,
+											&OperationCosts::gpu};
+	for (CostCurve OperationCosts::*curve : curves) {
+		std::vector<double> overheads, per_units;
+		for (const OperationCosts &costs : model.operations)
+			if ((costs.*curve).valid()) {
+				overheads.push_back((costs.*curve).overhead);
+				per_units.push_back((costs.*curve).per_unit);
+			}
+		(model.fallback.*curve).overhead = median(overheads);
+		(model.fallback.*curve).per_unit = std::max(median(per_units), 0.0);
+	}
+}
+/** Path of the cost model if the user passes none */
+static std::string defaultPath() {
+	return environment_or("FLINT_COST_MODEL",
+						  cache_directory() + "/cost_model");
+}
+static FErrorType saveModel(const std::string &path) {
+	namespace fs = std::filesystem;
+	std::error_code err;
+	if (fs::path(path).has_parent_path())
+		fs::create_directories(fs::path(path).parent_path(), err);
+	std::ofstream file(path);
+	file << "flint-cost-model " << COST_MODEL_VERSION << " " << model.threads
+		 << "\n";
+	for (int op = 0; op < FNUM_OPERATION_TYPES; op++) {
+		const OperationCosts &costs = model.operations[op];
+		if (!costs.sequential.valid())
+			continue;
+		file << fop_to_string[op];
+		for (const CostCurve &curve :
+			 {costs.sequential, costs.parallel, costs.gpu})
+			file << " " << curve.overhead << " " << curve.per_unit;
+		file << "\n";
+	}
+	if (!file) {
+		setErrorType(IO_ERROR);
+		flogging(F_ERROR, "Could not write the cost model to " + path);
+		return IO_ERROR;
+	}
+	return NO_ERROR;
+}
+FErrorType fLoadCostModel(const char *path) {
+	const std::string file_path = path ? path : defaultPath();
+	std::ifstream file(file_path);
+	std::string magic;
+	int version = 0;
+	size_t threads = 0;
+	if (!(file >> magic >> version >> threads) ||
+		magic != "flint-cost-model" || version != COST_MODEL_VERSION) {
+		setErrorType(IO_ERROR);
+		flogging(F_ERROR, "Could not load the cost model from " + file_path);
+		return IO_ERROR;
+	}
+	CostModel loaded;
+	loaded.threads = threads;
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream entry(line);
+		std::string name;
+		OperationCosts costs;
+		if (!(entry >> name >> costs.sequential.overhead >>
+			  costs.sequential.per_unit >> costs.parallel.overhead >>
+			  costs.parallel.per_unit >> costs.gpu.overhead >>
+			  costs.gpu.per_unit))
+			continue;
+		for (int op = 0; op < FNUM_OPERATION_TYPES; op++)
+			if (name == fop_to_string[op])
+				loaded.operations[op] = costs;
+	}
+	loaded.loaded = true;
+	model = loaded;
+	computeFallback();
+	if (model.threads != cpu_thread_pool()->size())
+		flogging(F_WARNING, "The cost model was calibrated with " +
+								std::to_string(model.threads) +
+								" threads, the parallel costs may be wrong");
+	flogging(F_VERBOSE, "Loaded the cost model from " + file_path);
+	return NO_ERROR;
+}
+void fResetCostModel() { model = CostModel(); }
+void load_default_cost_model() {
+	if (model.loaded)
+		return;
+	const std::string path = defaultPath();
+	if (std::filesystem::exists(path))
+		fLoadCostModel(path.c_str());
+	else if (environment_or("FLINT_CALIBRATE", "0") == "1")
+		fCalibrateCostModel(path.c_str());
+}
+/** Minimum time of repeated calls of `run` in nanoseconds */
+template <typename F> static double measure(F run) {
+	run(); // warm up caches and compile kernels
+	double best = INFINITY, total = 0;
+	for (int i = 0; i < CALIBRATION_MAX_REPETITIONS &&
+					(i < 3 || total < CALIBRATION_MIN_TIME);
+		 i++) {
+		const auto start = std::chrono::high_resolution_clock::now();
+		run();
+		const double time = std::chrono::duration<double, std::nano>(
+								std::chrono::high_resolution_clock::now() -
+								start)
+								.count();
+		best = std::min(best, time);
+		total += time;
+	}
+	return best;
+}
+/**
+ * Node of operation `op` that is measured, `a` and `b` are vectors with the
+ * same number of elements (a multiple of 64), `k` has 256 elements. Returns
+ * nullptr for operations that are not calibrated.
+ */
+static FGraphNode *calibrationNode(FOperationType op, FGraphNode *a,
+								   FGraphNode *b, FGraphNode *k) {
+	const size_t n = a->operation.shape[0];
+	const size_t rows[2] = {n / 16, 16}, square[2] = {16, 16},
+				 wide[2] = {n / 64, 64};
+	int transposition[2] = {1, 0};
+	switch (op) {
+	case FADD:
+		return fadd_g(a, b);
+	case FSUB:
+		return fsub_g(a, b);
+	case FMUL:
+		return fmul_g(a, b);
+	case FDIV:
+		return fdiv_g(a, b);
+	case FPOW:
+		return fpow_g(a, b);
+	case FMIN:
+		return fmin_g(a, b);
+	case FMAX:
+		return fmax_g(a, b);
+	case FLESS:
+		return fless_g(a, b);
+	case FEQUAL:
+		return fequal_g(a, b);
+	case FGREATER:
+		return fgreater_g(a, b);
+	case FNEG:
+		return fneg(a);
+	case FLOG:
+		return flog(a);
+	case FSIGN:
+		return fsign(a);
+	case FLOG2:
+		return flog2(a);
+	case FLOG10:
+		return flog10(a);
+	case FSIN:
+		return fsin(a);
+	case FCOS:
+		return fcos(a);
+	case FTAN:
+		return ftan(a);
+	case FASIN:
+		return fasin(a);
+	case FACOS:
+		return facos(a);
+	case FATAN:
+		return fatan(a);
+	case FSQRT:
+		return fsqrt_g(a);
+	case FEXP:
+		return fexp(a);
+	case FABS:
+		return fabs_g(a);
+	case FCONVERSION:
+		return fconvert(a, F_FLOAT64);
+	case FMATMUL:
+		return fmatmul(freshape(a, rows, 2), freshape(k, square, 2));
+	case FREDUCE_SUM:
+		return freduce_sum(freshape(a, rows, 2), 1);
+	case FREDUCE_MUL:
+		return freduce_mul(freshape(a, rows, 2), 1);
+	case FREDUCE_MIN:
+		return freduce_min(freshape(a, rows, 2), 1);
+	case FREDUCE_MAX:
+		return freduce_max(freshape(a, rows, 2), 1);
+	case FTRANSPOSE:
+		return ftranspose(freshape(a, wide, 2), transposition);
+	case FCONCAT:
+		return fconcat(a, b, 0);
+	default:
+		return nullptr;
+	}
+}
+/** Input data of the predecessors of `node`, executes them if necessary */
+static std::vector<CPUResultData> predecessorData(FGraphNode *node) {
+	std::vector<CPUResultData> pred_data(node->num_predecessor);
+	for (int i = 0; i < node->num_predecessor; i++) {
+		FGraphNode *pred = node->predecessors[i];
+		if (pred->operation.op_type != FSTORE)
+			fExecuteGraph_cpu(pred);
+		if (pred->result_data) {
+			pred_data[i].data = pred->result_data->data;
+			pred_data[i].num_entries = pred->result_data->num_entries;
+		} else {
+			FStore *store = (FStore *)pred->operation.additional_data;
+			pred_data[i].data = store->data;
+			pred_data[i].num_entries = store->num_entries;
+		}
+		pred_data[i].type = pred->operation.data_type;
+		pred_data[i].shape = std::vector<size_t>(
+			pred->operation.shape,
+			pred->operation.shape + pred->operation.dimensions);
+	}
+	return pred_data;
+}
+FErrorType fCalibrateCostModel(const char *path) {
+	const bool eager = fIsEagerExecution();
+	fDisableEagerExecution();
+	WorkStealingPool *pool = cpu_thread_pool();
+	const bool gpu = flintInitializedBackends() & FLINT_BACKEND_ONLY_GPU;
+	// (work, time) per operation
+	std::vector<std::pair<double, double>> samples[3][FNUM_OPERATION_TYPES];
+	for (size_t n : {1ul << 10, 1ul << 13, 1ul << 16, 1ul << 18}) {
+		std::vector<float> data(n);
+		for (size_t i = 0; i < n; i++)
+			data[i] = 0.1f + 0.8f * (float)((i * 7919) % 1024) / 1024.0f;
+		const size_t small = 256;
+		FGraphNode *a = fCreateGraph(data.data(), n, F_FLOAT32, &n, 1);
+		FGraphNode *b = fCreateGraph(data.data(), n, F_FLOAT32, &n, 1);
+		FGraphNode *k = fCreateGraph(data.data(), small, F_FLOAT32, &small, 1);
+		for (FGraphNode *leaf : {a, b, k})
+			leaf->reference_counter++;
+		for (int op = 0; op < FNUM_OPERATION_TYPES; op++) {
+			FGraphNode *node = calibrationNode((FOperationType)op, a, b, k);
+			if (!node)
+				continue;
+			node->reference_counter++;
+			OperationImplementation *impl =
+				OperationImplementation::implementations[op];
+			const std::vector<CPUResultData> pred_data = predecessorData(node);
+			const size_t total = numElements(node);
+			// split reductions are measured without combining their parts
+			const size_t dis_num = impl->deploy_as_many_elements(node) *
+								   impl->reduction_parts(node);
+			const double work = (double)total * impl->operation_score(node);
+			void *result = pool_allocate(std::max(total, dis_num) *
+										 type_size(node->operation.data_type));
+			if (!result) {
+				if (eager)
+					fEnableEagerExecution();
+				setErrorType(OUT_OF_MEMORY);
+				flogging(F_ERROR, "Not enough memory for the calibration!");
+				return OUT_OF_MEMORY;
+			}
+			const auto sequential = [&]() {
+				impl->execute_cpu(node, pred_data, result, 0, dis_num);
+			};
+			const auto parallel = [&]() {
+				pool->execute_parallel(node, pred_data, result, dis_num,
+									   std::min(dis_num, pool->size()));
+			};
+			// including the download of the result
+			const auto on_gpu = [&]() {
+				FGraphNode *g = calibrationNode((FOperationType)op, a, b, k);
+				fSyncMemory(fExecuteGraph_gpu(g));
+				fFreeGraph(g);
+			};
+			samples[0][op].push_back({work, measure(sequential)});
+			if (pool->size() > 1 && dis_num >= pool->size())
+				samples[1][op].push_back({work, measure(parallel)});
+			pool_free(result);
+			node->reference_counter--;
+			fFreeGraph(node);
+			if (gpu)
+				samples[2][op].push_back({work, measure(on_gpu)});
+		}
+		for (FGraphNode *leaf : {a, b, k}) {
+			leaf->reference_counter--;
+			fFreeGraph(leaf);
+		}
+	}
+	CostModel calibrated;
+	calibrated.loaded = true;
+	calibrated.threads = pool->size();
+	for (int op = 0; op < FNUM_OPERATION_TYPES; op++) {
+		OperationCosts &costs = calibrated.operations[op];
+		costs.sequential = fitCurve(samples[0][op]);
+		costs.parallel = fitCurve(samples[1][op]);
+		costs.gpu = fitCurve(samples[2][op]);
+	}
+	model = calibrated;
+	computeFallback();
+	if (eager)
+		fEnableEagerExecution();
+	const std::string file_path = path ? path : defaultPath();
+	flogging(F_INFO, "Calibrated the cost model, saving it to " + file_path);
+	return saveModel(file_path);
+}
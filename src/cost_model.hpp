@@ -0,0 +1,54 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_COST_MODEL_HPP
+#define FLINT_COST_MODEL_HPP
+#include "../flint.h"
+#include <cstddef>
+
+/**
+ * Predicted execution times in nanoseconds of nodes that are executed as one
+ * unit (e.g. nodes that are fused on the cpu or one kernel on the gpu). The
+ * overheads of a parallel execution and of a gpu kernel are only payed once
+ * per unit, the times of the work are summed up.
+ */
+struct CostPrediction {
+		double sequential = 0;
+		double parallel_overhead = 0, parallel_work = 0;
+		double gpu_overhead = 0, gpu_work = 0;
+		// false if one of the nodes has no calibrated gpu costs
+		bool has_gpu = true;
+		double parallel() const { return parallel_overhead + parallel_work; }
+		double gpu() const { return gpu_overhead + gpu_work; }
+};
+/**
+ * Adds the costs of computing `elements` elements of `node` to `prediction`.
+ * Returns false (and does not change `prediction`) if no cost model is loaded,
+ * then the callers use their built-in heuristics. Operations that could not
+ * be calibrated are predicted by the median costs of the calibrated ones.
+ */
+bool predict_costs(const FGraphNode *node, size_t elements,
+				   CostPrediction &prediction);
+/**
+ * Decides if `node` (and its predecessors without results if `with_pred` is
+ * set) should rather be executed on the gpu than on the cpu. Returns
+ * `fallback` if there is no cost model with gpu costs.
+ */
+bool prefer_gpu(FGraphNode *node, bool with_pred, bool fallback);
+/**
+ * Loads the default cost model (see `fLoadCostModel`) if it exists and none
+ * is loaded yet, or calibrates it if the environment variable
+ * `FLINT_CALIBRATE` is set to 1. Called by `flintInit`.
+ */
+void load_default_cost_model();
+#endif
@@ -91,6 +91,8 @@ struct LayerGraph {
 struct Variable : public LayerGraph {
 		static int variable_no;
 		FGraphNode *node = nullptr;
+		/** parameters of `node` if it is quantized (see `quantize`) */
+		FGraphNode *scale = nullptr, *zero_point = nullptr;
 		Variable() : LayerGraph(1) {
 			name = "Variable" + std::to_string(variable_no++);
 		}
@@ -102,8 +104,60 @@ struct Variable : public LayerGraph {
 			if (node) {
 				node->reference_counter--;
 			}
+			if (scale) {
+				scale->reference_counter--;
+				zero_point->reference_counter--;
+			}
+		}
+		void forward() override {
+			output[0] = scale ? fdequantize(node, scale, zero_point) : node;
+		}
+		/**
+		 * Quantizes the variable to `type` (`F_INT8` or `F_UINT8`) with one
+		 * scale per entry of its first dimension (e.g. per filter), calibrated
+		 * from the range of the values. `F_INT8` is quantized symmetrically
+		 * (zero point 0), `F_UINT8` maps the range between the minimum and
+		 * maximum. The forward pass dequantizes the variable. Variables with
+		 * less than two dimensions (e.g. biases) are kept.
+		 */
+		void quantize(FType type = F_INT8) {
+			const int dims = node->operation.dimensions;
+			if (scale || dims < 2)
+				return;
+			std::vector<int> axes(dims - 1);
+			for (int i = 0; i < dims - 1; i++)
+				axes[i] = i + 1;
+			FGraphNode *lo = fconvert(
+				freduce_min_axes(node, axes.data(), dims - 1, false), F_FLOAT32);
+			FGraphNode *hi = fconvert(
+				freduce_max_axes(node, axes.data(), dims - 1, false), F_FLOAT32);
+			// the range has to include 0
+			lo = fmin(lo, 0.0f);
+			hi = fmax(hi, 0.0f);
+			const float eps = std::numeric_limits<float>::min();
+			if (type == F_INT8) {
+				scale = fmax(fdiv(fmax(fneg(lo), hi), 127.0f), eps);
+				zero_point = fconstant_i(0, node->operation.shape, 1);
+			} else {
+				scale = fmax(fdiv(fsub(hi, lo), 255.0f), eps);
+				zero_point =
+					fconvert(fadd(fdiv(fneg(lo), scale), 0.5f), F_INT32);
+			}
+			fEnforceInverseBroadcasting(scale);
+			fEnforceInverseBroadcasting(zero_point);
+			scale->reference_counter++;
+			zero_point->reference_counter++;
+			FGraphNode *quantized = fquantize(node, scale, zero_point, type);
+			quantized->reference_counter++;
+			fExecuteGraph(quantized);
+			// keep only the results
+			fOptimizeMemory(fExecuteGraph(scale));
+			fOptimizeMemory(fExecuteGraph(zero_point));
+			fOptimizeMemory(quantized);
+			if (--node->reference_counter == 0)
+				fFreeGraph(node);
+			node = quantized;
 		}
-		void forward() override { output[0] = node; }
 		void deserialize_to_onnx(onnx::NodeProto *node) override {
 			// already included as an initializer
 		}
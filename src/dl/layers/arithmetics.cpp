@@ -45,27 +45,7 @@ void Connected::forward() {
 #endif
 	FGraphNode *img = incoming[0]->output[0];
 	FGraphNode *kernel = incoming[1]->output[0];
-	if (transposeA) {
-		int transposition[img->operation.dimensions];
-		for (int i = 0; i < img->operation.dimensions; i++)
-			transposition[i] = i;
-		transposition[img->operation.dimensions - 1] =
-			img->operation.dimensions - 2;
-		transposition[img->operation.dimensions - 2] =
-			img->operation.dimensions - 1;
-		img = ftranspose(img, transposition);
-	}
-	if (transposeB) {
-		int transposition[img->operation.dimensions];
-		for (int i = 0; i < img->operation.dimensions; i++)
-			transposition[i] = i;
-		transposition[img->operation.dimensions - 1] =
-			img->operation.dimensions - 2;
-		transposition[img->operation.dimensions - 2] =
-			img->operation.dimensions - 1;
-		kernel = ftranspose(kernel, transposition);
-	}
-	output[0] = fmatmul(img, kernel);
+	output[0] = fmatmul_transposed(img, kernel, transposeA, transposeB);
 	if (incoming.size() == 3) {
 		FGraphNode *bias = incoming[2]->output[0];
 		if (bias->operation.dimensions == 2 && bias->operation.shape[0] == 1) {
@@ -15,66 +15,51 @@ void BatchNorm::forward() {
 	FGraphNode *x = incoming[0]->output[0];
 	FGraphNode *gamma = incoming[1]->output[0];
 	FGraphNode *beta = incoming[2]->output[0];
-	// because channels and other dimensions have to be swapped
 	FGraphNode *mean_running =
 		incoming.size() <= 3 ? nullptr : incoming[3]->output[0];
 	FGraphNode *var_running =
 		incoming.size() <= 3 ? nullptr : incoming[4]->output[0];
-	int transpositions1[x->operation.dimensions];
-	for (int i = 0; i < x->operation.dimensions; i++)
-		transpositions1[i] = i;
-	transpositions1[1] = x->operation.dimensions - 1;
-	transpositions1[x->operation.dimensions - 1] = 1;
-	FGraphNode *tx = ftranspose(x, transpositions1);
-	// calculate mean and std var
+	// the channels are normalized along their own dimension, no transpositions
+	const int ax = 1;
+	const size_t channels = x->operation.shape[ax];
+	const long mean_start[] = {0, 0}, mean_end[] = {1, (long)channels};
+	const long var_start[] = {1, 0}, var_end[] = {2, (long)channels};
+	const size_t row[] = {1, channels};
+	FGraphNode *moments;
+	if (training || !mean_running)
+		// mean and var of the batch in a single pass
+		moments = fbatch_moments(x, ax);
+	else
+		moments = fconcat(freshape(mean_running, row, 2),
+						  freshape(var_running, row, 2), 0);
+	output[0] = fbatch_norm(x, moments, gamma, beta, ax,
+							std::numeric_limits<float>::epsilon());
 	if (training && mean_running) {
-		// mean and var for all except for the channels
-		FGraphNode *mean = tx;
-		while (mean->operation.dimensions > 1)
-			mean = fdiv_ci(freduce_sum(mean, 0),
-						   (unsigned int)mean->operation.shape[0]);
-		FGraphNode *var = fsub_g(tx, mean);
-		while (var->operation.dimensions > 1)
-			var = fdiv_ci(freduce_sum(var, 0),
-						  (unsigned int)var->operation.shape[0]);
-		mean_running =
-			fadd_g(fmul_cf(mean_running, alpha), fmul_cf(mean, 1 - alpha));
-		var_running =
-			fadd_g(fmul_cf(var_running, alpha), fmul_cf(var, 1 - alpha));
-		Variable *node_mean = dynamic_cast<Variable *>(incoming[3]);
-		Variable *node_var = dynamic_cast<Variable *>(incoming[4]);
-		fExecuteGraph(mean_running);
-		fExecuteGraph(var_running);
-		node_mean->node->reference_counter--;
-		node_var->node->reference_counter--;
-		fFreeGraph(node_mean->node);
-		fFreeGraph(node_var->node);
-		node_mean->node = mean_running;
-		node_var->node = var_running;
+		// the old running statistics are only referenced by their update, so
+		// its execution may reuse their memory
+		Variable *running[] = {dynamic_cast<Variable *>(incoming[3]),
+							   dynamic_cast<Variable *>(incoming[4])};
+		FGraphNode *batch[] = {fslice(moments, mean_start, mean_end),
+							   fslice(moments, var_start, var_end)};
+		for (int i = 0; i < 2; i++) {
+			FGraphNode *old = running[i]->node;
+			FGraphNode *updated = fadd_g(
+				fmul_cf(old, alpha),
+				fmul_cf(freshape(batch[i], old->operation.shape,
+								 old->operation.dimensions),
+						1 - alpha));
+			old->reference_counter--;
+			running[i]->node = fOptimizeMemory(fExecuteGraph(updated));
+			running[i]->node->reference_counter++;
+		}
 	}
 	if (!mean_running) {
-		FGraphNode *mean = tx;
-		while (mean->operation.dimensions > 1)
-			mean = fdiv_ci(freduce_sum(mean, 0),
-						   (unsigned int)mean->operation.shape[0]);
-		FGraphNode *var = fsub_g(tx, mean);
-		while (var->operation.dimensions > 1)
-			var = fdiv_ci(freduce_sum(var, 0),
-						  (unsigned int)var->operation.shape[0]);
-		incoming.push_back(new Variable(mean));
-		incoming.push_back(new Variable(var));
-		mean_running = mean;
-		var_running = var;
+		const size_t shape[] = {channels};
+		incoming.push_back(new Variable(
+			freshape(fslice(moments, mean_start, mean_end), shape, 1)));
+		incoming.push_back(new Variable(
+			freshape(fslice(moments, var_start, var_end), shape, 1)));
 	}
-	FGraphNode *y = ftranspose(
-		fadd_g(
-			fmul_g(gamma, fdiv_g(fsub_g(tx, mean_running),
-								 fsqrt_g(fadd_cf(
-									 var_running,
-									 std::numeric_limits<float>::epsilon())))),
-			beta),
-		transpositions1);
-	output[0] = y;
 };
 //
 int Dropout::drop_no = 0;
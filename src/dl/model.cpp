@@ -61,6 +61,23 @@ GraphModel *GraphModel::load_model(std::string path) {
 			data = (void *)init.int64_data().data();
 			break;
 		}
+		// the 8 and 16bit types are only read from the raw data
+		case onnx::TensorProto_DataType::TensorProto_DataType_INT8: {
+			type = F_INT8;
+			break;
+		}
+		case onnx::TensorProto_DataType::TensorProto_DataType_UINT8: {
+			type = F_UINT8;
+			break;
+		}
+		case onnx::TensorProto_DataType::TensorProto_DataType_FLOAT16: {
+			type = F_FLOAT16;
+			break;
+		}
+		case onnx::TensorProto_DataType::TensorProto_DataType_BFLOAT16: {
+			type = F_BFLOAT16;
+			break;
+		}
 		default:
 			flogging(F_ERROR, "Unknown type: " + to_string(init.data_type()));
 		}
@@ -199,7 +216,10 @@ std::string GraphModel::serialize_onnx() {
 	}
 	int variable = 0;
 	for (Variable *w : weights) {
-		FGraphNode *node = w->node;
+		// quantized weights are stored dequantized
+		FGraphNode *node =
+			w->scale ? fdequantize(w->node, w->scale, w->zero_point) : w->node;
+		node->reference_counter++;
 		fExecuteGraph(node);
 		fSyncMemory(node);
 		FResultData *data = node->result_data;
@@ -228,7 +248,29 @@ std::string GraphModel::serialize_onnx() {
 				onnx::TensorProto_DataType::TensorProto_DataType_DOUBLE);
 			proto.set_raw_data(data->data, sizeof(double) * data->num_entries);
 			break;
+		case F_FLOAT16:
+			proto.set_data_type(
+				onnx::TensorProto_DataType::TensorProto_DataType_FLOAT16);
+			proto.set_raw_data(data->data, 2 * data->num_entries);
+			break;
+		case F_BFLOAT16:
+			proto.set_data_type(
+				onnx::TensorProto_DataType::TensorProto_DataType_BFLOAT16);
+			proto.set_raw_data(data->data, 2 * data->num_entries);
+			break;
+		case F_INT8:
+			proto.set_data_type(
+				onnx::TensorProto_DataType::TensorProto_DataType_INT8);
+			proto.set_raw_data(data->data, data->num_entries);
+			break;
+		case F_UINT8:
+			proto.set_data_type(
+				onnx::TensorProto_DataType::TensorProto_DataType_UINT8);
+			proto.set_raw_data(data->data, data->num_entries);
+			break;
 		}
+		if (--node->reference_counter == 0)
+			fFreeGraph(node);
 	}
 	{
 		using namespace std;
@@ -44,6 +44,15 @@ struct GraphModel {
 				time_per_layer = std::nullopt);
 		/** Serializes the model into an ONNX string. */
 		std::string serialize_onnx();
+		/**
+		 * Quantizes all weights with at least two dimensions to `type`
+		 * (`F_INT8` or `F_UINT8`), see `Variable::quantize`. They are
+		 * dequantized in the forward pass and serialized as `F_FLOAT32`.
+		 */
+		void quantize_weights(FType type = F_INT8) {
+			for (Variable *w : weights)
+				w->quantize(type);
+		}
 		/**
 		 * Infers all output shapes for the given input shapes. The returned
 		 * shapes are ordered like the output nodes of the model.
@@ -328,6 +328,10 @@ struct LossFunction {
  * calculation of `in`.
  *
  * Calculates: `sum(-expected * log(in))`
+ *
+ * If `in` is a softmax along its last dimension, the loss is computed with
+ * `fsoftmax_cross_entropy` directly from the input of the softmax. In that
+ * case `expected` may also contain the integer class index per row.
  * */
 struct CrossEntropyLoss : public LossFunction {
 		FGraphNode *calculate_loss(FGraphNode *actual,
@@ -489,7 +489,8 @@ std::string Adam::description() const {
 }
 
 std::string CrossEntropyLoss::description() const {
-	return "Categorical cross entropy: sum(-expected * log(actual)).";
+	return "Categorical cross entropy: sum(-expected * log(actual)), fused "
+		   "with a preceding softmax.";
 }
 
 MetricReporter &Trainer::get_metric_reporter() {
@@ -588,11 +589,12 @@ TrainingMetrics Trainer::train_epoch() {
 		double batch_loss = 0.0;
 		for (size_t i = 0; i < output.size(); i++) {
 			errors[i]->reference_counter--;
-			while (errors[i]->operation.dimensions > 1) {
-				errors[i] =
-					freduce_sum(errors[i], errors[i]->operation.dimensions - 1);
-			}
-			errors[i] = fconvert(freduce_sum(errors[i], 0), F_FLOAT32);
+			std::vector<int> axes(errors[i]->operation.dimensions);
+			for (size_t d = 0; d < axes.size(); d++)
+				axes[d] = d;
+			errors[i] = fconvert(freduce_sum_axes(errors[i], axes.data(),
+												  axes.size(), false),
+								 F_FLOAT32);
 			batch_loss +=
 				((float *)fCalculateResult(errors[i])->result_data->data)[0];
 		}
@@ -666,9 +668,12 @@ void Trainer::train(size_t epochs) {
 		double validation_error = 0.0;
 		for (size_t j = 0; j < output.size(); j++) {
 			FGraphNode *error = loss->calculate_loss(output[j], out_nodes[j]);
-			while (error->operation.dimensions > 1)
-				error = freduce_sum(error, error->operation.dimensions - 1);
-			error = fconvert(freduce_sum(error, 0), F_FLOAT32);
+			std::vector<int> axes(error->operation.dimensions);
+			for (size_t d = 0; d < axes.size(); d++)
+				axes[d] = d;
+			error = fconvert(
+				freduce_sum_axes(error, axes.data(), axes.size(), false),
+				F_FLOAT32);
 			validation_error +=
 				((float *)fCalculateResult(error)->result_data->data)[0];
 			fFreeGraph(error);
@@ -697,10 +702,27 @@ void Trainer::train(size_t epochs) {
 
 FGraphNode *CrossEntropyLoss::calculate_loss(FGraphNode *out, FGraphNode *exp) {
 	const int n = out->operation.dimensions;
-	auto pred = fmin_cd(fmax_cd(out, 1e-7), 1 - 1e-7);
-	auto t1 = (fmul(exp, fneg(flog(pred))));
-	while (t1->operation.dimensions > 1)
-		t1 = freduce_sum(t1, 1);
+	FGraphNode *t1;
+	if (out->operation.op_type == FSOFTMAX &&
+		((int *)out->operation.additional_data)[0] == n - 1) {
+		// fused with the softmax of the output layer, the gradient does not
+		// pass through the softmax
+		t1 = fsoftmax_cross_entropy(out->predecessors[0], exp, n - 1);
+		if (n > 2) {
+			std::vector<int> axes(n - 2);
+			for (int d = 1; d < n - 1; d++)
+				axes[d - 1] = d;
+			t1 = freduce_sum_axes(t1, axes.data(), axes.size(), false);
+		}
+	} else {
+		auto pred = fmin_cd(fmax_cd(out, 1e-7), 1 - 1e-7);
+		t1 = (fmul(exp, fneg(flog(pred))));
+		// everything except for the batch dimension
+		std::vector<int> axes(n - 1);
+		for (int d = 1; d < n; d++)
+			axes[d - 1] = d;
+		t1 = freduce_sum_axes(t1, axes.data(), axes.size(), false);
+	}
 	size_t total_size = 1;
 	for (unsigned int i = 0; i < (unsigned int)(n - 1); i++)
 		total_size *= out->operation.shape[i];
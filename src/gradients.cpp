@@ -20,10 +20,10 @@
 #include "src/errors.hpp"
 #include "src/operations/implementation.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <iostream>
-#include <list>
 #include <math.h>
 #include <ostream>
 #include <unordered_map>
@@ -61,6 +61,16 @@ static FGraphNode *constant_tensor(double val, FType type, size_t *shape,
 		return fconstant_l((long)val, shape, dimensions);
 	case F_FLOAT64:
 		return fconstant_d((double)val, shape, dimensions);
+	case F_FLOAT16:
+	case F_BFLOAT16:
+		return fconvert(fconstant_f((float)val, shape, dimensions), type);
+	case F_INT8:
+	case F_UINT8:
+		return fconvert(fconstant_i((int)val, shape, dimensions), type);
+	default:
+		setErrorType(WRONG_TYPE);
+		flogging(F_ERROR, "Unknown data type for a constant gradient!");
+		return nullptr; // for c compatibility
 	}
 }
 static FGraphNode *unbroadcast(FGraphNode *adjoint, const FGraphNode *node) {
@@ -89,38 +99,18 @@ static FGraphNode *unbroadcast(FGraphNode *adjoint, const FGraphNode *node) {
 	}
 	return adjoint;
 }
-static void collect(FGraphNode *x, std::list<FGraphNode *> &stack,
-					std::unordered_set<FGraphNode *> &visited,
-					const std::unordered_set<const FGraphNode *> dxs) {
-	// TODO could be made more performant with explicit todo stack and a
-	// push_back before continuing on the parents, see utils
-	if (visited.contains(x))
-		return;
-	visited.insert(x);
-	for (int i = 0; i < x->num_predecessor; i++) {
-		FGraphNode *parent = x->predecessors[i];
-		// check if visited
-		if (visited.contains(parent))
-			continue;
-		// check if it contains dx
-		if (parent->gradient_data) {
-			std::unordered_set<const FGraphNode *> *trace =
-				(std::unordered_set<const FGraphNode *> *)parent->gradient_data;
-			bool skip = true;
-			for (const FGraphNode *dx : dxs) {
-				if (trace->contains(dx)) {
-					skip = false;
-					break;
-				}
-			}
-			if (skip)
-				continue;
-		} else if (!dxs.contains(parent))
-			continue;
-		// recurse
-		collect(parent, stack, visited, dxs);
+/** true if the gradient of `parent` is needed to derive for one of `dxs` */
+static bool needsGradient(const FGraphNode *parent,
+						  const std::unordered_set<const FGraphNode *> &dxs) {
+	if (parent->gradient_data) {
+		std::unordered_set<const FGraphNode *> *trace =
+			(std::unordered_set<const FGraphNode *> *)parent->gradient_data;
+		for (const FGraphNode *dx : dxs)
+			if (trace->contains(dx))
+				return true;
+		return false;
 	}
-	stack.push_front(x);
+	return dxs.contains(parent);
 }
 FGraphNode *fCalculateGradient(FGraphNode *y, FGraphNode *dx) {
 	FGraphNode *res;
@@ -155,9 +145,13 @@ FErrorType fCalculateGradients(FGraphNode *y, FGraphNode **dx,
 	}
 	// to store gradients per node
 	unordered_map<const FGraphNode *, FGraphNode *> adjoints;
-	list<FGraphNode *> todo;
-	std::unordered_set<FGraphNode *> visited;
-	collect(y, todo, visited, vars);
+	// reverse topological order, every node before its parents
+	vector<FGraphNode *> todo =
+		topological_sort(y, [&vars](FGraphNode *curr, int i) {
+			return needsGradient(curr->predecessors[i], vars);
+		});
+	std::reverse(todo.begin(), todo.end());
+	std::unordered_set<FGraphNode *> visited(todo.begin(), todo.end());
 	// used to determine when a node may be freed
 	unordered_map<const FGraphNode *, unsigned int> needed_by(adjoints.size());
 	// initialize
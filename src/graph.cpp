@@ -14,9 +14,11 @@
 
 #include "../flint.h"
 #include "backend_ocl/comp.hpp"
+#include "cost_model.hpp"
 #include "errors.hpp"
 #include "src/operations/implementation.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <list>
@@ -78,8 +80,22 @@ const char *fop_to_string[] = {"FSTORE",
 							   "FPOOLING_MAX",
 							   "FPOOLING_SUM",
 							   "FGRADIENT_POOLING_MAX",
-							   "FDROPOUT"};
+							   "FDROPOUT",
+							   "FQUANTIZE",
+							   "FDEQUANTIZE",
+							   "FSPARSE",
+							   "FSPARSE_MATMUL",
+							   "FSOFTMAX",
+							   "FLOG_SOFTMAX",
+							   "FSOFTMAX_CROSS_ENTROPY",
+							   "FBATCH_MOMENTS",
+							   "FBATCH_NORM",
+							   "FGRADIENT_BATCH_NORM_SUMS",
+							   "FGRADIENT_BATCH_NORM"};
 static bool use_cpu, use_gpu, eager_execution = false, gradient_context = false;
+static bool use_cpu_jit = false;
+static FMathAccuracy math_accuracy = F_STRICT_MATH;
+static FConvolutionAlgorithm convolution_algorithm = F_CONV_AUTO;
 static FErrorType last_error;
 void setErrorType(FErrorType error) { last_error = error; }
 // TODO do execution of parents where necessary in parallel
@@ -87,10 +103,20 @@ void setErrorType(FErrorType error) { last_error = error; }
 void fEnableEagerExecution() { eager_execution = true; }
 void fDisableEagerExecution() { eager_execution = false; }
 int fIsEagerExecution() { return eager_execution; }
+void fSetMathAccuracy(FMathAccuracy accuracy) { math_accuracy = accuracy; }
+FMathAccuracy fMathAccuracy() { return math_accuracy; }
+void fSetConvolutionAlgorithm(FConvolutionAlgorithm algorithm) {
+	convolution_algorithm = algorithm;
+}
+FConvolutionAlgorithm fConvolutionAlgorithm() { return convolution_algorithm; }
 void fStartGradientContext() { gradient_context = true; }
 void fStopGradientContext() { gradient_context = false; }
 bool fIsGradientContext() { return gradient_context; }
 FErrorType fErrorType() { return last_error; }
+// lazy execution on the cpu, compiled if the jit is enabled
+static inline FGraphNode *execute_cpu(FGraphNode *node) {
+	return use_cpu_jit ? fExecuteGraph_cpu_jit(node) : fExecuteGraph_cpu(node);
+}
 static inline FGraphNode *execute_eagerly(FGraphNode *f) {
 	if (!use_cpu && !use_gpu)
 		flintInit(FLINT_BACKEND_BOTH);
@@ -117,7 +143,8 @@ static inline FGraphNode *execute_eagerly(FGraphNode *f) {
 			}
 		}
 		unsigned int gpu_score = compute_score(f, false);
-		prefer_gpu = no_elems * gpu_score * gpu_boost / cpu_boost >= 512;
+		prefer_gpu = ::prefer_gpu(
+			f, false, no_elems * gpu_score * gpu_boost / cpu_boost >= 512);
 	}
 	if (all_calculated && (use_cpu || use_gpu)) {
 		// since we only have one node the heuristics become constant
@@ -178,14 +205,15 @@ FGraphNode *fExecuteGraph(FGraphNode *node) {
 					gpu_boost = 1;
 			}
 		}
-		return no_elems * gpu_score * gpu_boost / cpu_boost >= 1024
+		return prefer_gpu(node, true,
+						  no_elems * gpu_score * gpu_boost / cpu_boost >= 1024)
 				   ? fExecuteGraph_gpu(node)
-				   : fExecuteGraph_cpu(node);
+				   : execute_cpu(node);
 	}
 	if (use_gpu)
 		return fExecuteGraph_gpu(node);
 	if (use_cpu)
-		return fExecuteGraph_cpu(node);
+		return execute_cpu(node);
 	return nullptr;
 }
 FGraphNode *fCalculateResult(FGraphNode *node) {
@@ -203,24 +231,35 @@ FErrorType flintCleanup() {
 	FErrorType e2 = flintCleanup_gpu();
 	if (e2 != NO_ERROR)
 		return e2;
+	FErrorType e3 = flintCleanup_cpu_jit();
+	if (e3 != NO_ERROR)
+		return e3;
+	fTrimMemoryPool(0);
 	use_cpu = false;
 	use_gpu = false;
+	use_cpu_jit = false;
 	return NO_ERROR;
 }
 FErrorType flintInit(int backends) {
 	flogging(F_VERBOSE, "Initializing Flint");
 	std::srand((unsigned int)(std::time(nullptr)));
-	use_cpu = (backends & FLINT_BACKEND_ONLY_CPU);
+	use_cpu_jit = (backends & FLINT_BACKEND_CPU_JIT);
+	use_cpu = (backends & FLINT_BACKEND_ONLY_CPU) || use_cpu_jit;
 	use_gpu = (backends & FLINT_BACKEND_ONLY_GPU);
-	FErrorType e1 = NO_ERROR, e2 = NO_ERROR;
+	FErrorType e1 = NO_ERROR, e2 = NO_ERROR, e3 = NO_ERROR;
 	if (use_cpu)
 		e1 = flintInit_cpu();
 	if (use_gpu)
 		e2 = flintInit_gpu();
+	if (use_cpu_jit)
+		e3 = flintInit_cpu_jit();
 	if (e1 != NO_ERROR)
 		return e1;
 	if (e2 != NO_ERROR)
 		return e2;
+	if (e3 != NO_ERROR)
+		return e3;
+	load_default_cost_model();
 	return NO_ERROR;
 }
 int flintInitializedBackends() {
@@ -229,6 +268,8 @@ int flintInitializedBackends() {
 		backends |= FLINT_BACKEND_ONLY_CPU;
 	if (use_gpu)
 		backends |= FLINT_BACKEND_ONLY_GPU;
+	if (use_cpu_jit)
+		backends |= FLINT_BACKEND_CPU_JIT;
 	return backends;
 }
 // GRAPH METHODS
@@ -253,29 +294,53 @@ FGraphNode *fCreateGraph(const void *data, const int num_entries,
 	size_t byte_size = num_entries;
 	switch (data_type) {
 	case F_INT32:
-		store->data = safe_mal<int>(num_entries);
+		store->data = safe_mal_pooled<int>(num_entries);
 		if (!store->data)
 			return nullptr;
 		byte_size *= sizeof(int);
 		break;
 	case F_INT64:
-		store->data = safe_mal<long>(num_entries);
+		store->data = safe_mal_pooled<long>(num_entries);
 		if (!store->data)
 			return nullptr;
 		byte_size *= sizeof(long);
 		break;
 	case F_FLOAT32:
-		store->data = safe_mal<float>(num_entries);
+		store->data = safe_mal_pooled<float>(num_entries);
 		if (!store->data)
 			return nullptr;
 		byte_size *= sizeof(float);
 		break;
 	case F_FLOAT64:
-		store->data = safe_mal<long>(num_entries);
+		store->data = safe_mal_pooled<long>(num_entries);
 		if (!store->data)
 			return nullptr;
 		byte_size *= sizeof(double);
 		break;
+	case F_FLOAT16:
+		store->data = safe_mal_pooled<Float16>(num_entries);
+		if (!store->data)
+			return nullptr;
+		byte_size *= sizeof(Float16);
+		break;
+	case F_BFLOAT16:
+		store->data = safe_mal_pooled<BFloat16>(num_entries);
+		if (!store->data)
+			return nullptr;
+		byte_size *= sizeof(BFloat16);
+		break;
+	case F_INT8:
+		store->data = safe_mal_pooled<int8_t>(num_entries);
+		if (!store->data)
+			return nullptr;
+		byte_size *= sizeof(int8_t);
+		break;
+	case F_UINT8:
+		store->data = safe_mal_pooled<uint8_t>(num_entries);
+		if (!store->data)
+			return nullptr;
+		byte_size *= sizeof(uint8_t);
+		break;
 	}
 	memcpy(store->data, data, byte_size);
 	store->num_entries = num_entries;
@@ -320,7 +385,7 @@ void fFreeGraph(FGraphNode *graph) {
 			freed_res = true;
 			FResultData *rd = gn->result_data;
 			if (rd->data)
-				free(rd->data);
+				pool_free(rd->data);
 			if (rd->mem_id)
 				clReleaseMemObject(rd->mem_id);
 			rd->mem_id = nullptr;
@@ -336,7 +401,7 @@ void fFreeGraph(FGraphNode *graph) {
 			case FSTORE: {
 				FStore *st = (FStore *)gn->operation.additional_data;
 				if (!freed_res) {
-					free(st->data);
+					pool_free(st->data);
 					if (st->mem_id) {
 						clReleaseMemObject(st->mem_id);
 						st->mem_id = nullptr;
@@ -509,7 +574,7 @@ FGraphNode *fOptimizeMemory(FGraphNode *node) {
 					parent->operation.op_type != FSTORE) {
 					FResultData *rd = parent->result_data;
 					if (rd->data)
-						free(rd->data);
+						pool_free(rd->data);
 					if (rd->mem_id)
 						clReleaseMemObject(rd->mem_id);
 					rd->mem_id = nullptr;
@@ -643,13 +708,22 @@ FGraphNode *farange(const size_t *shape, const int dimensions, const int ax) {
 	((int *)op.additional_data)[0] = ax;
 	return addNode(op, {});
 }
+// type of an operation between a tensor of type `a` and a constant of type
+// `b`, floating point constants don't widen 16bit floating point tensors
+static inline FType constant_result_type(FType a, FType b) {
+	if ((a == F_FLOAT16 || a == F_BFLOAT16) &&
+		(b == F_FLOAT32 || b == F_FLOAT64))
+		return a;
+	return higher_type(a, b);
+}
 // adds the constant value to each entry in a
 template <typename T> static inline FGraphNode *add(FGraphNode *a, const T b) {
 	FOperation op;
 	op.additional_data = nullptr;
 	op.op_type = FADD;
 	initShape_keep(op, &a->operation, nullptr);
-	op.data_type = higher_type(a->operation.data_type, to_flint_type<T>());
+	op.data_type =
+		constant_result_type(a->operation.data_type, to_flint_type<T>());
 	FGraphNode *foo = addNodeWithConst(op, a, b);
 	return foo;
 }
@@ -663,7 +737,8 @@ template <typename T> static inline FGraphNode *sub(FGraphNode *a, const T b) {
 	op.op_type = FSUB;
 	op.additional_data = nullptr;
 	initShape_keep(op, &a->operation, nullptr);
-	op.data_type = higher_type(a->operation.data_type, to_flint_type<T>());
+	op.data_type =
+		constant_result_type(a->operation.data_type, to_flint_type<T>());
 	return addNodeWithConst(op, a, b);
 }
 template <typename T> static inline FGraphNode *sub(const T b, FGraphNode *a) {
@@ -690,7 +765,8 @@ template <typename T> static inline FGraphNode *div(FGraphNode *a, const T b) {
 	op.additional_data = nullptr;
 	op.op_type = FDIV;
 	initShape_keep(op, &a->operation, nullptr);
-	op.data_type = higher_type(a->operation.data_type, to_flint_type<T>());
+	op.data_type =
+		constant_result_type(a->operation.data_type, to_flint_type<T>());
 	return addNodeWithConst(op, a, b);
 }
 template <typename T> static inline FGraphNode *div(const T b, FGraphNode *a) {
@@ -717,7 +793,8 @@ template <typename T> static inline FGraphNode *mul(FGraphNode *a, const T b) {
 	op.additional_data = nullptr;
 	op.op_type = FMUL;
 	initShape_keep(op, &a->operation, nullptr);
-	op.data_type = higher_type(a->operation.data_type, to_flint_type<T>());
+	op.data_type =
+		constant_result_type(a->operation.data_type, to_flint_type<T>());
 	return addNodeWithConst(op, a, b);
 }
 FGraphNode *fmul_cd(FGraphNode *a, const double b) { return mul<double>(a, b); }
@@ -730,7 +807,8 @@ template <typename T> static inline FGraphNode *pow(FGraphNode *a, const T b) {
 	op.additional_data = nullptr;
 	op.op_type = FPOW;
 	initShape_keep(op, &a->operation, nullptr);
-	op.data_type = higher_type(a->operation.data_type, to_flint_type<T>());
+	op.data_type =
+		constant_result_type(a->operation.data_type, to_flint_type<T>());
 	return addNodeWithConst(op, a, b);
 }
 FGraphNode *fpow_cd(FGraphNode *a, const double b) { return pow<double>(a, b); }
@@ -743,7 +821,8 @@ template <typename T> static inline FGraphNode *min(FGraphNode *a, const T b) {
 	op.additional_data = nullptr;
 	op.op_type = FMIN;
 	initShape_keep(op, &a->operation, nullptr);
-	op.data_type = higher_type(a->operation.data_type, to_flint_type<T>());
+	op.data_type =
+		constant_result_type(a->operation.data_type, to_flint_type<T>());
 	return addNodeWithConst(op, a, b);
 }
 FGraphNode *fmin_ci(FGraphNode *a, const int b) { return min(a, b); }
@@ -756,7 +835,8 @@ template <typename T> static inline FGraphNode *max(FGraphNode *a, const T b) {
 	op.additional_data = nullptr;
 	op.op_type = FMAX;
 	initShape_keep(op, &a->operation, nullptr);
-	op.data_type = higher_type(a->operation.data_type, to_flint_type<T>());
+	op.data_type =
+		constant_result_type(a->operation.data_type, to_flint_type<T>());
 	return addNodeWithConst(op, a, b);
 }
 FGraphNode *fmax_ci(FGraphNode *a, const int b) { return max(a, b); }
@@ -897,8 +977,68 @@ FGraphNode *fflatten_dimension(FGraphNode *a, const int dimension) {
 	op.data_type = prev_op.data_type;
 	return addNode(op, {a});
 }
-
-FGraphNode *fmatmul(FGraphNode *x, FGraphNode *y) {
+// type of a matrix multiplication or convolution, the products of two 8bit
+// tensors are accumulated in `F_INT32`
+static inline FType accumulation_type(FType a, FType b) {
+	const FType type = higher_type(a, b);
+	return type == F_INT8 || type == F_UINT8 ? F_INT32 : type;
+}
+// product of the sparse matrix `x` (see `fsparse`) with the matrix `y`, only
+// the stored values, their columns and the row offsets are parameters
+static FGraphNode *sparse_matmul(FGraphNode *x, FGraphNode *y) {
+	if (x->operation.shape[1] != y->operation.shape[0]) {
+		last_error = INCOMPATIBLE_SHAPES;
+		flogging(F_ERROR,
+				 "Incompatible shapes for sparse matrix multiplication: " +
+					 vector_string(std::vector<size_t>(x->operation.shape,
+													   x->operation.shape + 2)) +
+					 " and " +
+					 vector_string(std::vector<size_t>(y->operation.shape,
+													   y->operation.shape + 2)));
+		return nullptr; // for c compatibility
+	}
+	FGraphNode *values = x->predecessors[0];
+	// the kernels index the rows of y, a constant only stores one element
+	if (y->operation.op_type == FGEN_CONSTANT) {
+		const size_t element = type_size(y->operation.data_type);
+		const size_t total = y->operation.shape[0] * y->operation.shape[1];
+		std::vector<char> data(total * element);
+		for (size_t i = 0; i < total; i++)
+			memcpy(data.data() + i * element, y->operation.additional_data,
+				   element);
+		y = fCreateGraph(data.data(), total, y->operation.data_type,
+						 y->operation.shape, 2);
+	}
+	// both are computed in the type of the result
+	const FType type =
+		accumulation_type(values->operation.data_type, y->operation.data_type);
+	if (values->operation.data_type != type)
+		values = fconvert(values, type);
+	if (y->operation.data_type != type)
+		y = fconvert(y, type);
+	// both are accessed directly
+	if (!values->result_data && values->operation.op_type != FSTORE)
+		values = fExecuteGraph(values);
+	if (!y->result_data && y->operation.op_type != FSTORE)
+		y = fExecuteGraph(y);
+	FOperation op;
+	op.broadcasting_mode = 0;
+	op.additional_data = nullptr;
+	op.op_type = FSPARSE_MATMUL;
+	op.data_type = type;
+	op.dimensions = 2;
+	op.shape = safe_mal<size_t>(2);
+	if (!op.shape)
+		return nullptr;
+	op.shape[0] = x->operation.shape[0];
+	op.shape[1] = y->operation.shape[1];
+	return addNode(op, {values, y, x->predecessors[1], x->predecessors[2]});
+}
+FGraphNode *fmatmul_transposed(FGraphNode *x, FGraphNode *y, int transpose_a,
+							   int transpose_b) {
+	if (x->operation.op_type == FSPARSE && !transpose_a && !transpose_b &&
+		y->operation.dimensions == 2)
+		return sparse_matmul(x, y);
 	// TODO: lazy matmul
 	if (!x->result_data && x->operation.op_type != FSTORE) {
 		x = fExecuteGraph(x);
@@ -915,10 +1055,10 @@ FGraphNode *fmatmul(FGraphNode *x, FGraphNode *y) {
 						  "must be at least 2!");
 		return nullptr;
 	}
-	size_t l = ao.shape[ao.dimensions - 2];
-	size_t m = ao.shape[ao.dimensions - 1];
-	size_t mb = bo.shape[bo.dimensions - 2];
-	size_t n = bo.shape[bo.dimensions - 1];
+	size_t l = ao.shape[ao.dimensions - (transpose_a ? 1 : 2)];
+	size_t m = ao.shape[ao.dimensions - (transpose_a ? 2 : 1)];
+	size_t mb = bo.shape[bo.dimensions - (transpose_b ? 1 : 2)];
+	size_t n = bo.shape[bo.dimensions - (transpose_b ? 2 : 1)];
 	if (m != mb) {
 		last_error = INCOMPATIBLE_SHAPES;
 		flogging(F_ERROR, "Incompatible Shapes for matrix multiplications: " +
@@ -940,9 +1080,16 @@ FGraphNode *fmatmul(FGraphNode *x, FGraphNode *y) {
 			   sizeof(size_t) * (res.dimensions - 2));
 	res.shape[res.dimensions - 2] = l;
 	res.shape[res.dimensions - 1] = n;
-	res.data_type = ao.data_type > bo.data_type ? ao.data_type : bo.data_type;
+	res.data_type = accumulation_type(ao.data_type, bo.data_type);
 	res.op_type = FMATMUL;
 	res.additional_data = nullptr;
+	if (transpose_a || transpose_b) {
+		res.additional_data = safe_mal<int>(2);
+		if (!res.additional_data)
+			return nullptr;
+		((int *)res.additional_data)[0] = transpose_a != 0;
+		((int *)res.additional_data)[1] = transpose_b != 0;
+	}
 
 	FGraphNode *node = new FGraphNode();
 	configureGradientInformation(node, {x, y});
@@ -959,6 +1106,9 @@ FGraphNode *fmatmul(FGraphNode *x, FGraphNode *y) {
 	node->reference_counter = 0;
 	return eager_execution ? execute_eagerly(node) : node;
 }
+FGraphNode *fmatmul(FGraphNode *x, FGraphNode *y) {
+	return fmatmul_transposed(x, y, 0, 0);
+}
 FGraphNode *freshape(FGraphNode *a, const size_t *newshape,
 					 const int dimensions) {
 	size_t total_size_node = 1;
@@ -1018,11 +1168,18 @@ FGraphNode *fconvert(FGraphNode *a, FType newtype) {
 	;
 }
 
-static inline FGraphNode *reduce_operation(FGraphNode *a, const int dimension,
+// reduces the dimensions `[first, last]` of `a`, they are kept with size 1 if
+// `keepdims` is set
+static inline FGraphNode *reduce_operation(FGraphNode *a, const int first,
+										   const int last, const bool keepdims,
 										   FOperationType type) {
+	// sums and products of 8bit tensors would wrap around
+	if ((type == FREDUCE_SUM || type == FREDUCE_MUL) &&
+		(a->operation.data_type == F_INT8 || a->operation.data_type == F_UINT8))
+		a = fconvert(a, F_INT32);
 	size_t total = 1;
 	for (int i = 0; i < a->operation.dimensions; i++)
-		if (i != dimension)
+		if (i < first || i > last)
 			total *= a->operation.shape[i];
 	if (total <= 128 ||
 		a->reference_counter > 1) { // small reduction size will be slow on gpu
@@ -1071,14 +1228,20 @@ static inline FGraphNode *reduce_operation(FGraphNode *a, const int dimension,
 	op.broadcasting_mode = 0;
 	op.data_type = other.data_type;
 	op.op_type = type;
-	if (other.dimensions > 1) {
-		op.dimensions = other.dimensions - 1;
+	const int reduced = last - first + 1;
+	if (keepdims || other.dimensions > reduced) {
+		op.dimensions = keepdims ? other.dimensions : other.dimensions - reduced;
 		op.shape = safe_mal<size_t>(op.dimensions);
 		if (!op.shape)
 			return nullptr;
-		memcpy(op.shape, other.shape, sizeof(size_t) * dimension);
-		memcpy(op.shape + dimension, other.shape + (dimension + 1),
-			   sizeof(size_t) * (other.dimensions - dimension - 1));
+		memcpy(op.shape, other.shape, sizeof(size_t) * first);
+		if (keepdims) {
+			std::fill(op.shape + first, op.shape + last + 1, 1);
+			memcpy(op.shape + last + 1, other.shape + last + 1,
+				   sizeof(size_t) * (other.dimensions - last - 1));
+		} else
+			memcpy(op.shape + first, other.shape + last + 1,
+				   sizeof(size_t) * (other.dimensions - last - 1));
 	} else {
 		op.dimensions = 1;
 		op.shape = safe_mal<size_t>(1);
@@ -1086,26 +1249,92 @@ static inline FGraphNode *reduce_operation(FGraphNode *a, const int dimension,
 			return nullptr;
 		op.shape[0] = 1;
 	}
-	op.additional_data = safe_mal<int>(1);
+	op.additional_data = safe_mal<int>(2);
 	if (!op.additional_data)
 		return nullptr;
-	((int *)op.additional_data)[0] = dimension;
+	((int *)op.additional_data)[0] = first;
+	((int *)op.additional_data)[1] = last;
 	foo->operation = op;
 	return eager_execution && total >= 128 ? execute_eagerly(foo) : foo;
 }
 // freduce_sum([[1,2,3], [4,5,6]], 0) = [5,7,9],
 // freduce_sum([[1,2,3], [4,5,6]], 1) = [6,15]
 FGraphNode *freduce_sum(FGraphNode *a, const int dimension) {
-	return reduce_operation(a, dimension, FREDUCE_SUM);
+	return reduce_operation(a, dimension, dimension, false, FREDUCE_SUM);
 }
 FGraphNode *freduce_mul(FGraphNode *a, const int dimension) {
-	return reduce_operation(a, dimension, FREDUCE_MUL);
+	return reduce_operation(a, dimension, dimension, false, FREDUCE_MUL);
 }
 FGraphNode *freduce_min(FGraphNode *a, const int dimension) {
-	return reduce_operation(a, dimension, FREDUCE_MIN);
+	return reduce_operation(a, dimension, dimension, false, FREDUCE_MIN);
 }
 FGraphNode *freduce_max(FGraphNode *a, const int dimension) {
-	return reduce_operation(a, dimension, FREDUCE_MAX);
+	return reduce_operation(a, dimension, dimension, false, FREDUCE_MAX);
+}
+// each run of consecutive axes is reduced by one operation, beginning with the
+// last one so the dimensions of the earlier runs stay the same
+static FGraphNode *reduce_axes(FGraphNode *a, const int *axes,
+							   const int num_axes, const bool keepdims,
+							   FOperationType type) {
+	const int dims = a->operation.dimensions;
+	std::vector<bool> reduced(dims, false);
+	for (int i = 0; i < num_axes; i++) {
+		const int ax = axes[i] < 0 ? dims + axes[i] : axes[i];
+		if (ax < 0 || ax >= dims || reduced[ax]) {
+			last_error = ILLEGAL_DIMENSION;
+			flogging(F_ERROR, "Invalid or repeated axis " +
+								  std::to_string(axes[i]) +
+								  " for a reduction of a Tensor with " +
+								  std::to_string(dims) + " dimensions!");
+			return nullptr;
+		}
+		reduced[ax] = true;
+	}
+	if (num_axes == 0)
+		return a;
+	for (int last = dims - 1; last >= 0; last--) {
+		if (!reduced[last])
+			continue;
+		int first = last;
+		while (first > 0 && reduced[first - 1])
+			first--;
+		a = reduce_operation(a, first, last, keepdims, type);
+		if (!a)
+			return nullptr;
+		last = first;
+	}
+	return a;
+}
+FGraphNode *freduce_sum_axes(FGraphNode *a, const int *axes,
+							 const int num_axes, const int keepdims) {
+	return reduce_axes(a, axes, num_axes, keepdims, FREDUCE_SUM);
+}
+FGraphNode *freduce_mul_axes(FGraphNode *a, const int *axes,
+							 const int num_axes, const int keepdims) {
+	return reduce_axes(a, axes, num_axes, keepdims, FREDUCE_MUL);
+}
+FGraphNode *freduce_min_axes(FGraphNode *a, const int *axes,
+							 const int num_axes, const int keepdims) {
+	return reduce_axes(a, axes, num_axes, keepdims, FREDUCE_MIN);
+}
+FGraphNode *freduce_max_axes(FGraphNode *a, const int *axes,
+							 const int num_axes, const int keepdims) {
+	return reduce_axes(a, axes, num_axes, keepdims, FREDUCE_MAX);
+}
+FGraphNode *freduce_mean_axes(FGraphNode *a, const int *axes,
+							  const int num_axes, const int keepdims) {
+	const FOperation op = a->operation;
+	FGraphNode *sum = freduce_sum_axes(a, axes, num_axes, keepdims);
+	if (!sum)
+		return nullptr;
+	size_t count = 1;
+	for (int i = 0; i < num_axes; i++)
+		count *= op.shape[axes[i] < 0 ? op.dimensions + axes[i] : axes[i]];
+	// integer means would be truncated
+	return op.data_type == F_INT32 || op.data_type == F_INT64 ||
+				   op.data_type == F_INT8 || op.data_type == F_UINT8
+			   ? fdiv_cd(sum, (double)count)
+			   : fdiv_cl(sum, (long)count);
 }
 
 FGraphNode *fslice_step(FGraphNode *a, const long *start, const long *end,
@@ -1451,12 +1680,15 @@ FGraphNode *fconvolve(FGraphNode *a, FGraphNode *kernel,
 		op, ao, multiple_filters ? bo.shape + 1 : bo.shape, steps);
 	if (multiple_filters)
 		op.shape[ao.dimensions - 1] = bo.shape[0];
-	op.data_type = higher_type(ao.data_type, bo.data_type);
+	op.data_type = accumulation_type(ao.data_type, bo.data_type);
 	op.op_type = FCONVOLVE;
-	op.additional_data = safe_mal<unsigned int>(op.dimensions);
+	// one step per dimension of `a` except the last, the eager gpu backend
+	// uploads one per dimension of the result
+	op.additional_data = safe_mal<unsigned int>(ao.dimensions);
 	if (!op.additional_data)
 		return nullptr;
-	memcpy(op.additional_data, steps, op.dimensions * sizeof(unsigned int));
+	memcpy(op.additional_data, steps, (ao.dimensions - 1) * sizeof(unsigned int));
+	((unsigned int *)op.additional_data)[ao.dimensions - 1] = 1;
 	return addNode(op, {a, kernel});
 }
 FGraphNode *frandom(const size_t *shape, const int dimensions) {
@@ -1508,6 +1740,320 @@ FGraphNode *fdropout(FGraphNode *g, const double p) {
 	((double *)op.additional_data)[1] = p;
 	return addNode(op, {g});
 }
+// (de-)quantization of `a` with the parameters broadcasted to its shape
+static FGraphNode *quantization(FGraphNode *a, FGraphNode *scale,
+								FGraphNode *zero_point, FOperationType type,
+								FType data_type) {
+	for (const FGraphNode *par : {scale, zero_point}) {
+		if (par->operation.dimensions > a->operation.dimensions) {
+			last_error = ILLEGAL_DIMENSIONALITY;
+			flogging(F_ERROR, "The quantization parameters may not have more "
+							  "dimensions than the quantized tensor!");
+			return nullptr; // for c compatibility
+		}
+		// only checks the shapes
+		FOperation check;
+		check.op_type = type;
+		initShape_keep(check, &a->operation, &par->operation);
+		free(check.shape);
+	}
+	if (scale->operation.data_type != F_FLOAT32)
+		scale = fconvert(scale, F_FLOAT32);
+	if (zero_point->operation.data_type != F_INT32)
+		zero_point = fconvert(zero_point, F_INT32);
+	FOperation op;
+	op.broadcasting_mode = 0;
+	op.additional_data = nullptr;
+	op.op_type = type;
+	op.dimensions = a->operation.dimensions;
+	op.shape = safe_mal<size_t>(op.dimensions);
+	if (!op.shape)
+		return nullptr;
+	memcpy(op.shape, a->operation.shape, op.dimensions * sizeof(size_t));
+	op.data_type = data_type;
+	return addNode(op, {a, scale, zero_point});
+}
+FGraphNode *fsparse(FGraphNode *values, const size_t *rows,
+					const size_t *columns, const size_t *shape) {
+	if (values->operation.dimensions != 1) {
+		last_error = ILLEGAL_DIMENSIONALITY;
+		flogging(F_ERROR, "The values of a sparse matrix have to be a one "
+						  "dimensional tensor!");
+		return nullptr; // for c compatibility
+	}
+	const size_t num_values = values->operation.shape[0];
+	// sort the values by their row (stable), i.e. count the values per row
+	std::vector<long> offsets(shape[0] + 1, 0);
+	for (size_t i = 0; i < num_values; i++) {
+		if (rows[i] >= shape[0] || columns[i] >= shape[1]) {
+			last_error = INCOMPATIBLE_SHAPES;
+			flogging(F_ERROR, "Position of a sparse value (" +
+								  std::to_string(rows[i]) + ", " +
+								  std::to_string(columns[i]) +
+								  ") is outside of its shape!");
+			return nullptr; // for c compatibility
+		}
+		offsets[rows[i] + 1]++;
+	}
+	for (size_t i = 0; i < shape[0]; i++)
+		offsets[i + 1] += offsets[i];
+	std::vector<long> next(offsets.begin(), offsets.end() - 1);
+	std::vector<long> order(num_values), sorted_columns(num_values);
+	bool sorted = true;
+	for (size_t i = 0; i < num_values; i++) {
+		const long position = next[rows[i]]++;
+		order[position] = i;
+		sorted_columns[position] = columns[i];
+		sorted &= position == (long)i;
+	}
+	if (!sorted) {
+		const size_t num = num_values;
+		values =
+			findex(values, fCreateGraph(order.data(), num, F_INT64, &num, 1));
+	}
+	if (!values->result_data && values->operation.op_type != FSTORE)
+		values = fExecuteGraph(values);
+	const size_t num_offsets = offsets.size();
+	FGraphNode *row_offsets = fCreateGraph(offsets.data(), num_offsets,
+										   F_INT64, &num_offsets, 1);
+	FGraphNode *column_indices = fCreateGraph(
+		sorted_columns.data(), num_values, F_INT64, &num_values, 1);
+	FOperation op;
+	op.broadcasting_mode = 0;
+	op.additional_data = nullptr;
+	op.op_type = FSPARSE;
+	op.data_type = values->operation.data_type;
+	op.dimensions = 2;
+	op.shape = safe_mal<size_t>(2);
+	if (!op.shape)
+		return nullptr;
+	memcpy(op.shape, shape, 2 * sizeof(size_t));
+	return addNode(op, {values, row_offsets, column_indices});
+}
+// checks the axis of a softmax and converts integer tensors to floating point,
+// the result is accessed directly by the operations
+static FGraphNode *softmax_operand(FGraphNode *a, const int ax) {
+	if (ax < 0 || ax >= a->operation.dimensions) {
+		last_error = ILLEGAL_DIMENSION;
+		flogging(F_ERROR, "Invalid axis " + std::to_string(ax) +
+							  " for a softmax of a Tensor with " +
+							  std::to_string(a->operation.dimensions) +
+							  " dimensions!");
+		return nullptr; // for c compatibility
+	}
+	const FType type = a->operation.data_type;
+	if (type == F_INT32 || type == F_INT64 || type == F_INT8 ||
+		type == F_UINT8)
+		a = fconvert(a, F_FLOAT64);
+	if (!a->result_data && a->operation.op_type != FSTORE)
+		a = fExecuteGraph(a);
+	return a;
+}
+static FGraphNode *softmax(FGraphNode *a, const int ax,
+						   FOperationType op_type) {
+	a = softmax_operand(a, ax);
+	if (!a)
+		return nullptr;
+	FOperation op;
+	op.broadcasting_mode = 0;
+	op.op_type = op_type;
+	op.data_type = a->operation.data_type;
+	op.dimensions = a->operation.dimensions;
+	op.shape = safe_mal<size_t>(op.dimensions);
+	if (!op.shape)
+		return nullptr;
+	memcpy(op.shape, a->operation.shape, op.dimensions * sizeof(size_t));
+	op.additional_data = safe_mal<int>(1);
+	if (!op.additional_data)
+		return nullptr;
+	((int *)op.additional_data)[0] = ax;
+	return addNode(op, {a});
+}
+FGraphNode *fsoftmax(FGraphNode *a, const int ax) {
+	return softmax(a, ax, FSOFTMAX);
+}
+FGraphNode *flog_softmax(FGraphNode *a, const int ax) {
+	return softmax(a, ax, FLOG_SOFTMAX);
+}
+FGraphNode *fsoftmax_cross_entropy(FGraphNode *a, FGraphNode *labels,
+								   const int ax) {
+	a = softmax_operand(a, ax);
+	if (!a)
+		return nullptr;
+	const FOperation other = a->operation;
+	FOperation op;
+	op.broadcasting_mode = 0;
+	op.op_type = FSOFTMAX_CROSS_ENTROPY;
+	op.data_type = other.data_type;
+	// like a reduction along ax
+	op.dimensions = other.dimensions > 1 ? other.dimensions - 1 : 1;
+	op.shape = safe_mal<size_t>(op.dimensions);
+	if (!op.shape)
+		return nullptr;
+	if (other.dimensions > 1) {
+		memcpy(op.shape, other.shape, ax * sizeof(size_t));
+		memcpy(op.shape + ax, other.shape + ax + 1,
+			   (other.dimensions - ax - 1) * sizeof(size_t));
+	} else
+		op.shape[0] = 1;
+	const FOperation lop = labels->operation;
+	const bool distribution =
+		lop.dimensions == other.dimensions &&
+		std::equal(lop.shape, lop.shape + lop.dimensions, other.shape);
+	const bool indices =
+		!distribution &&
+		(lop.data_type == F_INT32 || lop.data_type == F_INT64 ||
+		 lop.data_type == F_INT8 || lop.data_type == F_UINT8) &&
+		lop.dimensions == op.dimensions &&
+		std::equal(lop.shape, lop.shape + lop.dimensions, op.shape);
+	if (!distribution && !indices) {
+		free(op.shape);
+		last_error = INCOMPATIBLE_SHAPES;
+		flogging(F_ERROR,
+				 "The labels of a softmax cross entropy have to be a "
+				 "distribution with the shape of the input " +
+					 vector_string(std::vector<size_t>(
+						 other.shape, other.shape + other.dimensions)) +
+					 " or integer class indices with the shape of the result, "
+					 "not " +
+					 vector_string(std::vector<size_t>(
+						 lop.shape, lop.shape + lop.dimensions)) +
+					 "!");
+		return nullptr; // for c compatibility
+	}
+	// the kernels distinguish class indices from distributions by their type
+	if (distribution && lop.data_type != op.data_type)
+		labels = fconvert(labels, op.data_type);
+	else if (indices && (lop.data_type == F_INT8 || lop.data_type == F_UINT8))
+		labels = fconvert(labels, F_INT32);
+	if (!labels->result_data && labels->operation.op_type != FSTORE)
+		labels = fExecuteGraph(labels);
+	op.additional_data = safe_mal<int>(1);
+	if (!op.additional_data)
+		return nullptr;
+	((int *)op.additional_data)[0] = ax;
+	return addNode(op, {a, labels});
+}
+// the axis and epsilon of the batch normalization operations
+static void *batch_norm_data(const int ax, const double epsilon) {
+	double *data = safe_mal<double>(2);
+	if (!data)
+		return nullptr;
+	data[0] = ax;
+	data[1] = epsilon;
+	return data;
+}
+// checks the channel axis of a batch normalization and prepares the operand
+// like for a softmax
+static FGraphNode *batch_norm_operand(FGraphNode *a, const int ax) {
+	if (ax < 0 || ax >= a->operation.dimensions) {
+		last_error = ILLEGAL_DIMENSION;
+		flogging(F_ERROR, "Invalid channel axis " + std::to_string(ax) +
+							  " for a Tensor with " +
+							  std::to_string(a->operation.dimensions) +
+							  " dimensions!");
+		return nullptr; // for c compatibility
+	}
+	return softmax_operand(a, ax);
+}
+FGraphNode *fbatch_moments(FGraphNode *a, const int ax) {
+	a = batch_norm_operand(a, ax);
+	if (!a)
+		return nullptr;
+	FOperation op;
+	op.broadcasting_mode = 0;
+	op.op_type = FBATCH_MOMENTS;
+	op.data_type = a->operation.data_type;
+	op.dimensions = 2;
+	op.shape = safe_mal<size_t>(2);
+	if (!op.shape)
+		return nullptr;
+	op.shape[0] = 2;
+	op.shape[1] = a->operation.shape[ax];
+	op.additional_data = batch_norm_data(ax, 0);
+	if (!op.additional_data)
+		return nullptr;
+	FGraphNode *moments = addNode(op, {a});
+	// only derived through fbatch_norm
+	if (moments && moments->gradient_data) {
+		delete (std::unordered_set<const FGraphNode *> *)moments->gradient_data;
+		moments->gradient_data = nullptr;
+	}
+	return moments;
+}
+FGraphNode *fbatch_norm(FGraphNode *a, FGraphNode *moments, FGraphNode *gamma,
+						FGraphNode *beta, const int ax, const double epsilon) {
+	a = batch_norm_operand(a, ax);
+	if (!a)
+		return nullptr;
+	const size_t channels = a->operation.shape[ax];
+	const FOperation mop = moments->operation;
+	if (mop.dimensions != 2 || mop.shape[0] != 2 || mop.shape[1] != channels) {
+		last_error = INCOMPATIBLE_SHAPES;
+		flogging(F_ERROR, "The statistics of a batch normalization have to "
+						  "have the shape [2, " +
+							  std::to_string(channels) + "], not " +
+							  vector_string(std::vector<size_t>(
+								  mop.shape, mop.shape + mop.dimensions)) +
+							  "!");
+		return nullptr; // for c compatibility
+	}
+	for (FGraphNode *parameter : {gamma, beta}) {
+		const FOperation pop = parameter->operation;
+		size_t total = 1;
+		for (int d = 0; d < pop.dimensions; d++)
+			total *= pop.shape[d];
+		if (total != channels) {
+			last_error = INCOMPATIBLE_SHAPES;
+			flogging(F_ERROR, "The scale and shift of a batch normalization "
+							  "need one entry per channel (" +
+								  std::to_string(channels) + "), not " +
+								  std::to_string(total) + "!");
+			return nullptr; // for c compatibility
+		}
+	}
+	// the parameters are accessed directly by the kernels
+	FGraphNode *pred[] = {moments, gamma, beta};
+	for (FGraphNode *&p : pred) {
+		if (p->operation.data_type != a->operation.data_type)
+			p = fconvert(p, a->operation.data_type);
+		if (!p->result_data && p->operation.op_type != FSTORE)
+			p = fExecuteGraph(p);
+	}
+	FOperation op;
+	op.broadcasting_mode = 0;
+	op.op_type = FBATCH_NORM;
+	op.data_type = a->operation.data_type;
+	op.dimensions = a->operation.dimensions;
+	op.shape = safe_mal<size_t>(op.dimensions);
+	if (!op.shape)
+		return nullptr;
+	memcpy(op.shape, a->operation.shape, op.dimensions * sizeof(size_t));
+	op.additional_data = batch_norm_data(ax, epsilon);
+	if (!op.additional_data)
+		return nullptr;
+	return addNode(op, {a, pred[0], pred[1], pred[2]});
+}
+FGraphNode *fquantize(FGraphNode *a, FGraphNode *scale, FGraphNode *zero_point,
+					  FType type) {
+	if (type != F_INT8 && type != F_UINT8) {
+		last_error = WRONG_TYPE;
+		flogging(F_ERROR, "Tensors can only be quantized to F_INT8 or F_UINT8!");
+		return nullptr; // for c compatibility
+	}
+	return quantization(a, scale, zero_point, FQUANTIZE, type);
+}
+FGraphNode *fdequantize(FGraphNode *a, FGraphNode *scale,
+						FGraphNode *zero_point) {
+	const FType type = a->operation.data_type;
+	if (type != F_INT8 && type != F_UINT8 && type != F_INT32 &&
+		type != F_INT64) {
+		last_error = WRONG_TYPE;
+		flogging(F_ERROR, "Only integer tensors can be dequantized!");
+		return nullptr; // for c compatibility
+	}
+	return quantization(a, scale, zero_point, FDEQUANTIZE, F_FLOAT32);
+}
 FGraphNode *findex(FGraphNode *a, FGraphNode *indices) {
 	if (indices->operation.dimensions > a->operation.dimensions) {
 		last_error = ILLEGAL_DIMENSIONALITY;
@@ -0,0 +1,180 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "memory_pool.hpp"
+#include "../flint.h"
+#include <bit>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// alignment and granularity of the buffers
+#define POOL_ALIGNMENT 64
+// classes 0 to 3 hold 1 to 4 units of `POOL_ALIGNMENT` bytes, afterwards 4
+// classes per power of two, buffers above 2^40 units are not pooled
+#define POOL_NUM_CLASSES (4 + 4 * 38)
+
+struct BufferPool {
+		std::mutex lock;
+		// released buffers per size class
+		std::vector<void *> free_buffers[POOL_NUM_CLASSES];
+		// size class of every buffer allocated by the pool
+		std::unordered_map<void *, unsigned int> classes;
+		// number of references of shared buffers (see `pool_share`), buffers
+		// with a single reference have no entry
+		std::unordered_map<void *, size_t> references;
+		// buffer and number of references of every shared pointer that points
+		// behind the start of its buffer
+		std::unordered_map<void *, std::pair<void *, size_t>> interior;
+		size_t limit = 1ul << 30;
+		FMemoryPoolStatistics stats = {0, 0, 0, 0};
+};
+// never destructed, since tensors may still be freed during the destruction of
+// static objects
+static BufferPool *const pool = new BufferPool();
+
+/** Size class of a request of `units` * `POOL_ALIGNMENT` bytes */
+static inline unsigned int sizeClass(size_t units) {
+	if (units <= 4)
+		return units == 0 ? 0 : units - 1;
+	// units - 1 in [2^k, 2^(k + 1)), the range is divided in 4 steps
+	const unsigned int k = std::bit_width(units - 1) - 1;
+	const size_t step = (size_t)1 << (k - 2);
+	const size_t m = (units + step - 1) / step; // in [5, 8]
+	return 4 + 4 * (k - 2) + (m - 5);
+}
+/** Size of the buffers of class `c` in bytes */
+static inline size_t classBytes(unsigned int c) {
+	if (c < 4)
+		return (c + 1) * POOL_ALIGNMENT;
+	const unsigned int k = 2 + (c - 4) / 4;
+	const size_t m = 5 + (c - 4) % 4;
+	return (m << (k - 2)) * POOL_ALIGNMENT;
+}
+/** Frees retained buffers, largest first. Expects the lock to be held. */
+static void trimPool(size_t max_retained_bytes) {
+	for (int c = POOL_NUM_CLASSES - 1;
+		 c >= 0 && pool->stats.retained_bytes > max_retained_bytes; c--) {
+		std::vector<void *> &buffers = pool->free_buffers[c];
+		while (!buffers.empty() &&
+			   pool->stats.retained_bytes > max_retained_bytes) {
+			void *data = buffers.back();
+			buffers.pop_back();
+			pool->classes.erase(data);
+			pool->stats.retained_bytes -= classBytes(c);
+			free(data);
+		}
+	}
+}
+void *pool_allocate(size_t bytes) {
+	const unsigned int c =
+		sizeClass((bytes + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT);
+	if (c >= POOL_NUM_CLASSES)
+		return malloc(bytes);
+	const size_t size = classBytes(c);
+	{
+		std::lock_guard<std::mutex> guard(pool->lock);
+		pool->stats.allocations++;
+		std::vector<void *> &buffers = pool->free_buffers[c];
+		if (!buffers.empty()) {
+			void *data = buffers.back();
+			buffers.pop_back();
+			pool->stats.hits++;
+			pool->stats.retained_bytes -= size;
+			pool->stats.used_bytes += size;
+			return data;
+		}
+	}
+	void *data = std::aligned_alloc(POOL_ALIGNMENT, size);
+	std::lock_guard<std::mutex> guard(pool->lock);
+	if (!data) {
+		// retained buffers of other classes may be in the way
+		trimPool(0);
+		data = std::aligned_alloc(POOL_ALIGNMENT, size);
+		if (!data)
+			return nullptr;
+	}
+	pool->classes.insert({data, c});
+	pool->stats.used_bytes += size;
+	return data;
+}
+/**
+ * Buffer that `data` points into. If `release` is set, one reference of an
+ * interior pointer is dropped. Expects the lock to be held.
+ */
+static void *bufferOf(void *data, bool release) {
+	const auto view = pool->interior.find(data);
+	if (view == pool->interior.end())
+		return data;
+	void *buffer = view->second.first;
+	if (release && --view->second.second == 0)
+		pool->interior.erase(view);
+	return buffer;
+}
+void pool_free(void *data) {
+	if (!data)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(pool->lock);
+		if (!pool->interior.empty() || !pool->references.empty()) {
+			data = bufferOf(data, true);
+			const auto shared = pool->references.find(data);
+			if (shared != pool->references.end()) {
+				// other references remain
+				if (--shared->second == 1)
+					pool->references.erase(shared);
+				return;
+			}
+		}
+		const auto entry = pool->classes.find(data);
+		if (entry != pool->classes.end()) {
+			const unsigned int c = entry->second;
+			const size_t size = classBytes(c);
+			pool->stats.used_bytes -= size;
+			if (pool->stats.retained_bytes + size <= pool->limit) {
+				pool->free_buffers[c].push_back(data);
+				pool->stats.retained_bytes += size;
+				return;
+			}
+			pool->classes.erase(entry);
+		}
+	}
+	free(data);
+}
+void *pool_share(void *data, size_t offset) {
+	std::lock_guard<std::mutex> guard(pool->lock);
+	void *buffer = bufferOf(data, false);
+	pool->references.try_emplace(buffer, 1).first->second++;
+	void *view = (char *)data + offset;
+	if (view != buffer)
+		pool->interior.try_emplace(view, buffer, 0).first->second.second++;
+	return view;
+}
+bool pool_shared(void *data) {
+	std::lock_guard<std::mutex> guard(pool->lock);
+	return pool->references.count(bufferOf(data, false)) != 0;
+}
+FMemoryPoolStatistics fMemoryPoolStatistics() {
+	std::lock_guard<std::mutex> guard(pool->lock);
+	return pool->stats;
+}
+void fTrimMemoryPool(size_t max_retained_bytes) {
+	std::lock_guard<std::mutex> guard(pool->lock);
+	trimPool(max_retained_bytes);
+}
+void fSetMemoryPoolLimit(size_t max_retained_bytes) {
+	std::lock_guard<std::mutex> guard(pool->lock);
+	pool->limit = max_retained_bytes;
+	trimPool(max_retained_bytes);
+}
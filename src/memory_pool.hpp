@@ -0,0 +1,48 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_MEMORY_POOL_HPP
+#define FLINT_MEMORY_POOL_HPP
+#include <cstddef>
+
+/**
+ * Buffer pool for the data of tensors (`FStore::data` and `FResultData::data`).
+ * Requests are rounded up to size classes (4 classes per power of two, so at
+ * most 25% are wasted) and released buffers are kept per class, so repeated
+ * executions of the same graph do not go through the system allocator.
+ *
+ * Returns an uninitialized, 64 byte aligned buffer with at least `bytes`
+ * bytes or nullptr if there is not enough memory. Thread safe.
+ */
+void *pool_allocate(size_t bytes);
+/**
+ * Returns a buffer to the pool. Buffers that were not allocated by
+ * `pool_allocate` are passed to `free`, so every tensor buffer may be
+ * released with this function. Thread safe.
+ */
+void pool_free(void *data);
+/**
+ * Registers another reference to the buffer that `data` points into and
+ * returns `data + offset` (in bytes), so the result of a node may share the
+ * buffer of its parameter instead of copying it. `data` may itself be a
+ * pointer returned by this function or a buffer that was not allocated by
+ * `pool_allocate`. Every reference is released with `pool_free`, the buffer is
+ * only freed (or retained) with the last one. Thread safe.
+ */
+void *pool_share(void *data, size_t offset);
+/**
+ * Checks if the buffer that `data` points into is referenced more than once
+ * (see `pool_share`). Shared buffers must not be overwritten. Thread safe.
+ */
+bool pool_shared(void *data);
+#endif
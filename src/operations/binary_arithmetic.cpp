@@ -13,6 +13,8 @@
  * limitations under the License. */
 #include "binary_arithmetic.hpp"
 #include "../utils.hpp"
+#include "fast_math.hpp"
+#include "gemm.hpp"
 #include "flint.h"
 
 using namespace std;
@@ -27,10 +29,9 @@ void AddImpl::binary_expression(T *__restrict__ result,
 								size_t size, size_t index_man_1,
 								size_t inv_man_1, size_t index_man_2,
 								size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = data1[(i / inv_man_1) % index_man_1] +
-					data2[(i / inv_man_2) % index_man_2];
-	}
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) { return a + b; });
 }
 int AddImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 							   OCLLazyCodegenState &compiler_state) {
@@ -82,10 +83,9 @@ void SubImpl::binary_expression(T *__restrict__ result,
 								size_t size, size_t index_man_1,
 								size_t inv_man_1, size_t index_man_2,
 								size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = data1[(i / inv_man_1) % index_man_1] -
-					data2[(i / inv_man_2) % index_man_2];
-	}
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) { return a - b; });
 }
 int SubImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 							   OCLLazyCodegenState &compiler_state) {
@@ -119,10 +119,9 @@ void MulImpl::binary_expression(T *__restrict__ result,
 								size_t size, size_t index_man_1,
 								size_t inv_man_1, size_t index_man_2,
 								size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = data1[(i / inv_man_1) % index_man_1] *
-					data2[(i / inv_man_2) % index_man_2];
-	}
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) { return a * b; });
 }
 int MulImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 							   OCLLazyCodegenState &compiler_state) {
@@ -160,10 +159,9 @@ void DivImpl::binary_expression(T *__restrict__ result,
 								size_t size, size_t index_man_1,
 								size_t inv_man_1, size_t index_man_2,
 								size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = data1[(i / inv_man_1) % index_man_1] /
-					data2[(i / inv_man_2) % index_man_2];
-	}
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) { return a / b; });
 }
 int DivImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 							   OCLLazyCodegenState &compiler_state) {
@@ -203,10 +201,24 @@ void PowImpl::binary_expression(T *__restrict__ result,
 								size_t size, size_t index_man_1,
 								size_t inv_man_1, size_t index_man_2,
 								size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = pow(data1[(i / inv_man_1) % index_man_1],
-						data2[(i / inv_man_2) % index_man_2]);
-	}
+	if constexpr (is_same_v<T, A> && is_same_v<T, B> &&
+				  is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			// too large to be inlined into all loops of broadcast_binary
+			// otherwise, which would prevent their vectorization
+			broadcast_binary(
+				result, data1, data2, from, size, index_man_1, inv_man_1,
+				index_man_2, inv_man_2,
+				[](T a, T b) __attribute__((always_inline)) {
+					return fast_pow(a, b);
+				});
+			return;
+		}
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) {
+						 return pow((compute_type<A>)a, (compute_type<B>)b);
+					 });
 }
 int PowImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 							   OCLLazyCodegenState &compiler_state) {
@@ -265,20 +277,19 @@ FGraphNode *MatMulImpl::local_gradient(FGraphNode *y, int dx_i,
 									   FGraphNode *prev_adj) {
 	FGraphNode *a = y->predecessors[0];
 	FGraphNode *b = y->predecessors[1];
+	const int *transposed = (const int *)y->operation.additional_data;
+	const bool ta = transposed && transposed[0],
+			   tb = transposed && transposed[1];
+	// y = op(a) * op(b) with op(x) = x or x^T, the transpositions of the
+	// adjoint are expressed by the flags of the products
 	if (0 == dx_i) {
-		vector<int> perm(b->operation.dimensions);
-		for (int i = 0; i < perm.size() - 2; i++)
-			perm[i] = i;
-		perm[perm.size() - 2] = perm.size() - 1;
-		perm[perm.size() - 1] = perm.size() - 2;
-		return fmatmul(prev_adj, ftranspose(b, perm.data()));
+		// d op(a) = prev_adj * op(b)^T
+		return ta ? fmatmul_transposed(b, prev_adj, tb, 1)
+				  : fmatmul_transposed(prev_adj, b, 0, !tb);
 	} else if (1 == dx_i) {
-		vector<int> perm(a->operation.dimensions);
-		for (int i = 0; i < perm.size() - 2; i++)
-			perm[i] = i;
-		perm[perm.size() - 2] = perm.size() - 1;
-		perm[perm.size() - 1] = perm.size() - 2;
-		return fmatmul(ftranspose(a, perm.data()), prev_adj);
+		// d op(b) = op(a)^T * prev_adj
+		return tb ? fmatmul_transposed(prev_adj, a, 1, ta)
+				  : fmatmul_transposed(a, prev_adj, !ta, 0);
 	} else {
 		return nullptr;
 	}
@@ -290,39 +301,39 @@ void MatMulImpl::binary_expression(T *__restrict__ result,
 								   size_t size, size_t index_man_1,
 								   size_t inv_man_1, size_t index_man_2,
 								   size_t inv_man_2, const FGraphNode *curr) {
-	FGraphNode *gnp1 = curr->predecessors[0], *gnp2 = curr->predecessors[1];
-	// total size of each parameter
-	size_t num_entries0 = 1, num_entries1 = 1;
-	if (gnp1->operation.op_type != FGEN_CONSTANT)
-		for (int i = 0; i < gnp1->operation.dimensions; i++)
-			num_entries0 *= gnp1->operation.shape[i];
-	if (gnp2->operation.op_type != FGEN_CONSTANT)
-		for (int i = 0; i < gnp2->operation.dimensions; i++)
-			num_entries1 *= gnp2->operation.shape[i];
-	size_t l = gnp1->operation.shape[gnp1->operation.dimensions - 2];
-	size_t m = gnp1->operation.shape[gnp1->operation.dimensions - 1];
-	size_t n = gnp2->operation.shape[gnp2->operation.dimensions - 1];
-	for (size_t index = from; index < from + size; index++) {
-		result[index] = 0;
-		// indices in node matrix
-		size_t j = (index % (l * n)) / n;
-		size_t k = (index % (l * n)) % n;
-
-		// matrix number of predecessors
-		size_t base_p1 = 0;
-		if (gnp1->operation.dimensions > 2) {
-			// get matrix number of index and then reproject
-			base_p1 = (index / (l * n)) * (l * m);
-		}
-		size_t base_p2 = 0;
-		if (gnp2->operation.dimensions > 2) {
-			// get matrix number of index and then reproject
-			base_p2 = (index / (l * n)) * (m * n);
-		}
-		for (size_t i = 0; i < m; i++) {
-			result[index] +=
-				data1[(base_p1 + j * m + i) % num_entries0] * data2[(base_p2 + i * n + k) % num_entries1];
-		}
+	const FGraphNode *gnp1 = curr->predecessors[0],
+					 *gnp2 = curr->predecessors[1];
+	const FOperation &op1 = gnp1->operation, &op2 = gnp2->operation;
+	const MatMulLayout mm = layout(curr);
+	const size_t l = mm.l, m = mm.m, n = mm.n;
+	// number of matrices of each parameter, parameters with less of them are
+	// broadcasted, constants have only one element
+	const bool constant1 = op1.op_type == FGEN_CONSTANT,
+			   constant2 = op2.op_type == FGEN_CONSTANT;
+	size_t batches1 = 1, batches2 = 1;
+	for (int i = 0; i < op1.dimensions - 2; i++)
+		batches1 *= op1.shape[i];
+	for (int i = 0; i < op2.dimensions - 2; i++)
+		batches2 *= op2.shape[i];
+	GemmWorkspace<T> workspace;
+	// the range is split into runs of whole rows and partial rows at its ends
+	// (which happen when it is split across threads)
+	for (size_t index = from; index < from + size;) {
+		const size_t batch = index / (l * n);
+		const size_t row = (index % (l * n)) / n, col = index % n;
+		size_t rows = 1, cols = std::min(n - col, from + size - index);
+		if (col == 0 && cols == n)
+			rows = std::min(l - row, (from + size - index) / n);
+		const A *a = constant1 ? data1
+							   : data1 + (batch % batches1) * l * m +
+									 row * mm.a_row;
+		const B *b = constant2 ? data2
+							   : data2 + (batch % batches2) * m * n +
+									 col * mm.b_col;
+		gemm(rows, cols, m, a, constant1 ? 0 : mm.a_row,
+			 constant1 ? 0 : mm.a_col, b, constant2 ? 0 : mm.b_row,
+			 constant2 ? 0 : mm.b_col, result + index, n, workspace);
+		index += rows * cols;
 	}
 }
 int MatMulImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
@@ -359,9 +370,8 @@ int MatMulImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 	if (gnp2->operation.op_type != FGEN_CONSTANT)
 		for (int i = 0; i < gnp2->operation.dimensions; i++)
 			num_entries1 *= gnp2->operation.shape[i];
-	size_t l = gnp1->operation.shape[gnp1->operation.dimensions - 2];
-	size_t m = gnp1->operation.shape[gnp1->operation.dimensions - 1];
-	size_t n = gnp2->operation.shape[gnp2->operation.dimensions - 1];
+	const MatMulLayout mm = layout(node);
+	const size_t l = mm.l, m = mm.m, n = mm.n;
 	// we need to compute $name
 	// indices j and k of $name
 	string j = "((index % " + to_string(l * n) + ")/" + to_string(n) + ")";
@@ -383,9 +393,11 @@ int MatMulImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 				 "; i++){\n"
 				 "  " +
 				 name + " += " + par1 + "[(" + base_p1 + " + " + j + " * " +
-				 to_string(m) + " + i) % " + to_string(num_entries0) + "] * " +
-				 par2 + "[(" + base_p2 + " + i * " + to_string(n) + " + " + k +
-				 ") % " + to_string(num_entries1) + "];\n}\n");
+				 to_string(mm.a_row) + " + i * " + to_string(mm.a_col) +
+				 ") % " + to_string(num_entries0) + "] * " + par2 + "[(" +
+				 base_p2 + " + i * " + to_string(mm.b_row) + " + " + k +
+				 " * " + to_string(mm.b_col) + ") % " +
+				 to_string(num_entries1) + "];\n}\n");
 	code.prepend(type + " " + name + " = 0;\n");
 	return OCL_LAZY_DONT_PUSH_PREDS;
 }
@@ -398,7 +410,8 @@ MatMulImpl::generate_ocl_parameters_eager(FType res_type,
 				to_string(i) + ", long num_entries" + to_string(i) +
 				", int dimensions" + to_string(i);
 	}
-	code += ", long l, long m, long n";
+	code += ", long l, long m, long n, long a_row, long a_col, long b_row, "
+			"long b_col";
 	return code;
 }
 std::string MatMulImpl::generate_ocl_eager(FType res_type,
@@ -411,9 +424,9 @@ std::string MatMulImpl::generate_ocl_eager(FType res_type,
 		   "0;\n"
 		   "long base_p1 = dimensions1 > 2 ? (index / (l * n)) * (m * n) : "
 		   "0;\n"
-		   "for(int i = 0; i < m; i++){\n res += P0[(base_p0 + j * m + i) % "
-		   "num_entries0] * "
-		   "P1[(base_p1 + i * n + k) % num_entries1];\n}"
+		   "for(int i = 0; i < m; i++){\n res += P0[(base_p0 + j * a_row + "
+		   "i * a_col) % num_entries0] * "
+		   "P1[(base_p1 + i * b_row + k * b_col) % num_entries1];\n}"
 		   "R[index] = res;\n";
 }
 void MatMulImpl::push_additional_kernel_parameters(FGraphNode *node,
@@ -421,12 +434,12 @@ void MatMulImpl::push_additional_kernel_parameters(FGraphNode *node,
 												   cl_context context,
 												   int &par_index,
 												   std::list<cl_mem> &to_free) {
-	const FGraphNode *gnp1 = node->predecessors[0],
-					 *gnp2 = node->predecessors[1];
-	const long l = gnp1->operation.shape[gnp1->operation.dimensions - 2];
-	const long m = gnp1->operation.shape[gnp1->operation.dimensions - 1];
-	const long n = gnp2->operation.shape[gnp2->operation.dimensions - 1];
-	for (const long *mmd : {&l, &m, &n}) {
+	const MatMulLayout mm = layout(node);
+	// l, m, n and the strides of the parameters
+	const long sizes[7] = {(long)mm.l, (long)mm.m, (long)mm.n,
+						   (long)mm.a_row, (long)mm.a_col,
+						   (long)mm.b_row, (long)mm.b_col};
+	for (const long *mmd = sizes; mmd != sizes + 7; mmd++) {
 		if (clSetKernelArg(kernel, par_index++, sizeof(long), (void *)mmd) !=
 			CL_SUCCESS) {
 			setErrorType(OCL_ERROR);
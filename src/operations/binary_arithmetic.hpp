@@ -37,6 +37,7 @@ struct AddImpl : OperationImplementation {
 						   std::vector<FType> parameter_types) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return reuse_parameter_binary_impl(node);
@@ -62,6 +63,7 @@ struct SubImpl : OperationImplementation {
 						   std::vector<FType> parameter_types) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return AddImpl::reuse_parameter_binary_impl(node);
@@ -87,6 +89,7 @@ struct MulImpl : OperationImplementation {
 						   std::vector<FType> parameter_types) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return AddImpl::reuse_parameter_binary_impl(node);
@@ -112,6 +115,7 @@ struct DivImpl : OperationImplementation {
 						   std::vector<FType> parameter_types) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return AddImpl::reuse_parameter_binary_impl(node);
@@ -138,12 +142,46 @@ struct PowImpl : OperationImplementation {
 		int operation_score(FGraphNode *node) override { return 1; }
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return AddImpl::reuse_parameter_binary_impl(node);
 		}
 };
+/**
+ * Sizes and strides of a matrix multiplication of `l x m` matrices of the first
+ * parameter with `m x n` matrices of the second one. Element `(i, k)` of a
+ * matrix of the first parameter is stored at `i * a_row + k * a_col`, element
+ * `(k, j)` of the second one at `k * b_row + j * b_col` (this way transposed
+ * parameters are multiplied without moving them).
+ */
+struct MatMulLayout {
+		size_t l, m, n;
+		size_t a_row, a_col, b_row, b_col;
+};
 struct MatMulImpl : OperationImplementation {
+		/** Layout of the parameters of the `FMATMUL` node */
+		static MatMulLayout layout(const FGraphNode *node) {
+			const FOperation &a = node->predecessors[0]->operation,
+							 &b = node->predecessors[1]->operation;
+			const int *transposed =
+				(const int *)node->operation.additional_data;
+			const bool ta = transposed && transposed[0],
+					   tb = transposed && transposed[1];
+			const size_t a_rows = a.shape[a.dimensions - 2],
+						 a_cols = a.shape[a.dimensions - 1],
+						 b_rows = b.shape[b.dimensions - 2],
+						 b_cols = b.shape[b.dimensions - 1];
+			MatMulLayout layout;
+			layout.l = ta ? a_cols : a_rows;
+			layout.m = ta ? a_rows : a_cols;
+			layout.n = tb ? b_rows : b_cols;
+			layout.a_row = ta ? 1 : a_cols;
+			layout.a_col = ta ? a_cols : 1;
+			layout.b_row = tb ? 1 : b_cols;
+			layout.b_col = tb ? b_cols : 1;
+			return layout;
+		}
 		template <typename T, typename A, typename B>
 		static void binary_expression(T *__restrict__ result,
 									  const A *__restrict__ data1,
@@ -175,10 +213,12 @@ struct MatMulImpl : OperationImplementation {
 			push_per_parameter_dimension(pred->operation, kernel, par_index);
 		}
 		int operation_score(FGraphNode *node) override {
-			const FGraphNode *a = node->predecessors[0];
-			return 5 * a->operation.shape[a->operation.dimensions - 1];
+			return 5 * layout(node).m;
 		}
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		void free_additional_data(FGraphNode *gn) override {
+			free(gn->operation.additional_data);
+		}
 };
 #endif
@@ -41,9 +41,11 @@ void MinImpl::binary_expression(T *__restrict__ result,
 								size_t size, size_t index_man_1,
 								size_t inv_man_1, size_t index_man_2,
 								size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++)
-		result[i] = MIN_VAL(data1[(i / inv_man_1) % index_man_1],
-							data2[(i / inv_man_2) % index_man_2]);
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) {
+						 return MIN_VAL((compute_type<A>)a, (compute_type<B>)b);
+					 });
 }
 void MinImpl::execute_cpu(const FGraphNode *node,
 						  std::vector<CPUResultData> predecessor_data,
@@ -86,9 +88,11 @@ void MaxImpl::binary_expression(T *__restrict__ result,
 								size_t size, size_t index_man_1,
 								size_t inv_man_1, size_t index_man_2,
 								size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++)
-		result[i] = MAX_VAL(data1[(i / inv_man_1) % index_man_1],
-							data2[(i / inv_man_2) % index_man_2]);
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) {
+						 return MAX_VAL((compute_type<A>)a, (compute_type<B>)b);
+					 });
 }
 int MaxImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 							   OCLLazyCodegenState &compiler_state) {
@@ -125,11 +129,9 @@ void LessImpl::binary_expression(int *__restrict__ result,
 								 size_t size, size_t index_man_1,
 								 size_t inv_man_1, size_t index_man_2,
 								 size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++)
-		result[i] = data1[(i / inv_man_1) % index_man_1] <
-							data2[(i / inv_man_2) % index_man_2]
-						? 1
-						: 0;
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) { return a < b ? 1 : 0; });
 }
 int LessImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 								OCLLazyCodegenState &compiler_state) {
@@ -166,11 +168,9 @@ void GreaterImpl::binary_expression(int *__restrict__ result,
 									size_t size, size_t index_man_1,
 									size_t inv_man_1, size_t index_man_2,
 									size_t inv_man_2, const FGraphNode *curr) {
-	for (size_t i = from; i < from + size; i++)
-		result[i] = data1[(i / inv_man_1) % index_man_1] >
-							data2[(i / inv_man_2) % index_man_2]
-						? 1
-						: 0;
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2,
+					 [](A a, B b) { return a > b ? 1 : 0; });
 }
 int GreaterImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 								   OCLLazyCodegenState &compiler_state) {
@@ -210,11 +210,10 @@ void EqualImpl::binary_expression(int *__restrict__ result,
 								  size_t inv_man_2, const FGraphNode *curr) {
 	const A e1 = numeric_limits<A>::epsilon();
 	const B e2 = numeric_limits<B>::epsilon();
-	for (size_t i = from; i < from + size; i++) {
-		const A d1 = data1[(i / inv_man_1) % index_man_1];
-		const B d2 = data2[(i / inv_man_2) % index_man_2];
-		result[i] = d1 + e1 >= d2 && d2 + e2 >= d1 ? 1 : 0;
-	}
+	broadcast_binary(result, data1, data2, from, size, index_man_1,
+					 inv_man_1, index_man_2, inv_man_2, [=](A d1, B d2) {
+						 return d1 + e1 >= d2 && d2 + e2 >= d1 ? 1 : 0;
+					 });
 }
 int EqualImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 								 OCLLazyCodegenState &compiler_state) {
@@ -264,7 +263,7 @@ void DropoutImpl::unary_expression(T *__restrict__ result,
 	for (size_t i = from; i < from + size; i++) {
 		result[i] = ((g1() % 100000000) / 100000000.0) > prob
 						? data1[i % num_entries0]
-						: 0;
+						: (T)0;
 	}
 }
 void DropoutImpl::execute_cpu(const FGraphNode *node,
@@ -36,6 +36,7 @@ struct MinImpl : OperationImplementation {
 						   std::vector<FType> parameter_types) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return AddImpl::reuse_parameter_binary_impl(node);
@@ -60,6 +61,7 @@ struct MaxImpl : OperationImplementation {
 						   std::vector<FType> parameter_types) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return AddImpl::reuse_parameter_binary_impl(node);
@@ -92,6 +94,7 @@ struct LessImpl : OperationImplementation {
 				comb.insert(comb.begin(), F_INT32);
 			return all_comb;
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {type_size(node->predecessors[0]->operation.data_type) ==
@@ -127,6 +130,7 @@ struct GreaterImpl : OperationImplementation {
 				comb.insert(comb.begin(), F_INT32);
 			return all_comb;
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {type_size(node->predecessors[0]->operation.data_type) ==
@@ -162,6 +166,7 @@ struct EqualImpl : OperationImplementation {
 				comb.insert(comb.begin(), F_INT32);
 			return all_comb;
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {type_size(node->predecessors[0]->operation.data_type) ==
@@ -3,9 +3,18 @@
 #include "../utils.hpp"
 #include "flint.h"
 #include "flint_helper.hpp"
+#include "gemm.hpp"
+#include "im2col.hpp"
+#include "winograd.hpp"
 
 #define MIN_VAL(x, y) (x < y ? x : y)
 #define MAX_VAL(x, y) (x < y ? y : x)
+// minimal number of elements per filter for which the cpu backend lowers
+// convolutions to matrix multiplications
+#define CONV_GEMM_MIN_DEPTH 16
+// minimal number of channels and filters for which 3x3 convolutions are
+// computed with Winograd
+#define CONV_WINOGRAD_MIN_CHANNELS 8
 
 using namespace std;
 
@@ -98,6 +107,275 @@ FGraphNode *ConvolveImpl::local_gradient(FGraphNode *y, int dx_i,
 	}
 	return nullptr;
 }
+/**
+ * If the convolution `node` (or one of its gradients) should be computed by
+ * the lowering to matrix multiplications. Constant parameters (with only one
+ * element) are left to the generic implementations.
+ */
+static bool lower_to_gemm(const FGraphNode *node, const ConvGeometry &geometry) {
+	if (node->predecessors[0]->operation.op_type == FGEN_CONSTANT ||
+		node->predecessors[1]->operation.op_type == FGEN_CONSTANT)
+		return false;
+	switch (fConvolutionAlgorithm()) {
+	case F_CONV_GENERIC:
+		return false;
+	case F_CONV_IM2COL:
+		return true;
+	default:
+		return geometry.depth >= CONV_GEMM_MIN_DEPTH;
+	}
+}
+// implementations of the forward convolution on the cpu
+enum ConvolveKernel {
+	CONVOLVE_GENERIC,
+	CONVOLVE_DIRECT,
+	CONVOLVE_IM2COL,
+	CONVOLVE_POINTWISE,
+	CONVOLVE_WINOGRAD
+};
+/**
+ * Chooses the implementation of the convolution `node` from the shapes of
+ * its kernel and its steps (see `FConvolutionAlgorithm`). `floating` is set
+ * if the result type is a floating point type, since Winograd is not exact.
+ */
+static ConvolveKernel choose_convolve_kernel(const FGraphNode *node,
+											 const ConvGeometry &geometry,
+											 bool floating) {
+	const FOperation image = node->predecessors[0]->operation,
+					 kernel = node->predecessors[1]->operation;
+	const unsigned int *steps = (unsigned int *)node->operation.additional_data;
+	if (!lower_to_gemm(node, geometry))
+		return fConvolutionAlgorithm() == F_CONV_AUTO &&
+					   image.op_type != FGEN_CONSTANT &&
+					   kernel.op_type != FGEN_CONSTANT
+				   ? CONVOLVE_DIRECT
+				   : CONVOLVE_GENERIC;
+	if (fConvolutionAlgorithm() == F_CONV_IM2COL)
+		return CONVOLVE_IM2COL;
+	// window dimensions of the kernel
+	const int n = image.dimensions - 1;
+	const size_t *kshape = kernel.dimensions != image.dimensions
+							   ? kernel.shape + 1
+							   : kernel.shape;
+	bool pointwise = true;
+	for (int d = 0; d < n; d++)
+		pointwise &= kshape[d] == 1 && steps[d] == 1;
+	if (pointwise)
+		return CONVOLVE_POINTWISE;
+	// 3x3 over the last two dimensions, the others are batches
+	bool winograd = floating && n >= 2 &&
+					image.shape[n] >= CONV_WINOGRAD_MIN_CHANNELS &&
+					geometry.filters >= CONV_WINOGRAD_MIN_CHANNELS;
+	for (int d = 0; d < n && winograd; d++)
+		winograd = steps[d] == 1 && kshape[d] == (d < n - 2 ? 1 : 3);
+	return winograd ? CONVOLVE_WINOGRAD : CONVOLVE_IM2COL;
+}
+/**
+ * Elements `[from, from + size)` of the convolution computed directly from
+ * the image, for kernels that are too small for the lowering. Images are
+ * stored with the channels last, so each window consists of runs of the
+ * last kernel dimension and the channels that are multiplied with the
+ * filter like two contiguous vectors.
+ */
+template <typename T, typename A, typename B>
+static void convolve_direct(T *__restrict__ result, const A *__restrict__ image,
+							const B *__restrict__ kernel,
+							const ConvGeometry &geometry, size_t from,
+							size_t size) {
+	const size_t filters = geometry.filters, depth = geometry.depth,
+				 run = geometry.run, runs = geometry.run_offsets.size();
+	for (size_t index = from; index < from + size;) {
+		const size_t w = index / filters;
+		const A *window = image + geometry.window_start(w);
+		for (const size_t to = std::min(from + size, (w + 1) * filters);
+			 index < to; index++) {
+			const B *filter = kernel + (index % filters) * depth;
+			T res = 0;
+			for (size_t r = 0; r < runs; r++) {
+				const A *src = window + geometry.run_offsets[r];
+				const B *weights = filter + r * run;
+				for (size_t k = 0; k < run; k++)
+					res += weights[k] * src[k];
+			}
+			result[index] = res;
+		}
+	}
+}
+/**
+ * Elements `[from, from + size)` of a convolution with a kernel of size 1 and
+ * step 1 in every window dimension. The image already is the patch matrix
+ * (one row of channels per pixel), so it is multiplied with the transposed
+ * filters without copying.
+ */
+template <typename T, typename A, typename B>
+static void convolve_pointwise(T *__restrict__ result,
+							   const A *__restrict__ image,
+							   const B *__restrict__ kernel,
+							   const ConvGeometry &geometry, size_t from,
+							   size_t size) {
+	const size_t filters = geometry.filters, channels = geometry.depth;
+	GemmWorkspace<T> workspace;
+	for (size_t index = from; index < from + size;) {
+		const size_t row = index / filters, col = index % filters;
+		size_t rows = 1, cols = std::min(filters - col, from + size - index);
+		if (col == 0 && cols == filters)
+			rows = (from + size - index) / filters;
+		gemm(rows, cols, channels, image + row * channels, channels, 1,
+			 kernel + col * channels, 1, channels, result + index, filters,
+			 workspace);
+		index += rows * cols;
+	}
+}
+/**
+ * Elements `[from, from + size)` of the convolution of `image` with `kernel`,
+ * i.e. of the product of the patch matrix with the transposed filters. The
+ * range is split into runs of whole rows (windows) and partial rows at its
+ * ends, the patches of each run are copied tile by tile.
+ */
+template <typename T, typename A, typename B>
+static void convolve_gemm(T *__restrict__ result, const A *__restrict__ image,
+						  const B *__restrict__ kernel,
+						  const ConvGeometry &geometry, size_t from,
+						  size_t size) {
+	const size_t filters = geometry.filters, depth = geometry.depth;
+	const size_t tile_windows = geometry.tile_windows(depth);
+	// the patches keep the type of the image (the 8bit kernel of `gemm`)
+	std::vector<A> tile(std::min(tile_windows, geometry.windows) * depth);
+	GemmWorkspace<T> workspace;
+	for (size_t index = from; index < from + size;) {
+		const size_t row = index / filters, col = index % filters;
+		size_t rows = 1, cols = std::min(filters - col, from + size - index);
+		if (col == 0 && cols == filters)
+			rows = std::min(geometry.windows - row,
+							(from + size - index) / filters);
+		for (size_t w = 0; w < rows; w += tile_windows) {
+			const size_t tile_rows = std::min(tile_windows, rows - w);
+			im2col(tile.data(), image, geometry, row + w, tile_rows, 0, depth);
+			gemm(tile_rows, cols, depth, tile.data(), depth, 1,
+				 kernel + col * depth, 1, depth,
+				 result + index + w * filters, filters, workspace);
+		}
+		index += rows * cols;
+	}
+}
+/**
+ * Elements `[from, from + size)` of the gradient of the image of a
+ * convolution. The gradients of the patches of all windows that overlap the
+ * range (i.e. the product of the adjoint with the filters) are computed tile
+ * by tile and added to the pixels they belong to.
+ */
+template <typename T, typename A, typename B>
+static void gradient_convolve1_gemm(T *__restrict__ result,
+									const A *__restrict__ kernel,
+									const B *__restrict__ adjoint,
+									const ConvGeometry &geometry, size_t from,
+									size_t size) {
+	const size_t filters = geometry.filters, depth = geometry.depth;
+	std::fill(result + from, result + from + size, (T)0);
+	// the starts of the windows are strictly increasing, the first window
+	// that ends in the range and the first one that starts behind it
+	size_t first = 0, last;
+	for (size_t count = geometry.windows; count > 0;) {
+		const size_t half = count / 2;
+		if (geometry.window_start(first + half) + geometry.span < from) {
+			first += half + 1;
+			count -= half + 1;
+		} else
+			count = half;
+	}
+	last = first;
+	for (size_t count = geometry.windows - first; count > 0;) {
+		const size_t half = count / 2;
+		if (geometry.window_start(last + half) < from + size) {
+			last += half + 1;
+			count -= half + 1;
+		} else
+			count = half;
+	}
+	const size_t tile_windows = geometry.tile_windows(depth);
+	std::vector<T> tile(std::min(tile_windows, geometry.windows) * depth);
+	GemmWorkspace<T> workspace;
+	for (size_t w = first; w < last; w += tile_windows) {
+		const size_t tile_rows = std::min(tile_windows, last - w);
+		gemm(tile_rows, depth, filters, adjoint + w * filters, filters, 1,
+			 kernel, depth, 1, tile.data(), depth, workspace);
+		col2im(result, tile.data(), geometry, w, tile_rows, from,
+			   from + size);
+	}
+}
+/**
+ * Adds `value` atomically to `target`, the 16bit types with a compare and
+ * swap loop since `atomic_ref` has no arithmetic for them.
+ */
+template <typename T> static inline void atomic_add(T &target, T value) {
+	if constexpr (is_arithmetic_v<T>)
+		atomic_ref<T>(target) += value;
+	else {
+		atomic_ref<T> ref(target);
+		T expected = ref.load();
+		while (!ref.compare_exchange_weak(expected, (float)expected + value))
+			;
+	}
+}
+/**
+ * Deployed elements `[from, from + size)` of the gradient of the kernel of a
+ * convolution, i.e. of the product of the transposed adjoint with the patch
+ * matrix. Each element of the result is deployed `parts` times for a part of
+ * the windows each (see `size_multiplier_convolve_kernel_gradient`). The
+ * elements of which all parts are in the range are split like
+ * `convolve_gemm` by filters and the windows are accumulated tile by tile,
+ * the parts of the others are added atomically.
+ */
+template <typename T, typename A, typename B>
+static void gradient_convolve2_gemm(T *__restrict__ result,
+									const A *__restrict__ image,
+									const B *__restrict__ adjoint,
+									const ConvGeometry &geometry, size_t parts,
+									size_t from, size_t size) {
+	const size_t filters = geometry.filters, depth = geometry.depth;
+	const size_t windows = geometry.windows, part_windows = windows / parts;
+	const auto add_parts = [&](size_t i, size_t first_part, size_t last_part) {
+		const size_t f = i / depth, k = i % depth;
+		const size_t offset =
+			geometry.run_offsets[k / geometry.run] + k % geometry.run;
+		const size_t to =
+			last_part == parts ? windows : last_part * part_windows;
+		compute_type<T> res = 0;
+		for (size_t w = first_part * part_windows; w < to; w++)
+			res += adjoint[w * filters + f] *
+				   image[geometry.window_start(w) + offset];
+		atomic_add(result[i], (T)res);
+	};
+	const size_t end = from + size;
+	const size_t first = (from + parts - 1) / parts, last = end / parts;
+	if (first > last) {
+		add_parts(last, from % parts, end % parts);
+		return;
+	}
+	if (from % parts != 0)
+		add_parts(from / parts, from % parts, parts);
+	if (end % parts != 0)
+		add_parts(last, 0, end % parts);
+	std::vector<T> tile;
+	GemmWorkspace<T> workspace;
+	for (size_t index = first; index < last;) {
+		const size_t row = index / depth, col = index % depth;
+		size_t rows = 1, cols = std::min(depth - col, last - index);
+		if (col == 0 && cols == depth)
+			rows = std::min(filters - row, (last - index) / depth);
+		const size_t tile_windows = geometry.tile_windows(cols);
+		tile.resize(std::min(tile_windows, windows) * cols);
+		for (size_t w = 0; w < windows; w += tile_windows) {
+			const size_t tile_rows = std::min(tile_windows, windows - w);
+			im2col(tile.data(), image, geometry, w, tile_rows, col,
+				   col + cols);
+			gemm(rows, cols, tile_rows, adjoint + w * filters + row, 1,
+				 filters, tile.data(), cols, 1, result + index, depth,
+				 workspace, w != 0);
+		}
+		index += rows * cols;
+	}
+}
 template <typename T, typename A, typename B>
 void ConvolveImpl::binary_expression(T *__restrict__ result,
 									 const A *__restrict__ data1,
@@ -112,6 +390,34 @@ void ConvolveImpl::binary_expression(T *__restrict__ result,
 	const unsigned int *steps = (unsigned int *)op.additional_data;
 	const bool multiple_filter =
 		gnp2->operation.dimensions != gnp1->operation.dimensions;
+	const ConvGeometry geometry(pred, kernel, multiple_filter, steps);
+	switch (choose_convolve_kernel(curr, geometry,
+								   std::is_floating_point<T>::value)) {
+	case CONVOLVE_DIRECT:
+		convolve_direct(result, data1, data2, geometry, from, size);
+		return;
+	case CONVOLVE_IM2COL:
+		convolve_gemm(result, data1, data2, geometry, from, size);
+		return;
+	case CONVOLVE_POINTWISE:
+		convolve_pointwise(result, data1, data2, geometry, from, size);
+		return;
+	case CONVOLVE_WINOGRAD: {
+		const int n = pred.dimensions - 1;
+		const size_t height = pred.shape[n - 2], width = pred.shape[n - 1];
+		// the larger tiles save more multiplications, but are wasted at the
+		// borders of small images
+		if (height >= 10 && width >= 10)
+			winograd_convolve<4>(result, data1, data2, height, width,
+								 pred.shape[n], geometry.filters, from, size);
+		else
+			winograd_convolve<2>(result, data1, data2, height, width,
+								 pred.shape[n], geometry.filters, from, size);
+		return;
+	}
+	case CONVOLVE_GENERIC:
+		break;
+	}
 	// total sizes
 	size_t num_entries1 = 1, num_entries2 = 1;
 	if (gnp1->operation.op_type != FGEN_CONSTANT)
@@ -447,6 +753,11 @@ void GradientConvolve1Impl::binary_expression(
 	// calculate accumulated sizes for result (pred), kernel and a
 	// (adjacent)
 	const bool multifilter = op.dimensions != kernel.dimensions;
+	const ConvGeometry geometry(op, kernel, multifilter, steps);
+	if (lower_to_gemm(curr, geometry)) {
+		gradient_convolve1_gemm(result, data1, data2, geometry, from, size);
+		return;
+	}
 	std::vector<size_t> acc_sizes = calc_acc_sizes(a);
 	std::vector<size_t> acc_sizes_pred = calc_acc_sizes(op);
 	std::vector<size_t> acc_sizes_kernel = calc_acc_sizes(kernel);
@@ -939,6 +1250,11 @@ void GradientConvolve2Impl::binary_expression(
 		multifilter ? acc_sizes_kernel[0] : acc_sizes_kernel[0] * op.shape[0];
 	const unsigned int *steps = (unsigned int *)op.additional_data;
 	const unsigned int num_filter = multifilter ? op.shape[0] : 1;
+	const ConvGeometry geometry(pred, op, multifilter, steps);
+	if (lower_to_gemm(curr, geometry)) {
+		gradient_convolve2_gemm(result, data1, data2, geometry, c, from, size);
+		return;
+	}
 	const size_t window_work_load = windows / c;
 	for (size_t i_m = from; i_m < from + size; i_m++) {
 		const int i = i_m / c;
@@ -957,7 +1273,6 @@ void GradientConvolve2Impl::binary_expression(
 			size_t ki = (i / acc_sizes_kernel[j]) % op.shape[j];
 			a_offset += ki * acc_sizes_pred[multifilter ? j - 1 : j];
 		}
-		auto target = atomic_ref<T>(result[i]);
 		// iterate over windows = adjoint elements in first dimensions
 		// we split windows for the thread iterations
 		for (size_t w = window_thread * window_work_load; w < to; w++) {
@@ -973,7 +1288,7 @@ void GradientConvolve2Impl::binary_expression(
 				data2[gnp2->operation.op_type == FGEN_CONSTANT
 						  ? 0
 						  : w * num_filter + f];
-			target += res;
+			atomic_add(result[i], res);
 		}
 	}
 }
@@ -172,5 +172,6 @@ struct GradientConvolve2Impl : OperationImplementation {
 			free(gn->operation.additional_data);
 		}
 		size_t deploy_as_many_elements(const FGraphNode *node) override;
+		bool accumulates_result() override { return true; }
 };
 #endif
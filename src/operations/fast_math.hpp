@@ -0,0 +1,385 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_FAST_MATH_HPP
+#define FLINT_FAST_MATH_HPP
+#include "../../flint.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+/*
+ * Polynomial implementations of the transcendental functions for the cpu
+ * backend if the accuracy is set to `F_FAST_MATH`. They contain no calls, no
+ * table lookups and no branches (only selects), so the loops over the
+ * elements are vectorized by the compiler. Arguments are reduced to a small
+ * interval with Cody-Waite constants and the functions are approximated there
+ * by their truncated Taylor series, the degrees are chosen such that the
+ * truncation error stays below half an ulp. Arguments the reduction can not
+ * handle (e.g. huge arguments of the trigonometric functions or subnormal
+ * arguments of `sqrt`) are reported by the `*_valid` functions and recomputed
+ * with the standard library.
+ */
+
+// the loops are only vectorized if everything is inlined and unrolled (for the
+// same reason conditions are combined with & and | instead of && and ||)
+#define FAST_MATH_INLINE inline __attribute__((always_inline))
+#define FAST_MATH_UNROLL _Pragma("GCC unroll 32")
+
+template <typename T> struct FastMathConstants;
+template <> struct FastMathConstants<float> {
+		using Int = int32_t;
+		static constexpr int mantissa = 23, bias = 127;
+		// adding it rounds to an integer that is stored in the low bits
+		static constexpr float round_magic = 0x1.8p23f;
+		static constexpr float min_normal = 0x1p-126f;
+		// exp overflows above and underflows below
+		static constexpr float exp_high = 89.f, exp_low = -104.f;
+		// ln(2) with 9 significant bits and the rest
+		static constexpr float ln2_hi = 0.693359375f, ln2_lo = -2.12194440e-4f;
+		// 1/2!, 1/3!, ..., 1/7!
+		static constexpr float exp_poly[] = {
+			1.f / 2, 1.f / 6, 1.f / 24, 1.f / 120, 1.f / 720, 1.f / 5040};
+		// 2/3, 2/5, ..., 2/9
+		static constexpr float log_poly[] = {2.f / 3, 2.f / 5, 2.f / 7,
+											 2.f / 9};
+		// initial guess of 1/sqrt(x) and number of newton iterations
+		static constexpr Int rsqrt_magic = 0x5f3759df;
+		static constexpr int rsqrt_steps = 3;
+};
+template <> struct FastMathConstants<double> {
+		using Int = int64_t;
+		static constexpr int mantissa = 52, bias = 1023;
+		static constexpr double round_magic = 0x1.8p52;
+		static constexpr double min_normal = 0x1p-1022;
+		static constexpr double exp_high = 710., exp_low = -746.;
+		static constexpr double ln2_hi = 6.93145751953125e-1,
+								ln2_lo = 1.42860682030941723212e-6;
+		// pi / 2 in parts that can be multiplied exactly with the quadrant
+		static constexpr double pio2_1 = 1.57079625129699707031,
+								pio2_2 = 7.54978941586159635336e-8,
+								pio2_3 = 5.39030285815811905290e-15;
+		// largest argument that is reduced with `pio2_*`
+		static constexpr double trig_limit = 1e9;
+		// 1/2!, ..., 1/13!
+		static constexpr double exp_poly[] = {
+			1. / 2,		   1. / 6,		   1. / 24,		  1. / 120,
+			1. / 720,	   1. / 5040,	   1. / 40320,	  1. / 362880,
+			1. / 3628800,  1. / 39916800,  1. / 479001600, 1. / 6227020800};
+		// 2/3, ..., 2/19
+		static constexpr double log_poly[] = {2. / 3,  2. / 5,	2. / 7,
+											  2. / 9,  2. / 11, 2. / 13,
+											  2. / 15, 2. / 17, 2. / 19};
+		// -1/3!, ..., -1/15!
+		static constexpr double sin_poly[] = {
+			-1. / 6,		  1. / 120,			 -1. / 5040,
+			1. / 362880,	  -1. / 39916800,	 1. / 6227020800,
+			-1. / 1307674368000};
+		// 1/4!, ..., 1/16!
+		static constexpr double cos_poly[] = {
+			1. / 24,		 -1. / 720,			  1. / 40320,
+			-1. / 3628800,	 1. / 479001600,	  -1. / 87178291200,
+			1. / 20922789888000};
+		static constexpr Int rsqrt_magic = 0x5fe6eb50c7b537a9;
+		static constexpr int rsqrt_steps = 4;
+};
+/** Evaluates the polynomial with coefficients `c` (lowest first) at `x` */
+template <typename T, size_t N>
+FAST_MATH_INLINE T fast_polynomial(T x, const T (&c)[N]) {
+	T p = c[N - 1];
+	FAST_MATH_UNROLL
+	for (size_t i = N - 1; i > 0; i--)
+		p = p * x + c[i - 1];
+	return p;
+}
+/**
+ * `c ? a : b` on the bits, since the compiler does not turn conditional
+ * floating point operations into selects (they might trap)
+ */
+template <typename T> FAST_MATH_INLINE T fast_select(bool c, T a, T b) {
+	using Int = typename FastMathConstants<T>::Int;
+	const Int mask = -(Int)c;
+	return std::bit_cast<T>((std::bit_cast<Int>(a) & mask) |
+							(std::bit_cast<Int>(b) & ~mask));
+}
+/** Rounds `x` to the nearest integer, returned as float and as integer */
+template <typename T>
+FAST_MATH_INLINE T fast_round(T x, typename FastMathConstants<T>::Int &n) {
+	using C = FastMathConstants<T>;
+	const T t = x + C::round_magic;
+	n = std::bit_cast<typename C::Int>(t) -
+		std::bit_cast<typename C::Int>(C::round_magic);
+	return t - C::round_magic;
+}
+/** exp(r) * 2^n for a reduced argument |r| <= ln(2) / 2 */
+template <typename T>
+FAST_MATH_INLINE T fast_exp_reduced(T r, typename FastMathConstants<T>::Int n) {
+	using C = FastMathConstants<T>;
+	using Int = typename C::Int;
+	const T p = 1 + r + r * r * fast_polynomial(r, C::exp_poly);
+	// in two factors, so that subnormal results and 2^(bias + 1) work
+	const Int n1 = n >> 1, n2 = n - n1;
+	return p * std::bit_cast<T>((n1 + C::bias) << C::mantissa) *
+		   std::bit_cast<T>((n2 + C::bias) << C::mantissa);
+}
+template <typename T> FAST_MATH_INLINE T fast_exp(T x) {
+	using C = FastMathConstants<T>;
+	// comparisons with NaN are false, so it stays NaN
+	x = fast_select(x > C::exp_high, C::exp_high, x);
+	x = fast_select(x < C::exp_low, C::exp_low, x);
+	typename C::Int n;
+	const T k = fast_round(x * (T)1.44269504088896340736, n);
+	return fast_exp_reduced((x - k * C::ln2_hi) - k * C::ln2_lo, n);
+}
+/**
+ * Splits `x > 0` into `2^e * (1 + f)` with `1 + f` in [sqrt(1/2), sqrt(2))
+ * and returns `f`.
+ */
+template <typename T> FAST_MATH_INLINE T fast_log_split(T x, T &e) {
+	using C = FastMathConstants<T>;
+	using Int = typename C::Int;
+	const bool subnormal = x < C::min_normal;
+	x = fast_select(subnormal, x * (T)((Int)1 << C::mantissa), x);
+	const Int bits = std::bit_cast<Int>(x);
+	const Int mantissa_mask = ((Int)1 << C::mantissa) - 1;
+	const T m = std::bit_cast<T>((bits & mantissa_mask) |
+								 std::bit_cast<Int>((T)1));
+	const bool upper = m > (T)1.41421356237309504880;
+	// exact conversion of the small biased exponent
+	e = std::bit_cast<T>(std::bit_cast<Int>(C::round_magic) +
+						 (bits >> C::mantissa)) -
+		C::round_magic - C::bias;
+	e = e + fast_select(upper, (T)1, (T)0) -
+		fast_select(subnormal, (T)C::mantissa, (T)0);
+	return fast_select(upper, m * (T)0.5, m) - 1;
+}
+/** `log(1 + f)` for `f` from `fast_log_split` by `2 atanh(f / (2 + f))` */
+template <typename T> FAST_MATH_INLINE T fast_log1p_reduced(T f) {
+	using C = FastMathConstants<T>;
+	const T s = f / (2 + f);
+	const T z = s * s;
+	// 2 s = f - s f, the small correction is computed separately
+	return f - s * (f - z * fast_polynomial(z, C::log_poly));
+}
+/** Selects the results of log for zero, negative and infinite arguments */
+template <typename T> FAST_MATH_INLINE T fast_log_special(T x, T result) {
+	constexpr T inf = std::numeric_limits<T>::infinity();
+	result = fast_select(x == inf, inf, result);
+	result = fast_select(x == 0, -inf, result);
+	return fast_select(x >= 0, result, std::numeric_limits<T>::quiet_NaN());
+}
+template <typename T> FAST_MATH_INLINE T fast_log(T x) {
+	using C = FastMathConstants<T>;
+	T e;
+	const T l = fast_log1p_reduced(fast_log_split(x, e));
+	return fast_log_special(x, e * C::ln2_hi + (l + e * C::ln2_lo));
+}
+template <typename T> FAST_MATH_INLINE T fast_log2(T x) {
+	T e;
+	const T l = fast_log1p_reduced(fast_log_split(x, e));
+	return fast_log_special(x, e + l * (T)1.44269504088896340736);
+}
+template <typename T> FAST_MATH_INLINE T fast_log10(T x) {
+	T e;
+	const T l = fast_log1p_reduced(fast_log_split(x, e));
+	// log10(2) with 7 significant bits and the rest
+	const T log10_2_hi = (T)3.0078125e-1,
+			log10_2_lo = (T)2.48745663981195213739e-4;
+	return fast_log_special(x, e * log10_2_hi +
+								   (l * (T)0.43429448190325182765 +
+									e * log10_2_lo));
+}
+/**
+ * Reduces `x` to `r` in [-pi/4, pi/4] and computes `sin(r)`, `cos(r)` and the
+ * quadrant `q` with `x = r + q * pi / 2`. Only valid for `|x| <= trig_limit`.
+ * Computed in double precision, since the reduction of float arguments loses
+ * too many bits in single precision.
+ */
+FAST_MATH_INLINE void fast_sincos_reduced(double x, double &sin, double &cos,
+								int64_t &q) {
+	using C = FastMathConstants<double>;
+	const double k = fast_round(x * 0.63661977236758134308, q);
+	const double r = ((x - k * C::pio2_1) - k * C::pio2_2) - k * C::pio2_3;
+	const double z = r * r;
+	sin = r + r * z * fast_polynomial(z, C::sin_poly);
+	cos = 1 - 0.5 * z + z * z * fast_polynomial(z, C::cos_poly);
+}
+template <typename T> FAST_MATH_INLINE bool fast_trig_valid(T x) {
+	return x <= FastMathConstants<double>::trig_limit &
+		   x >= -FastMathConstants<double>::trig_limit;
+}
+template <typename T> FAST_MATH_INLINE T fast_sin(T x) {
+	double s, c;
+	int64_t q;
+	fast_sincos_reduced(x, s, c, q);
+	const double v = fast_select(q & 1, c, s);
+	return (T)fast_select(q & 2, -v, v);
+}
+template <typename T> FAST_MATH_INLINE T fast_cos(T x) {
+	double s, c;
+	int64_t q;
+	fast_sincos_reduced(x, s, c, q);
+	const double v = fast_select(q & 1, s, c);
+	return (T)fast_select((q + 1) & 2, -v, v);
+}
+template <typename T> FAST_MATH_INLINE T fast_tan(T x) {
+	double s, c;
+	int64_t q;
+	fast_sincos_reduced(x, s, c, q);
+	return (T)fast_select(q & 1, -c / s, s / c);
+}
+/** Newton iterations of 1 / sqrt(x) from a bit level guess */
+template <typename T> FAST_MATH_INLINE T fast_sqrt(T x) {
+	using C = FastMathConstants<T>;
+	using Int = typename C::Int;
+	T y = std::bit_cast<T>(C::rsqrt_magic - (std::bit_cast<Int>(x) >> 1));
+	FAST_MATH_UNROLL
+	for (int i = 0; i < C::rsqrt_steps; i++)
+		y = y * ((T)1.5 - (T)0.5 * x * y * y);
+	T s = x * y;
+	// one correction of the square root itself rounds nearly correctly
+	s = s + (T)0.5 * y * (x - s * s);
+	s = fast_select(x == std::numeric_limits<T>::infinity() | x == 0, x, s);
+	return fast_select(x >= 0, s, std::numeric_limits<T>::quiet_NaN());
+}
+template <typename T> FAST_MATH_INLINE bool fast_sqrt_valid(T x) {
+	return !(x > 0 & x < FastMathConstants<T>::min_normal);
+}
+/** Sum `a + b = s + e` without rounding error */
+FAST_MATH_INLINE double fast_two_sum(double a, double b, double &e) {
+	const double s = a + b;
+	const double v = s - a;
+	e = (a - (s - v)) + (b - v);
+	return s;
+}
+/**
+ * Product `a * b = p + e` without rounding error. Without fma instructions the
+ * compiler does not contract the products of Dekker's algorithm either.
+ */
+FAST_MATH_INLINE double fast_two_product(double a, double b, double &e) {
+	const double p = a * b;
+#ifdef __FMA__
+	e = std::fma(a, b, -p);
+#else
+	const double ca = 134217729. * a, cb = 134217729. * b;
+	const double ah = ca - (ca - a), al = a - ah;
+	const double bh = cb - (cb - b), bl = b - bh;
+	e = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+#endif
+	return p;
+}
+/** Applies the special cases of the C standard to `result = |x|^y` */
+FAST_MATH_INLINE double fast_pow_special(double x, double y, double result) {
+	using Int = FastMathConstants<double>::Int;
+	constexpr double inf = std::numeric_limits<double>::infinity();
+	const double ax = std::abs(x), ay = std::abs(y);
+	const bool y_integer = ay >= 0x1p52 | (ay + 0x1p52) - 0x1p52 == ay;
+	const Int parity =
+		std::bit_cast<Int>(fast_select(ay < 0x1p52, ay + 0x1p52, ay)) & 1;
+	const Int y_odd = parity & -(Int)(y_integer & ay < 0x1p53);
+	result = fast_select(ax == 0 & y < 0, inf, result);
+	result = fast_select(ax == 0 & y > 0, 0., result);
+	result = fast_select(ax == inf & y < 0, 0., result);
+	result = fast_select(ax == inf & y > 0, inf, result);
+	result = fast_select(ay == inf, fast_select((ax < 1) == (y < 0), inf, 0.),
+						 result);
+	result = fast_select(ay == inf & ax == 1, 1., result);
+	// negative x and odd y flip the sign
+	result = std::bit_cast<double>(std::bit_cast<Int>(result) ^
+								   (std::bit_cast<Int>(x) & (y_odd << 63)));
+	result = fast_select(x < 0 & ax != inf & ay != inf & !y_integer,
+						 std::numeric_limits<double>::quiet_NaN(), result);
+	result = fast_select(x != x, x, result);
+	return fast_select(y == 0 | x == 1, 1., result);
+}
+/** `x^y` for float, log and exp in double precision are accurate enough */
+FAST_MATH_INLINE float fast_pow(float x, float y) {
+	const double ax = std::abs((double)x);
+	return (float)fast_pow_special(x, y, fast_exp(y * fast_log(ax)));
+}
+/**
+ * `x^y` for double. `y * log(|x|)` is computed with twice the precision, since
+ * its absolute error is the relative error of the result.
+ */
+FAST_MATH_INLINE double fast_pow(double x, double y) {
+	using C = FastMathConstants<double>;
+	// log(|x|) = e * ln2 + log(1 + f) = hi + lo with
+	// log(1 + f) = 2 s + 2 s^3 / 3 + ... and s = f / (2 + f)
+	double e;
+	const double f = fast_log_split(std::abs(x), e);
+	const double t = 2 + f, t_lo = f - (t - 2);
+	const double s = f / t;
+	double p_lo;
+	const double p = fast_two_product(s, t, p_lo);
+	const double s_lo = (((f - p) - p_lo) - s * t_lo) / t;
+	const double z = s * s;
+	const double tail = s * z * fast_polynomial(z, C::log_poly);
+	double lo;
+	double hi = fast_two_sum(e * C::ln2_hi, 2 * s, lo);
+	lo += e * C::ln2_lo + 2 * s_lo + tail;
+	hi = fast_two_sum(hi, lo, lo);
+	// w = y * log(|x|)
+	double w_lo;
+	double w = fast_two_product(y, hi, w_lo);
+	w_lo += y * lo;
+	// the splitting overflows for huge factors, the result is 0 or inf then
+	w_lo = fast_select(w < 1000 & w > -1000, w_lo, 0.);
+	w = fast_select(w > C::exp_high, C::exp_high, w);
+	w = fast_select(w < C::exp_low, C::exp_low, w);
+	C::Int n;
+	const double k = fast_round(w * 1.44269504088896340736, n);
+	return fast_pow_special(
+		x, y,
+		fast_exp_reduced(((w - k * C::ln2_hi) - k * C::ln2_lo) + w_lo, n));
+}
+/**
+ * Computes `result[i] = fast(data[i])` for the elements of a unary operation
+ * in a vectorizable loop. Elements for which `valid` is false are recomputed
+ * afterwards by `exact`. `result` may be the buffer of `data` (unary
+ * operations reuse the memory of their parameter), so every block of elements
+ * is computed in a temporary before it is written.
+ */
+template <typename T, typename Fast, typename Valid, typename Exact>
+inline void fast_unary(T *result, const T *data, size_t from, size_t size,
+					   const FGraphNode *curr, Fast fast, Valid valid,
+					   Exact exact) {
+	if (curr->predecessors[0]->operation.op_type == FGEN_CONSTANT) {
+		const T v = valid(data[0]) ? fast(data[0]) : exact(data[0]);
+		for (size_t i = from; i < from + size; i++)
+			result[i] = v;
+		return;
+	}
+	// counted in the element type, bool reductions are not vectorized
+	using Int = typename FastMathConstants<T>::Int;
+	constexpr size_t block = 256;
+	T tmp[block];
+	for (size_t start = from; start < from + size; start += block) {
+		const size_t n = std::min(block, from + size - start);
+		const T *in = data + start;
+		Int invalid = 0;
+		for (size_t i = 0; i < n; i++) {
+			tmp[i] = fast(in[i]);
+			invalid += !valid(in[i]);
+		}
+		if (invalid)
+			for (size_t i = 0; i < n; i++)
+				if (!valid(in[i]))
+					tmp[i] = exact(in[i]);
+		std::copy(tmp, tmp + n, result + start);
+	}
+}
+#endif
@@ -0,0 +1,339 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_GEMM_HPP
+#define FLINT_GEMM_HPP
+#include "../backend_cpu/float16.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ * Matrix multiplication of the cpu backend, blocked like in BLIS: the
+ * operands are copied block by block into packed panels (which also converts
+ * them to the type the result is computed in), so the innermost kernel reads
+ * both operands contiguously and keeps a `GEMM_MR x nr` tile of the result in
+ * registers.
+ * The kernel is written with fixed trip counts, the compiler unrolls and
+ * vectorizes it for every type.
+ * Products of two 8bit (quantized) operands have a kernel of their own that
+ * accumulates exactly in int: its panels hold the operands widened to
+ * `int16_t` with pairs of consecutive depths interleaved, so one multiply-add
+ * of pairs (`vpmaddwd`, or `vpdpwssd` with AVX-VNNI) computes two steps of the
+ * depth for 8 columns at once.
+ */
+
+// rows of the register tile
+#define GEMM_MR 6
+// depth of the packed panels, a `GEMM_KC x nr` sliver of the second operand
+// stays in the L1 cache
+#define GEMM_KC 256
+// rows of the first operand per packed block (L2 cache)
+#define GEMM_MC 120
+// columns of the second operand per packed panel (L3 cache)
+#define GEMM_NC 1024
+
+/** Columns of the register tile, two 256 bit vectors of `T` */
+template <typename T> constexpr size_t gemm_nr() { return 64 / sizeof(T); }
+// columns of the register tile of the 8bit kernel (two vectors of int)
+#define GEMM_S8_NR 16
+
+/** If `T` is one of the 8bit integer types of quantized tensors */
+template <typename T>
+constexpr bool is_8bit_type =
+	std::is_same<T, int8_t>::value || std::is_same<T, uint8_t>::value;
+
+/** Packed panels of one thread, reused for all multiplications of a chunk */
+template <typename T> struct GemmWorkspace {
+		std::vector<compute_type<T>> a, b;
+		// interleaved panels of the 8bit kernel
+		std::vector<int16_t> a_pairs, b_pairs;
+};
+/**
+ * Copies the `rows x depth` block of `a` (element `(i, p)` at
+ * `a[i * row_stride + p * col_stride]`) into slivers of `GEMM_MR` rows, each
+ * stored column by column. Missing rows of the last sliver are 0.
+ */
+template <typename T, typename A>
+inline void gemm_pack_a(T *__restrict__ packed, const A *__restrict__ a,
+						size_t rows, size_t depth, size_t row_stride,
+						size_t col_stride) {
+	for (size_t i0 = 0; i0 < rows; i0 += GEMM_MR) {
+		const size_t mr = std::min((size_t)GEMM_MR, rows - i0);
+		for (size_t p = 0; p < depth; p++) {
+			for (size_t i = 0; i < mr; i++)
+				packed[i] = (T)a[(i0 + i) * row_stride + p * col_stride];
+			for (size_t i = mr; i < GEMM_MR; i++)
+				packed[i] = 0;
+			packed += GEMM_MR;
+		}
+	}
+}
+/**
+ * Copies the `depth x cols` block of `b` into slivers of `gemm_nr<T>()`
+ * columns, each stored row by row. Missing columns of the last sliver are 0.
+ */
+template <typename T, typename B>
+inline void gemm_pack_b(T *__restrict__ packed, const B *__restrict__ b,
+						size_t depth, size_t cols, size_t row_stride,
+						size_t col_stride) {
+	constexpr size_t nr = gemm_nr<T>();
+	for (size_t j0 = 0; j0 < cols; j0 += nr) {
+		const size_t w = std::min(nr, cols - j0);
+		for (size_t p = 0; p < depth; p++) {
+			const B *row = b + p * row_stride + j0 * col_stride;
+			if (col_stride == 1)
+				for (size_t j = 0; j < w; j++)
+					packed[j] = (T)row[j];
+			else
+				for (size_t j = 0; j < w; j++)
+					packed[j] = (T)row[j * col_stride];
+			for (size_t j = w; j < nr; j++)
+				packed[j] = 0;
+			packed += nr;
+		}
+	}
+}
+/**
+ * Multiplies a packed sliver of `a` with a packed sliver of `b` over `depth`
+ * and stores (`first`) or adds the `rows x cols` upper left part of the tile
+ * to `c`.
+ */
+template <typename C, typename T>
+inline void gemm_kernel(size_t depth, const C *__restrict__ a,
+						const C *__restrict__ b, T *__restrict__ c, size_t ldc,
+						size_t rows, size_t cols, bool first) {
+	constexpr size_t nr = gemm_nr<C>();
+	C acc[GEMM_MR][nr] = {};
+	for (size_t p = 0; p < depth; p++) {
+#pragma GCC unroll 8
+		for (size_t i = 0; i < GEMM_MR; i++)
+#pragma GCC unroll 16
+			for (size_t j = 0; j < nr; j++)
+				acc[i][j] += a[i] * b[j];
+		a += GEMM_MR;
+		b += nr;
+	}
+	if (rows == GEMM_MR && cols == nr) {
+		for (size_t i = 0; i < GEMM_MR; i++)
+			for (size_t j = 0; j < nr; j++)
+				c[i * ldc + j] = first ? acc[i][j] : c[i * ldc + j] + acc[i][j];
+	} else
+		for (size_t i = 0; i < rows; i++)
+			for (size_t j = 0; j < cols; j++)
+				c[i * ldc + j] = first ? acc[i][j] : c[i * ldc + j] + acc[i][j];
+}
+/**
+ * Like `gemm_pack_a`, but stores for each pair of depths `(p, p + 1)` the two
+ * elements of each row next to each other (the second one is 0 for an odd
+ * `depth`).
+ */
+template <typename A>
+inline void gemm_pack_a_pairs(int16_t *__restrict__ packed,
+							  const A *__restrict__ a, size_t rows,
+							  size_t depth, size_t row_stride,
+							  size_t col_stride) {
+	for (size_t i0 = 0; i0 < rows; i0 += GEMM_MR) {
+		const size_t mr = std::min((size_t)GEMM_MR, rows - i0);
+		for (size_t p = 0; p < depth; p += 2) {
+			for (size_t i = 0; i < mr; i++) {
+				const A *row = a + (i0 + i) * row_stride + p * col_stride;
+				packed[2 * i] = row[0];
+				packed[2 * i + 1] = p + 1 < depth ? row[col_stride] : 0;
+			}
+			for (size_t i = mr; i < GEMM_MR; i++)
+				packed[2 * i] = packed[2 * i + 1] = 0;
+			packed += 2 * GEMM_MR;
+		}
+	}
+}
+/**
+ * Like `gemm_pack_b`, but stores for each pair of depths `(p, p + 1)` the two
+ * elements of each column next to each other.
+ */
+template <typename B>
+inline void gemm_pack_b_pairs(int16_t *__restrict__ packed,
+							  const B *__restrict__ b, size_t depth,
+							  size_t cols, size_t row_stride,
+							  size_t col_stride) {
+	for (size_t j0 = 0; j0 < cols; j0 += GEMM_S8_NR) {
+		const size_t w = std::min((size_t)GEMM_S8_NR, cols - j0);
+		for (size_t p = 0; p < depth; p += 2) {
+			const B *row = b + p * row_stride + j0 * col_stride;
+			for (size_t j = 0; j < w; j++) {
+				packed[2 * j] = row[j * col_stride];
+				packed[2 * j + 1] =
+					p + 1 < depth ? row[row_stride + j * col_stride] : 0;
+			}
+			for (size_t j = w; j < GEMM_S8_NR; j++)
+				packed[2 * j] = packed[2 * j + 1] = 0;
+			packed += 2 * GEMM_S8_NR;
+		}
+	}
+}
+#ifdef __AVX2__
+/** `acc + a0 * b0 + a1 * b1` for each int of 8 pairs of int16_t */
+inline __m256i gemm_dot_pairs(__m256i acc, __m256i a, __m256i b) {
+#if defined(__AVXVNNI__)
+	return _mm256_dpwssd_avx_epi32(acc, a, b);
+#elif defined(__AVX512VNNI__) && defined(__AVX512VL__)
+	return _mm256_dpwssd_epi32(acc, a, b);
+#else
+	return _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+#endif
+}
+#endif
+/**
+ * `gemm_kernel` of the 8bit operands for `pairs` interleaved pairs of depths
+ * of the panels of `gemm_pack_a_pairs` and `gemm_pack_b_pairs`.
+ */
+inline void gemm_kernel_pairs(size_t pairs, const int16_t *__restrict__ a,
+							  const int16_t *__restrict__ b,
+							  int *__restrict__ c, size_t ldc, size_t rows,
+							  size_t cols, bool first) {
+	int acc[GEMM_MR][GEMM_S8_NR];
+#ifdef __AVX2__
+	__m256i lo[GEMM_MR], hi[GEMM_MR];
+	for (size_t i = 0; i < GEMM_MR; i++)
+		lo[i] = hi[i] = _mm256_setzero_si256();
+	for (size_t p = 0; p < pairs; p++) {
+		const __m256i b0 = _mm256_loadu_si256((const __m256i *)b);
+		const __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + 16));
+#pragma GCC unroll 8
+		for (size_t i = 0; i < GEMM_MR; i++) {
+			int32_t pair;
+			std::memcpy(&pair, a + 2 * i, sizeof(pair));
+			const __m256i ai = _mm256_set1_epi32(pair);
+			lo[i] = gemm_dot_pairs(lo[i], ai, b0);
+			hi[i] = gemm_dot_pairs(hi[i], ai, b1);
+		}
+		a += 2 * GEMM_MR;
+		b += 2 * GEMM_S8_NR;
+	}
+	for (size_t i = 0; i < GEMM_MR; i++) {
+		_mm256_storeu_si256((__m256i *)acc[i], lo[i]);
+		_mm256_storeu_si256((__m256i *)(acc[i] + 8), hi[i]);
+	}
+#else
+	std::fill(&acc[0][0], &acc[0][0] + GEMM_MR * GEMM_S8_NR, 0);
+	for (size_t p = 0; p < pairs; p++) {
+		for (size_t i = 0; i < GEMM_MR; i++)
+			for (size_t j = 0; j < GEMM_S8_NR; j++)
+				acc[i][j] += a[2 * i] * b[2 * j] + a[2 * i + 1] * b[2 * j + 1];
+		a += 2 * GEMM_MR;
+		b += 2 * GEMM_S8_NR;
+	}
+#endif
+	for (size_t i = 0; i < rows; i++)
+		for (size_t j = 0; j < cols; j++)
+			c[i * ldc + j] = first ? acc[i][j] : c[i * ldc + j] + acc[i][j];
+}
+/** `gemm` of two 8bit operands, the products are summed up exactly in int */
+template <typename A, typename B>
+void gemm_8bit(size_t rows, size_t cols, size_t depth, const A *a,
+			   size_t a_row_stride, size_t a_col_stride, const B *b,
+			   size_t b_row_stride, size_t b_col_stride, int *c, size_t ldc,
+			   GemmWorkspace<int> &workspace, bool accumulate) {
+	constexpr size_t nr = GEMM_S8_NR;
+	const size_t kc_max = std::min(depth, (size_t)GEMM_KC);
+	const size_t mc_max = std::min(rows, (size_t)GEMM_MC);
+	const size_t nc_max = std::min(cols, (size_t)GEMM_NC);
+	const size_t pairs_max = (kc_max + 1) / 2;
+	workspace.a_pairs.resize(2 * pairs_max *
+							 ((mc_max + GEMM_MR - 1) / GEMM_MR * GEMM_MR));
+	workspace.b_pairs.resize(2 * pairs_max * ((nc_max + nr - 1) / nr * nr));
+	for (size_t jc = 0; jc < cols; jc += GEMM_NC) {
+		const size_t nc = std::min((size_t)GEMM_NC, cols - jc);
+		for (size_t pc = 0; pc < depth; pc += GEMM_KC) {
+			const size_t kc = std::min((size_t)GEMM_KC, depth - pc);
+			const size_t pairs = (kc + 1) / 2;
+			gemm_pack_b_pairs(workspace.b_pairs.data(),
+							  b + pc * b_row_stride + jc * b_col_stride, kc,
+							  nc, b_row_stride, b_col_stride);
+			for (size_t ic = 0; ic < rows; ic += GEMM_MC) {
+				const size_t mc = std::min((size_t)GEMM_MC, rows - ic);
+				gemm_pack_a_pairs(workspace.a_pairs.data(),
+								  a + ic * a_row_stride + pc * a_col_stride,
+								  mc, kc, a_row_stride, a_col_stride);
+				for (size_t jr = 0; jr < nc; jr += nr)
+					for (size_t ir = 0; ir < mc; ir += GEMM_MR)
+						gemm_kernel_pairs(
+							pairs, workspace.a_pairs.data() + 2 * ir * pairs,
+							workspace.b_pairs.data() + 2 * jr * pairs,
+							c + (ic + ir) * ldc + jc + jr, ldc,
+							std::min((size_t)GEMM_MR, mc - ir),
+							std::min(nr, nc - jr), pc == 0 && !accumulate);
+			}
+		}
+	}
+}
+/**
+ * `c = a * b` for a `rows x depth` matrix `a` and a `depth x cols` matrix `b`
+ * with arbitrary strides (0 for constants) into the row major matrix `c` with
+ * `ldc` elements per row. Everything is accumulated in `compute_type<T>`. If
+ * `accumulate` is set the product is added to `c` instead.
+ */
+template <typename T, typename A, typename B>
+void gemm(size_t rows, size_t cols, size_t depth, const A *a,
+		  size_t a_row_stride, size_t a_col_stride, const B *b,
+		  size_t b_row_stride, size_t b_col_stride, T *c, size_t ldc,
+		  GemmWorkspace<T> &workspace, bool accumulate = false) {
+	constexpr size_t nr = gemm_nr<compute_type<T>>();
+	if (depth == 0) {
+		if (!accumulate)
+			for (size_t i = 0; i < rows; i++)
+				std::fill(c + i * ldc, c + i * ldc + cols, (T)0);
+		return;
+	}
+	if constexpr (is_8bit_type<A> && is_8bit_type<B> &&
+				  std::is_same<T, int>::value) {
+		gemm_8bit(rows, cols, depth, a, a_row_stride, a_col_stride, b,
+				  b_row_stride, b_col_stride, c, ldc, workspace, accumulate);
+		return;
+	}
+	const size_t kc_max = std::min(depth, (size_t)GEMM_KC);
+	const size_t mc_max = std::min(rows, (size_t)GEMM_MC);
+	const size_t nc_max = std::min(cols, (size_t)GEMM_NC);
+	workspace.a.resize(kc_max * ((mc_max + GEMM_MR - 1) / GEMM_MR * GEMM_MR));
+	workspace.b.resize(kc_max * ((nc_max + nr - 1) / nr * nr));
+	for (size_t jc = 0; jc < cols; jc += GEMM_NC) {
+		const size_t nc = std::min((size_t)GEMM_NC, cols - jc);
+		for (size_t pc = 0; pc < depth; pc += GEMM_KC) {
+			const size_t kc = std::min((size_t)GEMM_KC, depth - pc);
+			gemm_pack_b(workspace.b.data(),
+						b + pc * b_row_stride + jc * b_col_stride, kc, nc,
+						b_row_stride, b_col_stride);
+			for (size_t ic = 0; ic < rows; ic += GEMM_MC) {
+				const size_t mc = std::min((size_t)GEMM_MC, rows - ic);
+				gemm_pack_a(workspace.a.data(),
+							a + ic * a_row_stride + pc * a_col_stride, mc, kc,
+							a_row_stride, a_col_stride);
+				for (size_t jr = 0; jr < nc; jr += nr)
+					for (size_t ir = 0; ir < mc; ir += GEMM_MR)
+						gemm_kernel(kc, workspace.a.data() + ir * kc,
+									workspace.b.data() + jr * kc,
+									c + (ic + ir) * ldc + jc + jr, ldc,
+									std::min((size_t)GEMM_MR, mc - ir),
+									std::min(nr, nc - jr),
+									pc == 0 && !accumulate);
+			}
+		}
+	}
+}
+#endif
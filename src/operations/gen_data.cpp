@@ -88,6 +88,10 @@ void GenConstantImpl::push_additional_kernel_parameters(
 	FGraphNode *node, cl_kernel kernel, cl_context context, int &par_index,
 	std::list<cl_mem> &to_free) {
 	unsigned int byte_size;
+	const void *value = node->operation.additional_data;
+	// the 16bit types are float on the gpu, the 8bit ones int
+	float narrow;
+	int narrow_int;
 	switch (node->operation.data_type) {
 	case F_FLOAT64:
 	case F_INT64:
@@ -97,9 +101,28 @@ void GenConstantImpl::push_additional_kernel_parameters(
 	case F_FLOAT32:
 		byte_size = 4;
 		break;
+	case F_FLOAT16:
+		narrow = *(const Float16 *)value;
+		value = &narrow;
+		byte_size = 4;
+		break;
+	case F_BFLOAT16:
+		narrow = *(const BFloat16 *)value;
+		value = &narrow;
+		byte_size = 4;
+		break;
+	case F_INT8:
+		narrow_int = *(const int8_t *)value;
+		value = &narrow_int;
+		byte_size = 4;
+		break;
+	case F_UINT8:
+		narrow_int = *(const uint8_t *)value;
+		value = &narrow_int;
+		byte_size = 4;
+		break;
 	}
-	if (clSetKernelArg(kernel, par_index++, byte_size,
-					   node->operation.additional_data) != CL_SUCCESS) {
+	if (clSetKernelArg(kernel, par_index++, byte_size, value) != CL_SUCCESS) {
 		setErrorType(OCL_ERROR);
 		flogging(F_ERROR, "Could not load Argument to kernel!");
 		return;
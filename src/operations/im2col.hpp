@@ -0,0 +1,143 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_IM2COL_HPP
+#define FLINT_IM2COL_HPP
+#include "../../flint.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Lowering of convolutions to matrix multiplications for the cpu backend.
+ * The windows of the image (shape `[p1, ..., pn, c]`) that the kernel is slid
+ * over are the rows of a patch matrix with one column per kernel element, the
+ * convolution is the product of that matrix with the transposed filters
+ * (shape `[filters, k1, ..., kn, c]`). The patch matrix is never stored as a
+ * whole, it is copied in tiles of a few windows (`im2col`) and the results of
+ * the gradient of the image are added back to their pixels (`col2im`).
+ */
+
+// elements of one tile of the patch matrix
+#define IM2COL_TILE_ELEMENTS (1 << 16)
+
+struct ConvGeometry {
+		// number of windows, filters and elements per filter
+		size_t windows, filters, depth;
+		// the last kernel dimension and the channels are contiguous in the
+		// image, so each window consists of runs of `run` elements
+		size_t run;
+		// offset of each run relative to the start of a window
+		std::vector<size_t> run_offsets;
+		// windows per dimension and the offset between two neighbouring
+		// windows in the image
+		std::vector<size_t> window_shape, window_strides;
+		// distance from the start of a window to its last element
+		size_t span;
+		/**
+		 * `image` is the shape of the convolved Tensor (channels included),
+		 * `kernel` the shape of the kernel (with the filters as the first
+		 * dimension if `multifilter` is set).
+		 */
+		ConvGeometry(const FOperation &image, const FOperation &kernel,
+					 bool multifilter, const unsigned int *steps) {
+			const int n = image.dimensions - 1;
+			const size_t *kshape = multifilter ? kernel.shape + 1 : kernel.shape;
+			filters = multifilter ? kernel.shape[0] : 1;
+			std::vector<size_t> acc_image(image.dimensions);
+			acc_image[n] = 1;
+			for (int d = n - 1; d >= 0; d--)
+				acc_image[d] = acc_image[d + 1] * image.shape[d + 1];
+			windows = 1;
+			depth = image.shape[n];
+			window_shape.resize(n);
+			window_strides.resize(n);
+			span = image.shape[n] - 1;
+			for (int d = 0; d < n; d++) {
+				window_shape[d] = (image.shape[d] - kshape[d]) / steps[d] + 1;
+				window_strides[d] = steps[d] * acc_image[d];
+				windows *= window_shape[d];
+				depth *= kshape[d];
+				span += (kshape[d] - 1) * acc_image[d];
+			}
+			run = kshape[n - 1] * image.shape[n];
+			run_offsets = {0};
+			for (int d = n - 2; d >= 0; d--) {
+				std::vector<size_t> outer;
+				outer.reserve(run_offsets.size() * kshape[d]);
+				for (size_t k = 0; k < kshape[d]; k++)
+					for (size_t o : run_offsets)
+						outer.push_back(k * acc_image[d] + o);
+				run_offsets = std::move(outer);
+			}
+		}
+		/** Offset of the first element of window `w` in the image */
+		size_t window_start(size_t w) const {
+			size_t start = 0;
+			for (long d = window_shape.size() - 1; d >= 0; d--) {
+				start += (w % window_shape[d]) * window_strides[d];
+				w /= window_shape[d];
+			}
+			return start;
+		}
+		/** Number of windows that can be copied into one tile */
+		size_t tile_windows(size_t columns) const {
+			return std::max((size_t)1, IM2COL_TILE_ELEMENTS / columns);
+		}
+};
+/**
+ * Copies columns `[k0, k1)` of the rows `[w0, w0 + rows)` of the patch
+ * matrix of `image` into the row major matrix `tile`.
+ */
+template <typename T, typename A>
+inline void im2col(T *__restrict__ tile, const A *__restrict__ image,
+				   const ConvGeometry &geometry, size_t w0, size_t rows,
+				   size_t k0, size_t k1) {
+	const size_t run = geometry.run;
+	for (size_t w = w0; w < w0 + rows; w++) {
+		const A *window = image + geometry.window_start(w);
+		for (size_t r = k0 / run; r * run < k1; r++) {
+			const A *src = window + geometry.run_offsets[r];
+			const size_t from = std::max(k0, r * run) - r * run,
+						 to = std::min(k1, (r + 1) * run) - r * run;
+			for (size_t k = from; k < to; k++)
+				tile[k - from] = (T)src[k];
+			tile += to - from;
+		}
+	}
+}
+/**
+ * Adds the rows `[w0, w0 + rows)` of the patch matrix `tile` to the pixels of
+ * `image` they were taken from, only the pixels in `[from, to)` are changed.
+ */
+template <typename T>
+inline void col2im(T *__restrict__ image, const T *__restrict__ tile,
+				   const ConvGeometry &geometry, size_t w0, size_t rows,
+				   size_t from, size_t to) {
+	const size_t run = geometry.run;
+	for (size_t w = w0; w < w0 + rows; w++, tile += geometry.depth) {
+		const size_t start = geometry.window_start(w);
+		for (size_t r = 0; r < geometry.run_offsets.size(); r++) {
+			const size_t pos = start + geometry.run_offsets[r];
+			if (pos >= to || pos + run <= from)
+				continue;
+			const size_t lo = std::max(pos, from) - pos,
+						 hi = std::min(pos + run, to) - pos;
+			const T *src = tile + r * run;
+			T *dst = image + pos;
+			for (size_t k = lo; k < hi; k++)
+				dst[k] += src[k];
+		}
+	}
+}
+#endif
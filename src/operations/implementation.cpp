@@ -18,9 +18,13 @@
 #include "convolution.hpp"
 #include "gen_data.hpp"
 #include "index_modification.hpp"
+#include "normalization.hpp"
 #include "pooling.hpp"
+#include "quantization.hpp"
 #include "reductions.hpp"
 #include "shape_modification.hpp"
+#include "softmax.hpp"
+#include "sparse.hpp"
 #include "sliding_windows.hpp"
 #include "unary_arithmetic.hpp"
 
@@ -49,6 +53,12 @@ FGraphNode *OperationImplementation::constant_tensor(double val, FType type,
 		return fconstant_l((long)val, shape, dimensions);
 	case F_FLOAT64:
 		return fconstant_d((double)val, shape, dimensions);
+	case F_FLOAT16:
+	case F_BFLOAT16:
+		return fconvert(fconstant_f((float)val, shape, dimensions), type);
+	case F_INT8:
+	case F_UINT8:
+		return fconvert(fconstant_i((int)val, shape, dimensions), type);
 	}
 	return nullptr;
 }
@@ -144,7 +154,18 @@ std::vector<OperationImplementation *>
 												new PoolingMaxImpl(),
 												new PoolingSumImpl(),
 												new GradientPoolingMax(),
-												new DropoutImpl()};
+												new DropoutImpl(),
+												new QuantizeImpl(),
+												new DequantizeImpl(),
+												new SparseImpl(),
+												new SparseMatMulImpl(),
+												new SoftmaxImpl(),
+												new LogSoftmaxImpl(),
+												new SoftmaxCrossEntropyImpl(),
+												new BatchMomentsImpl(),
+												new BatchNormImpl(),
+												new GradientBatchNormSumsImpl(),
+												new GradientBatchNormImpl()};
 
 std::string OperationImplementation::generate_ocl_parameters_eager(
 	FType res_type, std::vector<FType> parameter_types) {
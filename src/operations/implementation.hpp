@@ -16,11 +16,51 @@
 
 #include "../../flint.h"
 #include "../backend_cpu/cpu_common.hpp"
+#include "../backend_cpu/float16.hpp"
 #include "../backend_ocl/twine.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <set>
 #include <unordered_map>
 #include <vector>
 
+/* calls `binary_expression` with the result type `T`, the type `A` of the
+ * first parameter and the type of the second one */
+#define DISPATCH_BINARY_SECOND(T, A)                                           \
+	switch (p2.type) {                                                         \
+	case F_INT32:                                                              \
+		binary_expression((T *)result, (A *)p1.data, (int *)p2.data,           \
+						  from, size, im1, iv1, im2, iv2, node);               \
+		break;                                                                 \
+	case F_FLOAT32:                                                            \
+		binary_expression((T *)result, (A *)p1.data, (float *)p2.data,         \
+						  from, size, im1, iv1, im2, iv2, node);               \
+		break;                                                                 \
+	case F_FLOAT64:                                                            \
+		binary_expression((T *)result, (A *)p1.data, (double *)p2.data,        \
+						  from, size, im1, iv1, im2, iv2, node);               \
+		break;                                                                 \
+	case F_INT64:                                                              \
+		binary_expression((T *)result, (A *)p1.data, (long *)p2.data,          \
+						  from, size, im1, iv1, im2, iv2, node);               \
+		break;                                                                 \
+	case F_FLOAT16:                                                            \
+		binary_expression((T *)result, (A *)p1.data, (Float16 *)p2.data,       \
+						  from, size, im1, iv1, im2, iv2, node);               \
+		break;                                                                 \
+	case F_BFLOAT16:                                                           \
+		binary_expression((T *)result, (A *)p1.data, (BFloat16 *)p2.data,      \
+						  from, size, im1, iv1, im2, iv2, node);               \
+		break;                                                                 \
+	case F_INT8:                                                               \
+		binary_expression((T *)result, (A *)p1.data, (int8_t *)p2.data,        \
+						  from, size, im1, iv1, im2, iv2, node);               \
+		break;                                                                 \
+	case F_UINT8:                                                              \
+		binary_expression((T *)result, (A *)p1.data, (uint8_t *)p2.data,       \
+						  from, size, im1, iv1, im2, iv2, node);               \
+		break;                                                                 \
+	}
 #define DISPATCH_BINARY_OPERATION(T)                                           \
 	const CPUResultData p1 = predecessor_data[0], p2 = predecessor_data[1];    \
 	size_t im1 = p1.num_entries, im2 = p2.num_entries;                         \
@@ -29,89 +69,119 @@
 											   node->predecessors[1], iv2);    \
 	switch (p1.type) {                                                         \
 	case F_INT32:                                                              \
-		switch (p2.type) {                                                     \
-		case F_INT32:                                                          \
-			binary_expression((T *)result, (int *)p1.data, (int *)p2.data,     \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_FLOAT32:                                                        \
-			binary_expression((T *)result, (int *)p1.data, (float *)p2.data,   \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_FLOAT64:                                                        \
-			binary_expression((T *)result, (int *)p1.data, (double *)p2.data,  \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_INT64:                                                          \
-			binary_expression((T *)result, (int *)p1.data, (long *)p2.data,    \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		}                                                                      \
+		DISPATCH_BINARY_SECOND(T, int)                                         \
 		break;                                                                 \
 	case F_FLOAT32:                                                            \
-		switch (p2.type) {                                                     \
-		case F_INT32:                                                          \
-			binary_expression((T *)result, (float *)p1.data, (int *)p2.data,   \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_FLOAT32:                                                        \
-			binary_expression((T *)result, (float *)p1.data, (float *)p2.data, \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_FLOAT64:                                                        \
-			binary_expression((T *)result, (float *)p1.data,                   \
-							  (double *)p2.data, from, size, im1, iv1, im2,    \
-							  iv2, node);                                      \
-			break;                                                             \
-		case F_INT64:                                                          \
-			binary_expression((T *)result, (float *)p1.data, (long *)p2.data,  \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		}                                                                      \
+		DISPATCH_BINARY_SECOND(T, float)                                       \
 		break;                                                                 \
 	case F_FLOAT64:                                                            \
-		switch (p2.type) {                                                     \
-		case F_INT32:                                                          \
-			binary_expression((T *)result, (double *)p1.data, (int *)p2.data,  \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_FLOAT32:                                                        \
-			binary_expression((T *)result, (double *)p1.data,                  \
-							  (float *)p2.data, from, size, im1, iv1, im2,     \
-							  iv2, node);                                      \
-			break;                                                             \
-		case F_FLOAT64:                                                        \
-			binary_expression((T *)result, (double *)p1.data,                  \
-							  (double *)p2.data, from, size, im1, iv1, im2,    \
-							  iv2, node);                                      \
-			break;                                                             \
-		case F_INT64:                                                          \
-			binary_expression((T *)result, (double *)p1.data, (long *)p2.data, \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		}                                                                      \
+		DISPATCH_BINARY_SECOND(T, double)                                      \
 		break;                                                                 \
 	case F_INT64:                                                              \
-		switch (p2.type) {                                                     \
-		case F_INT32:                                                          \
-			binary_expression((T *)result, (long *)p1.data, (int *)p2.data,    \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_FLOAT32:                                                        \
-			binary_expression((T *)result, (long *)p1.data, (float *)p2.data,  \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_FLOAT64:                                                        \
-			binary_expression((T *)result, (long *)p1.data, (double *)p2.data, \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		case F_INT64:                                                          \
-			binary_expression((T *)result, (long *)p1.data, (long *)p2.data,   \
-							  from, size, im1, iv1, im2, iv2, node);           \
-			break;                                                             \
-		}                                                                      \
+		DISPATCH_BINARY_SECOND(T, long)                                        \
+		break;                                                                 \
+	case F_FLOAT16:                                                            \
+		DISPATCH_BINARY_SECOND(T, Float16)                                     \
 		break;                                                                 \
+	case F_BFLOAT16:                                                           \
+		DISPATCH_BINARY_SECOND(T, BFloat16)                                    \
+		break;                                                                 \
+	case F_INT8:                                                               \
+		DISPATCH_BINARY_SECOND(T, int8_t)                                      \
+		break;                                                                 \
+	case F_UINT8:                                                              \
+		DISPATCH_BINARY_SECOND(T, uint8_t)                                     \
+		break;                                                                 \
+	}
+/**
+ * Position of one operand of an elementwise binary operation, see
+ * `broadcast_binary`. The index is either contiguous (same shape or broadcast
+ * along the leading dimensions, it wraps around after `num_entries` elements)
+ * or constant (scalars and inverse broadcasting, where every value is repeated
+ * `inv_broadcast` times) for the next `remaining` elements.
+ */
+struct BroadcastCursor {
+		size_t index, remaining;
+		size_t num_entries, inv_broadcast;
+		bool constant;
+		BroadcastCursor(size_t i, size_t num_entries, size_t inv_broadcast)
+			: num_entries(num_entries), inv_broadcast(inv_broadcast) {
+			if (num_entries == 1) {
+				index = 0;
+				remaining = SIZE_MAX;
+				constant = true;
+			} else if (inv_broadcast == 1) {
+				index = i % num_entries;
+				remaining = num_entries - index;
+				constant = false;
+			} else {
+				index = (i / inv_broadcast) % num_entries;
+				remaining = inv_broadcast - i % inv_broadcast;
+				constant = true;
+			}
+		}
+		void advance(size_t n) {
+			if (remaining == SIZE_MAX)
+				return;
+			remaining -= n;
+			if (!constant)
+				index += n;
+			if (remaining == 0) {
+				if (constant) {
+					index = index + 1 == num_entries ? 0 : index + 1;
+					remaining = inv_broadcast;
+				} else {
+					index = 0;
+					remaining = num_entries;
+				}
+			}
+		}
+};
+/**
+ * Computes `result[i] = op(data1[(i / inv_man_1) % index_man_1],
+ * data2[(i / inv_man_2) % index_man_2])` for `i` in `[from, from + size)`
+ * without divisions per element. The range is cut into segments in which each
+ * operand is either contiguous or constant, so for same shape, scalar,
+ * broadcast and inversely broadcast operands every segment is a simple loop
+ * that can be vectorized.
+ */
+template <typename T, typename A, typename B, typename Op>
+inline void broadcast_binary(T *__restrict__ result,
+							 const A *__restrict__ data1,
+							 const B *__restrict__ data2, size_t from,
+							 size_t size, size_t index_man_1, size_t inv_man_1,
+							 size_t index_man_2, size_t inv_man_2, Op op) {
+	BroadcastCursor c1(from, index_man_1, inv_man_1);
+	BroadcastCursor c2(from, index_man_2, inv_man_2);
+	const size_t end = from + size;
+	for (size_t i = from; i < end;) {
+		const size_t n = std::min({end - i, c1.remaining, c2.remaining});
+		T *__restrict__ r = result + i;
+		if (c1.constant && c2.constant) {
+			const T v = op(data1[c1.index], data2[c2.index]);
+			for (size_t k = 0; k < n; k++)
+				r[k] = v;
+		} else if (c1.constant) {
+			const A a = data1[c1.index];
+			const B *__restrict__ b = data2 + c2.index;
+			for (size_t k = 0; k < n; k++)
+				r[k] = op(a, b[k]);
+		} else if (c2.constant) {
+			const A *__restrict__ a = data1 + c1.index;
+			const B b = data2[c2.index];
+			for (size_t k = 0; k < n; k++)
+				r[k] = op(a[k], b);
+		} else {
+			const A *__restrict__ a = data1 + c1.index;
+			const B *__restrict__ b = data2 + c2.index;
+			for (size_t k = 0; k < n; k++)
+				r[k] = op(a[k], b[k]);
+		}
+		i += n;
+		c1.advance(n);
+		c2.advance(n);
 	}
+}
 /* calls a function `binary_expression` with the signature
  * template <typename T, typename A, typename B>
  * void binaryExpression(T *__restrict__ result,
@@ -134,6 +204,18 @@
 	case F_FLOAT64: {                                                          \
 		DISPATCH_BINARY_OPERATION(double)                                      \
 	} break;                                                                   \
+	case F_FLOAT16: {                                                          \
+		DISPATCH_BINARY_OPERATION(Float16)                                     \
+	} break;                                                                   \
+	case F_BFLOAT16: {                                                         \
+		DISPATCH_BINARY_OPERATION(BFloat16)                                    \
+	} break;                                                                   \
+	case F_INT8: {                                                             \
+		DISPATCH_BINARY_OPERATION(int8_t)                                      \
+	} break;                                                                   \
+	case F_UINT8: {                                                            \
+		DISPATCH_BINARY_OPERATION(uint8_t)                                     \
+	} break;                                                                   \
 	}
 // calls a function `zeroary_expression` with the same signature as execute_cpu
 // but with a typed result and without predecessor data
@@ -151,6 +233,18 @@
 	case F_FLOAT64: {                                                          \
 		zeroary_expression(node, (double *__restrict__)result, from, size);    \
 	} break;                                                                   \
+	case F_FLOAT16: {                                                          \
+		zeroary_expression(node, (Float16 *__restrict__)result, from, size);   \
+	} break;                                                                   \
+	case F_BFLOAT16: {                                                         \
+		zeroary_expression(node, (BFloat16 *__restrict__)result, from, size);  \
+	} break;                                                                   \
+	case F_INT8: {                                                             \
+		zeroary_expression(node, (int8_t *__restrict__)result, from, size);    \
+	} break;                                                                   \
+	case F_UINT8: {                                                            \
+		zeroary_expression(node, (uint8_t *__restrict__)result, from, size);   \
+	} break;                                                                   \
 	}
 #define DISPATCH_UNARY_OPERATION(T)                                            \
 	switch (node->predecessors[0]->operation.data_type) {                      \
@@ -174,6 +268,26 @@
 						 (double *__restrict__)predecessor_data[0].data, from, \
 						 size, node);                                          \
 	} break;                                                                   \
+	case F_FLOAT16: {                                                          \
+		unary_expression((T *__restrict__)result,                              \
+						 (Float16 *__restrict__)predecessor_data[0].data,      \
+						 from, size, node);                                    \
+	} break;                                                                   \
+	case F_BFLOAT16: {                                                         \
+		unary_expression((T *__restrict__)result,                              \
+						 (BFloat16 *__restrict__)predecessor_data[0].data,     \
+						 from, size, node);                                    \
+	} break;                                                                   \
+	case F_INT8: {                                                             \
+		unary_expression((T *__restrict__)result,                              \
+						 (int8_t *__restrict__)predecessor_data[0].data,       \
+						 from, size, node);                                    \
+	} break;                                                                   \
+	case F_UINT8: {                                                            \
+		unary_expression((T *__restrict__)result,                              \
+						 (uint8_t *__restrict__)predecessor_data[0].data,      \
+						 from, size, node);                                    \
+	} break;                                                                   \
 	}
 /* calls a function `unary_expression` with the signature
  * template <typename T, typename A>
@@ -195,6 +309,18 @@
 	case F_FLOAT64: {                                                          \
 		DISPATCH_UNARY_OPERATION(double)                                       \
 	} break;                                                                   \
+	case F_FLOAT16: {                                                          \
+		DISPATCH_UNARY_OPERATION(Float16)                                      \
+	} break;                                                                   \
+	case F_BFLOAT16: {                                                         \
+		DISPATCH_UNARY_OPERATION(BFloat16)                                     \
+	} break;                                                                   \
+	case F_INT8: {                                                             \
+		DISPATCH_UNARY_OPERATION(int8_t)                                       \
+	} break;                                                                   \
+	case F_UINT8: {                                                            \
+		DISPATCH_UNARY_OPERATION(uint8_t)                                      \
+	} break;                                                                   \
 	}
 /* calls a function `unary_expression` with the signature
  * template <typename T>
@@ -224,6 +350,26 @@
 						 (double *__restrict__)predecessor_data[0].data, from, \
 						 size, node);                                          \
 	} break;                                                                   \
+	case F_FLOAT16: {                                                          \
+		unary_expression((Float16 *__restrict__)result,                        \
+						 (Float16 *__restrict__)predecessor_data[0].data,      \
+						 from, size, node);                                    \
+	} break;                                                                   \
+	case F_BFLOAT16: {                                                         \
+		unary_expression((BFloat16 *__restrict__)result,                       \
+						 (BFloat16 *__restrict__)predecessor_data[0].data,     \
+						 from, size, node);                                    \
+	} break;                                                                   \
+	case F_INT8: {                                                             \
+		unary_expression((int8_t *__restrict__)result,                         \
+						 (int8_t *__restrict__)predecessor_data[0].data,       \
+						 from, size, node);                                    \
+	} break;                                                                   \
+	case F_UINT8: {                                                            \
+		unary_expression((uint8_t *__restrict__)result,                        \
+						 (uint8_t *__restrict__)predecessor_data[0].data,      \
+						 from, size, node);                                    \
+	} break;                                                                   \
 	}
 /* calls a function `execute_cpu_typed` with the same signature as
  * `execute_cpu`, but with a typed return type */
@@ -245,6 +391,22 @@
 		execute_cpu_typed(node, predecessor_data,                              \
 						  (double *__restrict__)result, from, size);           \
 	} break;                                                                   \
+	case F_FLOAT16: {                                                          \
+		execute_cpu_typed(node, predecessor_data,                              \
+						  (Float16 *__restrict__)result, from, size);          \
+	} break;                                                                   \
+	case F_BFLOAT16: {                                                         \
+		execute_cpu_typed(node, predecessor_data,                              \
+						  (BFloat16 *__restrict__)result, from, size);         \
+	} break;                                                                   \
+	case F_INT8: {                                                             \
+		execute_cpu_typed(node, predecessor_data,                              \
+						  (int8_t *__restrict__)result, from, size);           \
+	} break;                                                                   \
+	case F_UINT8: {                                                            \
+		execute_cpu_typed(node, predecessor_data,                              \
+						  (uint8_t *__restrict__)result, from, size);          \
+	} break;                                                                   \
 	}
 /* calls a function `binary_expression` with the signature
  * template <typename T>
@@ -278,6 +440,26 @@
 						  (double *)p2.data, from, size, im1, iv1, im2, iv2,   \
 						  node);                                               \
 	} break;                                                                   \
+	case F_FLOAT16: {                                                          \
+		binary_expression((Float16 *)result, (Float16 *)p1.data,               \
+						  (Float16 *)p2.data, from, size, im1, iv1, im2, iv2,  \
+						  node);                                               \
+	} break;                                                                   \
+	case F_BFLOAT16: {                                                         \
+		binary_expression((BFloat16 *)result, (BFloat16 *)p1.data,             \
+						  (BFloat16 *)p2.data, from, size, im1, iv1, im2, iv2, \
+						  node);                                               \
+	} break;                                                                   \
+	case F_INT8: {                                                             \
+		binary_expression((int8_t *)result, (int8_t *)p1.data,                 \
+						  (int8_t *)p2.data, from, size, im1, iv1, im2, iv2,   \
+						  node);                                               \
+	} break;                                                                   \
+	case F_UINT8: {                                                            \
+		binary_expression((uint8_t *)result, (uint8_t *)p1.data,               \
+						  (uint8_t *)p2.data, from, size, im1, iv1, im2, iv2,  \
+						  node);                                               \
+	} break;                                                                   \
 	}
 struct OCLLazyCodegenState {
 		/** Working queue of nodes for which still code has to be generated */
@@ -431,6 +613,32 @@ struct OperationImplementation {
 		reuse_parameter_result(const FGraphNode *node) {
 			return {};
 		}
+		/**
+		 * Operations whose result is a contiguous range of the data of their
+		 * only parameter (e.g. reshapes) return the offset of that range in
+		 * elements, else -1. The backends do not compute such results, they
+		 * share the buffer of the parameter (see `pool_share`). Parameters
+		 * that are constants are never shared, since their data has only one
+		 * element.
+		 */
+		virtual long view_offset(const FGraphNode *node) { return -1; }
+		/**
+		 * Operations that only rearrange the elements of their only
+		 * parameter (e.g. transpositions) may describe their result by
+		 * strides into the data the parameter is read from. `strides` holds
+		 * the distance of two neighbouring indices in that data per dimension
+		 * of the parameter and has to be replaced by the ones of the
+		 * dimensions of the result, the position of the first element of the
+		 * result relative to the one of the parameter is added to `offset`.
+		 * Returns false if the result can not be described that way, which may
+		 * only depend on the shapes and not on `strides`. During a graph
+		 * execution the CPU backend then only materializes the result if a
+		 * consumer needs it to be dense (see `StridedLayout`).
+		 */
+		virtual bool strided_view(const FGraphNode *node,
+								  std::vector<long> &strides, long &offset) {
+			return false;
+		}
 		/** Controls the number of elements that are depatched for the cpu
 		 * backend and the eager gpu backend (NOT the lazy gpu backend!). In
 		 * general you want this to be the size of the result node (s.d. for
@@ -443,5 +651,38 @@ struct OperationImplementation {
 				total *= node->operation.shape[d];
 			return total;
 		}
+		/**
+		 * Elementwise operations compute element `i` of their result only
+		 * from element `i` of each parameter (as long as the parameter has as
+		 * many elements as the result and is not inversely broadcasted) and
+		 * deploy one element per result entry. The CPU backend fuses connected
+		 * elementwise operations into one loop.
+		 */
+		virtual bool is_elementwise() { return false; }
+		/**
+		 * The CPU backend hands out uninitialized memory for results.
+		 * Operations that accumulate into their result (e.g. because several
+		 * deployed elements contribute to the same entry) have to return true
+		 * here, so the result is zero initialized before `execute_cpu` is
+		 * called.
+		 */
+		virtual bool accumulates_result() { return false; }
+		/**
+		 * Reductions of long dimensions to few elements are split into parts
+		 * along the reduced dimension, so the CPU backend can compute them in
+		 * parallel. Returns the number of parts per element of the result (1
+		 * if each element is computed at once). If there are more, the CPU
+		 * backend deploys `deploy_as_many_elements` times that many elements,
+		 * `execute_cpu` stores one part per deployed element into a buffer
+		 * and `combine_parts_cpu` combines them into the result.
+		 */
+		virtual size_t reduction_parts(const FGraphNode *node) { return 1; }
+		/**
+		 * Combines the `reduction_parts` parts of each element of the result
+		 * that were stored consecutively in `parts` into `result`.
+		 */
+		virtual void combine_parts_cpu(const FGraphNode *node,
+									   const void *__restrict__ parts,
+									   void *__restrict__ result) {}
 };
 #endif
@@ -28,6 +28,34 @@ FGraphNode *SliceImpl::local_gradient(FGraphNode *y, int dx_i,
 	return fextend_step(prev_adj, a->operation.shape, start.data(),
 						slice->step);
 }
+long SliceImpl::view_offset(const FGraphNode *node) {
+	const FOperation &pred = node->predecessors[0]->operation;
+	if (pred.op_type == FGEN_CONSTANT)
+		return -1;
+	const FSlice *slice = (FSlice *)node->operation.additional_data;
+	const std::vector<size_t> acc_sizes = calc_acc_sizes(node->operation);
+	const std::vector<size_t> acc_sizes_pred =
+		calc_acc_sizes(pred.dimensions, pred.shape);
+	// contiguous if consecutive elements of the result are consecutive in the
+	// parameter, dimensions with one element are not stepped through
+	long start = 0;
+	for (int d = 0; d < node->operation.dimensions; d++) {
+		if (node->operation.shape[d] != 1 &&
+			slice->step[d] * (long)acc_sizes_pred[d] != (long)acc_sizes[d])
+			return -1;
+		start += slice->start[d] * acc_sizes_pred[d];
+	}
+	return start;
+}
+bool SliceImpl::strided_view(const FGraphNode *node, std::vector<long> &strides,
+							 long &offset) {
+	const FSlice *slice = (FSlice *)node->operation.additional_data;
+	for (int d = 0; d < node->operation.dimensions; d++) {
+		offset += slice->start[d] * strides[d];
+		strides[d] *= slice->step[d];
+	}
+	return true;
+}
 template <typename T>
 void SliceImpl::unary_expression(T *__restrict__ result,
 								 const T *__restrict__ data, size_t from,
@@ -243,7 +271,7 @@ void ExtendImpl::unary_expression(T *__restrict__ result,
 		}
 		if (pred.op_type == FGEN_CONSTANT)
 			j = 0;
-		result[i] = set_zero ? 0 : data[j];
+		result[i] = set_zero ? (T)0 : data[j];
 	}
 }
 int ExtendImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
@@ -55,6 +55,9 @@ struct SliceImpl : OperationImplementation {
 		}
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		long view_offset(const FGraphNode *node) override;
+		bool strided_view(const FGraphNode *node, std::vector<long> &strides,
+						  long &offset) override;
 		void free_additional_data(FGraphNode *gn) override {
 			FSlice *s = (FSlice *)gn->operation.additional_data;
 			free(s->end);
@@ -0,0 +1,402 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "normalization.hpp"
+#include "../utils.hpp"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+using namespace std;
+
+// the axis of the channels and the epsilon of the variance
+static void batch_norm_data(const FGraphNode *node, int &ax,
+							double &epsilon) {
+	const double *data = (const double *)node->operation.additional_data;
+	ax = (int)data[0];
+	epsilon = data[1];
+}
+// number of channels along `ax` of `op`, the product of the dimensions after
+// it (the distance of two channels) and of the ones before it
+static void channel_sizes(const FOperation &op, int ax, size_t &outer,
+						  size_t &channels, size_t &inner) {
+	outer = inner = 1;
+	for (int d = 0; d < ax; d++)
+		outer *= op.shape[d];
+	channels = op.shape[ax];
+	for (int d = ax + 1; d < op.dimensions; d++)
+		inner *= op.shape[d];
+}
+// if one of the two entries of channel `c` of a `[2, channels]` result is in
+// `[from, from + size)`
+static inline bool channel_in_range(size_t c, size_t channels, size_t from,
+									size_t size) {
+	return (c >= from && c < from + size) ||
+		   (c + channels >= from && c + channels < from + size);
+}
+template <typename T>
+static void batch_moments(const T *__restrict__ a, T *__restrict__ result,
+						  size_t from, size_t size, size_t outer,
+						  size_t channels, size_t inner) {
+	const double n = outer * inner;
+	for (size_t c = 0; c < channels; c++) {
+		if (!channel_in_range(c, channels, from, size))
+			continue;
+		// shifted by the first value of the channel against cancellation
+		const double shift = (double)a[c * inner];
+		double s1 = 0, s2 = 0;
+		for (size_t o = 0; o < outer; o++) {
+			const T *__restrict__ in = a + (o * channels + c) * inner;
+			for (size_t i = 0; i < inner; i++) {
+				const double d = (double)in[i] - shift;
+				s1 += d;
+				s2 += d * d;
+			}
+		}
+		const double mean = s1 / n;
+		if (c >= from && c < from + size)
+			result[c] = shift + mean;
+		if (c + channels >= from && c + channels < from + size)
+			result[c + channels] = std::max(0.0, s2 / n - mean * mean);
+	}
+}
+template <typename T>
+static void batch_norm(const T *__restrict__ a, const T *__restrict__ moments,
+					   const T *__restrict__ gamma, const T *__restrict__ beta,
+					   T *__restrict__ result, size_t from, size_t size,
+					   size_t channels, size_t inner, double epsilon) {
+	using C = compute_type<T>;
+	// y = x * scale + shift per channel
+	vector<C> scale(channels), shift(channels);
+	for (size_t c = 0; c < channels; c++) {
+		scale[c] = (C)gamma[c] /
+				   (C)std::sqrt((double)moments[channels + c] + epsilon);
+		shift[c] = (C)beta[c] - (C)moments[c] * scale[c];
+	}
+	for (size_t index = from; index < from + size;) {
+		const size_t c = (index / inner) % channels;
+		const size_t end = std::min(from + size, (index / inner + 1) * inner);
+		for (; index < end; index++)
+			result[index] = (C)a[index] * scale[c] + shift[c];
+	}
+}
+template <typename T>
+static void gradient_sums(const T *__restrict__ adj, const T *__restrict__ a,
+						  const T *__restrict__ moments,
+						  T *__restrict__ result, size_t from, size_t size,
+						  size_t outer, size_t channels, size_t inner,
+						  double epsilon) {
+	for (size_t c = 0; c < channels; c++) {
+		if (!channel_in_range(c, channels, from, size))
+			continue;
+		const double mean = (double)moments[c];
+		double s = 0, sx = 0;
+		for (size_t o = 0; o < outer; o++) {
+			const size_t base = (o * channels + c) * inner;
+			for (size_t i = 0; i < inner; i++) {
+				const double g = (double)adj[base + i];
+				s += g;
+				sx += g * ((double)a[base + i] - mean);
+			}
+		}
+		if (c >= from && c < from + size)
+			result[c] = s;
+		if (c + channels >= from && c + channels < from + size)
+			result[c + channels] =
+				sx / std::sqrt((double)moments[channels + c] + epsilon);
+	}
+}
+template <typename T>
+static void gradient_batch_norm(const T *__restrict__ adj,
+								const T *__restrict__ a,
+								const T *__restrict__ moments,
+								const T *__restrict__ gamma,
+								const T *__restrict__ sums,
+								T *__restrict__ result, size_t from,
+								size_t size, size_t outer, size_t channels,
+								size_t inner, double epsilon) {
+	using C = compute_type<T>;
+	const double n = outer * inner;
+	// dx = k * adj + p * x + q per channel, with the statistics of the input
+	// k * (adj - (sum(adj) + x_norm * sum(adj * x_norm)) / n)
+	vector<C> k(channels), p(channels, 0), q(channels, 0);
+	for (size_t c = 0; c < channels; c++) {
+		const double inv_std =
+			1.0 / std::sqrt((double)moments[channels + c] + epsilon);
+		const double kc = (double)gamma[c] * inv_std;
+		k[c] = kc;
+		if (sums) {
+			const double pc = -kc * inv_std * (double)sums[channels + c] / n;
+			p[c] = pc;
+			q[c] = -kc * (double)sums[c] / n - pc * (double)moments[c];
+		}
+	}
+	for (size_t index = from; index < from + size;) {
+		const size_t c = (index / inner) % channels;
+		const size_t end = std::min(from + size, (index / inner + 1) * inner);
+		for (; index < end; index++)
+			result[index] = k[c] * (C)adj[index] + p[c] * (C)a[index] + q[c];
+	}
+}
+template <typename T>
+void BatchNormBaseImpl::execute_cpu_typed(
+	const FGraphNode *node, std::vector<CPUResultData> predecessor_data,
+	T *__restrict__ result, size_t from, size_t size) {
+	int ax;
+	double epsilon;
+	batch_norm_data(node, ax, epsilon);
+	size_t outer, channels, inner;
+	channel_sizes(normalized(node)->operation, ax, outer, channels, inner);
+	vector<const T *> par(predecessor_data.size());
+	for (size_t i = 0; i < par.size(); i++)
+		par[i] = (const T *)predecessor_data[i].data;
+	switch (node->operation.op_type) {
+	case FBATCH_MOMENTS:
+		batch_moments(par[0], result, from, size, outer, channels, inner);
+		break;
+	case FBATCH_NORM:
+		batch_norm(par[0], par[1], par[2], par[3], result, from, size,
+				   channels, inner, epsilon);
+		break;
+	case FGRADIENT_BATCH_NORM_SUMS:
+		gradient_sums(par[0], par[1], par[2], result, from, size, outer,
+					  channels, inner, epsilon);
+		break;
+	case FGRADIENT_BATCH_NORM:
+		gradient_batch_norm(par[0], par[1], par[2], par[3],
+							par.size() > 4 ? par[4] : nullptr, result, from,
+							size, outer, channels, inner, epsilon);
+		break;
+	default:
+		break;
+	}
+}
+void BatchNormBaseImpl::execute_cpu(const FGraphNode *node,
+									std::vector<CPUResultData> predecessor_data,
+									void *__restrict__ result, size_t from,
+									size_t size) {
+	EXECUTE_TYPED_IMPL
+}
+int BatchNormBaseImpl::generate_ocl_lazy(const FGraphNode *node,
+										 std::string name,
+										 OCLLazyCodegenState &compiler_state) {
+	const string type = type_string(node->operation.data_type);
+	vector<string> par(node->num_predecessor);
+	for (int i = 0; i < node->num_predecessor; i++)
+		par[i] = compiler_state.findOrInsertParameter(node->predecessors[i]);
+	int ax;
+	double epsilon;
+	batch_norm_data(node, ax, epsilon);
+	size_t outer, channels, inner;
+	channel_sizes(normalized(node)->operation, ax, outer, channels, inner);
+	std::ostringstream eps;
+	eps << std::setprecision(17) << epsilon;
+	compiler_state.code.prepend(
+		type + " " + name + " = 0;\n{\nconst long channels = " +
+		to_string(channels) + ", inner = " + to_string(inner) +
+		", outer = " + to_string(outer) + ";\nconst double epsilon = " +
+		eps.str() + ";\n" + kernel_code(type, par) + name + " = res;\n}\n");
+	return OCL_LAZY_DONT_PUSH_PREDS;
+}
+std::string BatchNormBaseImpl::generate_ocl_parameters_eager(
+	FType res_type, std::vector<FType> parameter_types) {
+	return OperationImplementation::generate_ocl_parameters_eager(
+			   res_type, parameter_types) +
+		   ", const long channels, const long inner, const long outer, const "
+		   "double epsilon";
+}
+std::string
+BatchNormBaseImpl::generate_ocl_eager(FType res_type,
+									  std::vector<FType> parameter_types) {
+	vector<string> par(parameter_types.size());
+	for (size_t i = 0; i < par.size(); i++)
+		par[i] = "P" + to_string(i);
+	return "if(index >= num_entriesR) return;\n" +
+		   kernel_code(type_string(res_type), par) + "R[index] = res;\n";
+}
+void BatchNormBaseImpl::push_additional_kernel_parameters(
+	FGraphNode *node, cl_kernel kernel, cl_context context, int &par_index,
+	std::list<cl_mem> &to_free) {
+	int ax;
+	double epsilon;
+	batch_norm_data(node, ax, epsilon);
+	size_t outer, channels, inner;
+	channel_sizes(normalized(node)->operation, ax, outer, channels, inner);
+	for (const size_t *val : {&channels, &inner, &outer})
+		if (clSetKernelArg(kernel, par_index++, sizeof(long), (void *)val) !=
+			CL_SUCCESS) {
+			setErrorType(OCL_ERROR);
+			flogging(F_ERROR, "Could not load Argument to kernel!");
+			return;
+		}
+	if (clSetKernelArg(kernel, par_index++, sizeof(double),
+					   (void *)&epsilon) != CL_SUCCESS) {
+		setErrorType(OCL_ERROR);
+		flogging(F_ERROR, "Could not load Argument to kernel!");
+	}
+}
+// OpenCL loop over the elements of channel `c` with their index in `j`
+static const string channel_loop =
+	"for(long o = 0; o < outer; o++)\n"
+	" for(long j = (o * channels + c) * inner; j < (o * channels + c + 1) * "
+	"inner; j++)";
+std::string BatchMomentsImpl::kernel_code(std::string type,
+										  std::vector<std::string> par) {
+	return "const long c = index % channels;\n"
+		   "const " +
+		   type + " shift = " + par[0] + "[c * inner];\n" + type +
+		   " s1 = 0, s2 = 0;\n" + channel_loop + "{\n  const " + type +
+		   " d = " + par[0] +
+		   "[j] - shift;\n"
+		   "  s1 += d;\n"
+		   "  s2 += d * d;\n"
+		   " }\n"
+		   "const " +
+		   type + " mean = s1 / (outer * inner);\n" + type +
+		   " res = index < channels ? shift + mean : max(s2 / (outer * inner) "
+		   "- mean * mean, (" +
+		   type + ")0);\n";
+}
+int BatchMomentsImpl::operation_score(FGraphNode *node) {
+	size_t outer, channels, inner;
+	channel_sizes(node->predecessors[0]->operation,
+				  (int)((double *)node->operation.additional_data)[0], outer,
+				  channels, inner);
+	return (int)std::min((size_t)1 << 20, 5 + outer * inner);
+}
+FGraphNode *BatchMomentsImpl::local_gradient(FGraphNode *y, int dx_i,
+											 FGraphNode *prev_adj) {
+	// the statistics are not tracked, `fbatch_norm` derives through them
+	return nullptr;
+}
+std::string BatchNormImpl::kernel_code(std::string type,
+									   std::vector<std::string> par) {
+	return "const long c = (index / inner) % channels;\n" + type +
+		   " res = (" + par[0] + "[index] - " + par[1] + "[c]) * rsqrt(" +
+		   par[1] + "[channels + c] + (" + type + ")epsilon) * " + par[2] +
+		   "[c] + " + par[3] + "[c];\n";
+}
+std::string GradientBatchNormSumsImpl::kernel_code(std::string type,
+												   std::vector<std::string> par) {
+	return "const long c = index % channels;\n" + type + " res = 0;\n" +
+		   "if(index < channels)\n " + channel_loop + " res += " + par[0] +
+		   "[j];\n"
+		   "else {\n " +
+		   channel_loop + " res += " + par[0] + "[j] * (" + par[1] + "[j] - " +
+		   par[2] + "[c]);\n res *= rsqrt(" + par[2] + "[channels + c] + (" +
+		   type + ")epsilon);\n}\n";
+}
+int GradientBatchNormSumsImpl::operation_score(FGraphNode *node) {
+	size_t outer, channels, inner;
+	channel_sizes(node->predecessors[1]->operation,
+				  (int)((double *)node->operation.additional_data)[0], outer,
+				  channels, inner);
+	return (int)std::min((size_t)1 << 20, 5 + outer * inner);
+}
+std::string GradientBatchNormImpl::kernel_code(std::string type,
+											   std::vector<std::string> par) {
+	string code = "const long c = (index / inner) % channels;\n"
+				  "const " +
+				  type + " inv_std = rsqrt(" + par[2] + "[channels + c] + (" +
+				  type + ")epsilon);\n" + type + " res = " + par[3] +
+				  "[c] * inv_std * ";
+	if (par.size() > 4)
+		return code + "(" + par[0] + "[index] - (" + par[4] + "[c] + (" +
+			   par[1] + "[index] - " + par[2] + "[c]) * inv_std * " + par[4] +
+			   "[channels + c]) / (outer * inner));\n";
+	return code + par[0] + "[index];\n";
+}
+// a gradient node of the batch normalization `y`
+static FGraphNode *gradient_node(const FGraphNode *y, FOperationType op_type,
+								 std::vector<FGraphNode *> pred,
+								 const FOperation &shape) {
+	FGraphNode *gradient = new FGraphNode();
+	gradient->num_predecessor = pred.size();
+	gradient->predecessors = safe_mal<FGraphNode *>(pred.size());
+	if (!gradient->predecessors)
+		return nullptr;
+	for (size_t i = 0; i < pred.size(); i++) {
+		if (!pred[i]->result_data && pred[i]->operation.op_type != FSTORE)
+			fExecuteGraph(pred[i]);
+		gradient->predecessors[i] = pred[i];
+		pred[i]->reference_counter++;
+	}
+	gradient->result_data = nullptr;
+	gradient->reference_counter = 0;
+	FOperation op;
+	op.broadcasting_mode = 0;
+	op.data_type = y->operation.data_type;
+	op.dimensions = shape.dimensions;
+	op.shape = safe_mal<size_t>(op.dimensions);
+	if (!op.shape)
+		return nullptr;
+	memcpy(op.shape, shape.shape, op.dimensions * sizeof(size_t));
+	op.op_type = op_type;
+	op.additional_data = safe_mal<double>(2);
+	if (!op.additional_data)
+		return nullptr;
+	memcpy(op.additional_data, y->operation.additional_data, 2 * sizeof(double));
+	gradient->operation = op;
+	OperationImplementation::configure_gradient_information(gradient, pred);
+	return gradient;
+}
+FGraphNode *BatchNormImpl::local_gradient(FGraphNode *y, int dx_i,
+										  FGraphNode *prev_adj) {
+	FGraphNode *a = y->predecessors[0], *moments = y->predecessors[1];
+	FGraphNode *gamma = y->predecessors[2];
+	if (prev_adj->operation.data_type != y->operation.data_type)
+		prev_adj = fconvert(prev_adj, y->operation.data_type);
+	// if the statistics are the ones of the input they have to be derived too
+	const bool batch_statistics = moments->operation.op_type == FBATCH_MOMENTS &&
+								  moments->predecessors[0] == a;
+	const size_t channels = moments->operation.shape[1];
+	// input with constant statistics
+	if (dx_i == 0 && !batch_statistics)
+		return gradient_node(y, FGRADIENT_BATCH_NORM,
+							 {prev_adj, a, moments, gamma}, y->operation);
+	FGraphNode *sums =
+		gradient_node(y, FGRADIENT_BATCH_NORM_SUMS, {prev_adj, a, moments},
+					  moments->operation);
+	if (!sums)
+		return nullptr;
+	switch (dx_i) {
+	case 0:
+		return gradient_node(y, FGRADIENT_BATCH_NORM,
+							 {prev_adj, a, moments, gamma, sums}, y->operation);
+	case 1: {
+		// d/dmean = -gamma * inv_std * sum(adj),
+		// d/dvar = -gamma * inv_std^2 * sum(adj * x_norm) / 2
+		const long mean_start[] = {0, 0}, mean_end[] = {1, (long)channels};
+		const long var_start[] = {1, 0}, var_end[] = {2, (long)channels};
+		const size_t row[] = {1, channels};
+		const double epsilon = ((double *)y->operation.additional_data)[1];
+		FGraphNode *inv_std = fdiv_icd(
+			1.0, fsqrt_g(fadd_cd(fslice(moments, var_start, var_end), epsilon)));
+		FGraphNode *k = fmul(fneg(freshape(gamma, row, 2)), inv_std);
+		return fconcat(fmul(k, fslice(sums, mean_start, mean_end)),
+					   fmul(fmul_cd(fmul(k, inv_std), 0.5),
+							fslice(sums, var_start, var_end)),
+					   0);
+	}
+	case 2:
+	case 3: {
+		// gamma gets the sums of the adjoint times the normalized input, beta
+		// the ones of the adjoint
+		const long start[] = {dx_i == 2 ? 1 : 0, 0};
+		const long end[] = {dx_i == 2 ? 2 : 1, (long)channels};
+		FGraphNode *parameter = y->predecessors[dx_i];
+		return freshape(fslice(sums, start, end), parameter->operation.shape,
+						parameter->operation.dimensions);
+	}
+	}
+	return nullptr;
+}
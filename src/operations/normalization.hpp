@@ -0,0 +1,123 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_NORMALIZATION_HPP
+#define FLINT_NORMALIZATION_HPP
+#include "implementation.hpp"
+
+/**
+ * Shared parts of the batch normalization operations. Every one of them works
+ * on the channels along one axis of a tensor (the "normalized" tensor, i.e.
+ * the input of the normalization or of its statistics) and stores that axis
+ * and the epsilon added to the variance as two doubles in its additional
+ * data. The statistics (see `fbatch_moments`) are a `[2, channels]` tensor
+ * with the mean in the first and the variance in the second row.
+ */
+struct BatchNormBaseImpl : OperationImplementation {
+		/** The tensor whose channels are normalized */
+		virtual const FGraphNode *normalized(const FGraphNode *node) = 0;
+		/** OpenCL code that computes the entry `index` in a variable `res`,
+		 * `par` are the names of the parameters and `channels`, `inner`,
+		 * `outer` and `epsilon` are defined */
+		virtual std::string kernel_code(std::string type,
+										std::vector<std::string> par) = 0;
+		template <typename T>
+		void execute_cpu_typed(const FGraphNode *node,
+							   std::vector<CPUResultData> predecessor_data,
+							   T *__restrict__ result, size_t from,
+							   size_t size);
+		void execute_cpu(const FGraphNode *node,
+						 std::vector<CPUResultData> predecessor_data,
+						 void *__restrict__ result, size_t from,
+						 size_t size) override;
+		int generate_ocl_lazy(const FGraphNode *node, std::string name,
+							  OCLLazyCodegenState &compiler_state) override;
+		std::string
+		generate_ocl_eager(FType res_type,
+						   std::vector<FType> parameter_types) override;
+		std::string generate_ocl_parameters_eager(
+			FType res_type, std::vector<FType> parameter_types) override;
+		void
+		push_additional_kernel_parameters(FGraphNode *node, cl_kernel kernel,
+										  cl_context context, int &par_index,
+										  std::list<cl_mem> &to_free) override;
+		void free_additional_data(FGraphNode *gn) override {
+			free(gn->operation.additional_data);
+		}
+		std::vector<std::vector<FType>>
+		kernel_type_combinations(const FGraphNode *node) override {
+			return {std::vector<FType>(node->num_predecessor + 1, F_FLOAT32),
+					std::vector<FType>(node->num_predecessor + 1, F_FLOAT64)};
+		}
+};
+/**
+ * Mean and variance per channel of its predecessor in a single pass.
+ */
+struct BatchMomentsImpl : BatchNormBaseImpl {
+		const FGraphNode *normalized(const FGraphNode *node) override {
+			return node->predecessors[0];
+		}
+		std::string kernel_code(std::string type,
+								std::vector<std::string> par) override;
+		int operation_score(FGraphNode *node) override;
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override;
+};
+/**
+ * Normalizes the first predecessor with the statistics in the second one,
+ * scales it by the third one (gamma) and shifts it by the fourth one (beta).
+ */
+struct BatchNormImpl : BatchNormBaseImpl {
+		const FGraphNode *normalized(const FGraphNode *node) override {
+			return node;
+		}
+		std::string kernel_code(std::string type,
+								std::vector<std::string> par) override;
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override;
+};
+/**
+ * Sums of the adjoint (the gradient of beta) and of the adjoint times the
+ * normalized input (the gradient of gamma) per channel, the parameters are the
+ * adjoint, the input and its statistics.
+ */
+struct GradientBatchNormSumsImpl : BatchNormBaseImpl {
+		const FGraphNode *normalized(const FGraphNode *node) override {
+			return node->predecessors[1];
+		}
+		std::string kernel_code(std::string type,
+								std::vector<std::string> par) override;
+		int operation_score(FGraphNode *node) override;
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override {
+			return nullptr;
+		}
+};
+/**
+ * Gradient of a batch normalization for its input, the parameters are the
+ * adjoint, the input, its statistics, gamma and, if the statistics are the
+ * ones of the input, the sums of `GradientBatchNormSumsImpl` (else the
+ * statistics are constant).
+ */
+struct GradientBatchNormImpl : BatchNormBaseImpl {
+		const FGraphNode *normalized(const FGraphNode *node) override {
+			return node;
+		}
+		std::string kernel_code(std::string type,
+								std::vector<std::string> par) override;
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override {
+			return nullptr;
+		}
+};
+#endif
@@ -483,6 +483,35 @@ void GradientPoolingMax::execute_cpu_typed(
 							a + std::numeric_limits<double>::epsilon() >= b &&
 							a - std::numeric_limits<double>::epsilon() <= b;
 					} break;
+					case F_FLOAT16: {
+						const float a =
+							((const Float16 *__restrict__)data3)[cd3 ? 0 : i];
+						const float b = ((const Float16 *__restrict__)
+											 data1)[cd1 ? 0 : adjo + adji];
+						const float e = std::numeric_limits<Float16>::epsilon();
+						equal = a + e >= b && a - e <= b;
+					} break;
+					case F_BFLOAT16: {
+						const float a =
+							((const BFloat16 *__restrict__)data3)[cd3 ? 0 : i];
+						const float b = ((const BFloat16 *__restrict__)
+											 data1)[cd1 ? 0 : adjo + adji];
+						const float e =
+							std::numeric_limits<BFloat16>::epsilon();
+						equal = a + e >= b && a - e <= b;
+					} break;
+					case F_INT8:
+						equal =
+							((const int8_t *__restrict__)data3)[cd3 ? 0 : i] ==
+							((const int8_t *__restrict__)
+								 data1)[cd1 ? 0 : adjo + adji];
+						break;
+					case F_UINT8:
+						equal =
+							((const uint8_t *__restrict__)data3)[cd3 ? 0 : i] ==
+							((const uint8_t *__restrict__)
+								 data1)[cd1 ? 0 : adjo + adji];
+						break;
 					}
 					if (equal) {
 						res += ((
@@ -0,0 +1,255 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "quantization.hpp"
+#include "../utils.hpp"
+#include <cmath>
+#include <limits>
+using namespace std;
+
+/**
+ * Computes `result[i] = op(a[i], scale[s], zero_point[z])` for `i` in
+ * `[from, from + size)`, where `s` and `z` are the broadcasted indices of the
+ * quantization parameters.
+ */
+template <typename T, typename A, typename Op>
+static void quantization_loop(const FGraphNode *node,
+							  const std::vector<CPUResultData> &predecessor_data,
+							  T *__restrict__ result, size_t from, size_t size,
+							  Op op) {
+	const A *__restrict__ a = (const A *)predecessor_data[0].data;
+	const float *__restrict__ scale = (const float *)predecessor_data[1].data;
+	const int *__restrict__ zero_point = (const int *)predecessor_data[2].data;
+	size_t iv, iv_scale, iv_zero;
+	calculate_divisor_for_inverse_broadcasting(
+		node->predecessors[0], iv, node->predecessors[1], iv_scale);
+	calculate_divisor_for_inverse_broadcasting(
+		node->predecessors[0], iv, node->predecessors[2], iv_zero);
+	BroadcastCursor cs(from, predecessor_data[1].num_entries, iv_scale);
+	BroadcastCursor cz(from, predecessor_data[2].num_entries, iv_zero);
+	const size_t end = from + size;
+	for (size_t i = from; i < end;) {
+		const size_t n = std::min({end - i, cs.remaining, cz.remaining});
+		const size_t ds = cs.constant ? 0 : 1, dz = cz.constant ? 0 : 1;
+		for (size_t k = 0; k < n; k++)
+			result[i + k] = op(a[i + k], scale[cs.index + k * ds],
+							   zero_point[cz.index + k * dz]);
+		i += n;
+		cs.advance(n);
+		cz.advance(n);
+	}
+}
+template <typename T, typename A>
+static void quantize(const FGraphNode *node,
+					 const std::vector<CPUResultData> &predecessor_data,
+					 T *__restrict__ result, size_t from, size_t size) {
+	quantization_loop<T, A>(
+		node, predecessor_data, result, from, size,
+		[](A a, float scale, int zero_point) {
+			// rounds to the nearest even integer, NaN has no integer
+			// representation and becomes the zero point
+			float q = std::nearbyint(static_cast<float>(a) / scale);
+			q = std::isnan(q) ? (float)zero_point : q + (float)zero_point;
+			return (T)std::min(
+				std::max(q, (float)numeric_limits<T>::min()),
+				(float)numeric_limits<T>::max());
+		});
+}
+template <typename T>
+static void quantize_typed(const FGraphNode *node,
+						   const std::vector<CPUResultData> &predecessor_data,
+						   T *__restrict__ result, size_t from, size_t size) {
+	switch (predecessor_data[0].type) {
+	case F_INT32:
+		quantize<T, int>(node, predecessor_data, result, from, size);
+		break;
+	case F_INT64:
+		quantize<T, long>(node, predecessor_data, result, from, size);
+		break;
+	case F_FLOAT32:
+		quantize<T, float>(node, predecessor_data, result, from, size);
+		break;
+	case F_FLOAT64:
+		quantize<T, double>(node, predecessor_data, result, from, size);
+		break;
+	case F_FLOAT16:
+		quantize<T, Float16>(node, predecessor_data, result, from, size);
+		break;
+	case F_BFLOAT16:
+		quantize<T, BFloat16>(node, predecessor_data, result, from, size);
+		break;
+	case F_INT8:
+		quantize<T, int8_t>(node, predecessor_data, result, from, size);
+		break;
+	case F_UINT8:
+		quantize<T, uint8_t>(node, predecessor_data, result, from, size);
+		break;
+	}
+}
+void QuantizeImpl::execute_cpu(const FGraphNode *node,
+							   std::vector<CPUResultData> predecessor_data,
+							   void *__restrict__ result, size_t from,
+							   size_t size) {
+	if (node->operation.data_type == F_INT8)
+		quantize_typed(node, predecessor_data, (int8_t *)result, from, size);
+	else
+		quantize_typed(node, predecessor_data, (uint8_t *)result, from, size);
+}
+template <typename A>
+static void dequantize(const FGraphNode *node,
+					   const std::vector<CPUResultData> &predecessor_data,
+					   float *__restrict__ result, size_t from, size_t size) {
+	quantization_loop<float, A>(node, predecessor_data, result, from, size,
+								[](A a, float scale, int zero_point) {
+									return (float)(a - zero_point) * scale;
+								});
+}
+void DequantizeImpl::execute_cpu(const FGraphNode *node,
+								 std::vector<CPUResultData> predecessor_data,
+								 void *__restrict__ result, size_t from,
+								 size_t size) {
+	switch (predecessor_data[0].type) {
+	case F_INT8:
+		dequantize<int8_t>(node, predecessor_data, (float *)result, from, size);
+		break;
+	case F_UINT8:
+		dequantize<uint8_t>(node, predecessor_data, (float *)result, from,
+							size);
+		break;
+	case F_INT32:
+		dequantize<int>(node, predecessor_data, (float *)result, from, size);
+		break;
+	case F_INT64:
+		dequantize<long>(node, predecessor_data, (float *)result, from, size);
+		break;
+	default:
+		break;
+	}
+}
+int QuantizationImpl::generate_ocl_lazy(const FGraphNode *node,
+										std::string name,
+										OCLLazyCodegenState &compiler_state) {
+	const string type = type_string(node->operation.data_type);
+	const unsigned int var = compiler_state.variable_index;
+	compiler_state.code.prepend(
+		"const " + type + " " + name + " = " +
+		lazy_expression(node, "v" + to_string(var + 1), "v" + to_string(var + 2),
+						"v" + to_string(var + 3)) +
+		";\n");
+	size_t iv, iv_scale, iv_zero;
+	calculate_divisor_for_inverse_broadcasting(
+		node->predecessors[0], iv, node->predecessors[1], iv_scale);
+	calculate_divisor_for_inverse_broadcasting(
+		node->predecessors[0], iv, node->predecessors[2], iv_zero);
+	if (iv_scale == 1 && iv_zero == 1)
+		return 0;
+	// the parameters are inversely broadcasted, divide the index for them
+	const string old_idx = "old_idx" + to_string(compiler_state.num_indices++);
+	compiler_state.code.prepend("index = " + old_idx + ";\n");
+	list<tuple<FGraphNode *, string>> &todo = compiler_state.todo;
+	todo.push_front({nullptr, "long " + old_idx + " = index;\n"});
+	todo.push_front({node->predecessors[0], "v" + to_string(var + 1)});
+	todo.push_front({nullptr, "index = " + old_idx + " / " +
+								  to_string(iv_scale) + ";\n"});
+	todo.push_front({node->predecessors[1], "v" + to_string(var + 2)});
+	todo.push_front({nullptr, "index = " + old_idx + " / " +
+								  to_string(iv_zero) + ";\n"});
+	todo.push_front({node->predecessors[2], "v" + to_string(var + 3)});
+	compiler_state.variable_index += 3;
+	return OCL_LAZY_DONT_PUSH_PREDS;
+}
+std::string QuantizationImpl::generate_ocl_parameters_eager(
+	FType res_type, std::vector<FType> parameter_types) {
+	return OperationImplementation::generate_ocl_parameters_eager(
+			   res_type, parameter_types) +
+		   ", long inv_broad1, long inv_broad2";
+}
+void QuantizationImpl::push_additional_kernel_parameters(
+	FGraphNode *node, cl_kernel kernel, cl_context context, int &par_index,
+	std::list<cl_mem> &to_free) {
+	size_t iv, inv_broad[2];
+	for (int i = 0; i < 2; i++) {
+		calculate_divisor_for_inverse_broadcasting(
+			node->predecessors[0], iv, node->predecessors[i + 1], inv_broad[i]);
+		if (clSetKernelArg(kernel, par_index++, sizeof(long),
+						   (void *)&inv_broad[i]) != CL_SUCCESS) {
+			setErrorType(OCL_ERROR);
+			flogging(F_ERROR, "Could not load Argument to kernel!");
+			return;
+		}
+	}
+}
+FGraphNode *QuantizeImpl::local_gradient(FGraphNode *y, int dx_i,
+										 FGraphNode *prev_adj) {
+	// straight through estimator, i.e. the rounding is ignored
+	return dx_i == 0 ? fdiv(prev_adj, y->predecessors[1]) : nullptr;
+}
+std::string QuantizeImpl::lazy_expression(const FGraphNode *node,
+										  std::string a, std::string scale,
+										  std::string zero_point) {
+	const bool is_signed = node->operation.data_type == F_INT8;
+	const std::string q = "rint((float)" + a + " / " + scale + ")";
+	return "(int)min(max(isnan(" + q + ") ? (float)" + zero_point + " : " +
+		   q + " + " + zero_point + ", " + (is_signed ? "-128.0f" : "0.0f") +
+		   "), " + (is_signed ? "127.0f" : "255.0f") + ")";
+}
+std::string QuantizeImpl::generate_ocl_parameters_eager(
+	FType res_type, std::vector<FType> parameter_types) {
+	// int8 and uint8 share the kernel, the range is a parameter
+	return QuantizationImpl::generate_ocl_parameters_eager(res_type,
+														   parameter_types) +
+		   ", int quant_min, int quant_max";
+}
+std::string
+QuantizeImpl::generate_ocl_eager(FType res_type,
+								 std::vector<FType> parameter_types) {
+	return "if(index >= num_entriesR) return;\n"
+		   "const float q = rint((float)P0[index%num_entries0] / "
+		   "P1[(index/inv_broad1)%num_entries1]);\n"
+		   "const int zero_point = P2[(index/inv_broad2)%num_entries2];\n"
+		   "R[index] = (int)clamp(isnan(q) ? (float)zero_point : q + "
+		   "zero_point, (float)quant_min, (float)quant_max);";
+}
+void QuantizeImpl::push_additional_kernel_parameters(
+	FGraphNode *node, cl_kernel kernel, cl_context context, int &par_index,
+	std::list<cl_mem> &to_free) {
+	QuantizationImpl::push_additional_kernel_parameters(node, kernel, context,
+														par_index, to_free);
+	const bool is_signed = node->operation.data_type == F_INT8;
+	const int range[2] = {is_signed ? -128 : 0, is_signed ? 127 : 255};
+	for (int i = 0; i < 2; i++) {
+		if (clSetKernelArg(kernel, par_index++, sizeof(int),
+						   (void *)&range[i]) != CL_SUCCESS) {
+			setErrorType(OCL_ERROR);
+			flogging(F_ERROR, "Could not load Argument to kernel!");
+			return;
+		}
+	}
+}
+FGraphNode *DequantizeImpl::local_gradient(FGraphNode *y, int dx_i,
+										   FGraphNode *prev_adj) {
+	return dx_i == 0 ? fmul(prev_adj, y->predecessors[1]) : nullptr;
+}
+std::string DequantizeImpl::lazy_expression(const FGraphNode *node,
+											std::string a, std::string scale,
+											std::string zero_point) {
+	return "(" + a + " - " + zero_point + ") * " + scale;
+}
+std::string
+DequantizeImpl::generate_ocl_eager(FType res_type,
+								   std::vector<FType> parameter_types) {
+	return "if(index >= num_entriesR) return;\n"
+		   "R[index] = (P0[index%num_entries0] - "
+		   "P2[(index/inv_broad2)%num_entries2]) * "
+		   "P1[(index/inv_broad1)%num_entries1];";
+}
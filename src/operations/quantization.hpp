@@ -0,0 +1,85 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_QUANTIZATION_HPP
+#define FLINT_QUANTIZATION_HPP
+#include "implementation.hpp"
+
+/**
+ * Shared parts of `QuantizeImpl` and `DequantizeImpl`, i.e. elementwise
+ * operations on a tensor and its (broadcasted) scale and zero point.
+ */
+struct QuantizationImpl : OperationImplementation {
+		/** Code of the operation for the lazy backend on the values `a`,
+		 * `scale` and `zero_point`, (e.g. `"(v1 - v3) * v2"`) */
+		virtual std::string lazy_expression(const FGraphNode *node,
+											std::string a, std::string scale,
+											std::string zero_point) = 0;
+		int generate_ocl_lazy(const FGraphNode *node, std::string name,
+							  OCLLazyCodegenState &compiler_state) override;
+		std::string generate_ocl_parameters_eager(
+			FType res_type, std::vector<FType> parameter_types) override;
+		void
+		push_additional_kernel_parameters(FGraphNode *node, cl_kernel kernel,
+										  cl_context context, int &par_index,
+										  std::list<cl_mem> &to_free) override;
+		bool is_elementwise() override { return true; }
+};
+struct QuantizeImpl : QuantizationImpl {
+		void execute_cpu(const FGraphNode *node,
+						 std::vector<CPUResultData> predecessor_data,
+						 void *__restrict__ result, size_t from,
+						 size_t size) override;
+		std::string lazy_expression(const FGraphNode *node, std::string a,
+									std::string scale,
+									std::string zero_point) override;
+		std::string
+		generate_ocl_eager(FType res_type,
+						   std::vector<FType> parameter_types) override;
+		std::string generate_ocl_parameters_eager(
+			FType res_type, std::vector<FType> parameter_types) override;
+		void
+		push_additional_kernel_parameters(FGraphNode *node, cl_kernel kernel,
+										  cl_context context, int &par_index,
+										  std::list<cl_mem> &to_free) override;
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override;
+		std::vector<std::vector<FType>>
+		kernel_type_combinations(const FGraphNode *node) override {
+			// the 8bit types are int on the gpu
+			return {{F_INT32, F_INT32, F_FLOAT32, F_INT32},
+					{F_INT32, F_INT64, F_FLOAT32, F_INT32},
+					{F_INT32, F_FLOAT32, F_FLOAT32, F_INT32},
+					{F_INT32, F_FLOAT64, F_FLOAT32, F_INT32}};
+		}
+};
+struct DequantizeImpl : QuantizationImpl {
+		void execute_cpu(const FGraphNode *node,
+						 std::vector<CPUResultData> predecessor_data,
+						 void *__restrict__ result, size_t from,
+						 size_t size) override;
+		std::string lazy_expression(const FGraphNode *node, std::string a,
+									std::string scale,
+									std::string zero_point) override;
+		std::string
+		generate_ocl_eager(FType res_type,
+						   std::vector<FType> parameter_types) override;
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override;
+		std::vector<std::vector<FType>>
+		kernel_type_combinations(const FGraphNode *node) override {
+			return {{F_FLOAT32, F_INT32, F_FLOAT32, F_INT32},
+					{F_FLOAT32, F_INT64, F_FLOAT32, F_INT32}};
+		}
+};
+#endif
@@ -14,6 +14,7 @@
 #include "reductions.hpp"
 #include "../utils.hpp"
 #include "flint.h"
+#include <algorithm>
 #include <limits>
 
 #define MIN_VAL(x, y) (x < y ? x : y)
@@ -21,6 +22,39 @@
 
 using namespace std;
 
+/**
+ * Reductions reduce the dimensions `[first, last]` of their predecessor (one
+ * dimension for `freduce_sum` and co., a range for `freduce_sum_axes` and
+ * co.), which behave like a single dimension with `len` elements that are
+ * `it_dim` elements apart.
+ */
+static void reduced_range(const FGraphNode *node, size_t &len,
+						  size_t &it_dim) {
+	const FOperation pred = node->predecessors[0]->operation;
+	const int *range = (const int *)node->operation.additional_data;
+	len = 1;
+	for (int d = range[0]; d <= range[1]; d++)
+		len *= pred.shape[d];
+	it_dim = 1;
+	for (int d = range[1] + 1; d < pred.dimensions; d++)
+		it_dim *= pred.shape[d];
+}
+/**
+ * Repeats `t` (shaped like the result of the reduction `y`) along the reduced
+ * dimensions to the shape of the predecessor of `y`.
+ */
+static FGraphNode *broadcast_reduced(const FGraphNode *y, FGraphNode *t) {
+	const FOperation pred = y->predecessors[0]->operation;
+	const int *range = (const int *)y->operation.additional_data;
+	std::vector<int> rep(pred.dimensions);
+	std::vector<size_t> ns(pred.dimensions);
+	for (int i = 0; i < pred.dimensions; i++) {
+		const bool reduced = i >= range[0] && i <= range[1];
+		rep[i] = reduced ? pred.shape[i] - 1 : 0;
+		ns[i] = reduced ? 1 : pred.shape[i];
+	}
+	return frepeat(freshape(t, ns.data(), ns.size()), rep.data());
+}
 template <FOperationType op_type>
 static inline int reducing(const FGraphNode *node, std::string name,
 						   OCLLazyCodegenState &compiler_state) {
@@ -29,10 +63,8 @@ static inline int reducing(const FGraphNode *node, std::string name,
 	// predecessors
 	const string par1 = "v" + std::to_string(compiler_state.variable_index + 1);
 	const string type = type_string(node->operation.data_type);
-	const int red_dim = ((int *)node->operation.additional_data)[0];
-	size_t it_dim = 1; // iteration size <=> product of all dimensions along dim
-	for (size_t d = red_dim + 1; d < prev->operation.dimensions; d++)
-		it_dim *= prev->operation.shape[d];
+	size_t len, it_dim; // it_dim <=> product of all dimensions along dim
+	reduced_range(node, len, it_dim);
 	Twine index_defs;
 	index_defs += type + " " + name + " = ";
 	size_t total_el_size = 1;
@@ -61,13 +93,13 @@ static inline int reducing(const FGraphNode *node, std::string name,
 				  " = index;\n"
 				  "for(long " +
 				  itv + " = 0; " + itv + " < " +
-				  to_string(prev->operation.shape[red_dim]) + "; " + itv +
+				  to_string(len) + "; " + itv +
 				  "++){\n"
 				  "index = ((old_idx" +
 				  to_string(old_idx) + " / " + to_string(it_dim) + ") * " +
 
 				  to_string(it_dim) + " * " +
-				  to_string(prev->operation.shape[red_dim]) + " + (old_idx" +
+				  to_string(len) + " + (old_idx" +
 				  to_string(old_idx) + " % " + to_string(it_dim) + ") + " +
 				  itv + " * " + to_string(it_dim) + ") % " +
 				  to_string(total_el_size) + ";\n";
@@ -175,12 +207,11 @@ static void reducing_push_parameters(FGraphNode *node, cl_kernel kernel,
 static void reducing_push_per_parameter(FGraphNode *node, cl_kernel kernel,
 										cl_context context, int &par_index,
 										std::list<cl_mem> &to_free) {
-	const int dim = ((int *)node->operation.additional_data)[0];
 	const FOperation pred = node->predecessors[0]->operation;
-	long it_dim = 1; // iteration size <=> product of all dimensions along dim
-	for (size_t d = dim + 1; d < pred.dimensions; d++)
-		it_dim *= pred.shape[d];
-	const long shape_dim = pred.shape[dim];
+	size_t len, it;
+	reduced_range(node, len, it);
+	// iteration size <=> product of all dimensions along the reduced ones
+	const long it_dim = it, shape_dim = len;
 	if (clSetKernelArg(kernel, par_index++, sizeof(int),
 					   (void *)&pred.dimensions) != CL_SUCCESS) {
 		setErrorType(OCL_ERROR);
@@ -205,44 +236,172 @@ static std::vector<bool> reducing_reuse_params(const FGraphNode *node) {
 	return {false};
 	// return {node->predecessors[0]->operation.shape[ax] == 1};
 }
+// reductions to less results are split along the reduced dimension
+#define REDUCTION_FEW_OUTPUTS 256
+// minimal number of reduced elements per part
+#define REDUCTION_PART_SIZE 16384
+#define REDUCTION_MAX_PARTS 256
+// elements that are summed sequentially by `pairwise_sum`
+#define PAIRWISE_BLOCK 128
+/**
+ * Number of parts each result of a reduction is split into. Depends only on
+ * the shapes, so the result is the same for any number of threads.
+ */
+static size_t reduction_parts_of(const FGraphNode *node) {
+	const FOperation pred = node->predecessors[0]->operation;
+	if (pred.op_type == FGEN_CONSTANT)
+		return 1;
+	size_t len, it_dim;
+	reduced_range(node, len, it_dim);
+	size_t outputs = 1;
+	for (int d = 0; d < node->operation.dimensions; d++)
+		outputs *= node->operation.shape[d];
+	if (outputs >= REDUCTION_FEW_OUTPUTS)
+		return 1;
+	const size_t parts =
+		(len + REDUCTION_PART_SIZE - 1) / REDUCTION_PART_SIZE;
+	return std::max((size_t)1, std::min((size_t)REDUCTION_MAX_PARTS, parts));
+}
+/**
+ * Sum of `count` elements with distance `stride` by pairwise summation, the
+ * rounding error grows with the logarithm of `count` instead of linearly.
+ */
+template <typename T>
+static T pairwise_sum(const T *__restrict__ data, size_t stride,
+					  size_t count) {
+	if (count <= PAIRWISE_BLOCK) {
+		T res = 0;
+		for (size_t j = 0; j < count; j++)
+			res += data[j * stride];
+		return res;
+	}
+	const size_t half = count / 2;
+	return pairwise_sum(data, stride, half) +
+		   pairwise_sum(data + half * stride, stride, count - half);
+}
+template <FOperationType op, typename T> static constexpr T neutral_element() {
+	switch (op) {
+	case FREDUCE_MUL:
+		return 1;
+	case FREDUCE_MIN:
+		return std::numeric_limits<T>::max();
+	case FREDUCE_MAX:
+		return std::numeric_limits<T>::lowest();
+	default:
+		return 0;
+	}
+}
+template <FOperationType op, typename T>
+static T reduce_strided(const T *__restrict__ data, size_t stride,
+						size_t count) {
+	if (op == FREDUCE_SUM)
+		return pairwise_sum(data, stride, count);
+	T res = neutral_element<op, T>();
+	for (size_t j = 0; j < count; j++) {
+		const T curr = data[j * stride];
+		switch (op) {
+		case FREDUCE_MUL:
+			res *= curr;
+			break;
+		case FREDUCE_MIN:
+			res = MIN_VAL(res, curr);
+			break;
+		case FREDUCE_MAX:
+			res = MAX_VAL(res, curr);
+			break;
+		default:
+			break;
+		}
+	}
+	return res;
+}
+/**
+ * Computes the elements `[from, from + size)` of the reduction, or of its
+ * parts if it is split (see `reduction_parts_of`). Element `k` is then part
+ * `k % parts` of the result `k / parts`.
+ */
+template <FOperationType op, typename T>
+static void reduce(T *__restrict__ result, const T *__restrict__ data,
+				   size_t from, size_t size, const FGraphNode *curr) {
+	const FOperation pred = curr->predecessors[0]->operation;
+	size_t len, it_dim; // it_dim <=> product of all dimensions along dim
+	reduced_range(curr, len, it_dim);
+	const size_t parts = reduction_parts_of(curr);
+	const size_t part_len = (len + parts - 1) / parts;
+	// constants only store a single element
+	const bool constant = pred.op_type == FGEN_CONSTANT;
+	for (size_t k = from; k < from + size; k++) {
+		const size_t i = k / parts, p = k % parts;
+		const size_t start = std::min(len, p * part_len),
+					 end = std::min(len, start + part_len);
+		const size_t base =
+			(i / it_dim) * it_dim * len + i % it_dim + start * it_dim;
+		result[k] = reduce_strided<op>(constant ? data : data + base,
+									   constant ? 0 : it_dim, end - start);
+	}
+}
+/** Combines the parts of a split reduction in a fixed order */
+template <FOperationType op, typename T>
+static void combine_parts(const FGraphNode *node, const T *__restrict__ parts,
+						  T *__restrict__ result) {
+	const size_t num_parts = reduction_parts_of(node);
+	size_t outputs = 1;
+	for (int d = 0; d < node->operation.dimensions; d++)
+		outputs *= node->operation.shape[d];
+	for (size_t i = 0; i < outputs; i++)
+		result[i] = reduce_strided<op>(parts + i * num_parts, 1, num_parts);
+}
+template <FOperationType op>
+static void combine_parts_typed(const FGraphNode *node, const void *parts,
+								void *result) {
+	switch (node->operation.data_type) {
+	case F_INT32:
+		combine_parts<op>(node, (const int *)parts, (int *)result);
+		break;
+	case F_INT64:
+		combine_parts<op>(node, (const long *)parts, (long *)result);
+		break;
+	case F_FLOAT32:
+		combine_parts<op>(node, (const float *)parts, (float *)result);
+		break;
+	case F_FLOAT64:
+		combine_parts<op>(node, (const double *)parts, (double *)result);
+		break;
+	case F_FLOAT16:
+		combine_parts<op>(node, (const Float16 *)parts, (Float16 *)result);
+		break;
+	case F_BFLOAT16:
+		combine_parts<op>(node, (const BFloat16 *)parts, (BFloat16 *)result);
+		break;
+	case F_INT8:
+		combine_parts<op>(node, (const int8_t *)parts, (int8_t *)result);
+		break;
+	case F_UINT8:
+		combine_parts<op>(node, (const uint8_t *)parts, (uint8_t *)result);
+		break;
+	}
+}
+/**
+ * Score of a reduction for the decision whether it is executed in parallel,
+ * grows with the number of reduced elements per result.
+ */
+static int reduction_score(const FGraphNode *node) {
+	size_t len, it_dim;
+	reduced_range(node, len, it_dim);
+	return (int)std::min((size_t)1 << 20, 5 + len / reduction_parts_of(node));
+}
 FGraphNode *ReduceSumImpl::local_gradient(FGraphNode *y, int dx_i,
 										  FGraphNode *prev_adj) {
-	FGraphNode *a = y->predecessors[0];
-	if (0 == dx_i) {
-		const FOperation op = y->operation;
-		const int dim = ((int *)op.additional_data)[0];
-		std::vector<int> rep(a->operation.dimensions);
-		std::vector<size_t> ns(a->operation.dimensions);
-		for (int i = 0; i < rep.size(); i++) {
-			rep[i] = i == dim ? a->operation.shape[i] - 1 : 0;
-			ns[i] = i != dim ? a->operation.shape[i] : 1;
-		}
-		return frepeat(freshape(prev_adj, ns.data(), ns.size()), rep.data());
-	} else
+	if (0 == dx_i)
+		return broadcast_reduced(y, prev_adj);
+	else
 		return nullptr;
 }
 template <typename T>
 void ReduceSumImpl::unary_expression(T *__restrict__ result,
 									 const T *__restrict__ data, size_t from,
 									 size_t size, const FGraphNode *curr) {
-	const FOperation pred = curr->predecessors[0]->operation;
-	const int dim = ((int *)curr->operation.additional_data)[0];
-	size_t it_dim = 1; // iteration size <=> product of all dimensions along dim
-	for (size_t d = dim + 1; d < pred.dimensions; d++)
-		it_dim *= pred.shape[d];
-	size_t total_size = 1;
-	if (pred.op_type != FGEN_CONSTANT)
-		for (size_t d = 0; d < pred.dimensions; d++)
-			total_size *= pred.shape[d];
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = 0;
-		for (size_t j = 0; j < pred.shape[dim]; j++) {
-			const T curr = data[((i / it_dim) * it_dim * pred.shape[dim] +
-								 i % it_dim + j * it_dim) %
-								total_size];
-			result[i] += curr;
-		}
-	}
+	reduce<FREDUCE_SUM>(result, data, from, size, curr);
 }
 int ReduceSumImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 									 OCLLazyCodegenState &compiler_state) {
@@ -275,19 +434,11 @@ FGraphNode *ReduceMulImpl::local_gradient(FGraphNode *y, int dx_i,
 										  FGraphNode *prev_adj) {
 	FGraphNode *a = y->predecessors[0];
 	if (0 == dx_i) {
-		const FOperation op = y->operation;
-		const int dim = ((int *)op.additional_data)[0];
-		std::vector<int> rep(a->operation.dimensions);
-		std::vector<size_t> ns(a->operation.dimensions);
-		for (int i = 0; i < rep.size(); i++) {
-			rep[i] = i == dim ? a->operation.shape[i] - 1 : 0;
-			ns[i] = i != dim ? a->operation.shape[i] : 1;
-		}
 		FGraphNode *zero_node = fequal(a, 0);
 		// the normal gradient would be y/a, this does not work for a_i = 0,
 		// but at first we calculate the gradient for every a_i != 0
 		// broadcast y
-		FGraphNode *ls = frepeat(freshape(y, ns.data(), ns.size()), rep.data());
+		FGraphNode *ls = broadcast_reduced(y, y);
 		// calculate y/a and remove division by 0 case (it does not matter
 		// what we add in that case, since we multiply by 1 - fequal(a,
 		// 0.0), just avoid / 0 for portability)
@@ -297,15 +448,18 @@ FGraphNode *ReduceMulImpl::local_gradient(FGraphNode *y, int dx_i,
 		// to compute a_i = 0 case we set each 0-entry to 1 and repeat the
 		// computation, this yields the correct gradients only for the
 		// entries where a_i = 0
-		FGraphNode *zg = fmul(
-			zero_node, frepeat(freshape(freduce_mul(fadd(a, zero_node), dim),
-										ns.data(), ns.size()),
-							   rep.data()));
+		const int *range = (const int *)y->operation.additional_data;
+		std::vector<int> axes;
+		for (int d = range[0]; d <= range[1]; d++)
+			axes.push_back(d);
+		FGraphNode *zg =
+			fmul(zero_node,
+				 broadcast_reduced(y, freduce_mul_axes(fadd(a, zero_node),
+													   axes.data(),
+													   axes.size(), false)));
 		// now we can add both gradients and multiply with the previous
 		// adjoint
-		return fmul(
-			frepeat(freshape(prev_adj, ns.data(), ns.size()), rep.data()),
-			fadd(lg, zg));
+		return fmul(broadcast_reduced(y, prev_adj), fadd(lg, zg));
 	} else
 		return nullptr;
 }
@@ -313,24 +467,7 @@ template <typename T>
 void ReduceMulImpl::unary_expression(T *__restrict__ result,
 									 const T *__restrict__ data, size_t from,
 									 size_t size, const FGraphNode *curr) {
-	const FOperation pred = curr->predecessors[0]->operation;
-	const int dim = ((int *)curr->operation.additional_data)[0];
-	size_t it_dim = 1; // iteration size <=> product of all dimensions along dim
-	for (size_t d = dim + 1; d < pred.dimensions; d++)
-		it_dim *= pred.shape[d];
-	size_t total_size = 1;
-	if (pred.op_type != FGEN_CONSTANT)
-		for (size_t d = 0; d < pred.dimensions; d++)
-			total_size *= pred.shape[d];
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = 1;
-		for (size_t j = 0; j < pred.shape[dim]; j++) {
-			const T curr = data[((i / it_dim) * it_dim * pred.shape[dim] +
-								 i % it_dim + j * it_dim) %
-								total_size];
-			result[i] *= curr;
-		}
-	}
+	reduce<FREDUCE_MUL>(result, data, from, size, curr);
 }
 std::string ReduceMulImpl::generate_ocl_parameters_eager(
 	FType res_type, std::vector<FType> parameter_types) {
@@ -362,35 +499,17 @@ ReduceMulImpl::reuse_parameter_result(const FGraphNode *node) {
 FGraphNode *ReduceMinImpl::local_gradient(FGraphNode *y, int dx_i,
 										  FGraphNode *prev_adj) {
 	FGraphNode *a = y->predecessors[0];
-	unsigned int ax = ((unsigned int *)y->operation.additional_data)[0];
-	// work with extend to readjust the node to the same shape as before by
-	// repetition, then compare it with equal and multiply the 0-1 tensor
-	// with previous adjoint.
-	FGraphNode *n = fequal(a, fexpand(y, ax, a->operation.shape[ax]));
-	return fmul(fexpand(prev_adj, ax, a->operation.shape[ax]), n);
+	// readjust the node to the same shape as before by repetition, then
+	// compare it with equal and multiply the 0-1 tensor with previous
+	// adjoint.
+	FGraphNode *n = fequal(a, broadcast_reduced(y, y));
+	return fmul(broadcast_reduced(y, prev_adj), n);
 }
 template <typename T>
 void ReduceMinImpl::unary_expression(T *__restrict__ result,
 									 const T *__restrict__ data, size_t from,
 									 size_t size, const FGraphNode *curr) {
-	const FOperation pred = curr->predecessors[0]->operation;
-	const int dim = ((int *)curr->operation.additional_data)[0];
-	size_t it_dim = 1; // iteration size <=> product of all dimensions along dim
-	for (size_t d = dim + 1; d < pred.dimensions; d++)
-		it_dim *= pred.shape[d];
-	size_t total_size = 1;
-	if (pred.op_type != FGEN_CONSTANT)
-		for (size_t d = 0; d < pred.dimensions; d++)
-			total_size *= pred.shape[d];
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = std::numeric_limits<T>::max();
-		for (size_t j = 0; j < pred.shape[dim]; j++) {
-			const T curr = data[((i / it_dim) * it_dim * pred.shape[dim] +
-								 i % it_dim + j * it_dim) %
-								total_size];
-			result[i] = MIN_VAL(result[i], curr);
-		}
-	}
+	reduce<FREDUCE_MIN>(result, data, from, size, curr);
 }
 int ReduceMinImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 									 OCLLazyCodegenState &compiler_state) {
@@ -422,32 +541,14 @@ ReduceMinImpl::reuse_parameter_result(const FGraphNode *node) {
 FGraphNode *ReduceMaxImpl::local_gradient(FGraphNode *y, int dx_i,
 										  FGraphNode *prev_adj) {
 	FGraphNode *a = y->predecessors[0];
-	unsigned int ax = ((unsigned int *)y->operation.additional_data)[0];
-	FGraphNode *n = fequal(a, fexpand(y, ax, a->operation.shape[ax]));
-	return fmul(fexpand(prev_adj, ax, a->operation.shape[ax]), n);
+	FGraphNode *n = fequal(a, broadcast_reduced(y, y));
+	return fmul(broadcast_reduced(y, prev_adj), n);
 }
 template <typename T>
 void ReduceMaxImpl::unary_expression(T *__restrict__ result,
 									 const T *__restrict__ data, size_t from,
 									 size_t size, const FGraphNode *curr) {
-	const FOperation pred = curr->predecessors[0]->operation;
-	const int dim = ((int *)curr->operation.additional_data)[0];
-	size_t it_dim = 1; // iteration size <=> product of all dimensions along dim
-	for (size_t d = dim + 1; d < pred.dimensions; d++)
-		it_dim *= pred.shape[d];
-	size_t total_size = 1;
-	if (pred.op_type != FGEN_CONSTANT)
-		for (size_t d = 0; d < pred.dimensions; d++)
-			total_size *= pred.shape[d];
-	for (size_t i = from; i < from + size; i++) {
-		result[i] = std::numeric_limits<T>::lowest();
-		for (size_t j = 0; j < pred.shape[dim]; j++) {
-			const T curr = data[((i / it_dim) * it_dim * pred.shape[dim] +
-								 i % it_dim + j * it_dim) %
-								total_size];
-			result[i] = MAX_VAL(result[i], curr);
-		}
-	}
+	reduce<FREDUCE_MAX>(result, data, from, size, curr);
 }
 int ReduceMaxImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
 									 OCLLazyCodegenState &compiler_state) {
@@ -476,24 +577,68 @@ std::vector<bool>
 ReduceMaxImpl::reuse_parameter_result(const FGraphNode *node) {
 	return reducing_reuse_params(node);
 }
+size_t ReduceSumImpl::reduction_parts(const FGraphNode *node) {
+	return reduction_parts_of(node);
+}
+void ReduceSumImpl::combine_parts_cpu(const FGraphNode *node,
+									const void *__restrict__ parts,
+									void *__restrict__ result) {
+	combine_parts_typed<FREDUCE_SUM>(node, parts, result);
+}
+int ReduceSumImpl::operation_score(FGraphNode *node) {
+	return reduction_score(node);
+}
 void ReduceSumImpl::execute_cpu(const FGraphNode *node,
 								std::vector<CPUResultData> predecessor_data,
 								void *__restrict__ result, size_t from,
 								size_t size) {
 	UNARY_EXECUTE_MONOTON_IMPL
 }
+size_t ReduceMulImpl::reduction_parts(const FGraphNode *node) {
+	return reduction_parts_of(node);
+}
+void ReduceMulImpl::combine_parts_cpu(const FGraphNode *node,
+									const void *__restrict__ parts,
+									void *__restrict__ result) {
+	combine_parts_typed<FREDUCE_MUL>(node, parts, result);
+}
+int ReduceMulImpl::operation_score(FGraphNode *node) {
+	return reduction_score(node);
+}
 void ReduceMulImpl::execute_cpu(const FGraphNode *node,
 								std::vector<CPUResultData> predecessor_data,
 								void *__restrict__ result, size_t from,
 								size_t size) {
 	UNARY_EXECUTE_MONOTON_IMPL
 }
+size_t ReduceMinImpl::reduction_parts(const FGraphNode *node) {
+	return reduction_parts_of(node);
+}
+void ReduceMinImpl::combine_parts_cpu(const FGraphNode *node,
+									const void *__restrict__ parts,
+									void *__restrict__ result) {
+	combine_parts_typed<FREDUCE_MIN>(node, parts, result);
+}
+int ReduceMinImpl::operation_score(FGraphNode *node) {
+	return reduction_score(node);
+}
 void ReduceMinImpl::execute_cpu(const FGraphNode *node,
 								std::vector<CPUResultData> predecessor_data,
 								void *__restrict__ result, size_t from,
 								size_t size) {
 	UNARY_EXECUTE_MONOTON_IMPL
 }
+size_t ReduceMaxImpl::reduction_parts(const FGraphNode *node) {
+	return reduction_parts_of(node);
+}
+void ReduceMaxImpl::combine_parts_cpu(const FGraphNode *node,
+									const void *__restrict__ parts,
+									void *__restrict__ result) {
+	combine_parts_typed<FREDUCE_MAX>(node, parts, result);
+}
+int ReduceMaxImpl::operation_score(FGraphNode *node) {
+	return reduction_score(node);
+}
 void ReduceMaxImpl::execute_cpu(const FGraphNode *node,
 								std::vector<CPUResultData> predecessor_data,
 								void *__restrict__ result, size_t from,
@@ -40,7 +40,11 @@ struct ReduceSumImpl : OperationImplementation {
 										 cl_kernel kernel, cl_context context,
 										 int &par_index,
 										 std::list<cl_mem> &to_free) override;
-		virtual int operation_score(FGraphNode *node) override { return 5; }
+		int operation_score(FGraphNode *node) override;
+		size_t reduction_parts(const FGraphNode *node) override;
+		void combine_parts_cpu(const FGraphNode *node,
+							   const void *__restrict__ parts,
+							   void *__restrict__ result) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
 		void free_additional_data(FGraphNode *gn) override {
@@ -74,7 +78,11 @@ struct ReduceMulImpl : OperationImplementation {
 										 cl_kernel kernel, cl_context context,
 										 int &par_index,
 										 std::list<cl_mem> &to_free) override;
-		virtual int operation_score(FGraphNode *node) override { return 5; }
+		int operation_score(FGraphNode *node) override;
+		size_t reduction_parts(const FGraphNode *node) override;
+		void combine_parts_cpu(const FGraphNode *node,
+							   const void *__restrict__ parts,
+							   void *__restrict__ result) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
 		void free_additional_data(FGraphNode *gn) override {
@@ -108,7 +116,11 @@ struct ReduceMinImpl : OperationImplementation {
 										 cl_kernel kernel, cl_context context,
 										 int &par_index,
 										 std::list<cl_mem> &to_free) override;
-		virtual int operation_score(FGraphNode *node) override { return 5; }
+		int operation_score(FGraphNode *node) override;
+		size_t reduction_parts(const FGraphNode *node) override;
+		void combine_parts_cpu(const FGraphNode *node,
+							   const void *__restrict__ parts,
+							   void *__restrict__ result) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
 		void free_additional_data(FGraphNode *gn) override {
@@ -142,7 +154,11 @@ struct ReduceMaxImpl : OperationImplementation {
 										 cl_kernel kernel, cl_context context,
 										 int &par_index,
 										 std::list<cl_mem> &to_free) override;
-		virtual int operation_score(FGraphNode *node) override { return 5; }
+		int operation_score(FGraphNode *node) override;
+		size_t reduction_parts(const FGraphNode *node) override;
+		void combine_parts_cpu(const FGraphNode *node,
+							   const void *__restrict__ parts,
+							   void *__restrict__ result) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
 		void free_additional_data(FGraphNode *gn) override {
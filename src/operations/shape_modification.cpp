@@ -15,6 +15,8 @@
 #include "../backend_ocl/utils.hpp"
 #include "../utils.hpp"
 #include "flint.h"
+#include "transpose.hpp"
+#include <algorithm>
 #include <cstring>
 
 using namespace std;
@@ -49,6 +51,26 @@ void FlattenImpl::execute_cpu(const FGraphNode *node,
 				((long *)result)[i] = ((long *)pred.data)[0];
 		}
 		break;
+	case F_FLOAT16:
+	case F_BFLOAT16:
+		if (node->predecessors[0]->operation.op_type != FGEN_CONSTANT) {
+			memcpy((uint16_t *)result + from, (uint16_t *)pred.data + from,
+				   2 * size);
+		} else {
+			for (int i = from; i < from + size; i++)
+				((uint16_t *)result)[i] = ((uint16_t *)pred.data)[0];
+		}
+		break;
+	case F_INT8:
+	case F_UINT8:
+		if (node->predecessors[0]->operation.op_type != FGEN_CONSTANT) {
+			memcpy((uint8_t *)result + from, (uint8_t *)pred.data + from,
+				   size);
+		} else {
+			for (int i = from; i < from + size; i++)
+				((uint8_t *)result)[i] = ((uint8_t *)pred.data)[0];
+		}
+		break;
 	}
 }
 int FlattenImpl::generate_ocl_lazy(const FGraphNode *node, string name,
@@ -167,6 +189,18 @@ FGraphNode *RepeatImpl::local_gradient(FGraphNode *y, int dx_i,
 	}
 	return grad;
 }
+bool RepeatImpl::strided_view(const FGraphNode *node,
+							  std::vector<long> &strides, long &offset) {
+	// only broadcasts of dimensions with one element stay strided
+	const FOperation &pred = node->predecessors[0]->operation;
+	for (int d = 0; d < node->operation.dimensions; d++)
+		if (node->operation.shape[d] != pred.shape[d]) {
+			if (pred.shape[d] != 1)
+				return false;
+			strides[d] = 0;
+		}
+	return true;
+}
 template <typename T>
 void RepeatImpl::unary_expression(T *__restrict__ result,
 								  const T *__restrict__ data, size_t from,
@@ -288,33 +322,30 @@ FGraphNode *TransposeImpl::local_gradient(FGraphNode *y, int dx_i,
 	int *transp = ((int *)y->operation.additional_data);
 	return ftranspose(prev_adj, transp);
 }
+bool TransposeImpl::strided_view(const FGraphNode *node,
+								 std::vector<long> &strides, long &offset) {
+	const int *transposition = (int *)node->operation.additional_data;
+	const std::vector<long> pred_strides = strides;
+	for (int d = 0; d < node->operation.dimensions; d++)
+		strides[d] = pred_strides[transposition[d]];
+	return true;
+}
 template <typename T>
 void TransposeImpl::unary_expression(T *__restrict__ result,
 									 const T *__restrict__ data, size_t from,
 									 size_t size, const FGraphNode *curr) {
 	const FOperation op = curr->operation;
-	const int *transposition = (int *)op.additional_data;
 	const FOperation pred = curr->predecessors[0]->operation;
-	size_t total_el_size = 1;
-	if (pred.op_type != FGEN_CONSTANT)
-		for (int i = 0; i < pred.dimensions; i++)
-			total_el_size *= pred.shape[i];
-	// calculate number of elements per dimension entry for destination and
-	// source
-	vector<size_t> acc_sizes_d = calc_acc_sizes(op);
-	vector<size_t> acc_sizes_s = calc_acc_sizes(pred.dimensions, pred.shape);
-	for (int i = from; i < from + size; i++) {
-		// to get the index in the source array we first calculate the
-		// indices and reproject
-		int index = i;
-		int src_index = 0;
-		for (int dim = 0; dim < op.dimensions; dim++) {
-			int curr_idx = index / acc_sizes_d[dim];
-			index %= acc_sizes_d[dim];
-			src_index += curr_idx * acc_sizes_s[transposition[dim]];
-		}
-		result[i] = data[src_index % total_el_size];
+	if (pred.op_type == FGEN_CONSTANT) {
+		std::fill(result + from, result + from + size, data[0]);
+		return;
 	}
+	const vector<size_t> acc_sizes_s =
+		calc_acc_sizes(pred.dimensions, pred.shape);
+	const TransposeGeometry geometry(op.shape, op.dimensions,
+									 acc_sizes_s.data(),
+									 (const int *)op.additional_data);
+	transpose(result, data, geometry, from, size);
 }
 int TransposeImpl::generate_ocl_lazy(const FGraphNode *node, string name,
 									 OCLLazyCodegenState &compiler_state) {
@@ -337,7 +368,7 @@ int TransposeImpl::generate_ocl_lazy(const FGraphNode *node, string name,
 	}
 	// to get the index in the source array we first calculate the
 	// indices and reproject
-	index_defs += "{\nint working_index = index;\nindex = 0;\n";
+	index_defs += "{\nlong working_index = index;\nindex = 0;\n";
 	for (int dim = 0; dim < op.dimensions; dim++) {
 		index_defs += "index += ((working_index /" +
 					  to_string(acc_sizes_d[dim]) + ") % " +
@@ -366,9 +397,9 @@ TransposeImpl::generate_ocl_eager(FType res_type,
 								  std::vector<FType> parameter_types) {
 	return "if(index >= num_entriesR) return;\n"
 		   "long src_index = 0;\n"
-		   "int i = index;\n"
+		   "long i = index;\n"
 		   "for(int dim = 0; dim < dimensions0; dim++){\n"
-		   " int curr_idx = i / acc_sizes_d[dim];\n"
+		   " long curr_idx = i / acc_sizes_d[dim];\n"
 		   " i %= acc_sizes_d[dim];\n"
 		   " src_index += curr_idx * acc_sizes_s[dim];\n}\n"
 		   "R[index] = P0[src_index % total_el_size];\n";
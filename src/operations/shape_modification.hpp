@@ -30,10 +30,16 @@ struct FlattenImpl : OperationImplementation {
 						   std::vector<FType> parameter_types) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
 		}
+		long view_offset(const FGraphNode *node) override {
+			return node->predecessors[0]->operation.op_type == FGEN_CONSTANT
+					   ? -1
+					   : 0;
+		}
 		std::string generate_ocl_parameters_eager(
 			FType res_type, std::vector<FType> parameter_types) override;
 
@@ -63,6 +69,7 @@ struct ConversionImpl : OperationImplementation {
 			// all combinations of parameter and return type possible
 			return all_type_permutations(2);
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {type_size(node->predecessors[0]->operation.data_type) ==
@@ -98,6 +105,8 @@ struct RepeatImpl : OperationImplementation {
 										 std::list<cl_mem> &to_free) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool strided_view(const FGraphNode *node, std::vector<long> &strides,
+						  long &offset) override;
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return AddImpl::reuse_parameter_binary_impl(node);
@@ -126,6 +135,8 @@ struct TransposeImpl : OperationImplementation {
 										 std::list<cl_mem> &to_free) override;
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool strided_view(const FGraphNode *node, std::vector<long> &strides,
+						  long &offset) override;
 		void free_additional_data(FGraphNode *gn) override {
 			free(gn->operation.additional_data);
 		}
@@ -0,0 +1,324 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "softmax.hpp"
+#include "../utils.hpp"
+#include <cmath>
+using namespace std;
+
+// number of elements along the axis `ax` of `op` and the distance between two
+// of them
+static void axis_sizes(const FOperation &op, int ax, size_t &len,
+					   size_t &inner) {
+	len = op.shape[ax];
+	inner = 1;
+	for (int d = ax + 1; d < op.dimensions; d++)
+		inner *= op.shape[d];
+}
+// repeats `t` (shaped like `a` without the axis `ax`) along `ax` to the shape
+// of `a`
+static FGraphNode *expand_axis(FGraphNode *t, const FGraphNode *a, int ax) {
+	const size_t len = a->operation.shape[ax];
+	if (a->operation.dimensions == 1) {
+		int repetitions = len - 1;
+		return frepeat(t, &repetitions);
+	}
+	return fexpand(t, ax, len);
+}
+// OpenCL code that computes the maximum `m` and the sum of exponentials
+// (relative to the maximum) `s` of the `len` values of `par` starting at
+// `base` that are `inner` elements apart in a single pass, the sum is rescaled
+// whenever the maximum changes. If `labels` is not empty, the sum of the labels
+// at the same positions is computed in `t_sum` and their weighted sum of the
+// values in `tx`.
+static string online_softmax_code(const string &type, const string &par,
+								  const string &base, const string &len,
+								  const string &inner,
+								  const string &labels = "") {
+	string code = type + " m = " + par + "[" + base + "], s = 0" +
+				  (labels.empty() ? "" : ", t_sum = 0, tx = 0") +
+				  ";\nfor(long k = 0; k < " + len +
+				  "; k++){\n"
+				  " const " +
+				  type + " x = " + par + "[" + base + " + k * " + inner +
+				  "];\n";
+	if (!labels.empty())
+		code += " const " + type + " t = " + labels + "[" + base + " + k * " +
+				inner + "];\n t_sum += t;\n tx += t * x;\n";
+	code += " if(x > m){\n"
+			"  s = s * exp(m - x) + 1;\n"
+			"  m = x;\n"
+			" } else s += exp(x - m);\n"
+			"}\n";
+	return code;
+}
+template <typename T>
+void SoftmaxBaseImpl::execute_cpu_typed(
+	const FGraphNode *node, std::vector<CPUResultData> predecessor_data,
+	T *__restrict__ result, size_t from, size_t size) {
+	using C = compute_type<T>;
+	const T *a = (const T *)predecessor_data[0].data;
+	const int ax = ((int *)node->operation.additional_data)[0];
+	size_t len, inner;
+	axis_sizes(node->operation, ax, len, inner);
+	const size_t block = len * inner;
+	const bool log = logarithmic();
+	// maximum and sum of the exponentials per position in a block
+	vector<C> max(inner), sum(inner);
+	for (size_t outer = from / block; outer * block < from + size; outer++) {
+		const T *in = a + outer * block;
+		for (size_t i = 0; i < inner; i++) {
+			max[i] = in[i];
+			sum[i] = 0;
+		}
+		// in a single pass, the sum is rescaled whenever the maximum changes
+		for (size_t k = 0; k < len; k++)
+			for (size_t i = 0; i < inner; i++) {
+				const C x = in[k * inner + i];
+				if (x > max[i]) {
+					sum[i] = sum[i] * std::exp(max[i] - x) + 1;
+					max[i] = x;
+				} else
+					sum[i] += std::exp(x - max[i]);
+			}
+		const size_t first = std::max(from, outer * block);
+		const size_t last = std::min(from + size, (outer + 1) * block);
+		for (size_t index = first; index < last; index++) {
+			const size_t i = (index - outer * block) % inner;
+			const C x = (C)a[index] - max[i];
+			result[index] = log ? (C)(x - std::log(sum[i]))
+								: (C)(std::exp(x) / sum[i]);
+		}
+	}
+}
+void SoftmaxBaseImpl::execute_cpu(const FGraphNode *node,
+								  std::vector<CPUResultData> predecessor_data,
+								  void *__restrict__ result, size_t from,
+								  size_t size) {
+	EXECUTE_TYPED_IMPL
+}
+int SoftmaxBaseImpl::generate_ocl_lazy(const FGraphNode *node,
+									   std::string name,
+									   OCLLazyCodegenState &compiler_state) {
+	const string type = type_string(node->operation.data_type);
+	const string par =
+		compiler_state.findOrInsertParameter(node->predecessors[0]);
+	const int ax = ((int *)node->operation.additional_data)[0];
+	size_t len, inner;
+	axis_sizes(node->operation, ax, len, inner);
+	const string block = to_string(len * inner);
+	compiler_state.code.prepend(
+		type + " " + name + " = 0;\n{\nconst long base = (index / " + block +
+		") * " + block + " + index % " + to_string(inner) + ";\n" +
+		online_softmax_code(type, par, "base", to_string(len),
+							to_string(inner)) +
+		name + " = " +
+		(logarithmic() ? par + "[index] - m - log(s)"
+					   : "exp(" + par + "[index] - m) / s") +
+		";\n}\n");
+	return OCL_LAZY_DONT_PUSH_PREDS;
+}
+std::string SoftmaxBaseImpl::generate_ocl_parameters_eager(
+	FType res_type, std::vector<FType> parameter_types) {
+	return OperationImplementation::generate_ocl_parameters_eager(
+			   res_type, parameter_types) +
+		   ", const long shape_ax, const long inner";
+}
+std::string
+SoftmaxBaseImpl::generate_ocl_eager(FType res_type,
+									std::vector<FType> parameter_types) {
+	return "if(index >= num_entriesR) return;\n"
+		   "const long base = (index / (shape_ax * inner)) * shape_ax * inner "
+		   "+ index % inner;\n" +
+		   online_softmax_code(type_string(res_type), "P0", "base", "shape_ax",
+							   "inner") +
+		   (logarithmic() ? "R[index] = P0[index] - m - log(s);\n"
+						  : "R[index] = exp(P0[index] - m) / s;\n");
+}
+// pushes the size of the axis and the distance of its elements
+static void push_axis_parameters(const FOperation &op, int ax,
+								 cl_kernel kernel, int &par_index) {
+	size_t len, inner;
+	axis_sizes(op, ax, len, inner);
+	for (const size_t *val : {&len, &inner})
+		if (clSetKernelArg(kernel, par_index++, sizeof(long), (void *)val) !=
+			CL_SUCCESS) {
+			setErrorType(OCL_ERROR);
+			flogging(F_ERROR, "Could not load Argument to kernel!");
+			return;
+		}
+}
+void SoftmaxBaseImpl::push_additional_kernel_parameters(
+	FGraphNode *node, cl_kernel kernel, cl_context context, int &par_index,
+	std::list<cl_mem> &to_free) {
+	push_axis_parameters(node->operation,
+						 ((int *)node->operation.additional_data)[0], kernel,
+						 par_index);
+}
+FGraphNode *SoftmaxImpl::local_gradient(FGraphNode *y, int dx_i,
+										FGraphNode *prev_adj) {
+	if (dx_i != 0)
+		return nullptr;
+	// y * (adj - sum(adj * y))
+	const int ax = ((int *)y->operation.additional_data)[0];
+	return fmul(y, fsub(prev_adj,
+						expand_axis(freduce_sum(fmul(prev_adj, y), ax), y, ax)));
+}
+FGraphNode *LogSoftmaxImpl::local_gradient(FGraphNode *y, int dx_i,
+										   FGraphNode *prev_adj) {
+	if (dx_i != 0)
+		return nullptr;
+	// adj - softmax * sum(adj)
+	const int ax = ((int *)y->operation.additional_data)[0];
+	return fsub(prev_adj,
+				fmul(fexp(y), expand_axis(freduce_sum(prev_adj, ax), y, ax)));
+}
+// the cross entropy of the rows `[from, from + size)`, `indices` denotes if
+// the labels are class indices or a distribution
+template <typename T, typename L>
+static void cross_entropy(const T *__restrict__ a,
+						  const L *__restrict__ labels, bool indices,
+						  T *__restrict__ result, size_t from, size_t size,
+						  size_t len, size_t inner) {
+	using C = compute_type<T>;
+	for (size_t r = from; r < from + size; r++) {
+		const size_t base = (r / inner) * len * inner + r % inner;
+		C max = a[base], sum = 0, label_sum = 0, weighted = 0;
+		for (size_t k = 0; k < len; k++) {
+			const C x = a[base + k * inner];
+			if (!indices) {
+				const C t = labels[base + k * inner];
+				label_sum += t;
+				weighted += t * x;
+			}
+			if (x > max) {
+				sum = sum * std::exp(max - x) + 1;
+				max = x;
+			} else
+				sum += std::exp(x - max);
+		}
+		// log of the sum of the exponentials
+		const C lse = max + std::log(sum);
+		result[r] = indices ? lse - (C)a[base + (size_t)labels[r] * inner]
+							: label_sum * lse - weighted;
+	}
+}
+template <typename T>
+void SoftmaxCrossEntropyImpl::execute_cpu_typed(
+	const FGraphNode *node, std::vector<CPUResultData> predecessor_data,
+	T *__restrict__ result, size_t from, size_t size) {
+	const T *a = (const T *)predecessor_data[0].data;
+	const int ax = ((int *)node->operation.additional_data)[0];
+	size_t len, inner;
+	axis_sizes(node->predecessors[0]->operation, ax, len, inner);
+	const void *labels = predecessor_data[1].data;
+	switch (predecessor_data[1].type) {
+	case F_INT32:
+		cross_entropy(a, (const int *)labels, true, result, from, size, len,
+					  inner);
+		break;
+	case F_INT64:
+		cross_entropy(a, (const long *)labels, true, result, from, size, len,
+					  inner);
+		break;
+	default:
+		cross_entropy(a, (const T *)labels, false, result, from, size, len,
+					  inner);
+	}
+}
+void SoftmaxCrossEntropyImpl::execute_cpu(
+	const FGraphNode *node, std::vector<CPUResultData> predecessor_data,
+	void *__restrict__ result, size_t from, size_t size) {
+	EXECUTE_TYPED_IMPL
+}
+// result of the OpenCL code of the cross entropy, `m`, `s`, `t_sum` and `tx`
+// are defined by `online_softmax_code`
+static string cross_entropy_result(bool indices, const string &par,
+								   const string &labels, const string &inner) {
+	return indices ? "m + log(s) - " + par + "[base + " + labels +
+						 "[index] * " + inner + "]"
+				   : "t_sum * (m + log(s)) - tx";
+}
+int SoftmaxCrossEntropyImpl::generate_ocl_lazy(
+	const FGraphNode *node, std::string name,
+	OCLLazyCodegenState &compiler_state) {
+	const string type = type_string(node->operation.data_type);
+	const string par =
+		compiler_state.findOrInsertParameter(node->predecessors[0]);
+	const string labels =
+		compiler_state.findOrInsertParameter(node->predecessors[1]);
+	const FType label_type = node->predecessors[1]->operation.data_type;
+	const bool indices = label_type == F_INT32 || label_type == F_INT64;
+	const int ax = ((int *)node->operation.additional_data)[0];
+	size_t len, inner;
+	axis_sizes(node->predecessors[0]->operation, ax, len, inner);
+	compiler_state.code.prepend(
+		type + " " + name + " = 0;\n{\nconst long base = (index / " +
+		to_string(inner) + ") * " + to_string(len * inner) + " + index % " +
+		to_string(inner) + ";\n" +
+		online_softmax_code(type, par, "base", to_string(len),
+							to_string(inner), indices ? "" : labels) +
+		name + " = " +
+		cross_entropy_result(indices, par, labels, to_string(inner)) +
+		";\n}\n");
+	return OCL_LAZY_DONT_PUSH_PREDS;
+}
+std::string SoftmaxCrossEntropyImpl::generate_ocl_parameters_eager(
+	FType res_type, std::vector<FType> parameter_types) {
+	return OperationImplementation::generate_ocl_parameters_eager(
+			   res_type, parameter_types) +
+		   ", const long shape_ax, const long inner";
+}
+std::string SoftmaxCrossEntropyImpl::generate_ocl_eager(
+	FType res_type, std::vector<FType> parameter_types) {
+	const bool indices =
+		parameter_types[1] == F_INT32 || parameter_types[1] == F_INT64;
+	return "if(index >= num_entriesR) return;\n"
+		   "const long base = (index / inner) * shape_ax * inner + index % "
+		   "inner;\n" +
+		   online_softmax_code(type_string(res_type), "P0", "base", "shape_ax",
+							   "inner", indices ? "" : "P1") +
+		   "R[index] = " + cross_entropy_result(indices, "P0", "P1", "inner") +
+		   ";\n";
+}
+void SoftmaxCrossEntropyImpl::push_additional_kernel_parameters(
+	FGraphNode *node, cl_kernel kernel, cl_context context, int &par_index,
+	std::list<cl_mem> &to_free) {
+	push_axis_parameters(node->predecessors[0]->operation,
+						 ((int *)node->operation.additional_data)[0], kernel,
+						 par_index);
+}
+FGraphNode *SoftmaxCrossEntropyImpl::local_gradient(FGraphNode *y, int dx_i,
+													FGraphNode *prev_adj) {
+	FGraphNode *a = y->predecessors[0], *labels = y->predecessors[1];
+	const int ax = ((int *)y->operation.additional_data)[0];
+	const FType label_type = labels->operation.data_type;
+	const bool indices = label_type == F_INT32 || label_type == F_INT64;
+	if (dx_i == 0) {
+		// softmax * sum(labels) - labels, i.e. softmax - onehot for indices
+		FGraphNode *target;
+		FGraphNode *softmax = fsoftmax(a, ax);
+		if (indices) {
+			target = fequal(
+				farange(a->operation.shape, a->operation.dimensions, ax),
+				expand_axis(labels, a, ax));
+		} else {
+			target = labels;
+			softmax =
+				fmul(softmax, expand_axis(freduce_sum(labels, ax), a, ax));
+		}
+		return fmul(fsub(softmax, target), expand_axis(prev_adj, a, ax));
+	} else if (dx_i == 1 && !indices)
+		return fmul(fneg(flog_softmax(a, ax)), expand_axis(prev_adj, a, ax));
+	return nullptr;
+}
@@ -0,0 +1,111 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_SOFTMAX_HPP
+#define FLINT_SOFTMAX_HPP
+#include "implementation.hpp"
+
+/**
+ * Shared parts of `SoftmaxImpl` and `LogSoftmaxImpl`, both normalize their
+ * predecessor along the axis in the additional data.
+ */
+struct SoftmaxBaseImpl : OperationImplementation {
+		/** If the logarithm of the softmax is computed */
+		virtual bool logarithmic() const = 0;
+		template <typename T>
+		void execute_cpu_typed(const FGraphNode *node,
+							   std::vector<CPUResultData> predecessor_data,
+							   T *__restrict__ result, size_t from,
+							   size_t size);
+		void execute_cpu(const FGraphNode *node,
+						 std::vector<CPUResultData> predecessor_data,
+						 void *__restrict__ result, size_t from,
+						 size_t size) override;
+		int generate_ocl_lazy(const FGraphNode *node, std::string name,
+							  OCLLazyCodegenState &compiler_state) override;
+		std::string
+		generate_ocl_eager(FType res_type,
+						   std::vector<FType> parameter_types) override;
+		std::string generate_ocl_parameters_eager(
+			FType res_type, std::vector<FType> parameter_types) override;
+		void
+		push_additional_kernel_parameters(FGraphNode *node, cl_kernel kernel,
+										  cl_context context, int &par_index,
+										  std::list<cl_mem> &to_free) override;
+		int operation_score(FGraphNode *node) override { return 5; }
+		void free_additional_data(FGraphNode *gn) override {
+			free(gn->operation.additional_data);
+		}
+		std::vector<std::vector<FType>>
+		kernel_type_combinations(const FGraphNode *node) override {
+			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
+		}
+};
+struct SoftmaxImpl : SoftmaxBaseImpl {
+		bool logarithmic() const override { return false; }
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override;
+};
+struct LogSoftmaxImpl : SoftmaxBaseImpl {
+		bool logarithmic() const override { return true; }
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override;
+};
+/**
+ * Cross entropy between the softmax of the first predecessor along the axis in
+ * the additional data and the labels in the second one, either a distribution
+ * shaped like the first predecessor or (integer) class indices shaped like
+ * the result.
+ */
+struct SoftmaxCrossEntropyImpl : OperationImplementation {
+		template <typename T>
+		void execute_cpu_typed(const FGraphNode *node,
+							   std::vector<CPUResultData> predecessor_data,
+							   T *__restrict__ result, size_t from,
+							   size_t size);
+		void execute_cpu(const FGraphNode *node,
+						 std::vector<CPUResultData> predecessor_data,
+						 void *__restrict__ result, size_t from,
+						 size_t size) override;
+		int generate_ocl_lazy(const FGraphNode *node, std::string name,
+							  OCLLazyCodegenState &compiler_state) override;
+		std::string
+		generate_ocl_eager(FType res_type,
+						   std::vector<FType> parameter_types) override;
+		std::string generate_ocl_parameters_eager(
+			FType res_type, std::vector<FType> parameter_types) override;
+		void
+		push_additional_kernel_parameters(FGraphNode *node, cl_kernel kernel,
+										  cl_context context, int &par_index,
+										  std::list<cl_mem> &to_free) override;
+		int operation_score(FGraphNode *node) override {
+			const int ax = ((int *)node->operation.additional_data)[0];
+			return (int)std::min(
+				(size_t)1 << 20,
+				5 + node->predecessors[0]->operation.shape[ax]);
+		}
+		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
+								   FGraphNode *prev_adj) override;
+		void free_additional_data(FGraphNode *gn) override {
+			free(gn->operation.additional_data);
+		}
+		std::vector<std::vector<FType>>
+		kernel_type_combinations(const FGraphNode *node) override {
+			std::vector<std::vector<FType>> res;
+			for (FType t : {F_FLOAT32, F_FLOAT64})
+				for (FType l : {t, F_INT32, F_INT64})
+					res.push_back({t, t, l});
+			return res;
+		}
+};
+#endif
@@ -0,0 +1,219 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#include "sparse.hpp"
+#include "../utils.hpp"
+using namespace std;
+
+// the (int64) data of an index tensor of a sparse matrix
+static const long *index_data(FGraphNode *node) {
+	fExecuteGraph(node);
+	fSyncMemory(node);
+	return (const long *)node->result_data->data;
+}
+template <typename T>
+void SparseImpl::execute_cpu_typed(const FGraphNode *node,
+								   std::vector<CPUResultData> predecessor_data,
+								   T *__restrict__ result, size_t from,
+								   size_t size) {
+	const T *values = (const T *)predecessor_data[0].data;
+	const long *offsets = (const long *)predecessor_data[1].data;
+	const long *columns = (const long *)predecessor_data[2].data;
+	const size_t num_columns = node->operation.shape[1];
+	for (size_t i = from; i < from + size; i++)
+		result[i] = 0;
+	// scatter the values of the rows in the range
+	const size_t last = (from + size - 1) / num_columns;
+	for (size_t row = from / num_columns; row <= last; row++)
+		for (long v = offsets[row]; v < offsets[row + 1]; v++) {
+			const size_t index = row * num_columns + columns[v];
+			if (index >= from && index < from + size)
+				result[index] += values[v];
+		}
+}
+void SparseImpl::execute_cpu(const FGraphNode *node,
+							 std::vector<CPUResultData> predecessor_data,
+							 void *__restrict__ result, size_t from,
+							 size_t size) {
+	EXECUTE_TYPED_IMPL
+}
+int SparseImpl::generate_ocl_lazy(const FGraphNode *node, std::string name,
+								  OCLLazyCodegenState &compiler_state) {
+	const string type = type_string(node->operation.data_type);
+	const string values =
+		compiler_state.findOrInsertParameter(node->predecessors[0]);
+	const string offsets =
+		compiler_state.findOrInsertParameter(node->predecessors[1]);
+	const string columns =
+		compiler_state.findOrInsertParameter(node->predecessors[2]);
+	const string num_columns = to_string(node->operation.shape[1]);
+	compiler_state.code.prepend(
+		type + " " + name + " = 0;\n{\n const long row = index / " +
+		num_columns + ", col = index % " + num_columns +
+		";\n for(long v = " + offsets + "[row]; v < " + offsets +
+		"[row + 1]; v++)\n  if(" + columns + "[v] == col) " + name +
+		" += " + values + "[v];\n}\n");
+	return OCL_LAZY_DONT_PUSH_PREDS;
+}
+std::string
+SparseImpl::generate_ocl_parameters_eager(FType res_type,
+										  std::vector<FType> parameter_types) {
+	return OperationImplementation::generate_ocl_parameters_eager(
+			   res_type, parameter_types) +
+		   ", long num_columns";
+}
+std::string SparseImpl::generate_ocl_eager(FType res_type,
+										   std::vector<FType> parameter_types) {
+	return "if(index >= num_entriesR) return;\n" + type_string(res_type) +
+		   " res = 0;\n"
+		   "const long row = index / num_columns, col = index % num_columns;\n"
+		   "for(long v = P1[row]; v < P1[row + 1]; v++)\n"
+		   " if(P2[v] == col) res += P0[v];\n"
+		   "R[index] = res;\n";
+}
+void SparseImpl::push_additional_kernel_parameters(
+	FGraphNode *node, cl_kernel kernel, cl_context context, int &par_index,
+	std::list<cl_mem> &to_free) {
+	if (clSetKernelArg(kernel, par_index++, sizeof(long),
+					   (void *)&node->operation.shape[1]) != CL_SUCCESS) {
+		setErrorType(OCL_ERROR);
+		flogging(F_ERROR, "Could not load Argument to kernel!");
+	}
+}
+FGraphNode *SparseImpl::local_gradient(FGraphNode *y, int dx_i,
+									   FGraphNode *prev_adj) {
+	if (dx_i != 0)
+		return nullptr;
+	// the adjoint at the position of each value
+	const long *offsets = index_data(y->predecessors[1]);
+	const long *columns = index_data(y->predecessors[2]);
+	const size_t num_values = y->predecessors[0]->operation.shape[0];
+	vector<long> positions(num_values);
+	for (size_t row = 0; row < y->operation.shape[0]; row++)
+		for (long v = offsets[row]; v < offsets[row + 1]; v++)
+			positions[v] = row * y->operation.shape[1] + columns[v];
+	return findex(fflatten(prev_adj),
+				  fCreateGraph(positions.data(), num_values, F_INT64,
+							   &num_values, 1));
+}
+template <typename T>
+void SparseMatMulImpl::execute_cpu_typed(
+	const FGraphNode *node, std::vector<CPUResultData> predecessor_data,
+	T *__restrict__ result, size_t from, size_t size) {
+	using C = compute_type<T>;
+	const T *values = (const T *)predecessor_data[0].data;
+	const T *b = (const T *)predecessor_data[1].data;
+	const long *offsets = (const long *)predecessor_data[2].data;
+	const long *columns = (const long *)predecessor_data[3].data;
+	const size_t n = node->operation.shape[1];
+	// each part of a row of the result is the sum of the rows of `b` of the
+	// columns of the values in that row, scaled by the values
+	std::vector<C> acc;
+	for (size_t index = from; index < from + size;) {
+		const size_t row = index / n, j0 = index % n;
+		const size_t j1 = std::min(n, j0 + from + size - index);
+		acc.assign(j1 - j0, C(0));
+		for (long v = offsets[row]; v < offsets[row + 1]; v++) {
+			const C value = values[v];
+			const T *__restrict__ b_row = b + columns[v] * n;
+			for (size_t j = j0; j < j1; j++)
+				acc[j - j0] += value * (C)b_row[j];
+		}
+		for (size_t j = j0; j < j1; j++)
+			result[row * n + j] = acc[j - j0];
+		index += j1 - j0;
+	}
+}
+void SparseMatMulImpl::execute_cpu(const FGraphNode *node,
+								   std::vector<CPUResultData> predecessor_data,
+								   void *__restrict__ result, size_t from,
+								   size_t size) {
+	EXECUTE_TYPED_IMPL
+}
+int SparseMatMulImpl::generate_ocl_lazy(const FGraphNode *node,
+										std::string name,
+										OCLLazyCodegenState &compiler_state) {
+	const string type = type_string(node->operation.data_type);
+	const string values =
+		compiler_state.findOrInsertParameter(node->predecessors[0]);
+	const string b = compiler_state.findOrInsertParameter(node->predecessors[1]);
+	const string offsets =
+		compiler_state.findOrInsertParameter(node->predecessors[2]);
+	const string columns =
+		compiler_state.findOrInsertParameter(node->predecessors[3]);
+	const string n = to_string(node->operation.shape[1]);
+	compiler_state.code.prepend(
+		type + " " + name + " = 0;\n{\n const long row = index / " + n +
+		", col = index % " + n + ";\n for(long v = " + offsets +
+		"[row]; v < " + offsets + "[row + 1]; v++)\n  " + name + " += " +
+		values + "[v] * " + b + "[" + columns + "[v] * " + n + " + col];\n}\n");
+	return OCL_LAZY_DONT_PUSH_PREDS;
+}
+std::string SparseMatMulImpl::generate_ocl_parameters_eager(
+	FType res_type, std::vector<FType> parameter_types) {
+	return OperationImplementation::generate_ocl_parameters_eager(
+			   res_type, parameter_types) +
+		   ", long n";
+}
+std::string
+SparseMatMulImpl::generate_ocl_eager(FType res_type,
+									 std::vector<FType> parameter_types) {
+	return "if(index >= num_entriesR) return;\n" + type_string(res_type) +
+		   " res = 0;\n"
+		   "const long row = index / n, col = index % n;\n"
+		   "for(long v = P2[row]; v < P2[row + 1]; v++)\n"
+		   " res += P0[v] * P1[P3[v] * n + col];\n"
+		   "R[index] = res;\n";
+}
+void SparseMatMulImpl::push_additional_kernel_parameters(
+	FGraphNode *node, cl_kernel kernel, cl_context context, int &par_index,
+	std::list<cl_mem> &to_free) {
+	if (clSetKernelArg(kernel, par_index++, sizeof(long),
+					   (void *)&node->operation.shape[1]) != CL_SUCCESS) {
+		setErrorType(OCL_ERROR);
+		flogging(F_ERROR, "Could not load Argument to kernel!");
+	}
+}
+FGraphNode *SparseMatMulImpl::local_gradient(FGraphNode *y, int dx_i,
+											 FGraphNode *prev_adj) {
+	FGraphNode *values = y->predecessors[0], *b = y->predecessors[1];
+	FGraphNode *columns = y->predecessors[3];
+	// row of each value
+	const long *offsets = index_data(y->predecessors[2]);
+	const size_t num_values = values->operation.shape[0];
+	vector<size_t> rows(num_values);
+	for (size_t row = 0; row < y->operation.shape[0]; row++)
+		for (long v = offsets[row]; v < offsets[row + 1]; v++)
+			rows[v] = row;
+	if (dx_i == 0) {
+		// the gradient is sparse: one dot product of a row of the adjoint
+		// with a row of b per value
+		FGraphNode *adj_rows = findex(
+			prev_adj,
+			fCreateGraph(rows.data(), num_values, F_INT64, &num_values, 1));
+		return freduce_sum(fmul(adj_rows, findex(b, columns)), 1);
+	} else if (dx_i == 1) {
+		// the transposed sparse matrix times the adjoint
+		const long *column_data = index_data(columns);
+		const vector<size_t> transposed_rows(column_data,
+											 column_data + num_values);
+		const size_t shape[2] = {b->operation.shape[0], y->operation.shape[0]};
+		FGraphNode *transposed =
+			fsparse(values, transposed_rows.data(), rows.data(), shape);
+		FGraphNode *gradient = fmatmul(transposed, prev_adj);
+		// only its parameters are used by the product
+		fFreeGraph(transposed);
+		return gradient;
+	}
+	return nullptr;
+}
@@ -0,0 +1,189 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_TRANSPOSE_HPP
+#define FLINT_TRANSPOSE_HPP
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Transposition of the cpu backend. Neighbouring dimensions of the result
+ * that are neighbours in the source too are collapsed into one, so most
+ * permutations become a batch of copies of contiguous runs (if the last
+ * dimension stays the last one) or of 2D transpositions between the
+ * dimension that is contiguous in the source and the last one of the result.
+ * Those are computed in blocks that stay in the L1 cache, made of small square
+ * micro tiles.
+ */
+
+// edge length of the micro tiles, 4 floats fill a 128 bit register
+#define TRANSPOSE_MICRO 4
+// edge length of the cache blocks, a multiple of `TRANSPOSE_MICRO`
+#define TRANSPOSE_BLOCK 64
+
+struct TransposeGeometry {
+		// collapsed dimensions of the result and the distance of their
+		// elements in the source
+		std::vector<size_t> shape, src_strides;
+		/**
+		 * `shape` and `dimensions` describe the result, `src_acc` the number
+		 * of elements per index of each dimension of the source and
+		 * `transposition` the dimension of the source each dimension of the
+		 * result is taken from.
+		 */
+		TransposeGeometry(const size_t *dst_shape, int dimensions,
+						  const size_t *src_acc, const int *transposition) {
+			for (int d = 0; d < dimensions; d++) {
+				if (dst_shape[d] == 1)
+					continue;
+				const size_t stride = src_acc[transposition[d]];
+				if (!shape.empty() &&
+					src_strides.back() == stride * dst_shape[d]) {
+					shape.back() *= dst_shape[d];
+					src_strides.back() = stride;
+				} else {
+					shape.push_back(dst_shape[d]);
+					src_strides.push_back(stride);
+				}
+			}
+		}
+};
+/**
+ * `dst[i * dst_stride + j] = src[j * src_stride + i]` for a
+ * `TRANSPOSE_MICRO x TRANSPOSE_MICRO` tile. The trip counts are fixed, so the
+ * compiler unrolls it completely and transposes in registers.
+ */
+template <typename T>
+inline void transpose_micro(T *__restrict__ dst, size_t dst_stride,
+							const T *__restrict__ src, size_t src_stride) {
+	for (size_t i = 0; i < TRANSPOSE_MICRO; i++)
+		for (size_t j = 0; j < TRANSPOSE_MICRO; j++)
+			dst[i * dst_stride + j] = src[j * src_stride + i];
+}
+/**
+ * Elements `[from, from + size)` of the transposition of `data` described by
+ * `geometry` (see `TransposeGeometry`).
+ */
+template <typename T>
+void transpose(T *__restrict__ result, const T *__restrict__ data,
+			   const TransposeGeometry &geometry, size_t from, size_t size) {
+	const std::vector<size_t> &shape = geometry.shape,
+							  &src_strides = geometry.src_strides;
+	const size_t end = from + size;
+	const int dims = shape.size();
+	if (dims == 0) {
+		std::fill(result + from, result + end, data[0]);
+		return;
+	}
+	std::vector<size_t> dst_strides(dims);
+	dst_strides[dims - 1] = 1;
+	for (int d = dims - 2; d >= 0; d--)
+		dst_strides[d] = dst_strides[d + 1] * shape[d + 1];
+	const int last = dims - 1;
+	const size_t columns = shape[last];
+	if (src_strides[last] == 1) {
+		// rows of the result are contiguous in the source
+		size_t i = from;
+		while (i < end) {
+			const size_t row = i / columns * columns;
+			size_t src = 0;
+			for (int d = 0; d < last; d++)
+				src += (i / dst_strides[d]) % shape[d] * src_strides[d];
+			const size_t to = std::min(end, row + columns);
+			std::copy(data + src + (i - row), data + src + (to - row),
+					  result + i);
+			i = to;
+		}
+		return;
+	}
+	// the dimension that is contiguous in the source and the one after the
+	// last are transposed, the dimensions inbetween are iterated for each
+	// row of the first one
+	int contiguous = 0;
+	while (src_strides[contiguous] != 1)
+		contiguous++;
+	const size_t rows = shape[contiguous], row_stride = dst_strides[contiguous],
+				 column_stride = src_strides[last];
+	// elements per index of the dimensions before `contiguous`
+	const size_t outer_size = rows * row_stride;
+	std::vector<size_t> mid(last - contiguous - 1, 0);
+	const auto copy_element = [&](size_t dst, size_t src) {
+		if (dst >= from && dst < end)
+			result[dst] = data[src];
+	};
+	for (size_t outer = from / outer_size; outer * outer_size < end;
+		 outer++) {
+		const size_t dst_outer = outer * outer_size;
+		size_t src_outer = 0;
+		for (int d = 0; d < contiguous; d++)
+			src_outer +=
+				(dst_outer / dst_strides[d]) % shape[d] * src_strides[d];
+		// rows of `contiguous` that intersect the range
+		const size_t lo = std::max(from, dst_outer) - dst_outer,
+					 hi = std::min(end, dst_outer + outer_size) - dst_outer;
+		const size_t first_row = lo / row_stride,
+					 last_row = (hi - 1) / row_stride + 1;
+		for (size_t i0 = first_row; i0 < last_row; i0 += TRANSPOSE_BLOCK) {
+			const size_t i1 = std::min(last_row, i0 + TRANSPOSE_BLOCK);
+			std::fill(mid.begin(), mid.end(), 0);
+			for (bool more = true; more;) {
+				size_t dst = dst_outer + i0 * row_stride, src = src_outer + i0;
+				for (size_t k = 0; k < mid.size(); k++) {
+					dst += mid[k] * dst_strides[contiguous + 1 + k];
+					src += mid[k] * src_strides[contiguous + 1 + k];
+				}
+				for (size_t j0 = 0; j0 < columns; j0 += TRANSPOSE_BLOCK) {
+					const size_t j1 = std::min(columns, j0 + TRANSPOSE_BLOCK);
+					for (size_t i = 0; i < i1 - i0; i += TRANSPOSE_MICRO)
+						for (size_t j = j0; j < j1; j += TRANSPOSE_MICRO) {
+							const size_t mi =
+											 std::min((size_t)TRANSPOSE_MICRO,
+													  i1 - i0 - i),
+										 mj = std::min((size_t)TRANSPOSE_MICRO,
+													   j1 - j);
+							// first and behind the last written element
+							const size_t d0 = dst + i * row_stride + j,
+										 d1 = d0 + (mi - 1) * row_stride + mj;
+							if (d1 <= from || d0 >= end)
+								continue;
+							if (mi == TRANSPOSE_MICRO &&
+								mj == TRANSPOSE_MICRO && d0 >= from &&
+								d1 <= end)
+								transpose_micro(result + d0, row_stride,
+												data + src + i +
+													j * column_stride,
+												column_stride);
+							else
+								for (size_t a = 0; a < mi; a++)
+									for (size_t b = 0; b < mj; b++)
+										copy_element(
+											d0 + a * row_stride + b,
+											src + i + a +
+												(j + b) * column_stride);
+						}
+				}
+				// next index of the dimensions inbetween
+				more = false;
+				for (int k = (int)mid.size() - 1; k >= 0; k--) {
+					if (++mid[k] < shape[contiguous + 1 + k]) {
+						more = true;
+						break;
+					}
+					mid[k] = 0;
+				}
+			}
+		}
+	}
+}
+#endif
@@ -13,6 +13,7 @@
  * limitations under the License. */
 #include "unary_arithmetic.hpp"
 #include "../utils.hpp"
+#include "fast_math.hpp"
 #include "flint.h"
 
 using namespace std;
@@ -65,6 +66,14 @@ template <typename T, typename A>
 void LogImpl::unary_expression(T *__restrict__ result,
 							   const A *__restrict__ data, size_t from,
 							   size_t size, const FGraphNode *curr) {
+	if constexpr (is_same_v<T, A> && is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			fast_unary(result, data, from, size, curr,
+					   [](T x) { return fast_log(x); },
+					   [](T) { return true; },
+					   [](T x) { return (T)log(x); });
+			return;
+		}
 	for (size_t i = from; i < from + size; i++)
 		result[i] =
 			log(data[curr->predecessors[0]->operation.op_type == FGEN_CONSTANT
@@ -108,6 +117,14 @@ template <typename T, typename A>
 void Log2Impl::unary_expression(T *__restrict__ result,
 								const A *__restrict__ data, size_t from,
 								size_t size, const FGraphNode *curr) {
+	if constexpr (is_same_v<T, A> && is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			fast_unary(result, data, from, size, curr,
+					   [](T x) { return fast_log2(x); },
+					   [](T) { return true; },
+					   [](T x) { return (T)log2(x); });
+			return;
+		}
 	for (size_t i = from; i < from + size; i++)
 		result[i] =
 			log2(data[curr->predecessors[0]->operation.op_type == FGEN_CONSTANT
@@ -151,6 +168,14 @@ template <typename T, typename A>
 void Log10Impl::unary_expression(T *__restrict__ result,
 								 const A *__restrict__ data, size_t from,
 								 size_t size, const FGraphNode *curr) {
+	if constexpr (is_same_v<T, A> && is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			fast_unary(result, data, from, size, curr,
+					   [](T x) { return fast_log10(x); },
+					   [](T) { return true; },
+					   [](T x) { return (T)log10(x); });
+			return;
+		}
 	for (size_t i = from; i < from + size; i++)
 		result[i] =
 			log10(data[curr->predecessors[0]->operation.op_type == FGEN_CONSTANT
@@ -242,7 +267,31 @@ void EvenImpl::execute_cpu(const FGraphNode *node,
 					? 0
 					: 1;
 			break;
+		case F_INT8:
+			((int *__restrict__)result)[i] =
+				((int8_t *__restrict__)predecessor_data[0]
+					 .data)[node->predecessors[0]->operation.op_type ==
+									FGEN_CONSTANT
+								? 0
+								: i] %
+						2
+					? 0
+					: 1;
+			break;
+		case F_UINT8:
+			((int *__restrict__)result)[i] =
+				((uint8_t *__restrict__)predecessor_data[0]
+					 .data)[node->predecessors[0]->operation.op_type ==
+									FGEN_CONSTANT
+								? 0
+								: i] %
+						2
+					? 0
+					: 1;
+			break;
 		case F_FLOAT32:
+		case F_FLOAT16:
+		case F_BFLOAT16:
 			((int *__restrict__)
 				 result)[node->predecessors[0]->operation.op_type ==
 								 FGEN_CONSTANT
@@ -284,6 +333,14 @@ template <typename T, typename A>
 void SinImpl::unary_expression(T *__restrict__ result,
 							   const A *__restrict__ data, size_t from,
 							   size_t size, const FGraphNode *curr) {
+	if constexpr (is_same_v<T, A> && is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			fast_unary(result, data, from, size, curr,
+					   [](T x) { return fast_sin(x); },
+					   [](T x) { return fast_trig_valid(x); },
+					   [](T x) { return (T)sin(x); });
+			return;
+		}
 	for (size_t i = from; i < from + size; i++)
 		result[i] =
 			sin(data[curr->predecessors[0]->operation.op_type == FGEN_CONSTANT
@@ -320,6 +377,14 @@ template <typename T, typename A>
 void CosImpl::unary_expression(T *__restrict__ result,
 							   const A *__restrict__ data, size_t from,
 							   size_t size, const FGraphNode *curr) {
+	if constexpr (is_same_v<T, A> && is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			fast_unary(result, data, from, size, curr,
+					   [](T x) { return fast_cos(x); },
+					   [](T x) { return fast_trig_valid(x); },
+					   [](T x) { return (T)cos(x); });
+			return;
+		}
 	for (size_t i = from; i < from + size; i++)
 		result[i] =
 			cos(data[curr->predecessors[0]->operation.op_type == FGEN_CONSTANT
@@ -356,6 +421,14 @@ template <typename T, typename A>
 void TanImpl::unary_expression(T *__restrict__ result,
 							   const A *__restrict__ data, size_t from,
 							   size_t size, const FGraphNode *curr) {
+	if constexpr (is_same_v<T, A> && is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			fast_unary(result, data, from, size, curr,
+					   [](T x) { return fast_tan(x); },
+					   [](T x) { return fast_trig_valid(x); },
+					   [](T x) { return (T)tan(x); });
+			return;
+		}
 	for (size_t i = from; i < from + size; i++)
 		result[i] =
 			tan(data[curr->predecessors[0]->operation.op_type == FGEN_CONSTANT
@@ -500,6 +573,14 @@ template <typename T, typename A>
 void SqrtImpl::unary_expression(T *__restrict__ result,
 								const A *__restrict__ data, size_t from,
 								size_t size, const FGraphNode *curr) {
+	if constexpr (is_same_v<T, A> && is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			fast_unary(result, data, from, size, curr,
+					   [](T x) { return fast_sqrt(x); },
+					   [](T x) { return fast_sqrt_valid(x); },
+					   [](T x) { return (T)sqrt(x); });
+			return;
+		}
 	for (size_t i = from; i < from + size; i++)
 		result[i] =
 			sqrt(data[curr->predecessors[0]->operation.op_type == FGEN_CONSTANT
@@ -536,6 +617,14 @@ template <typename T, typename A>
 void ExpImpl::unary_expression(T *__restrict__ result,
 							   const A *__restrict__ data, size_t from,
 							   size_t size, const FGraphNode *curr) {
+	if constexpr (is_same_v<T, A> && is_floating_point_v<T>)
+		if (fMathAccuracy() == F_FAST_MATH) {
+			fast_unary(result, data, from, size, curr,
+					   [](T x) { return fast_exp(x); },
+					   [](T) { return true; },
+					   [](T x) { return (T)exp(x); });
+			return;
+		}
 	for (size_t i = from; i < from + size; i++)
 		result[i] =
 			exp(data[curr->predecessors[0]->operation.op_type == FGEN_CONSTANT
@@ -55,6 +55,7 @@ struct NegImpl : OperationImplementation {
 		virtual int operation_score(FGraphNode *node) override { return 1; }
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -93,6 +94,7 @@ struct LogImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -131,6 +133,7 @@ struct Log2Impl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -169,6 +172,7 @@ struct Log10Impl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -212,6 +216,7 @@ struct SignImpl : OperationImplementation {
 					{F_INT32, F_FLOAT32},
 					{F_INT32, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {type_size(node->predecessors[0]->operation.data_type) ==
@@ -249,6 +254,7 @@ struct EvenImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_INT32, F_INT32}, {F_INT32, F_INT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {type_size(node->predecessors[0]->operation.data_type) ==
@@ -288,6 +294,7 @@ struct SinImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -326,6 +333,7 @@ struct CosImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -364,6 +372,7 @@ struct TanImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -402,6 +411,7 @@ struct ASinImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -440,6 +450,7 @@ struct ACosImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -478,6 +489,7 @@ struct ATanImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -516,6 +528,7 @@ struct SqrtImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -554,6 +567,7 @@ struct ExpImpl : OperationImplementation {
 		kernel_type_combinations(const FGraphNode *node) override {
 			return {{F_FLOAT32, F_FLOAT32}, {F_FLOAT64, F_FLOAT64}};
 		}
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -588,6 +602,7 @@ struct AbsImpl : OperationImplementation {
 		virtual int operation_score(FGraphNode *node) override { return 1; }
 		FGraphNode *local_gradient(FGraphNode *y, int dx_i,
 								   FGraphNode *prev_adj) override;
+		bool is_elementwise() override { return true; }
 		std::vector<bool>
 		reuse_parameter_result(const FGraphNode *node) override {
 			return {true};
@@ -0,0 +1,204 @@
+/* Copyright 2023 David Schwarzbeck
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. */
+#ifndef FLINT_WINOGRAD_HPP
+#define FLINT_WINOGRAD_HPP
+#include "gemm.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Winograd convolution F(m x m, 3 x 3) of the cpu backend (Lavin and Gray,
+ * "Fast Algorithms for Convolutional Neural Networks"). The output is
+ * computed in tiles of `m x m` pixels from input tiles of `alpha = m + 2`
+ * pixels per dimension: `Y = A^T [(G g G^T) . (B^T d B)] A`. The elementwise
+ * products are summed over the channels by one matrix multiplication per
+ * element of the transformed tiles for a block of tiles, so the convolution
+ * needs `(alpha / m)^2` times fewer multiplications than the direct one.
+ */
+
+// tiles that are transformed and multiplied together
+#define WINOGRAD_TILE_BLOCK 32
+
+template <int m> struct WinogradMatrices;
+template <> struct WinogradMatrices<2> {
+		static constexpr int alpha = 4;
+		static constexpr double BT[4][4] = {
+			{1, 0, -1, 0}, {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, 0, -1}};
+		static constexpr double G[4][3] = {
+			{1, 0, 0}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}, {0, 0, 1}};
+		static constexpr double AT[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+};
+template <> struct WinogradMatrices<4> {
+		static constexpr int alpha = 6;
+		static constexpr double BT[6][6] = {
+			{4, 0, -5, 0, 1, 0},  {0, -4, -4, 1, 1, 0}, {0, 4, -4, -1, 1, 0},
+			{0, -2, -1, 2, 1, 0}, {0, 2, -1, -2, 1, 0}, {0, 4, 0, -5, 0, 1}};
+		static constexpr double G[6][3] = {
+			{1.0 / 4, 0, 0},
+			{-1.0 / 6, -1.0 / 6, -1.0 / 6},
+			{-1.0 / 6, 1.0 / 6, -1.0 / 6},
+			{1.0 / 24, 1.0 / 12, 1.0 / 6},
+			{1.0 / 24, -1.0 / 12, 1.0 / 6},
+			{0, 0, 1}};
+		static constexpr double AT[4][6] = {{1, 1, 1, 1, 1, 0},
+											{0, 1, -1, 2, -2, 0},
+											{0, 1, 1, 4, 4, 0},
+											{0, 1, -1, 8, -8, 1}};
+};
+/**
+ * `out = L * in * L^T` for a `R x K` matrix `L` and a `K x K` matrix `in`,
+ * both of whose elements are vectors of `n` values. Element `(i, j)` of `in`
+ * starts at `in[(i * K + j) * in_stride]`, element `(i, j)` of `out` at
+ * `out[(i * R + j) * out_stride]`. `tmp` holds `R * K * n` values.
+ */
+template <int R, int K, typename T, typename S>
+inline void winograd_transform(const double (&L)[R][K],
+							   const S *__restrict__ in, size_t in_stride,
+							   T *__restrict__ out, size_t out_stride, size_t n,
+							   T *__restrict__ tmp) {
+	for (int i = 0; i < R; i++)
+		for (int l = 0; l < K; l++) {
+			T *t = tmp + (i * K + l) * n;
+			std::fill(t, t + n, (T)0);
+			for (int k = 0; k < K; k++) {
+				if (L[i][k] == 0)
+					continue;
+				const T c = (T)L[i][k];
+				const S *src = in + (k * K + l) * in_stride;
+				for (size_t v = 0; v < n; v++)
+					t[v] += c * (T)src[v];
+			}
+		}
+	for (int i = 0; i < R; i++)
+		for (int j = 0; j < R; j++) {
+			T *o = out + (i * R + j) * out_stride;
+			std::fill(o, o + n, (T)0);
+			for (int l = 0; l < K; l++) {
+				if (L[j][l] == 0)
+					continue;
+				const T c = (T)L[j][l];
+				const T *t = tmp + (i * K + l) * n;
+				for (size_t v = 0; v < n; v++)
+					o[v] += c * t[v];
+			}
+		}
+}
+/**
+ * Elements `[from, from + size)` of the convolution of `batch` images of
+ * shape `[height, width, channels]` with `filters` kernels of shape
+ * `[3, 3, channels]` and step 1. The result has the shape `[batch, height -
+ * 2, width - 2, filters]`. Only the tiles that overlap the range are
+ * computed.
+ */
+template <int m, typename T, typename A, typename B>
+void winograd_convolve(T *__restrict__ result, const A *__restrict__ image,
+					   const B *__restrict__ kernel, size_t height,
+					   size_t width, size_t channels, size_t filters,
+					   size_t from, size_t size) {
+	using W = WinogradMatrices<m>;
+	constexpr int alpha = W::alpha;
+	constexpr size_t block = WINOGRAD_TILE_BLOCK;
+	const size_t out_h = height - 2, out_w = width - 2;
+	const size_t tiles_h = (out_h + m - 1) / m, tiles_w = (out_w + m - 1) / m;
+	const size_t end = from + size;
+	std::vector<T> tmp(alpha * alpha * std::max(channels, filters));
+	// transformed filters, `[alpha * alpha, filters, channels]`
+	std::vector<T> u(alpha * alpha * filters * channels);
+	for (size_t f = 0; f < filters; f++)
+		winograd_transform(W::G, kernel + f * 9 * channels, channels,
+						   u.data() + f * channels, filters * channels,
+						   channels, tmp.data());
+	// transformed input tiles `[alpha * alpha, block, channels]` and their
+	// products with the filters `[alpha * alpha, block, filters]`
+	std::vector<T> v(alpha * alpha * block * channels),
+		p(alpha * alpha * block * filters), patch(alpha * alpha * channels),
+		y(m * m * filters);
+	GemmWorkspace<T> workspace;
+	struct Tile {
+			size_t b, ty, tx;
+	};
+	std::vector<Tile> tiles;
+	tiles.reserve(block);
+	const auto process = [&]() {
+		const size_t count = tiles.size();
+		for (size_t t = 0; t < count; t++) {
+			const Tile &tile = tiles[t];
+			for (int i = 0; i < alpha; i++)
+				for (int j = 0; j < alpha; j++) {
+					const size_t py = tile.ty * m + i, px = tile.tx * m + j;
+					T *dst = patch.data() + (i * alpha + j) * channels;
+					if (py < height && px < width) {
+						const A *src =
+							image + ((tile.b * height + py) * width + px) *
+										channels;
+						for (size_t c = 0; c < channels; c++)
+							dst[c] = (T)src[c];
+					} else
+						std::fill(dst, dst + channels, (T)0);
+				}
+			winograd_transform(W::BT, patch.data(), channels,
+							   v.data() + t * channels, block * channels,
+							   channels, tmp.data());
+		}
+		for (int xi = 0; xi < alpha * alpha; xi++)
+			gemm(count, filters, channels, v.data() + xi * block * channels,
+				 channels, 1, u.data() + xi * filters * channels, 1, channels,
+				 p.data() + xi * block * filters, filters, workspace);
+		for (size_t t = 0; t < count; t++) {
+			const Tile &tile = tiles[t];
+			winograd_transform(W::AT, p.data() + t * filters, block * filters,
+							   y.data(), filters, filters, tmp.data());
+			for (int i = 0; i < m; i++)
+				for (int j = 0; j < m; j++) {
+					const size_t oy = tile.ty * m + i, ox = tile.tx * m + j;
+					if (oy >= out_h || ox >= out_w)
+						continue;
+					const size_t base =
+						((tile.b * out_h + oy) * out_w + ox) * filters;
+					if (base >= end || base + filters <= from)
+						continue;
+					const size_t lo = std::max(base, from) - base,
+								 hi = std::min(base + filters, end) - base;
+					const T *src = y.data() + (i * m + j) * filters;
+					for (size_t f = lo; f < hi; f++)
+						result[base + f] = src[f];
+				}
+		}
+		tiles.clear();
+	};
+	// rows of tiles (over all images) that contain the range
+	const size_t first_row = from / filters / out_w,
+				 last_row = (end - 1) / filters / out_w;
+	const size_t first = first_row / out_h * tiles_h + first_row % out_h / m,
+				 last = last_row / out_h * tiles_h + last_row % out_h / m;
+	for (size_t row = first; row <= last; row++) {
+		const size_t b = row / tiles_h, ty = row % tiles_h;
+		const size_t y0 = b * out_h + ty * m,
+					 y1 = b * out_h + std::min(ty * m + m, out_h) - 1;
+		for (size_t tx = 0; tx < tiles_w; tx++) {
+			const size_t x1 = std::min(tx * m + m, out_w) - 1;
+			// first and last element of the tile
+			if ((y1 * out_w + x1 + 1) * filters <= from ||
+				(y0 * out_w + tx * m) * filters >= end)
+				continue;
+			tiles.push_back({b, ty, tx});
+			if (tiles.size() == block)
+				process();
+		}
+	}
+	if (!tiles.empty())
+		process();
+}
+#endif
@@ -17,15 +17,19 @@
 #include "../flint.h"
 #include "../flint_helper.hpp"
 #include "src/errors.hpp"
+#include "src/memory_pool.hpp"
 #include "src/operations/implementation.hpp"
 #include <cmath>
 #include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <limits>
 #include <list>
 #include <mutex>
 #include <queue>
 #include <stdexcept>
+#include <unordered_set>
 #include <vector>
 
 template <typename T> inline T *safe_mal(unsigned int count) {
@@ -38,6 +42,34 @@ template <typename T> inline T *safe_mal(unsigned int count) {
 	}
 	return data;
 }
+/** Like `safe_mal`, but allocates the data of a tensor from the buffer pool
+ * (see `pool_allocate`). The memory is not initialized and has to be released
+ * with `pool_free`. */
+template <typename T> inline T *safe_mal_pooled(size_t count) {
+	T *data = (T *)pool_allocate(count * sizeof(T));
+	if (!data) {
+		setErrorType(OUT_OF_MEMORY);
+		flogging(F_ERROR, "Could not malloc '" +
+							  std::to_string(sizeof(T) * count) + "' bytes!");
+		return nullptr;
+	}
+	return data;
+}
+/** Value of the environment variable `name` or `other` if it is not set */
+inline std::string environment_or(const char *name, std::string other) {
+	const char *value = std::getenv(name);
+	return value && *value ? std::string(value) : other;
+}
+/** Directory for files that are kept between runs ($XDG_CACHE_HOME/flint or
+ * ~/.cache/flint), it is not created by this function. */
+inline std::string cache_directory() {
+	const std::string home = environment_or("HOME", "");
+	return environment_or("XDG_CACHE_HOME",
+						  home.empty()
+							  ? std::filesystem::temp_directory_path().string()
+							  : home + "/.cache") +
+		   "/flint";
+}
 extern const char *fop_to_string[];
 template <typename T>
 static inline std::string vector_string(const std::vector<T> &vec,
@@ -92,31 +124,63 @@ template <typename T> static std::string print_node(FGraphNode *node) {
 	int b = 0;
 	return print_node<T>(node, 0, &b);
 }
+/**
+ * Returns `root` and its (transitive) predecessors in topological order, i.e.
+ * every node after all of its predecessors and `root` last. Predecessor `i`
+ * of a node is only visited if `follow(node, i)` returns true (which is
+ * called at most once per node that has not been visited yet). Iterative
+ * depth first search, so it runs in linear time and does not overflow the
+ * stack on very deep graphs.
+ */
+template <typename Node, typename Follow>
+inline std::vector<Node *> topological_sort(Node *root, Follow follow) {
+	std::vector<Node *> order;
+	std::unordered_set<const FGraphNode *> visited;
+	// node and index of the next predecessor to visit
+	std::vector<std::pair<Node *, int>> stack;
+	visited.insert(root);
+	stack.push_back({root, 0});
+	while (!stack.empty()) {
+		Node *node = stack.back().first;
+		const int i = stack.back().second++;
+		if (i < node->num_predecessor) {
+			Node *pred = node->predecessors[i];
+			if (!visited.contains(pred) && follow(node, i)) {
+				visited.insert(pred);
+				stack.push_back({pred, 0});
+			}
+		} else {
+			order.push_back(node);
+			stack.pop_back();
+		}
+	}
+	return order;
+}
 static inline size_t compute_score(FGraphNode *g, bool with_pred = true) {
-	std::queue<FGraphNode *> todo;
 	size_t score = 0;
-	todo.push(g);
-	while (!todo.empty()) {
-		FGraphNode *c = todo.front();
-		todo.pop();
+	const std::vector<FGraphNode *> nodes =
+		topological_sort(g, [with_pred](FGraphNode *c, int i) {
+			return with_pred && !c->predecessors[i]->result_data &&
+				   c->operation.op_type != FSTORE;
+		});
+	for (FGraphNode *c : nodes)
 		score += OperationImplementation::implementations[c->operation.op_type]
 					 ->operation_score(c);
-		if (with_pred) {
-			for (int i = 0; i < c->num_predecessor; i++)
-				if (!c->predecessors[i]->result_data &&
-					c->operation.op_type != FSTORE)
-					todo.push(c->predecessors[i]);
-		}
-	}
 	return score;
 }
+/** Type of generated kernels, the 16bit types are computed (and stored on the
+ * gpu) as float, the 8bit types as int */
 inline std::string type_string(FType t) {
 	switch (t) {
 	case F_INT32:
+	case F_INT8:
+	case F_UINT8:
 		return "int";
 	case F_INT64:
 		return "long";
 	case F_FLOAT32:
+	case F_FLOAT16:
+	case F_BFLOAT16:
 		return "float";
 	case F_FLOAT64:
 		return "double";
@@ -133,9 +197,34 @@ inline size_t type_size(FType t) {
 		return sizeof(float);
 	case F_FLOAT64:
 		return sizeof(double);
+	case F_FLOAT16:
+		return sizeof(Float16);
+	case F_BFLOAT16:
+		return sizeof(BFloat16);
+	case F_INT8:
+		return sizeof(int8_t);
+	case F_UINT8:
+		return sizeof(uint8_t);
 	}
 	return 1;
 }
+/** If `t` is one of the 16bit or 8bit storage types */
+inline bool is_narrow_type(FType t) {
+	return t == F_FLOAT16 || t == F_BFLOAT16 || t == F_INT8 || t == F_UINT8;
+}
+/** The type values of type `t` are computed in, see `type_string` */
+inline FType widened_type(FType t) {
+	switch (t) {
+	case F_FLOAT16:
+	case F_BFLOAT16:
+		return F_FLOAT32;
+	case F_INT8:
+	case F_UINT8:
+		return F_INT32;
+	default:
+		return t;
+	}
+}
 inline std::vector<size_t> calc_acc_sizes(const int dimensions,
 										const size_t *shape) {
 	std::vector<size_t> acc_sizes(dimensions);
@@ -171,6 +260,10 @@ static std::string epsilon_for_type(FType type) {
 	switch (type) {
 	case F_FLOAT32:
 		return "FLT_EPSILON";
+	case F_FLOAT16:
+		return "0.0009765625f";
+	case F_BFLOAT16:
+		return "0.0078125f";
 	case F_FLOAT64:
 		return "DBL_EPSILON";
 	default:
@@ -180,10 +273,14 @@ static std::string epsilon_for_type(FType type) {
 static std::string max_for_type(FType type) {
 	switch (type) {
 	case F_FLOAT32:
+	case F_FLOAT16:
+	case F_BFLOAT16:
 		return "FLT_MAX";
 	case F_FLOAT64:
 		return "DBL_MAX";
 	case F_INT32:
+	case F_INT8:
+	case F_UINT8:
 		return "INT_MAX";
 	case F_INT64:
 		return "LONG_MAX";
@@ -193,10 +290,14 @@ static std::string max_for_type(FType type) {
 static std::string min_for_type(FType type) {
 	switch (type) {
 	case F_FLOAT32:
+	case F_FLOAT16:
+	case F_BFLOAT16:
 		return "-FLT_MAX";
 	case F_FLOAT64:
 		return "-DBL_MAX";
 	case F_INT32:
+	case F_INT8:
+	case F_UINT8:
 		return "INT_MIN";
 	case F_INT64:
 		return "LONG_MIN";
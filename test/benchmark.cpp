@@ -1,7 +1,9 @@
 #include "../flint.hpp"
 #include "../flint_helper.hpp"
+#include "../src/backend_cpu/thread_pool.hpp"
 #include "plf_nanotimer.h"
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 using namespace plf;
 using namespace std;
@@ -125,17 +127,581 @@ double convolve_grad_fun() {
 	}
 	return timer.get_elapsed_ms();
 }
-void call_benchmarks(int benchmarks = FLINT_BACKEND_BOTH) {
+/**
+ * Measures the time the CPU scheduler needs to split a small node into one
+ * task per thread, run it and wait for it, for growing thread counts.
+ */
+void dispatch_overhead() {
+	const size_t size = 1024;
+	const int iterations = 20000;
+	std::vector<float> d1(size, 1.f), d2(size, 2.f), res(size);
+	const size_t shape = size;
+	FGraphNode *a = fCreateGraph(d1.data(), size, F_FLOAT32, &shape, 1);
+	FGraphNode *b = fCreateGraph(d2.data(), size, F_FLOAT32, &shape, 1);
+	FGraphNode *c = fadd(a, b);
+	c->reference_counter++;
+	const std::vector<CPUResultData> pred_data = {
+		{d1.data(), F_FLOAT32, false, size, {size}},
+		{d2.data(), F_FLOAT32, false, size, {size}}};
+	size_t max_threads = std::thread::hardware_concurrency();
+	if (max_threads < 8)
+		max_threads = 8;
+	std::cout << "+---------+------------------------+" << std::endl;
+	std::cout << "| threads | dispatch per node (us) |" << std::endl;
+	std::cout << "+---------+------------------------+" << std::endl;
+	for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+		WorkStealingPool pool(threads);
+		nanotimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; i++)
+			pool.execute_parallel(c, pred_data, res.data(), size, threads);
+		const double us = timer.get_elapsed_us() / iterations;
+		string t = to_string(threads), d = to_string(us);
+		t.resize(7, ' ');
+		d.resize(22, ' ');
+		std::cout << "| " << t << " | " << d << " |" << std::endl;
+	}
+	std::cout << "+---------+------------------------+" << std::endl;
+	c->reference_counter--;
+	fFreeGraph(c);
+}
+/**
+ * Measures the lazy execution of graphs with growing numbers of nodes. Each
+ * node is used by two others (x_{k+1} = x_k + x_{k-1}), so nothing is fused
+ * and the scheduler has to handle every node, the time per node should stay
+ * constant.
+ */
+void graph_scheduling() {
+	const bool eager = fIsEagerExecution();
+	fDisableEagerExecution();
+	const string line = "+---------+------------------+------------------+";
+	std::cout << line << std::endl;
+	std::cout << "| nodes   | total (ms)       | per node (us)    |"
+			  << std::endl;
+	std::cout << line << std::endl;
+	for (size_t nodes = 100; nodes <= 1000000; nodes *= 10) {
+		const size_t shape = 4;
+		FGraphNode *prev = fconstant_f(0.f, &shape, 1);
+		FGraphNode *curr = fconstant_f(0.f, &shape, 1);
+		for (size_t i = 2; i < nodes; i++) {
+			FGraphNode *next = fadd(curr, prev);
+			prev = curr;
+			curr = next;
+		}
+		curr->reference_counter++;
+		nanotimer timer;
+		timer.start();
+		fExecuteGraph_cpu(curr);
+		const double ms = timer.get_elapsed_ms();
+		curr->reference_counter--;
+		fFreeGraph(curr);
+		string n = to_string(nodes), t = to_string(ms),
+			   p = to_string(ms * 1000 / nodes);
+		n.resize(7, ' ');
+		t.resize(16, ' ');
+		p.resize(16, ' ');
+		std::cout << "| " << n << " | " << t << " | " << p << " |" << std::endl;
+	}
+	std::cout << line << std::endl;
+	if (eager)
+		fEnableEagerExecution();
+}
+/**
+ * Measures elementwise additions of a 512x2048 matrix with an operand of each
+ * broadcasting class: same shape, scalar, a row that is broadcast over the
+ * leading dimension and a column that is inversely broadcast.
+ */
+void binary_broadcasting() {
+	const bool eager = fIsEagerExecution();
+	fDisableEagerExecution();
+	const int iterations = 20;
+	const size_t rows = 512, cols = 2048;
+	const size_t shape[2] = {rows, cols}, one = 1;
+	FGraphNode *a = frandom(shape, 2);
+	FGraphNode *operands[4] = {frandom(shape, 2), fconstant_f(2.f, &one, 1),
+							   frandom(&cols, 1), frandom(&rows, 1)};
+	const char *names[4] = {"same shape", "scalar", "broadcast", "inverse"};
+	a->reference_counter++;
+	fExecuteGraph_cpu(a);
+	for (FGraphNode *b : operands) {
+		b->reference_counter++;
+		fExecuteGraph_cpu(b);
+	}
+	const string line = "+------------+------------------+------------------+";
+	std::cout << line << std::endl;
+	std::cout << "| operand    | per add (ms)     | per element (ns) |"
+			  << std::endl;
+	std::cout << line << std::endl;
+	for (int k = 0; k < 4; k++) {
+		nanotimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; i++) {
+			FGraphNode *c = fadd(a, operands[k]);
+			c->reference_counter++;
+			fExecuteGraph_cpu(c);
+			c->reference_counter--;
+			fFreeGraph(c);
+		}
+		const double ms = timer.get_elapsed_ms() / iterations;
+		string n = names[k], t = to_string(ms),
+			   e = to_string(ms * 1e6 / (rows * cols));
+		n.resize(10, ' ');
+		t.resize(16, ' ');
+		e.resize(16, ' ');
+		std::cout << "| " << n << " | " << t << " | " << e << " |" << std::endl;
+	}
+	std::cout << line << std::endl;
+	a->reference_counter--;
+	fFreeGraph(a);
+	for (FGraphNode *b : operands) {
+		b->reference_counter--;
+		fFreeGraph(b);
+	}
+	if (eager)
+		fEnableEagerExecution();
+}
+// the matrix multiplication kernel before the blocked implementation
+template <typename T>
+static void reference_matmul(T *result, const T *data1, const T *data2,
+							 size_t l, size_t m, size_t n) {
+	const size_t num_entries0 = l * m, num_entries1 = m * n;
+	for (size_t index = 0; index < l * n; index++) {
+		result[index] = 0;
+		size_t j = (index % (l * n)) / n;
+		size_t k = (index % (l * n)) % n;
+		for (size_t i = 0; i < m; i++)
+			result[index] += data1[(j * m + i) % num_entries0] *
+							 data2[(i * n + k) % num_entries1];
+	}
+}
+void matmul_gflops() {
+	const bool eager = fIsEagerExecution();
+	fDisableEagerExecution();
+	const string line = "+------+---------+------------------+---------------"
+						"---+------------------+";
+	std::cout << "GFLOP/s of square matrix multiplications" << std::endl;
+	std::cout << line << std::endl;
+	std::cout << "| size | type    | reference kernel | blocked          "
+				 "| blocked 1 thread |"
+			  << std::endl;
+	std::cout << line << std::endl;
+	const unsigned int threads = fNumThreads_cpu();
+	for (FType type : {F_FLOAT32, F_FLOAT64}) {
+		for (size_t size : {64, 128, 256, 512, 1024}) {
+			const size_t shape[2] = {size, size};
+			const double flops = 2.0 * size * size * size;
+			FGraphNode *a = fconvert(frandom(shape, 2), type);
+			FGraphNode *b = fconvert(frandom(shape, 2), type);
+			a->reference_counter++;
+			b->reference_counter++;
+			fExecuteGraph_cpu(a);
+			fExecuteGraph_cpu(b);
+			// enough repetitions for about 1e9 flops, at least one
+			const int iterations = std::max(1, (int)(1e9 / flops));
+			nanotimer timer;
+			std::vector<char> reference(size * size * sizeof(double));
+			timer.start();
+			// the reference kernel is much slower, it is run once
+			if (type == F_FLOAT32)
+				reference_matmul((float *)reference.data(),
+								 (float *)a->result_data->data,
+								 (float *)b->result_data->data, size, size,
+								 size);
+			else
+				reference_matmul((double *)reference.data(),
+								 (double *)a->result_data->data,
+								 (double *)b->result_data->data, size, size,
+								 size);
+			const double old_gflops = flops / timer.get_elapsed_ns();
+			double gflops[2];
+			// the second measurement only differs with more threads
+			for (int single = 0; single < (threads > 1 ? 2 : 1); single++) {
+				if (single)
+					fConfigureThreads_cpu(1, nullptr, nullptr);
+				timer.start();
+				for (int i = 0; i < iterations; i++) {
+					FGraphNode *c = fmatmul(a, b);
+					c->reference_counter++;
+					fExecuteGraph_cpu(c);
+					c->reference_counter--;
+					fFreeGraph(c);
+				}
+				gflops[single] =
+					flops * iterations / timer.get_elapsed_ns();
+			}
+			if (threads > 1)
+				fConfigureThreads_cpu(threads, nullptr, nullptr);
+			else
+				gflops[1] = gflops[0];
+			string n = to_string(size), o = to_string(old_gflops),
+				   p = to_string(gflops[0]), q = to_string(gflops[1]);
+			n.resize(4, ' ');
+			o.resize(16, ' ');
+			p.resize(16, ' ');
+			q.resize(16, ' ');
+			std::cout << "| " << n << " | "
+					  << (type == F_FLOAT32 ? "float32" : "float64") << " | "
+					  << o << " | " << p << " | " << q << " |" << std::endl;
+			a->reference_counter--;
+			b->reference_counter--;
+			fFreeGraph(a);
+			fFreeGraph(b);
+		}
+	}
+	std::cout << line << std::endl;
+	if (eager)
+		fEnableEagerExecution();
+}
+/**
+ * GFLOP/s of convolutions with the shapes of typical layers (images
+ * `batch x height x width x channels` and `filters` kernels of size
+ * `kernel x kernel`), forward and both gradients.
+ */
+void convolution_gflops() {
+	const bool eager = fIsEagerExecution();
+	fDisableEagerExecution();
+	struct Layer {
+			size_t batch, size, channels, filters, kernel;
+			unsigned int step;
+	};
+	const Layer layers[] = {{8, 32, 3, 8, 3, 1},	 {8, 32, 16, 32, 3, 1},
+							{8, 16, 64, 64, 3, 1}, {8, 28, 32, 32, 1, 1},
+							{4, 64, 3, 16, 7, 2},	 {8, 16, 32, 64, 3, 2}};
+	const string line = "+---------------+-------------+------+--------------"
+						"----+------------------+";
+	std::cout << "GFLOP/s of float32 convolutions" << std::endl;
+	std::cout << line << std::endl;
+	std::cout << "| image         | kernels     | step | forward          "
+				 "| gradients        |"
+			  << std::endl;
+	std::cout << line << std::endl;
+	for (const Layer &l : layers) {
+		const size_t image_shape[4] = {l.batch, l.size, l.size, l.channels};
+		const size_t kernel_shape[5] = {l.filters, 1, l.kernel, l.kernel,
+										l.channels};
+		const unsigned int steps[3] = {1, l.step, l.step};
+		const size_t windows = (l.size - l.kernel) / l.step + 1;
+		const double flops = 2.0 * l.batch * windows * windows * l.filters *
+							 l.kernel * l.kernel * l.channels;
+		FGraphNode *x = fconvert(frandom(image_shape, 4), F_FLOAT32);
+		FGraphNode *k = fconvert(frandom(kernel_shape, 5), F_FLOAT32);
+		const size_t result_shape[4] = {l.batch, windows, windows, l.filters};
+		FGraphNode *w = fconvert(frandom(result_shape, 4), F_FLOAT32);
+		for (FGraphNode *n : {x, k, w}) {
+			n->reference_counter++;
+			fExecuteGraph_cpu(n);
+		}
+		fMarkGradientVariable(x);
+		fMarkGradientVariable(k);
+		// enough repetitions for about 1e9 flops, at least one
+		const int iterations = std::max(1, (int)(1e9 / flops));
+		nanotimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; i++) {
+			FGraphNode *y = fconvolve(x, k, steps);
+			y->reference_counter++;
+			fExecuteGraph_cpu(y);
+			y->reference_counter--;
+			fFreeGraph(y);
+		}
+		const double forward = flops * iterations / timer.get_elapsed_ns();
+		timer.start();
+		for (int i = 0; i < iterations; i++) {
+			fStartGradientContext();
+			FGraphNode *y = fmul(fconvolve(x, k, steps), w);
+			fStopGradientContext();
+			FGraphNode *dx[2] = {x, k}, *grads[2];
+			fCalculateGradients(y, dx, 2, grads);
+			for (FGraphNode *g : grads) {
+				g->reference_counter++;
+				fExecuteGraph_cpu(g);
+				g->reference_counter--;
+				fFreeGraph(g);
+			}
+			fFreeGraph(y);
+		}
+		const double backward =
+			2 * flops * iterations / timer.get_elapsed_ns();
+		fUnmarkGradientVariable(x);
+		fUnmarkGradientVariable(k);
+		string a = to_string(l.batch) + "x" + to_string(l.size) + "x" +
+				   to_string(l.size) + "x" + to_string(l.channels),
+			   b = to_string(l.filters) + "x" + to_string(l.kernel) + "x" +
+				   to_string(l.kernel),
+			   c = to_string(l.step), f = to_string(forward),
+			   g = to_string(backward);
+		a.resize(13, ' ');
+		b.resize(11, ' ');
+		c.resize(4, ' ');
+		f.resize(16, ' ');
+		g.resize(16, ' ');
+		std::cout << "| " << a << " | " << b << " | " << c << " | " << f
+				  << " | " << g << " |" << std::endl;
+		for (FGraphNode *n : {x, k, w}) {
+			n->reference_counter--;
+			fFreeGraph(n);
+		}
+	}
+	std::cout << line << std::endl;
+	if (eager)
+		fEnableEagerExecution();
+}
+/**
+ * GFLOP/s of the forward convolution of typical layers with each
+ * `FConvolutionAlgorithm` and the speedup of the automatically chosen kernel
+ * over the generic implementation.
+ */
+void convolution_algorithms() {
+	const bool eager = fIsEagerExecution();
+	fDisableEagerExecution();
+	struct Layer {
+			size_t batch, size, channels, filters, kernel;
+	};
+	// Winograd (small and large tiles), 1x1, direct and im2col
+	const Layer layers[] = {{8, 8, 32, 32, 3},	 {8, 32, 16, 32, 3},
+							{8, 16, 64, 64, 3},	 {8, 28, 32, 32, 1},
+							{8, 32, 1, 16, 3},	 {8, 16, 32, 32, 5}};
+	const FConvolutionAlgorithm algorithms[3] = {F_CONV_GENERIC, F_CONV_IM2COL,
+												 F_CONV_AUTO};
+	const string line = "+---------------+-------------+-----------+---------"
+						"--+-----------+---------+";
+	std::cout << "GFLOP/s of float32 convolutions (step 1) per algorithm"
+			  << std::endl;
+	std::cout << line << std::endl;
+	std::cout << "| image         | kernels     | generic   | im2col    | "
+				 "auto      | speedup |"
+			  << std::endl;
+	std::cout << line << std::endl;
+	for (const Layer &l : layers) {
+		const size_t image_shape[4] = {l.batch, l.size, l.size, l.channels};
+		const size_t kernel_shape[5] = {l.filters, 1, l.kernel, l.kernel,
+										l.channels};
+		const unsigned int steps[3] = {1, 1, 1};
+		const size_t windows = l.size - l.kernel + 1;
+		const double flops = 2.0 * l.batch * windows * windows * l.filters *
+							 l.kernel * l.kernel * l.channels;
+		FGraphNode *x = fconvert(frandom(image_shape, 4), F_FLOAT32);
+		FGraphNode *k = fconvert(frandom(kernel_shape, 5), F_FLOAT32);
+		for (FGraphNode *n : {x, k}) {
+			n->reference_counter++;
+			fExecuteGraph_cpu(n);
+		}
+		// the generic implementation is slow, about 2e8 flops suffice
+		const int iterations = std::max(1, (int)(2e8 / flops));
+		double gflops[3];
+		for (int a = 0; a < 3; a++) {
+			fSetConvolutionAlgorithm(algorithms[a]);
+			nanotimer timer;
+			timer.start();
+			for (int i = 0; i < iterations; i++) {
+				FGraphNode *y = fconvolve(x, k, steps);
+				y->reference_counter++;
+				fExecuteGraph_cpu(y);
+				y->reference_counter--;
+				fFreeGraph(y);
+			}
+			gflops[a] = flops * iterations / timer.get_elapsed_ns();
+		}
+		fSetConvolutionAlgorithm(F_CONV_AUTO);
+		string a = to_string(l.batch) + "x" + to_string(l.size) + "x" +
+				   to_string(l.size) + "x" + to_string(l.channels),
+			   b = to_string(l.filters) + "x" + to_string(l.kernel) + "x" +
+				   to_string(l.kernel),
+			   s = to_string(gflops[2] / gflops[0]);
+		a.resize(13, ' ');
+		b.resize(11, ' ');
+		s.resize(7, ' ');
+		std::cout << "| " << a << " | " << b << " | ";
+		for (double g : gflops) {
+			string c = to_string(g);
+			c.resize(9, ' ');
+			std::cout << c << " | ";
+		}
+		std::cout << s << " |" << std::endl;
+		for (FGraphNode *n : {x, k}) {
+			n->reference_counter--;
+			fFreeGraph(n);
+		}
+	}
+	std::cout << line << std::endl;
+	if (eager)
+		fEnableEagerExecution();
+}
+static FGraphNode *pow_self(FGraphNode *a) { return fpow_g(a, a); }
+// largest distance in ulp of `fast` to `exact`
+template <typename T>
+static double max_ulp(const T *fast, const T *exact, size_t n) {
+	double max = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (fast[i] == exact[i])
+			continue;
+		const T e = std::abs(exact[i]);
+		const T ulp = std::nextafter(e, std::numeric_limits<T>::infinity()) - e;
+		max = std::max(max, (double)(std::abs(fast[i] - exact[i]) / ulp));
+	}
+	return max;
+}
+void transcendental_functions() {
+	const bool eager = fIsEagerExecution();
+	fDisableEagerExecution();
+	const int iterations = 10;
+	const size_t n = 1 << 20;
+	const char *names[9] = {"exp", "log", "log2", "log10", "sin",
+							"cos", "tan", "sqrt", "pow"};
+	FGraphNode *(*functions[9])(FGraphNode *) = {
+		fexp, flog, flog2, flog10, fsin, fcos, ftan, fsqrt_g, pow_self};
+	const string line = "+----------+---------+------------------+-----------"
+						"-------+---------+";
+	std::cout << line << std::endl;
+	std::cout << "| function | type    | strict (ns)      | fast (ns)        "
+				 "| max ulp |"
+			  << std::endl;
+	std::cout << line << std::endl;
+	for (FType type : {F_FLOAT32, F_FLOAT64}) {
+		// values in [0, 20)
+		FGraphNode *a = fconvert(fmul_cd(frandom(&n, 1), 20.0), type);
+		a->reference_counter++;
+		fExecuteGraph_cpu(a);
+		for (int k = 0; k < 9; k++) {
+			FGraphNode *results[2];
+			double ns[2];
+			for (int mode = 0; mode < 2; mode++) {
+				fSetMathAccuracy(mode ? F_FAST_MATH : F_STRICT_MATH);
+				nanotimer timer;
+				timer.start();
+				for (int i = 0; i < iterations; i++) {
+					FGraphNode *c = functions[k](a);
+					c->reference_counter++;
+					fExecuteGraph_cpu(c);
+					if (i < iterations - 1) {
+						c->reference_counter--;
+						fFreeGraph(c);
+					} else
+						results[mode] = c;
+				}
+				ns[mode] = timer.get_elapsed_ns() / (iterations * (double)n);
+			}
+			const void *fast = results[1]->result_data->data,
+					   *strict = results[0]->result_data->data;
+			const double ulp =
+				type == F_FLOAT32
+					? max_ulp((const float *)fast, (const float *)strict, n)
+					: max_ulp((const double *)fast, (const double *)strict, n);
+			string f = names[k], s = to_string(ns[0]), t = to_string(ns[1]),
+				   u = to_string(ulp);
+			f.resize(8, ' ');
+			s.resize(16, ' ');
+			t.resize(16, ' ');
+			u.resize(7, ' ');
+			std::cout << "| " << f << " | "
+					  << (type == F_FLOAT32 ? "float32" : "float64") << " | "
+					  << s << " | " << t << " | " << u << " |" << std::endl;
+			for (FGraphNode *c : results) {
+				c->reference_counter--;
+				fFreeGraph(c);
+			}
+		}
+		a->reference_counter--;
+		fFreeGraph(a);
+	}
+	std::cout << line << std::endl;
+	fSetMathAccuracy(F_STRICT_MATH);
+	if (eager)
+		fEnableEagerExecution();
+}
+void transpose_bandwidth() {
+	const bool eager = fIsEagerExecution();
+	fDisableEagerExecution();
+	const int iterations = 10;
+	// a square matrix and swapping the channels of images like BatchNorm
+	const std::vector<std::vector<size_t>> shapes = {{4096, 4096},
+													 {32, 56, 56, 64}};
+	std::vector<std::vector<int>> transpositions = {{1, 0}, {0, 3, 2, 1}};
+	for (size_t k = 0; k < shapes.size(); k++) {
+		FGraphNode *a = fconvert(
+			frandom(shapes[k].data(), shapes[k].size()), F_FLOAT32);
+		a->reference_counter++;
+		fExecuteGraph_cpu(a);
+		size_t n = 1;
+		for (size_t s : shapes[k])
+			n *= s;
+		nanotimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; i++) {
+			FGraphNode *t = ftranspose(a, transpositions[k].data());
+			t->reference_counter++;
+			fExecuteGraph_cpu(t);
+			t->reference_counter--;
+			fFreeGraph(t);
+		}
+		const double ns = timer.get_elapsed_ns() / iterations;
+		string shape = "[";
+		for (size_t d = 0; d < shapes[k].size(); d++)
+			shape += to_string(shapes[k][d]) +
+					 (d + 1 == shapes[k].size() ? "]" : ", ");
+		// read and written once
+		std::cout << "transpose " << shape << ": "
+				  << 2.0 * n * sizeof(float) / ns << " GB/s" << std::endl;
+		a->reference_counter--;
+		fFreeGraph(a);
+	}
+	if (eager)
+		fEnableEagerExecution();
+}
+static unordered_map<string, double (*)()> all_benchmarks() {
 	unordered_map<string, double (*)()> benches;
 	benches.insert({"convolve_fun", convolve_fun});
 	benches.insert({"convolve_grad_fun", convolve_grad_fun});
 	benches.insert({"gradient_fun", gradient_fun});
 	benches.insert({"matrix_multiplication", matrix_multiplication});
 	benches.insert({"reduce_fun", reduce_fun});
+	return benches;
+}
+/**
+ * Compares the lazy cpu backend with the jit compiled one. The first run of
+ * the jit includes the compilation (or loading from the disk cache), the
+ * second one only the execution of the compiled graphs.
+ */
+void jit_comparison() {
+	unordered_map<string, double (*)()> benches = all_benchmarks();
+	Flint::setLoggingLevel(F_INFO);
+	fDisableEagerExecution();
+	std::cout << "+------------------------+------------------+---------------"
+				 "---+------------------+"
+			  << std::endl;
+	std::cout << "| benchmark name         | cpu lazy (ms)    | jit cold (ms) "
+				 "   | jit warm (ms)    |"
+			  << std::endl;
+	std::cout << "+------------------------+------------------+---------------"
+				 "---+------------------+"
+			  << std::endl;
+	for (const auto &bench : benches) {
+		flintInit(FLINT_BACKEND_ONLY_CPU);
+		string lazy = to_string(bench.second());
+		flintCleanup();
+		flintInit(FLINT_BACKEND_CPU_JIT);
+		string cold = to_string(bench.second());
+		string warm = to_string(bench.second());
+		flintCleanup();
+		string name = bench.first;
+		for (string *str : {&name, &lazy, &cold, &warm}) {
+			size_t target = str == &name ? 22 : 16;
+			str->resize(target, ' ');
+		}
+		cout << "| " << name << " | " << lazy << " | " << cold << " | "
+			 << warm << " |" << endl;
+		std::cout << "+------------------------+------------------+-----------"
+					 "-------+------------------+"
+				  << std::endl;
+	}
+}
+void call_benchmarks(int benchmarks = FLINT_BACKEND_BOTH,
+					 bool only_lazy = false) {
+	unordered_map<string, double (*)()> benches = all_benchmarks();
 	/////////////////////////////////////////////////
 	unordered_map<string, tuple<double, double, double>> times;
 	Flint::setLoggingLevel(F_INFO);
-	if (benchmarks & FLINT_BACKEND_ONLY_CPU) {
+	if (benchmarks & FLINT_BACKEND_ONLY_CPU && !only_lazy) {
 		// cpu tests
 		flintInit(FLINT_BACKEND_ONLY_CPU);
 		fEnableEagerExecution();
@@ -145,9 +711,17 @@ void call_benchmarks(int benchmarks = FLINT_BACKEND_BOTH) {
 			flogging(F_INFO,
 					 "took " + to_string(std::get<0>(times[bench.first])));
 		}
+		dispatch_overhead();
+		graph_scheduling();
+		binary_broadcasting();
+		transcendental_functions();
+		matmul_gflops();
+		convolution_gflops();
+		convolution_algorithms();
+		transpose_bandwidth();
 		flintCleanup();
 	}
-	if (benchmarks & FLINT_BACKEND_ONLY_GPU) {
+	if (benchmarks & FLINT_BACKEND_ONLY_GPU && !only_lazy) {
 		// gpu tests
 		flintInit(FLINT_BACKEND_ONLY_GPU);
 		fDisableEagerExecution();
@@ -159,8 +733,7 @@ void call_benchmarks(int benchmarks = FLINT_BACKEND_BOTH) {
 		}
 		flintCleanup();
 	}
-	if ((benchmarks & FLINT_BACKEND_BOTH) == FLINT_BACKEND_BOTH ||
-		benchmarks == 4) {
+	if ((benchmarks & FLINT_BACKEND_BOTH) == FLINT_BACKEND_BOTH) {
 		// both tests
 		flintInit(FLINT_BACKEND_BOTH);
 		for (const auto &bench : benches) {
@@ -220,7 +793,8 @@ int main(int argc, char **argv) {
 		if (argc > 3)
 			flogging(F_ERROR,
 					 "Invalid number of command line arguments! Call this "
-					 "program like this: benchmark [cpu] [gpu]");
+					 "program like this: benchmark [cpu] [gpu] [jit] [cpujit] "
+					 "[eager]");
 
 		for (int i = 1; i < argc; i++) {
 			if (strcmp(argv[i], "cpu") == 0)
@@ -229,20 +803,27 @@ int main(int argc, char **argv) {
 				backends |= FLINT_BACKEND_ONLY_GPU;
 			} else if (strcmp(argv[i], "jit") == 0) {
 				lazy = true;
+			} else if (strcmp(argv[i], "cpujit") == 0) {
+				backends |= FLINT_BACKEND_CPU_JIT;
 			} else if (strcmp(argv[i], "eager") == 0) {
 				eager = true;
 			} else
 				flogging(
 					F_ERROR,
 					"Invalid argument: " + std::string(argv[i]) +
-						"! Call this program like this: benchmark [cpu] [gpu]");
+						"! Call this program like this: benchmark [cpu] [gpu] "
+						"[jit] [cpujit] [eager]");
 		}
 	}
 	if (eager)
 		fEnableEagerExecution();
-	if (lazy)
-		backends = 4;
-	if (backends == 0)
+	if (backends & FLINT_BACKEND_CPU_JIT) {
+		jit_comparison();
+		if (!lazy && backends == FLINT_BACKEND_CPU_JIT)
+			return 0;
+	}
+	backends &= FLINT_BACKEND_BOTH;
+	if (lazy || backends == 0)
 		backends = FLINT_BACKEND_BOTH;
-	call_benchmarks(backends);
+	call_benchmarks(backends, lazy);
 }
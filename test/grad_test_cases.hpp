@@ -63,6 +63,36 @@ TEST_SUITE("Autodiff") {
 		CHECK_EQ(dz[1][1][0], 40);
 		CHECK_EQ(dz[1][1][1], -40);
 	}
+	TEST_CASE("Transposed Matmul") {
+		GradientContext _;
+		Tensor<double, 3> x = {{{1.0, -2.0, 0.5}, {2.0, 3.0, -1.0}},
+							   {{4.0, 5.0, 2.0}, {-6.0, 7.0, 1.5}}};
+		x.watch();
+		Tensor<double, 2> y = {{3.0, -7.0}, {-1.0, 5.0}, {2.0, 0.5}};
+		y.watch();
+		// the gradients of the transposed operands have to match the ones
+		// of explicit transpositions
+		for (int ta = 0; ta < 2; ta++)
+			for (int tb = 0; tb < 2; tb++) {
+				Tensor<double, 3> xs = ta ? x.transpose({0, 2, 1}) : x;
+				Tensor<double, 2> ys = tb ? y.transpose() : y;
+				Tensor<double, 3> w1 =
+					xs.matmul(ys, ta, tb) * Tensor<double, 1>{1.0, -3.0};
+				Tensor<double, 3> xe = ta ? xs.transpose({0, 2, 1}) : xs;
+				Tensor<double, 2> ye = tb ? ys.transpose() : ys;
+				Tensor<double, 3> w2 =
+					xe.matmul(ye) * Tensor<double, 1>{1.0, -3.0};
+				Tensor<double, 3> dx1 = w1.gradient(x), dx2 = w2.gradient(x);
+				Tensor<double, 2> dy1 = w1.gradient(y), dy2 = w2.gradient(y);
+				for (int i = 0; i < 2; i++)
+					for (int j = 0; j < 2; j++)
+						for (int k = 0; k < 3; k++)
+							CHECK_EQ(dx1[i][j][k], dx2[i][j][k]);
+				for (int i = 0; i < 3; i++)
+					for (int j = 0; j < 2; j++)
+						CHECK_EQ(dy1[i][j], dy2[i][j]);
+			}
+	}
 	TEST_CASE("Add, Mul, Matmul") {
 		GradientContext _;
 		Tensor<double, 3> x = {{{1.0, 1.0}, {2.0, 3.0}},
@@ -275,6 +305,49 @@ TEST_SUITE("Autodiff") {
 		CHECK_EQ(-10, dx[1][2][0]);
 		CHECK_EQ(-10, dx[1][2][1]);
 	}
+	TEST_CASE("Multi-axis Reductions") {
+		GradientContext _;
+		Tensor<double, 3> x = {{{2, -1}, {4, 0.5}, {1, 3}},
+							   {{-2, 5}, {1, 2}, {0.5, 4}}};
+		x.watch();
+		const int inner[2] = {1, 2}, outer[2] = {0, 2};
+		// sum of squares per batch
+		Tensor<double, 1> s(freduce_sum_axes(fmul(x.get_graph_node(),
+												  x.get_graph_node()),
+											 inner, 2, false),
+							2);
+		Tensor<double, 3> dx = s.gradient(x);
+		for (int i = 0; i < 2; i++)
+			for (int j = 0; j < 3; j++)
+				for (int k = 0; k < 2; k++)
+					CHECK_EQ(2 * x[i][j][k], dx[i][j][k]);
+		// non consecutive axes with kept dimensions
+		Tensor<double, 3> m(
+			freduce_mean_axes(x.get_graph_node(), outer, 2, true), {1, 3, 1});
+		dx = m.gradient(x);
+		for (int i = 0; i < 2; i++)
+			for (int j = 0; j < 3; j++)
+				for (int k = 0; k < 2; k++)
+					CHECK_EQ(0.25, dx[i][j][k]);
+		Tensor<double, 1> p(freduce_mul_axes(x.get_graph_node(), inner, 2, false),
+							2);
+		dx = p.gradient(x);
+		CHECK_EQ(-6, dx[0][0][0]);
+		CHECK_EQ(12, dx[0][0][1]);
+		CHECK_EQ(-12, dx[0][2][0]);
+		CHECK_EQ(-40, dx[1][1][0]);
+		Tensor<double, 1> mx(
+			freduce_max_axes(x.get_graph_node(), inner, 2, false), 2);
+		dx = mx.gradient(x);
+		for (int i = 0; i < 2; i++)
+			for (int j = 0; j < 3; j++)
+				for (int k = 0; k < 2; k++)
+					CHECK_EQ((i == 0 && j == 1 && k == 0) ||
+									 (i == 1 && j == 0 && k == 1)
+								 ? 1
+								 : 0,
+							 dx[i][j][k]);
+	}
 	TEST_CASE("REPEAT, SLICE, TRANSPOSE") {
 		GradientContext _;
 		Tensor<double, 2> t{{0, 1, 2, 3},
@@ -484,6 +557,79 @@ TEST_SUITE("Autodiff") {
 			for (int j = 0; j < 6; j++)
 				CHECK_EQ(0, da[2 + i][j][0]);
 	}
+	TEST_CASE("Convolve Lowering") {
+		// large enough to be lowered to matrix multiplications, split by
+		// threads inside of windows and filters (and for the small kernel
+		// inside of the windows of one element of the gradient)
+		GradientContext _;
+		CHECK_EQ(fConfigureThreads_cpu(3, nullptr, nullptr), NO_ERROR);
+		using namespace std;
+		const int c = 30, f = 8;
+		vector<vector<vector<vector<double>>>> img(
+			2, vector<vector<vector<double>>>(
+				   9, vector<vector<double>>(8, vector<double>(c))));
+		for (int b = 0; b < 2; b++)
+			for (int i = 0; i < 9; i++)
+				for (int j = 0; j < 8; j++)
+					for (int l = 0; l < c; l++)
+						img[b][i][j][l] = (b * 7 + i * 5 + j * 3 + l) % 9 - 4;
+		Tensor<double, 4> x(img);
+		x.watch();
+		for (const int ks : {3, 1}) {
+			const int wh = (9 - ks) / 2 + 1, ww = 8 - ks + 1;
+			vector<vector<vector<vector<vector<double>>>>> ker(
+				f, vector<vector<vector<vector<double>>>>(
+					   1, vector<vector<vector<double>>>(
+							  ks, vector<vector<double>>(ks, vector<double>(c)))));
+			vector<vector<vector<vector<double>>>> adj(
+				2, vector<vector<vector<double>>>(
+					   wh, vector<vector<double>>(ww, vector<double>(f))));
+			for (int g = 0; g < f; g++)
+				for (int i = 0; i < ks; i++)
+					for (int j = 0; j < ks; j++)
+						for (int l = 0; l < c; l++)
+							ker[g][0][i][j][l] = (g * 3 + i * 2 + j + l * 5) % 7 - 3;
+			for (int b = 0; b < 2; b++)
+				for (int i = 0; i < wh; i++)
+					for (int j = 0; j < ww; j++)
+						for (int g = 0; g < f; g++)
+							adj[b][i][j][g] = (b + i * 3 + j * 2 + g) % 5 - 2;
+			Tensor<double, 5> k(ker);
+			Tensor<double, 4> w(adj);
+			k.watch();
+			Tensor<double, 4> y = x.convolve(k, 1, 2, 1) * w;
+			Tensor<double, 4> dx = y.gradient(x);
+			Tensor<double, 5> dk = y.gradient(k);
+			for (int b = 0; b < 2; b++)
+				for (int p = 0; p < 9; p++)
+					for (int q = 0; q < 8; q++)
+						for (int l = 0; l < c; l++) {
+							double expected = 0;
+							for (int i = 0; i < wh; i++)
+								for (int j = 0; j < ww; j++)
+									if (p >= i * 2 && p < i * 2 + ks &&
+										q >= j && q < j + ks)
+										for (int g = 0; g < f; g++)
+											expected +=
+												adj[b][i][j][g] *
+												ker[g][0][p - i * 2][q - j][l];
+							CHECK_EQ(expected, dx[b][p][q][l]);
+						}
+			for (int g = 0; g < f; g++)
+				for (int s = 0; s < ks; s++)
+					for (int t = 0; t < ks; t++)
+						for (int l = 0; l < c; l++) {
+							double expected = 0;
+							for (int b = 0; b < 2; b++)
+								for (int i = 0; i < wh; i++)
+									for (int j = 0; j < ww; j++)
+										expected += adj[b][i][j][g] *
+													img[b][i * 2 + s][j + t][l];
+							CHECK_EQ(expected, dk[g][0][s][t][l]);
+						}
+		}
+		CHECK_EQ(fConfigureThreads_cpu(0, nullptr, nullptr), NO_ERROR);
+	}
 	TEST_CASE("Multifilter Convolve") {
 		GradientContext _;
 		Tensor<int, 3> x{{{0, 1, 2}, {1, 2, 3}, {2, 3, 4}, {0, 0, 0}},
@@ -939,4 +1085,149 @@ TEST_SUITE("Autodiff") {
 				}
 			}
 	}
+	TEST_CASE("Sparse") {
+		GradientContext _;
+		const size_t rows[] = {3, 0, 2, 0, 4, 1, 3},
+					 columns[] = {1, 2, 0, 2, 4, 3, 0}, shape[] = {5, 5};
+		Tensor<double, 1> values{0.5, -1, 2, 3, 1.5, -2, 4};
+		Tensor<double, 2> b = Flint::random(5, 3);
+		Tensor<double, 2> w = Flint::random(5, 3);
+		values.watch();
+		b.watch();
+		Tensor<double, 2> y(
+			fmatmul(fsparse(values.get_graph_node(), rows, columns, shape),
+					b.get_graph_node()));
+		Tensor<double, 2> e(fmatmul(
+			fadd(fsparse(values.get_graph_node(), rows, columns, shape), 0.0),
+			b.get_graph_node()));
+		Tensor<double, 2> yw = y * w, ew = e * w;
+		Tensor<double, 1> dv = yw.gradient(values);
+		Tensor<double, 1> ev = ew.gradient(values);
+		for (int i = 0; i < 7; i++)
+			CHECK_EQ(doctest::Approx(ev[i]).epsilon(0.000000001), dv[i]);
+		Tensor<double, 2> db = yw.gradient(b);
+		Tensor<double, 2> eb = ew.gradient(b);
+		for (int i = 0; i < 5; i++)
+			for (int j = 0; j < 3; j++)
+				CHECK_EQ(doctest::Approx(eb[i][j]).epsilon(0.000000001),
+						 db[i][j]);
+	}
+	TEST_CASE("Softmax") {
+		GradientContext _;
+		Tensor<double, 3> a = Flint::random(3, 4, 5) * 6 - 3;
+		Tensor<double, 3> w = Flint::random(3, 4, 5);
+		a.watch();
+		for (int ax = 0; ax < 3; ax++) {
+			const size_t len = a.get_shape()[ax];
+			Tensor<double, 3> e = a.exp();
+			Tensor<double, 3> s(fdiv(
+				e.get_graph_node(),
+				fexpand(freduce_sum(e.get_graph_node(), ax), ax, len)));
+			Tensor<double, 3> ds = (a.softmax(ax) * w).gradient(a);
+			Tensor<double, 3> es = (s * w).gradient(a);
+			Tensor<double, 3> dl = (a.log_softmax(ax) * w).gradient(a);
+			Tensor<double, 3> el = (s.log() * w).gradient(a);
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 4; j++)
+					for (int k = 0; k < 5; k++) {
+						CHECK_EQ(doctest::Approx(es[i][j][k]).epsilon(0.000001),
+								 ds[i][j][k]);
+						CHECK_EQ(doctest::Approx(el[i][j][k]).epsilon(0.000001),
+								 dl[i][j][k]);
+					}
+		}
+		// cross entropy with a distribution and with class indices
+		Tensor<double, 2> b = Flint::random(4, 6) * 6 - 3;
+		Tensor<double, 2> labels = Flint::random(4, 6);
+		Tensor<double, 1> v = Flint::random(4);
+		Tensor<long, 1> classes{5, 0, 2, 2};
+		b.watch();
+		labels.watch();
+		Tensor<double, 1> ce(fsoftmax_cross_entropy(
+			b.get_graph_node(), labels.get_graph_node(), 1));
+		Tensor<double, 1> ee = (labels * b.log_softmax(1)).reduce_sum(1) * -1;
+		Tensor<double, 1> cev = ce * v, eev = ee * v;
+		Tensor<double, 2> db = cev.gradient(b), eb = eev.gradient(b);
+		Tensor<double, 2> dt = cev.gradient(labels), et = eev.gradient(labels);
+		Tensor<double, 1> ci(fsoftmax_cross_entropy(
+			b.get_graph_node(), classes.get_graph_node(), 1));
+		Tensor<double, 2> dc = (ci * v).gradient(b);
+		Tensor<double, 2> sb = b.softmax(1);
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 6; j++) {
+				CHECK_EQ(doctest::Approx(eb[i][j]).epsilon(0.000001), db[i][j]);
+				CHECK_EQ(doctest::Approx(et[i][j]).epsilon(0.000001), dt[i][j]);
+				// softmax - onehot
+				const double onehot = classes[i] == j ? 1 : 0;
+				CHECK_EQ(doctest::Approx((sb[i][j] - onehot) * v[i]), dc[i][j]);
+			}
+	}
+	TEST_CASE("Batch Norm") {
+		GradientContext _;
+		const double eps = 1e-5;
+		Tensor<double, 3> a = Flint::random(2, 3, 4) * 6 - 3;
+		Tensor<double, 3> w = Flint::random(2, 3, 4);
+		Tensor<double, 1> gamma{0.5, 2, -1.5};
+		Tensor<double, 1> beta{1, 0, -2};
+		Tensor<double, 1> mean{0.5, -1, 0.25};
+		Tensor<double, 1> var{1, 2, 0.5};
+		a.watch();
+		gamma.watch();
+		beta.watch();
+		mean.watch();
+		var.watch();
+		// broadcasts a channel vector to the shape of a
+		const auto expand = [](FGraphNode *c) {
+			return fexpand(fexpand(c, 0, 2), 2, 4);
+		};
+		const auto reference = [&](FGraphNode *m, FGraphNode *v) {
+			return Tensor<double, 3>(
+				fadd(fmul(fdiv(fsub(a.get_graph_node(), expand(m)),
+							   fsqrt_g(fadd_cd(expand(v), eps))),
+						  expand(gamma.get_graph_node())),
+					 expand(beta.get_graph_node())));
+		};
+		// with the statistics of the batch
+		Tensor<double, 1> bm = a.reduce_sum(0).reduce_sum(1) / 8.0;
+		Tensor<double, 3> centered(
+			fsub(a.get_graph_node(), expand(bm.get_graph_node())));
+		Tensor<double, 1> bv =
+			(centered * centered).reduce_sum(0).reduce_sum(1) / 8.0;
+		Tensor<double, 3> y(fbatch_norm(
+			a.get_graph_node(), fbatch_moments(a.get_graph_node(), 1),
+			gamma.get_graph_node(), beta.get_graph_node(), 1, eps));
+		Tensor<double, 3> ey =
+			reference(bm.get_graph_node(), bv.get_graph_node());
+		Tensor<double, 3> yw = y * w, eyw = ey * w;
+		Tensor<double, 3> da = yw.gradient(a), ea = eyw.gradient(a);
+		Tensor<double, 1> dg = yw.gradient(gamma), eg = eyw.gradient(gamma);
+		Tensor<double, 1> db = yw.gradient(beta), eb = eyw.gradient(beta);
+		// with other statistics, e.g. running ones during inference
+		const size_t row[] = {1, 3};
+		Tensor<double, 3> r(fbatch_norm(
+			a.get_graph_node(),
+			fconcat(freshape(mean.get_graph_node(), row, 2),
+					freshape(var.get_graph_node(), row, 2), 0),
+			gamma.get_graph_node(), beta.get_graph_node(), 1, eps));
+		Tensor<double, 3> er =
+			reference(mean.get_graph_node(), var.get_graph_node());
+		Tensor<double, 3> rw = r * w, erw = er * w;
+		Tensor<double, 3> dr = rw.gradient(a), edr = erw.gradient(a);
+		Tensor<double, 1> dm = rw.gradient(mean), em = erw.gradient(mean);
+		Tensor<double, 1> dv = rw.gradient(var), ev = erw.gradient(var);
+		for (int i = 0; i < 2; i++)
+			for (int j = 0; j < 3; j++)
+				for (int k = 0; k < 4; k++) {
+					CHECK_EQ(doctest::Approx(ea[i][j][k]).epsilon(0.000001),
+							 da[i][j][k]);
+					CHECK_EQ(doctest::Approx(edr[i][j][k]).epsilon(0.000001),
+							 dr[i][j][k]);
+				}
+		for (int c = 0; c < 3; c++) {
+			CHECK_EQ(doctest::Approx(eg[c]).epsilon(0.000001), dg[c]);
+			CHECK_EQ(doctest::Approx(eb[c]).epsilon(0.000001), db[c]);
+			CHECK_EQ(doctest::Approx(em[c]).epsilon(0.000001), dm[c]);
+			CHECK_EQ(doctest::Approx(ev[c]).epsilon(0.000001), dv[c]);
+		}
+	}
 }
@@ -14,6 +14,7 @@
 
 #include "../flint.h"
 #include <cmath>
+#include <filesystem>
 #define DOCTEST_CONFIG_IMPLEMENT
 #include "doctest.h"
 #include "testutils.hpp"
@@ -393,6 +394,370 @@ TEST_SUITE("Execution") {
 			CHECK_EQ(fe3[i], d3[i]);
 		fFreeGraph(r2);
 	}
+	TEST_CASE("matmul blocking") {
+		// larger than one block in every dimension and not divisible by the
+		// tile sizes, split by threads inside of rows
+		CHECK_EQ(fConfigureThreads_cpu(3, nullptr, nullptr), NO_ERROR);
+		const size_t l = 37, m = 300, n = 1030;
+		std::vector<std::vector<std::vector<int>>> d1(
+			2, std::vector<std::vector<int>>(l, std::vector<int>(m)));
+		std::vector<std::vector<std::vector<float>>> d2(
+			3, std::vector<std::vector<float>>(m, std::vector<float>(n)));
+		for (size_t i = 0; i < l; i++)
+			for (size_t k = 0; k < m; k++) {
+				d1[0][i][k] = (i * 7 + k) % 13 - 6;
+				d1[1][i][k] = (i + k * 3) % 5 - 2;
+			}
+		for (size_t b = 0; b < 3; b++)
+			for (size_t k = 0; k < m; k++)
+				for (size_t j = 0; j < n; j++)
+					d2[b][k][j] = (float)((b + k * 5 + j) % 11) - 5;
+		Tensor<int, 3> a(d1);
+		Tensor<float, 3> b(d2);
+		Tensor<int, 2> a1(d1[1]);
+		Tensor<float, 2> b0(d2[0]);
+		// broadcasted batches: (2, l, m) x (m, n) and (l, m) x (3, m, n)
+		Tensor<float, 3> c1 = a.matmul(b0);
+		Tensor<float, 3> c2 = a1.matmul(b);
+		Tensor<double, 2> ones = Flint::constant(1.0, l, m);
+		Tensor<double, 3> c3 = ones.matmul(b);
+		c1.execute();
+		c2.execute();
+		c3.execute();
+		for (size_t i = 0; i < l; i++)
+			for (size_t j = 0; j < n; j++) {
+				for (size_t t = 0; t < 2; t++) {
+					float expected = 0;
+					for (size_t k = 0; k < m; k++)
+						expected += d1[t][i][k] * d2[0][k][j];
+					CHECK_EQ(expected, c1[t][i][j]);
+				}
+				for (size_t t = 0; t < 3; t++) {
+					float expected = 0;
+					double sum = 0;
+					for (size_t k = 0; k < m; k++) {
+						expected += d1[1][i][k] * d2[t][k][j];
+						sum += d2[t][k][j];
+					}
+					CHECK_EQ(expected, c2[t][i][j]);
+					CHECK_EQ(sum, c3[t][i][j]);
+				}
+			}
+		CHECK_EQ(fConfigureThreads_cpu(0, nullptr, nullptr), NO_ERROR);
+	}
+	TEST_CASE("matmul transposed") {
+		// every combination of flags with a broadcasted batch, compared to
+		// the product of the explicitly transposed operands
+		const size_t l = 9, m = 70, n = 23;
+		std::vector<std::vector<std::vector<double>>> d1(
+			2, std::vector<std::vector<double>>(m, std::vector<double>(l)));
+		std::vector<std::vector<float>> d2(n, std::vector<float>(m));
+		for (size_t b = 0; b < 2; b++)
+			for (size_t k = 0; k < m; k++)
+				for (size_t i = 0; i < l; i++)
+					d1[b][k][i] = (double)((b * 3 + k * 7 + i) % 17) - 8;
+		for (size_t j = 0; j < n; j++)
+			for (size_t k = 0; k < m; k++)
+				d2[j][k] = (float)((j * 5 + k) % 13) * 0.5f - 3;
+		Tensor<double, 3> at(d1);
+		Tensor<float, 2> bt(d2);
+		Tensor<double, 3> a = at.transpose({0, 2, 1});
+		Tensor<float, 2> b = bt.transpose();
+		a.execute();
+		b.execute();
+		Tensor<double, 3> expected = a.matmul(b);
+		Tensor<double, 3> results[4] = {
+			a.matmul(b), at.matmul(b, true, false), a.matmul(bt, false, true),
+			at.matmul(bt, true, true)};
+		for (Tensor<double, 3> &res : results) {
+			CHECK_EQ(res.get_shape(), expected.get_shape());
+			for (size_t t = 0; t < 2; t++)
+				for (size_t i = 0; i < l; i++)
+					for (size_t j = 0; j < n; j++)
+						CHECK_EQ(expected[t][i][j], res[t][i][j]);
+		}
+	}
+	TEST_CASE("wide graph") {
+		// many independent branches that are reduced pairwise
+		Tensor<double, 2> x = Flint::constant(0.5, 64, 64);
+		std::vector<Tensor<double, 2>> branches;
+		for (int i = 0; i < 64; i++)
+			branches.push_back(x * (double)(i + 1) + x.sin() - x.sin());
+		while (branches.size() > 1) {
+			std::vector<Tensor<double, 2>> next;
+			for (size_t i = 0; i < branches.size(); i += 2)
+				next.push_back(branches[i] + branches[i + 1]);
+			branches = std::move(next);
+		}
+		Tensor<double, 2> res = branches[0];
+		res.execute();
+		for (int i = 0; i < 64; i++)
+			for (int j = 0; j < 64; j++)
+				CHECK_EQ(doctest::Approx(res[i][j]), 0.5 * 64 * 65 / 2);
+	}
+	TEST_CASE("elementwise chains") {
+		// spans multiple blocks of a fused loop, mixes types and broadcasting
+		Tensor<long, 2> a = Flint::arange(1, 3, 1500);
+		Tensor<double, 1> b = Flint::arange(0, 1500).convert<double>();
+		Tensor<float, 2> c = Flint::constant(2.0f, 3, 1500);
+		Tensor<double, 2> res =
+			((a + 1) * b - c.sqrt() / (c + 3.0f)).abs().convert<float>() +
+			a.convert<double>().sin() * 0.0;
+		res.execute();
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 1500; j++)
+				CHECK_EQ(doctest::Approx(res[i][j]).epsilon(0.0001),
+						 std::abs((j + 1) * (double)j - std::sqrt(2.0) / 5.0));
+	}
+	TEST_CASE("memory planning") {
+		std::vector<std::vector<float>> data(100, std::vector<float>(100));
+		for (int i = 0; i < 100; i++)
+			for (int j = 0; j < 100; j++)
+				data[i][j] = i * 100 + j;
+		Tensor<float, 2> t(data);
+		// every step materializes two intermediate results
+		for (int k = 0; k < 8; k++)
+			t = t.transpose() + 1.0f;
+		if (!fIsEagerExecution()) {
+			const size_t bytes = 100 * 100 * sizeof(float);
+			const size_t predicted =
+				fPredictPeakMemory_cpu(t.get_graph_node());
+			// intermediate results share their memory
+			CHECK_GE(predicted, bytes);
+			CHECK_LE(predicted, 4 * bytes);
+		}
+		t.execute();
+		for (int i = 0; i < 100; i++)
+			for (int j = 0; j < 100; j++)
+				CHECK_EQ(t[i][j], data[i][j] + 8);
+	}
+	TEST_CASE("buffer pool") {
+		fTrimMemoryPool(0);
+		const FMemoryPoolStatistics before = fMemoryPoolStatistics();
+		CHECK_EQ(before.retained_bytes, 0);
+		for (int i = 0; i < 4; i++) {
+			// same sizes in every iteration, buffers are reused
+			std::vector<std::vector<float>> data(
+				100, std::vector<float>(100, (float)i));
+			Tensor<float, 2> a(data);
+			Tensor<float, 2> b = (a + 1.0f) * 3.0f;
+			b.execute();
+			for (int j = 0; j < 100; j++)
+				CHECK_EQ(b[j][99 - j], (i + 1) * 3.0f);
+		}
+		const FMemoryPoolStatistics after = fMemoryPoolStatistics();
+		CHECK_GT(after.allocations, before.allocations);
+		CHECK_GT(after.hits, before.hits);
+		CHECK_GT(after.retained_bytes, 0);
+		fTrimMemoryPool(0);
+		CHECK_EQ(fMemoryPoolStatistics().retained_bytes, 0);
+	}
+	TEST_CASE("cost model") {
+		const std::string path =
+			(std::filesystem::temp_directory_path() / "flint_test_cost_model")
+				.string();
+		const int eager = fIsEagerExecution();
+		CHECK_EQ(fCalibrateCostModel(path.c_str()), NO_ERROR);
+		CHECK_EQ(fIsEagerExecution(), eager);
+		CHECK(std::filesystem::exists(path));
+		fResetCostModel();
+		CHECK_EQ(fLoadCostModel(path.c_str()), NO_ERROR);
+		// the decisions change, the results do not
+		std::vector<float> data(10000);
+		for (int i = 0; i < 10000; i++)
+			data[i] = i / 100.0f;
+		Tensor<float, 1> t(data);
+		Tensor<float, 1> r = (t.sin() + t * 2.0f).abs();
+		r.execute();
+		for (int i = 0; i < 10000; i++)
+			CHECK_EQ(doctest::Approx(std::abs(std::sin(data[i]) + data[i] * 2)),
+					 r[i]);
+		fResetCostModel();
+		std::filesystem::remove(path);
+	}
+	TEST_CASE("thread configuration") {
+		CHECK_GE(fNumNumaNodes(), 1);
+		// one pinned worker, one bound to the first NUMA node, one unpinned
+		const int cpus[3] = {0, -1, -1};
+		const int nodes[3] = {-1, 0, -1};
+		CHECK_EQ(fConfigureThreads_cpu(4, cpus, nodes), NO_ERROR);
+		CHECK_EQ(fNumThreads_cpu(), 4);
+		std::vector<std::vector<double>> data(64, std::vector<double>(64));
+		for (int i = 0; i < 64; i++)
+			for (int j = 0; j < 64; j++)
+				data[i][j] = (i + j) % 7;
+		Tensor<double, 2> a(data);
+		Tensor<double, 2> b = (a.matmul(a) + 1.0).transpose();
+		b.execute();
+		for (int i = 0; i < 64; i++)
+			for (int j = 0; j < 64; j++) {
+				double expected = 1;
+				for (int k = 0; k < 64; k++)
+					expected += data[j][k] * data[k][i];
+				CHECK_EQ(expected, b[i][j]);
+			}
+		CHECK_EQ(fConfigureThreads_cpu(0, nullptr, nullptr), NO_ERROR);
+	}
+	TEST_CASE("broadcasting classes") {
+		// odd sizes, so the chunks of the threads start inside of rows
+		const int rows = 37, cols = 257;
+		std::vector<std::vector<double>> data(rows, std::vector<double>(cols));
+		std::vector<int> row(cols), column(rows);
+		for (int i = 0; i < rows; i++)
+			for (int j = 0; j < cols; j++)
+				data[i][j] = i * 0.5 + j;
+		for (int j = 0; j < cols; j++)
+			row[j] = j % 13;
+		for (int i = 0; i < rows; i++)
+			column[i] = i % 5;
+		Tensor<double, 2> a(data);
+		Tensor<int, 1> r(row), c(column);
+		Tensor<double, 2> same = a - a * 0.5;
+		Tensor<double, 2> scalar = a / 2.0;
+		Tensor<double, 2> broadcast = a.max(r);
+		Tensor<double, 2> inverse = a * c;
+		Tensor<int, 2> less = c < a;
+		for (int i = 0; i < rows; i++)
+			for (int j = 0; j < cols; j++) {
+				CHECK_EQ(data[i][j] * 0.5, same[i][j]);
+				CHECK_EQ(data[i][j] / 2.0, scalar[i][j]);
+				CHECK_EQ(std::max(data[i][j], (double)row[j]), broadcast[i][j]);
+				CHECK_EQ(data[i][j] * column[i], inverse[i][j]);
+				CHECK_EQ(column[i] < data[i][j] ? 1 : 0, less[i][j]);
+			}
+	}
+	TEST_CASE("fast math") {
+		// distance of a fast result to the one of the C library in ulp
+		const auto ulps = [](auto fast, auto exact) -> double {
+			using T = decltype(exact);
+			if (std::isnan(exact) || std::isnan(fast))
+				return std::isnan(exact) && std::isnan(fast) ? 0 : INFINITY;
+			if (fast == exact)
+				return 0;
+			if (std::isinf(exact))
+				return INFINITY;
+			const T e = std::abs(exact);
+			const T ulp = std::nextafter(e, (T)INFINITY) - e;
+			return std::abs(fast - exact) / ulp;
+		};
+		const auto check = [&](auto type) {
+			using T = decltype(type);
+			std::vector<T> x, y;
+			for (int i = 0; i < 3000; i++) {
+				x.push_back((T)((i - 1500) * 0.0517));
+				x.push_back((T)std::pow(10.0, (i - 1500) * 0.02));
+			}
+			for (T v : {(T)0, (T)-0.0, (T)1, (T)-1, (T)INFINITY, (T)-INFINITY,
+						(T)NAN, std::numeric_limits<T>::denorm_min()})
+				x.push_back(v);
+			const T exponents[] = {-3, -0.5, 0, 0.5, 1.7, 2, 3, INFINITY};
+			for (size_t i = 0; i < x.size(); i++)
+				y.push_back(exponents[i % 8]);
+			Tensor<T, 1> a(x), b(y);
+			fSetMathAccuracy(F_FAST_MATH);
+			Tensor<T, 1> log = a.log(), log2 = a.log2(), log10 = a.log10(),
+						 sin = a.sin(), cos = a.cos(), tan = a.tan(),
+						 sqrt = a.sqrt(), exp = a.exp(), pow = a.pow(b);
+			log.execute();
+			log2.execute();
+			log10.execute();
+			sin.execute();
+			cos.execute();
+			tan.execute();
+			sqrt.execute();
+			exp.execute();
+			pow.execute();
+			fSetMathAccuracy(F_STRICT_MATH);
+			double max[9] = {0};
+			for (size_t i = 0; i < x.size(); i++) {
+				max[0] = std::max(max[0], ulps(log[i], std::log(x[i])));
+				max[1] = std::max(max[1], ulps(log2[i], std::log2(x[i])));
+				max[2] = std::max(max[2], ulps(log10[i], std::log10(x[i])));
+				max[3] = std::max(max[3], ulps(sin[i], std::sin(x[i])));
+				max[4] = std::max(max[4], ulps(cos[i], std::cos(x[i])));
+				max[5] = std::max(max[5], ulps(tan[i], std::tan(x[i])));
+				max[6] = std::max(max[6], ulps(sqrt[i], std::sqrt(x[i])));
+				max[7] = std::max(max[7], ulps(exp[i], std::exp(x[i])));
+				max[8] = std::max(max[8], ulps(pow[i], std::pow(x[i], y[i])));
+			}
+			// 2 ulp, 4 ulp for the tangent of doubles
+			for (int f = 0; f < 9; f++) {
+				CAPTURE(f);
+				CAPTURE(max[f]);
+				CHECK_LE(max[f], f == 5 && sizeof(T) == 8 ? 4.0 : 2.0);
+			}
+		};
+		check(0.0f);
+		check(0.0);
+		// the result may overwrite the parameter, whose out of range values
+		// are recomputed exactly
+		std::vector<double> huge(64);
+		for (size_t i = 0; i < huge.size(); i++)
+			huge[i] = 1e200 * (1 + i * 1e-3);
+		const size_t len = huge.size();
+		fSetMathAccuracy(F_FAST_MATH);
+		Tensor<double, 1> s(
+			fsin(fCreateGraph(huge.data(), len, F_FLOAT64, &len, 1)));
+		s.execute();
+		fSetMathAccuracy(F_STRICT_MATH);
+		for (size_t i = 0; i < len; i++)
+			CHECK_EQ(doctest::Approx(std::sin(huge[i])), s[i]);
+	}
+	TEST_CASE("jit compilation") {
+		namespace fs = std::filesystem;
+		// compiles into an empty cache (whose path needs quoting), so every
+		// graph that compiled leaves a library there
+		const fs::path cache =
+			fs::temp_directory_path() / "flint jit 'test' cache";
+		fs::remove_all(cache);
+		const char *previous = getenv("FLINT_JIT_CACHE");
+		const std::string previous_cache = previous ? previous : "";
+		setenv("FLINT_JIT_CACHE", cache.c_str(), 1);
+		flintCleanup_cpu_jit();
+		flintInit_cpu_jit();
+		const bool eager = fIsEagerExecution();
+		fDisableEagerExecution();
+		const auto libraries = [&]() {
+			size_t num = 0;
+			for (const auto &entry : fs::directory_iterator(cache))
+				num += entry.path().extension() == ".so";
+			return num;
+		};
+		// the identities of min and max reductions come from float.h and
+		// limits.h
+		Tensor<double, 2> a{{1, -2, 3}, {4, 5, -6}};
+		Tensor<int, 2> b{{1, -2, 3}, {4, 5, -6}};
+		Tensor<double, 1> min(
+			fExecuteGraph_cpu_jit(freduce_min(a.get_graph_node(), 1)));
+		CHECK_EQ(libraries(), 1);
+		Tensor<int, 1> max(
+			fExecuteGraph_cpu_jit(freduce_max(b.get_graph_node(), 1)));
+		CHECK_EQ(libraries(), 2);
+		CHECK_EQ(-2, min[0]);
+		CHECK_EQ(-6, min[1]);
+		CHECK_EQ(3, max[0]);
+		CHECK_EQ(5, max[1]);
+		// the batch normalization kernels use rsqrt
+		Tensor<double, 1> gamma{1, 2, 3}, beta{0, 1, 0};
+		Tensor<double, 2> moments(fExecuteGraph_cpu_jit(
+			fbatch_moments(a.get_graph_node(), 1)));
+		CHECK_EQ(libraries(), 3);
+		Tensor<double, 2> y(fExecuteGraph_cpu_jit(
+			fbatch_norm(a.get_graph_node(), moments.get_graph_node(),
+						gamma.get_graph_node(), beta.get_graph_node(), 1, 0)));
+		CHECK_EQ(libraries(), 4);
+		CHECK_EQ(doctest::Approx(20.25), moments[1][2]);
+		// (-2 - 1.5) / sqrt(12.25) * 2 + 1
+		CHECK_EQ(doctest::Approx(-1), y[0][1]);
+		flintCleanup_cpu_jit();
+		if (previous)
+			setenv("FLINT_JIT_CACHE", previous_cache.c_str(), 1);
+		else
+			unsetenv("FLINT_JIT_CACHE");
+		if (eager)
+			fEnableEagerExecution();
+		fs::remove_all(cache);
+	}
 }
 #include <chrono>
 TEST_SUITE("Operation Implementations") {
@@ -948,6 +1313,84 @@ TEST_SUITE("Operation Implementations") {
 				for (int k = 0; k < e1.get_shape()[0]; k++)
 					CHECK_EQ(r1[i][j][k], e1[i][j][k]);
 	}
+	TEST_CASE("Convolve Lowering") {
+		// enough elements per filter to be lowered to matrix multiplications,
+		// split by threads inside of windows
+		CHECK_EQ(fConfigureThreads_cpu(3, nullptr, nullptr), NO_ERROR);
+		using namespace std;
+		vector<vector<vector<vector<float>>>> img(
+			2, vector<vector<vector<float>>>(
+				   11, vector<vector<float>>(9, vector<float>(6))));
+		vector<vector<vector<vector<vector<double>>>>> ker(
+			5, vector<vector<vector<vector<double>>>>(
+				   1, vector<vector<vector<double>>>(
+						  3, vector<vector<double>>(3, vector<double>(6)))));
+		for (int b = 0; b < 2; b++)
+			for (int i = 0; i < 11; i++)
+				for (int j = 0; j < 9; j++)
+					for (int c = 0; c < 6; c++)
+						img[b][i][j][c] = (b * 7 + i * 5 + j * 3 + c) % 9 - 4;
+		for (int f = 0; f < 5; f++)
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					for (int c = 0; c < 6; c++)
+						ker[f][0][i][j][c] = (f * 3 + i * 2 + j + c * 5) % 7 - 3;
+		Tensor<float, 4> t(img);
+		Tensor<double, 5> k(ker);
+		Tensor<double, 4> multi = t.convolve(k, 1, 2, 1);
+		Tensor<double, 4> k2 = k.slice(TensorRange(2, 3)).reshape(1, 3, 3, 6);
+		Tensor<double, 3> single = t.convolve(k2, 1, 2, 1);
+		CHECK_EQ(multi.get_shape(), std::array<size_t, 4>{2, 5, 7, 5});
+		for (int b = 0; b < 2; b++)
+			for (int i = 0; i < 5; i++)
+				for (int j = 0; j < 7; j++)
+					for (int f = 0; f < 5; f++) {
+						double expected = 0;
+						for (int y = 0; y < 3; y++)
+							for (int x = 0; x < 3; x++)
+								for (int c = 0; c < 6; c++)
+									expected += img[b][i * 2 + y][j + x][c] *
+												ker[f][0][y][x][c];
+						CHECK_EQ(expected, multi[b][i][j][f]);
+						if (f == 2)
+							CHECK_EQ(expected, single[b][i][j]);
+					}
+		CHECK_EQ(fConfigureThreads_cpu(0, nullptr, nullptr), NO_ERROR);
+	}
+	TEST_CASE("Convolve Algorithms") {
+		// the specialized kernels of the cpu backend against the generic one:
+		// Winograd F(2x2, 3x3) and F(4x4, 3x3), 1x1, a kernel that is too
+		// small for the lowering and im2col
+		struct Layer {
+				size_t size, channels, filters, kernel;
+				unsigned int step;
+		};
+		for (const Layer &l : {Layer{8, 8, 8, 3, 1}, Layer{14, 9, 10, 3, 1},
+							   Layer{9, 20, 7, 1, 1}, Layer{9, 1, 5, 3, 1},
+							   Layer{9, 8, 8, 3, 2}}) {
+			Tensor<float, 4> x =
+				(Flint::random(2, l.size, l.size - 1, l.channels) * 4 - 2)
+					.convert<float>();
+			Tensor<float, 5> k =
+				(Flint::random(l.filters, 1, l.kernel, l.kernel, l.channels) -
+				 0.5)
+					.convert<float>();
+			x.execute();
+			k.execute();
+			fSetConvolutionAlgorithm(F_CONV_GENERIC);
+			Tensor<float, 4> expected = x.convolve(k, 1, l.step, 1)();
+			fSetConvolutionAlgorithm(F_CONV_AUTO);
+			Tensor<float, 4> y = x.convolve(k, 1, l.step, 1)();
+			const auto shape = expected.get_shape();
+			for (size_t b = 0; b < shape[0]; b++)
+				for (size_t i = 0; i < shape[1]; i++)
+					for (size_t j = 0; j < shape[2]; j++)
+						for (size_t f = 0; f < shape[3]; f++)
+							CHECK_EQ(doctest::Approx(expected[b][i][j][f])
+										 .epsilon(0.0001),
+									 y[b][i][j][f]);
+		}
+	}
 	TEST_CASE("Total Reduce") {
 		Tensor<float, 2> t1{{-1., 1.}, {1., 2.}, {4, 1}, {-0.5, -0.5}};
 		Tensor<float, 1> r1 = t1.flattened().reduce_sum();
@@ -955,6 +1398,564 @@ TEST_SUITE("Operation Implementations") {
 		r1 = t1.flattened().reduce_mul();
 		CHECK_EQ(r1[0], -2);
 	}
+	TEST_CASE("Multi-axis Reduce") {
+		Tensor<int, 3> a{{{0, 1, 32, 5}, {2, 3, 4, -8}, {1, 1, 1, 1}},
+						 {{4, 5, -6, 2}, {6, 7, -1, 0}, {9, -3, 2, 7}}};
+		const int first[2] = {0, 1}, outer[2] = {0, 2}, last[2] = {-1, 1};
+		const int all[3] = {2, 0, 1};
+		Tensor<int, 1> s1(freduce_sum_axes(a.get_graph_node(), first, 2, false),
+						  4);
+		Tensor<int, 1> s2(freduce_sum_axes(a.get_graph_node(), outer, 2, false),
+						  3);
+		Tensor<int, 3> s3(freduce_sum_axes(a.get_graph_node(), last, 2, true),
+						  {2, 1, 1});
+		Tensor<int, 1> s4(freduce_sum_axes(a.get_graph_node(), all, 3, false),
+						  1);
+		Tensor<int, 1> mn(freduce_min_axes(a.get_graph_node(), outer, 2, false),
+						  3);
+		Tensor<int, 1> mx(freduce_max_axes(a.get_graph_node(), first, 2, false),
+						  4);
+		Tensor<double, 2> mean(
+			freduce_mean_axes(a.get_graph_node(), last, 2, false), {2, 1});
+		int total = 0;
+		for (int k = 0; k < 4; k++) {
+			int sum = 0, max = std::numeric_limits<int>::min();
+			for (int i = 0; i < 2; i++)
+				for (int j = 0; j < 3; j++) {
+					sum += a[i][j][k];
+					max = std::max(max, a[i][j][k]);
+				}
+			CHECK_EQ(sum, s1[k]);
+			CHECK_EQ(max, mx[k]);
+			total += sum;
+		}
+		for (int j = 0; j < 3; j++) {
+			int sum = 0, min = std::numeric_limits<int>::max();
+			for (int i = 0; i < 2; i++)
+				for (int k = 0; k < 4; k++) {
+					sum += a[i][j][k];
+					min = std::min(min, a[i][j][k]);
+				}
+			CHECK_EQ(sum, s2[j]);
+			CHECK_EQ(min, mn[j]);
+		}
+		CHECK_EQ(43, s3[0][0][0]);
+		CHECK_EQ(32, s3[1][0][0]);
+		CHECK_EQ(doctest::Approx(43 / 12.0), mean[0][0]);
+		CHECK_EQ(doctest::Approx(32 / 12.0), mean[1][0]);
+		CHECK_EQ(total, s4[0]);
+		CHECK_EQ(total, a.reduce_sum()[0]);
+	}
+	TEST_CASE("Tiled Transpose") {
+		// shapes that are not multiples of the tiles, split between threads
+		CHECK_EQ(fConfigureThreads_cpu(3, nullptr, nullptr), NO_ERROR);
+		using namespace std;
+		vector<vector<vector<vector<int>>>> data(
+			3, vector<vector<vector<int>>>(
+				   37, vector<vector<int>>(5, vector<int>(70))));
+		for (int a = 0; a < 3; a++)
+			for (int b = 0; b < 37; b++)
+				for (int c = 0; c < 5; c++)
+					for (int d = 0; d < 70; d++)
+						data[a][b][c][d] = ((a * 37 + b) * 5 + c) * 70 + d;
+		Tensor<int, 4> t(data);
+		Tensor<int, 4> t1 = t.transpose({0, 3, 2, 1})();
+		Tensor<int, 4> t2 = t.transpose({3, 1, 2, 0})();
+		Tensor<int, 2> m = t.reshape(111, 350).transpose()();
+		for (int a = 0; a < 3; a++)
+			for (int b = 0; b < 37; b++)
+				for (int c = 0; c < 5; c++)
+					for (int d = 0; d < 70; d++) {
+						CHECK_EQ(data[a][b][c][d], t1[a][d][c][b]);
+						CHECK_EQ(data[a][b][c][d], t2[d][b][c][a]);
+						CHECK_EQ(data[a][b][c][d],
+								 m[c * 70 + d][a * 37 + b]);
+					}
+		CHECK_EQ(fConfigureThreads_cpu(0, nullptr, nullptr), NO_ERROR);
+	}
+	TEST_CASE("Split Reduce") {
+		// long reductions to few results are split into parts, the result may
+		// not depend on the number of threads
+		using namespace std;
+		const size_t n = 1000003;
+		vector<float> data(n);
+		double expected = 0;
+		for (size_t i = 0; i < n; i++) {
+			data[i] = (float)((i * 7919) % 1000) / 1000.0f;
+			expected += data[i];
+		}
+		vector<vector<float>> columns(n / 3, vector<float>(3));
+		for (size_t i = 0; i < n / 3; i++)
+			for (int j = 0; j < 3; j++)
+				columns[i][j] = data[i * 3 + j] - j;
+		Tensor<float, 1> t(data);
+		Tensor<float, 2> c(columns);
+		vector<float> sums;
+		for (unsigned int threads : {1u, 4u, 0u}) {
+			CHECK_EQ(fConfigureThreads_cpu(threads, nullptr, nullptr),
+					 NO_ERROR);
+			Tensor<float, 1> sum = t.reduce_sum()();
+			sums.push_back(sum[0]);
+			CHECK_EQ(doctest::Approx(expected).epsilon(0.000001), sum[0]);
+			Tensor<float, 1> min = c.reduce_min(0)();
+			Tensor<float, 1> max = c.reduce_max(0)();
+			for (int j = 0; j < 3; j++) {
+				CHECK_EQ(-j, min[j]);
+				CHECK_EQ(0.999f - j, max[j]);
+			}
+		}
+		CHECK_EQ(sums[0], sums[1]);
+		CHECK_EQ(sums[0], sums[2]);
+	}
+	TEST_CASE("Views") {
+		// reshapes and slices of contiguous ranges share the buffer of their
+		// parameter
+		using namespace std;
+		vector<vector<float>> data(6, vector<float>(4));
+		for (int i = 0; i < 6; i++)
+			for (int j = 0; j < 4; j++)
+				data[i][j] = i * 4 + j;
+		Tensor<float, 3> r;
+		Tensor<float, 2> s, c, n;
+		Tensor<float, 1> l;
+		{
+			Tensor<float, 2> t(data);
+			t.execute();
+			const float *base =
+				(const float *)t.get_graph_node()->result_data->data;
+			r = t.reshape(2, 3, 4)();
+			s = t.slice(TensorRange(2, 5))();
+			c = t.slice(TensorRange(1, 2), TensorRange(1, 3))();
+			n = t.slice(TensorRange(0, 6), TensorRange(1, 3))();
+			l = t.flattened().slice(TensorRange(4, 12))();
+			CHECK_EQ(base, r.get_graph_node()->result_data->data);
+			CHECK_EQ(base + 8, s.get_graph_node()->result_data->data);
+			CHECK_EQ(base + 5, c.get_graph_node()->result_data->data);
+			CHECK_EQ(base + 4, l.get_graph_node()->result_data->data);
+			CHECK_NE(base + 1, n.get_graph_node()->result_data->data);
+			// consumers must not overwrite the shared buffer
+			Tensor<float, 3> r1 = (r + 1.0f)();
+			Tensor<float, 1> l1 = ((t * 2.0f).flattened().slice(
+									   TensorRange(4, 12)) -
+								   1.0f)();
+			for (int i = 0; i < 8; i++) {
+				CHECK_EQ(i + 4, l[i]);
+				CHECK_EQ(2 * (i + 4) - 1, l1[i]);
+			}
+			for (int i = 0; i < 24; i++) {
+				CHECK_EQ(i + 1, r1[i / 12][i / 4 % 3][i % 4]);
+				CHECK_EQ(i, t[i / 4][i % 4]);
+			}
+		}
+		// the views keep the buffer alive
+		for (int i = 0; i < 24; i++)
+			CHECK_EQ(i, r[i / 12][i / 4 % 3][i % 4]);
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 4; j++)
+				CHECK_EQ(data[i + 2][j], s[i][j]);
+		CHECK_EQ(5, c[0][0]);
+		CHECK_EQ(6, c[0][1]);
+		for (int i = 0; i < 6; i++)
+			for (int j = 0; j < 2; j++)
+				CHECK_EQ(data[i][j + 1], n[i][j]);
+	}
+	TEST_CASE("Strided Layouts") {
+		// transpositions, slices and broadcasts that are only read by their
+		// consumers are gathered from the data of their parameter
+		using namespace std;
+		CHECK_EQ(fConfigureThreads_cpu(3, nullptr, nullptr), NO_ERROR);
+		vector<vector<vector<float>>> data(
+			5, vector<vector<float>>(6, vector<float>(7)));
+		for (int i = 0; i < 5; i++)
+			for (int j = 0; j < 6; j++)
+				for (int k = 0; k < 7; k++)
+					data[i][j][k] = i * 42 + j * 7 + k;
+		Tensor<float, 3> t(data);
+		// 7 x 6 x 5
+		Tensor<float, 3> a =
+			(t.transpose().slice(TensorRange(1, 7, 2), TensorRange(5, 0, -2)) *
+				 2.0f +
+			 1.0f)();
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				for (int k = 0; k < 5; k++)
+					CHECK_EQ(data[k][5 - 2 * j][1 + 2 * i] * 2 + 1, a[i][j][k]);
+		// the rearranged node itself is the result
+		Tensor<float, 3> b =
+			t.slice(TensorRange(4, 0, -1)).transpose({1, 0, 2})();
+		for (int i = 0; i < 6; i++)
+			for (int j = 0; j < 4; j++)
+				for (int k = 0; k < 7; k++)
+					CHECK_EQ(data[4 - j][i][k], b[i][j][k]);
+		// broadcasts of size 1 dimensions
+		Tensor<float, 1> row{1, 2, 3, 4, 5, 6, 7};
+		Tensor<float, 4> c =
+			(t.expand(0, 2) - row.expand(0, 6).expand(0, 5).expand(0, 2))();
+		for (int h = 0; h < 2; h++)
+			for (int i = 0; i < 5; i++)
+				for (int j = 0; j < 6; j++)
+					for (int k = 0; k < 7; k++)
+						CHECK_EQ(data[i][j][k] - k - 1, c[h][i][j][k]);
+		// a rearrangement that is read by a consumer that needs it dense
+		Tensor<float, 2> m{{1, 0}, {0, 1}, {1, 1}, {2, 0}, {0, 0}};
+		Tensor<float, 3> d =
+			t.transpose({2, 1, 0})
+				.slice(TensorRange(0, 7), TensorRange(0, 6),
+					   TensorRange(TensorRange::MAX_SCOPE,
+								   TensorRange::MAX_SCOPE, -1))
+				.matmul(m)();
+		for (int i = 0; i < 7; i++)
+			for (int j = 0; j < 6; j++) {
+				CHECK_EQ(data[4][j][i] + data[2][j][i] + data[1][j][i] * 2,
+						 d[i][j][0]);
+				CHECK_EQ(data[3][j][i] + data[2][j][i], d[i][j][1]);
+			}
+		CHECK_EQ(fConfigureThreads_cpu(0, nullptr, nullptr), NO_ERROR);
+	}
+	TEST_CASE("Half Precision") {
+		// the 16bit types are computed in float and rounded when stored
+		using namespace std;
+		CHECK_EQ(higher_type(F_FLOAT16, F_BFLOAT16), F_FLOAT32);
+		CHECK_EQ(higher_type(F_FLOAT16, F_INT64), F_FLOAT16);
+		CHECK_EQ(higher_type(F_BFLOAT16, F_FLOAT32), F_FLOAT32);
+		Tensor<float, 2> t{{1, 2, 3}, {4, 5, 6}};
+		FGraphNode *h = fconvert(t.get_graph_node(), F_FLOAT16);
+		FGraphNode *b = fconvert(t.get_graph_node(), F_BFLOAT16);
+		h->reference_counter++;
+		b->reference_counter++;
+		FGraphNode *hd = fdiv(h, 3.0f);
+		FGraphNode *bd = fdiv(b, 3.0f);
+		CHECK_EQ(hd->operation.data_type, F_FLOAT16);
+		CHECK_EQ(bd->operation.data_type, F_BFLOAT16);
+		Tensor<float, 2> thd(fconvert(hd, F_FLOAT32));
+		Tensor<float, 2> tbd(fconvert(bd, F_FLOAT32));
+		CHECK_EQ(thd[0][0], 0.333251953125f);
+		CHECK_EQ(tbd[0][0], 0.333984375f);
+		for (int i = 0; i < 2; i++)
+			for (int j = 0; j < 3; j++) {
+				CHECK_LE(abs(thd[i][j] - t[i][j] / 3), t[i][j] / 3 / 1024);
+				CHECK_LE(abs(tbd[i][j] - t[i][j] / 3), t[i][j] / 3 / 128);
+			}
+		// matrix multiplication accumulates in float
+		int transposition[] = {1, 0};
+		FGraphNode *hm = fmatmul(h, ftranspose(h, transposition));
+		CHECK_EQ(hm->operation.data_type, F_FLOAT16);
+		Tensor<double, 2> thm(fconvert(hm, F_FLOAT64));
+		CHECK_EQ(thm[0][0], 14);
+		CHECK_EQ(thm[0][1], 32);
+		CHECK_EQ(thm[1][1], 77);
+		FGraphNode *bs = freduce_sum(b, 1);
+		CHECK_EQ(bs->operation.data_type, F_BFLOAT16);
+		Tensor<float, 1> tbs(fconvert(bs, F_FLOAT32));
+		CHECK_EQ(tbs[0], 6);
+		CHECK_EQ(tbs[1], 15);
+		// mixing both storage types widens to float
+		FGraphNode *hb = fadd(h, b);
+		CHECK_EQ(hb->operation.data_type, F_FLOAT32);
+		Tensor<float, 2> thb(hb);
+		CHECK_EQ(thb[1][2], 12);
+		h->reference_counter--;
+		b->reference_counter--;
+		// data is passed as bit patterns
+		const uint16_t bits[] = {0x3c00, 0xc000, 0x3555};
+		const size_t shape = 3;
+		Tensor<double, 1> tb(fconvert(
+			fCreateGraph(bits, 3, F_FLOAT16, &shape, 1), F_FLOAT64));
+		CHECK_EQ(tb[0], 1);
+		CHECK_EQ(tb[1], -2);
+		CHECK_EQ(tb[2], 0.333251953125);
+	}
+	TEST_CASE("Quantization") {
+		using namespace std;
+		CHECK_EQ(higher_type(F_INT8, F_INT8), F_INT8);
+		CHECK_EQ(higher_type(F_INT8, F_UINT8), F_INT32);
+		const size_t one = 1, two = 2;
+		// one scale for the whole tensor, rounded to the nearest even integer
+		Tensor<float, 2> t{{-1, 0.25, 0.75}, {1, 2.6, -300}};
+		FGraphNode *q = fquantize(t.get_graph_node(), fconstant_f(0.5, &one, 1),
+								  fconstant_i(0, &one, 1), F_INT8);
+		CHECK_EQ(q->operation.data_type, F_INT8);
+		q->reference_counter++;
+		Tensor<int, 2> tq(fconvert(q, F_INT32));
+		CHECK_EQ(tq[0][0], -2);
+		CHECK_EQ(tq[0][1], 0);
+		CHECK_EQ(tq[0][2], 2);
+		CHECK_EQ(tq[1][1], 5);
+		CHECK_EQ(tq[1][2], -128);
+		Tensor<float, 2> tdq(fdequantize(q, fconstant_f(0.5, &one, 1),
+										 fconstant_i(0, &one, 1)));
+		CHECK_EQ(tdq[0][0], -1);
+		CHECK_EQ(tdq[1][1], 2.5);
+		CHECK_EQ(tdq[1][2], -64);
+		q->reference_counter--;
+		// NaN has no integer representation and becomes the zero point
+		Tensor<float, 1> nan{NAN, 1, -NAN};
+		Tensor<int, 1> tnan(fconvert(
+			fquantize(nan.get_graph_node(), fconstant_f(0.5, &one, 1),
+					  fconstant_i(3, &one, 1), F_UINT8),
+			F_INT32));
+		CHECK_EQ(tnan[0], 3);
+		CHECK_EQ(tnan[1], 5);
+		CHECK_EQ(tnan[2], 3);
+		// one scale and zero point per row
+		const float scales[] = {0.5, 2};
+		const int zero_points[] = {10, 128};
+		FGraphNode *s = fCreateGraph(scales, 2, F_FLOAT32, &two, 1);
+		FGraphNode *z = fCreateGraph(zero_points, 2, F_INT32, &two, 1);
+		fEnforceInverseBroadcasting(s);
+		fEnforceInverseBroadcasting(z);
+		FGraphNode *u = fquantize(t.get_graph_node(), s, z, F_UINT8);
+		u->reference_counter++;
+		Tensor<int, 2> tu(fconvert(u, F_INT32));
+		CHECK_EQ(tu[0][0], 8);
+		CHECK_EQ(tu[0][2], 12);
+		CHECK_EQ(tu[1][0], 128);
+		CHECK_EQ(tu[1][1], 129);
+		CHECK_EQ(tu[1][2], 0);
+		Tensor<float, 2> tdu(fdequantize(u, s, z));
+		CHECK_EQ(tdu[0][1], 0);
+		CHECK_EQ(tdu[1][1], 2);
+		CHECK_EQ(tdu[1][2], -256);
+		u->reference_counter--;
+		// products of 8bit matrices are accumulated in int
+		const size_t sa[] = {37, 70}, sb[] = {70, 33};
+		vector<int8_t> da(37 * 70), db(70 * 33);
+		for (size_t i = 0; i < da.size(); i++)
+			da[i] = (i * 7) % 255 - 127;
+		for (size_t i = 0; i < db.size(); i++)
+			db[i] = (i * 5) % 13 - 6;
+		FGraphNode *a = fCreateGraph(da.data(), da.size(), F_INT8, sa, 2);
+		FGraphNode *b = fCreateGraph(db.data(), db.size(), F_INT8, sb, 2);
+		a->reference_counter++;
+		b->reference_counter++;
+		FGraphNode *ab = fmatmul(a, b);
+		CHECK_EQ(ab->operation.data_type, F_INT32);
+		Tensor<int, 2> tab(ab);
+		Tensor<int, 2> expected(
+			fmatmul(fconvert(a, F_INT32), fconvert(b, F_INT32)));
+		for (int i = 0; i < 37; i++)
+			for (int j = 0; j < 33; j++)
+				CHECK_EQ(tab[i][j], expected[i][j]);
+		a->reference_counter--;
+		b->reference_counter--;
+		// and so are convolutions
+		const size_t si[] = {11, 9, 6}, sk[] = {5, 3, 3, 6};
+		vector<uint8_t> di(11 * 9 * 6);
+		vector<int8_t> dk(5 * 3 * 3 * 6);
+		for (size_t i = 0; i < di.size(); i++)
+			di[i] = (i * 11) % 256;
+		for (size_t i = 0; i < dk.size(); i++)
+			dk[i] = (i * 3) % 15 - 7;
+		FGraphNode *img = fCreateGraph(di.data(), di.size(), F_UINT8, si, 3);
+		FGraphNode *ker = fCreateGraph(dk.data(), dk.size(), F_INT8, sk, 4);
+		img->reference_counter++;
+		ker->reference_counter++;
+		const unsigned int steps[] = {1, 2};
+		FGraphNode *conv = fconvolve(img, ker, steps);
+		CHECK_EQ(conv->operation.data_type, F_INT32);
+		Tensor<int, 3> tconv(conv);
+		Tensor<int, 3> econv(
+			fconvolve(fconvert(img, F_INT32), fconvert(ker, F_INT32), steps));
+		CHECK_EQ(tconv.get_shape(), econv.get_shape());
+		for (int i = 0; i < 9; i++)
+			for (int j = 0; j < 4; j++)
+				for (int f = 0; f < 5; f++)
+					CHECK_EQ(tconv[i][j][f], econv[i][j][f]);
+		img->reference_counter--;
+		ker->reference_counter--;
+		// sums and products of 8bit tensors do not wrap around, means are
+		// not truncated
+		const size_t four = 4;
+		const int8_t dr[] = {100, 100, 100, 100}, dm[] = {1, 2, 2, 2};
+		FGraphNode *r = fCreateGraph(dr, 4, F_INT8, &four, 1);
+		r->reference_counter++;
+		FGraphNode *rs = freduce_sum(r, 0);
+		CHECK_EQ(rs->operation.data_type, F_INT32);
+		Tensor<int, 1> trs(rs);
+		CHECK_EQ(trs[0], 400);
+		Tensor<int, 1> trm(freduce_mul(r, 0));
+		CHECK_EQ(trm[0], 100000000);
+		r->reference_counter--;
+		const int mean_axis = 0;
+		FGraphNode *mean = freduce_mean_axes(
+			fCreateGraph(dm, 4, F_INT8, &four, 1), &mean_axis, 1, false);
+		CHECK_EQ(mean->operation.data_type, F_FLOAT64);
+		Tensor<double, 1> tmean(mean);
+		CHECK_EQ(tmean[0], 1.75);
+	}
+	TEST_CASE("Sparse") {
+		using namespace std;
+		// unsorted coordinates with a duplicate
+		const size_t rows[] = {2, 0, 1, 0, 2}, columns[] = {1, 3, 0, 3, 3};
+		const size_t shape[] = {3, 4};
+		Tensor<float, 1> values{5, 1, -2, 2, 4};
+		FGraphNode *a = fsparse(values.get_graph_node(), rows, columns, shape);
+		a->reference_counter++;
+		Tensor<float, 2> b{{1, 2}, {3, 4}, {5, 6}, {7, 8}};
+		Tensor<float, 2> ab(fmatmul(a, b.get_graph_node()));
+		CHECK_EQ(ab.get_shape()[0], 3);
+		CHECK_EQ(ab.get_shape()[1], 2);
+		CHECK_EQ(ab[0][0], 21);
+		CHECK_EQ(ab[0][1], 24);
+		CHECK_EQ(ab[1][0], -2);
+		CHECK_EQ(ab[1][1], -4);
+		CHECK_EQ(ab[2][0], 43);
+		CHECK_EQ(ab[2][1], 52);
+		// every other operation sees the dense matrix
+		Tensor<float, 2> dense(fadd(a, 0.0f));
+		CHECK_EQ(dense[0][3], 3);
+		CHECK_EQ(dense[0][0], 0);
+		CHECK_EQ(dense[1][0], -2);
+		CHECK_EQ(dense[2][1], 5);
+		CHECK_EQ(dense[2][2], 0);
+		// constants only store one element
+		const size_t cshape[] = {4, 2};
+		Tensor<float, 2> ac(fmatmul(a, fconstant_f(1, cshape, 2)));
+		const float row_sums[] = {3, -2, 9};
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 2; j++)
+				CHECK_EQ(row_sums[i], ac[i][j]);
+		a->reference_counter--;
+		fFreeGraph(a);
+		// compared with the dense product
+		vector<size_t> r, c;
+		vector<int> v;
+		for (size_t i = 0; i < 400; i++) {
+			r.push_back((i * 13) % 37);
+			c.push_back((i * 29) % 53);
+			v.push_back(i % 11 - 5);
+		}
+		const size_t sshape[] = {37, 53}, bshape[] = {53, 17}, nnz = 400;
+		vector<int> db(53 * 17);
+		for (size_t i = 0; i < db.size(); i++)
+			db[i] = (i * 7) % 9 - 4;
+		FGraphNode *s = fsparse(fCreateGraph(v.data(), v.size(), F_INT32,
+											  &nnz, 1),
+								r.data(), c.data(), sshape);
+		FGraphNode *m = fCreateGraph(db.data(), db.size(), F_INT32, bshape, 2);
+		s->reference_counter++;
+		m->reference_counter++;
+		Tensor<int, 2> sm(fmatmul(s, m));
+		Tensor<int, 2> expected(fmatmul(fadd(s, 0), m));
+		for (int i = 0; i < 37; i++)
+			for (int j = 0; j < 17; j++)
+				CHECK_EQ(sm[i][j], expected[i][j]);
+		s->reference_counter--;
+		m->reference_counter--;
+		fFreeGraph(s);
+		fFreeGraph(m);
+	}
+	TEST_CASE("Softmax") {
+		Tensor<double, 3> a = Flint::random(4, 5, 6) * 10 - 5;
+		for (int ax = 0; ax < 3; ax++) {
+			Tensor<double, 3> e = a.exp();
+			Tensor<double, 3> expected(fdiv(
+				e.get_graph_node(),
+				fexpand(freduce_sum(e.get_graph_node(), ax), ax,
+						a.get_shape()[ax])));
+			Tensor<double, 3> s = a.softmax(ax);
+			Tensor<double, 3> l = a.log_softmax(ax);
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 5; j++)
+					for (int k = 0; k < 6; k++) {
+						CHECK_EQ(doctest::Approx(expected[i][j][k]),
+								 s[i][j][k]);
+						CHECK_EQ(doctest::Approx(std::log(expected[i][j][k])),
+								 l[i][j][k]);
+					}
+		}
+		// large values do not overflow
+		Tensor<float, 2> b{{1000, 1001, 999}, {-3, 0, 3}};
+		Tensor<float, 2> sb = b.softmax(1);
+		CHECK_EQ(doctest::Approx(0.2447285f), sb[0][0]);
+		CHECK_EQ(doctest::Approx(0.6652410f), sb[0][1]);
+		CHECK_EQ(doctest::Approx(0.0900305f), sb[0][2]);
+		CHECK_EQ(doctest::Approx(0.0023556f), sb[1][0]);
+		Tensor<float, 2> lb = b.log_softmax(1);
+		CHECK_EQ(doctest::Approx(-6.0509458f), lb[1][0]);
+		// cross entropy with a distribution and with class indices
+		Tensor<float, 2> labels{{0, 1, 0}, {0.5, 0, 0.5}};
+		Tensor<float, 1> ce(
+			fsoftmax_cross_entropy(b.get_graph_node(),
+								   labels.get_graph_node(), 1));
+		CHECK_EQ(ce.get_shape()[0], 2);
+		CHECK_EQ(doctest::Approx(0.4076059f), ce[0]);
+		CHECK_EQ(doctest::Approx(3.0509458f), ce[1]);
+		Tensor<int, 1> classes{2, 0};
+		Tensor<float, 1> ci(
+			fsoftmax_cross_entropy(b.get_graph_node(),
+								   classes.get_graph_node(), 1));
+		CHECK_EQ(doctest::Approx(2.4076059f), ci[0]);
+		CHECK_EQ(doctest::Approx(6.0509458f), ci[1]);
+		// along the first dimension
+		Tensor<long, 1> first{1, 0, 1};
+		Tensor<float, 1> cf(
+			fsoftmax_cross_entropy(b.get_graph_node(),
+								   first.get_graph_node(), 0));
+		CHECK_EQ(cf.get_shape()[0], 3);
+		Tensor<float, 2> lf = b.log_softmax(0);
+		CHECK_EQ(doctest::Approx(-lf[1][0]), cf[0]);
+		CHECK_EQ(doctest::Approx(-lf[0][1]), cf[1]);
+		CHECK_EQ(doctest::Approx(-lf[1][2]), cf[2]);
+	}
+	TEST_CASE("Batch Norm") {
+		Tensor<double, 3> a = Flint::random(3, 4, 5) * 10 + 100;
+		Tensor<double, 1> gamma{0.5, 2, -1, 1.5, 3};
+		Tensor<double, 1> beta{1, 0, -2, 0.25, 4};
+		const double eps = 1e-5;
+		for (int ax = 0; ax < 3; ax++) {
+			const size_t channels = a.get_shape()[ax];
+			Tensor<double, 2> moments(fbatch_moments(a.get_graph_node(), ax));
+			CHECK_EQ(moments.get_shape()[0], 2);
+			CHECK_EQ(moments.get_shape()[1], channels);
+			std::vector<double> mean(channels, 0), var(channels, 0);
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 4; j++)
+					for (int k = 0; k < 5; k++) {
+						const int c = ax == 0 ? i : ax == 1 ? j : k;
+						mean[c] += a[i][j][k] * channels / 60;
+					}
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 4; j++)
+					for (int k = 0; k < 5; k++) {
+						const int c = ax == 0 ? i : ax == 1 ? j : k;
+						var[c] += (a[i][j][k] - mean[c]) *
+								  (a[i][j][k] - mean[c]) * channels / 60;
+					}
+			for (size_t c = 0; c < channels; c++) {
+				CHECK_EQ(doctest::Approx(mean[c]), moments[0][c]);
+				CHECK_EQ(doctest::Approx(var[c]), moments[1][c]);
+			}
+			Tensor<double, 1> g = gamma.slice(TensorRange(0, channels));
+			Tensor<double, 1> b = beta.slice(TensorRange(0, channels));
+			Tensor<double, 3> y(fbatch_norm(
+				a.get_graph_node(), moments.get_graph_node(),
+				g.get_graph_node(), b.get_graph_node(), ax, eps));
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 4; j++)
+					for (int k = 0; k < 5; k++) {
+						const int c = ax == 0 ? i : ax == 1 ? j : k;
+						CHECK_EQ(doctest::Approx((a[i][j][k] - mean[c]) /
+													 std::sqrt(var[c] + eps) *
+													 gamma[c] +
+												 beta[c]),
+								 y[i][j][k]);
+					}
+		}
+		// running statistics in a different type
+		Tensor<float, 2> x{{1, 2}, {3, 6}};
+		Tensor<double, 2> running{{1, 2}, {4, 1}};
+		Tensor<float, 1> one{1, 1};
+		Tensor<float, 1> zero{0, 0};
+		Tensor<float, 2> z(fbatch_norm(x.get_graph_node(),
+									   running.get_graph_node(),
+									   one.get_graph_node(),
+									   zero.get_graph_node(), 1, 0));
+		CHECK_EQ(doctest::Approx(0), z[0][0]);
+		CHECK_EQ(doctest::Approx(0), z[0][1]);
+		CHECK_EQ(doctest::Approx(1), z[1][0]);
+		CHECK_EQ(doctest::Approx(4), z[1][1]);
+	}
 	TEST_CASE("Concat") {
 		Tensor<float, 2> t1{{-1., 1.}, {1., 2.}, {4, 1}, {-0.5, -0.5}};
 		Tensor<float, 2> t2{{0, 0}, {3.141592, 42}};
@@ -1394,7 +2395,7 @@ TEST_SUITE("Advanced Broadcasting") {
 }
 int main(int argc, char **argv) {
 	fSetLoggingLevel(F_VERBOSE);
-	bool doCPU = false, doGPU = false, eager = false;
+	bool doCPU = false, doGPU = false, eager = false, jit = false;
 	for (int i = 0; i < argc; i++) {
 		std::string arg(argv[i]);
 		if (arg == "cpu")
@@ -1403,6 +2404,8 @@ int main(int argc, char **argv) {
 			doGPU = true;
 		if (arg == "eager")
 			eager = true;
+		if (arg == "jit")
+			doCPU = jit = true;
 	}
 	if (!doCPU && !doGPU) {
 		doCPU = doGPU = true;
@@ -1413,7 +2416,7 @@ int main(int argc, char **argv) {
 	context.applyCommandLine(argc, argv);
 	int res;
 	if (doCPU) {
-		flintInit(FLINT_BACKEND_ONLY_CPU);
+		flintInit(jit ? FLINT_BACKEND_CPU_JIT : FLINT_BACKEND_ONLY_CPU);
 		res = context.run();
 		flintCleanup();
 	}